@@ -110,7 +110,9 @@ Action::Kill::~Kill(void)
 void
 Action::Kill::operator()(const UserEntryPtr user)
 {
-  server.kill(this->client_->handleAndBot(), user->getNick(), this->reason_);
+  IRC::Context context(user->getServer());
+
+  server().kill(this->client_->handleAndBot(), user->getNick(), this->reason_);
 }
 
 
@@ -0,0 +1,364 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+#include <functional>
+#include <ctime>
+
+// Boost C++ Headers
+#include <boost/lexical_cast.hpp>
+
+// OOMon Headers
+#include "oomon.h"
+#include "actionbatch.h"
+#include "irc.h"
+#include "pattern.h"
+#include "util.h"
+#include "vars.h"
+#include "botclient.h"
+#include "defaults.h"
+
+
+ActionBatch::PendingList ActionBatch::pending;
+ActionBatch::PendingSet ActionBatch::pendingSet;
+ActionBatch::HostIndex ActionBatch::hosts;
+ActionBatch::PendingList ActionBatch::wildcards;
+unsigned long ActionBatch::absorbedKlines = 0;
+unsigned long ActionBatch::absorbedDlines = 0;
+unsigned long ActionBatch::absorbedKills = 0;
+int ActionBatch::window(DEFAULT_ACTION_BATCH_WINDOW);
+
+
+bool
+ActionBatch::Pending::operator<(const ActionBatch::Pending & rhs) const
+{
+  if (this->server != rhs.server)
+  {
+    return std::less<const IRC *>()(this->server, rhs.server);
+  }
+  else if (this->type != rhs.type)
+  {
+    return this->type < rhs.type;
+  }
+  else
+  {
+    return this->key < rhs.key;
+  }
+}
+
+
+void
+ActionBatch::expire(const std::time_t now)
+{
+  // Entries expire the current ACTION_BATCH_WINDOW seconds after they
+  // were added, so they expire in the order they were added even after
+  // the window is changed
+  while (!ActionBatch::pending.empty() &&
+    ((ActionBatch::pending.front().added + ActionBatch::window <= now) ||
+    (ActionBatch::window <= 0)))
+  {
+    const Pending & entry = ActionBatch::pending.front();
+
+    ActionBatch::pendingSet.erase(entry);
+
+    if (!entry.host.empty())
+    {
+      std::pair<HostIndex::iterator, HostIndex::iterator> range =
+        ActionBatch::hosts.equal_range(std::make_pair(entry.server,
+        entry.host));
+
+      for (HostIndex::iterator pos = range.first; pos != range.second; ++pos)
+      {
+        if ((pos->second.type == entry.type) && (pos->second.key == entry.key))
+        {
+          ActionBatch::hosts.erase(pos);
+          break;
+        }
+      }
+    }
+    else if (ActionBatch::coversUsers(entry))
+    {
+      // The wildcard entries are a subsequence of the pending list
+      ActionBatch::wildcards.pop_front();
+    }
+
+    ActionBatch::pending.pop_front();
+  }
+}
+
+
+// coversUsers(entry)
+//
+// Returns true if the entry is a local K-line or D-line, which may
+// make a KILL unnecessary.
+//
+bool
+ActionBatch::coversUsers(const ActionBatch::Pending & entry)
+{
+  return ((KLINE == entry.type) &&
+    (std::string::npos != entry.key.find('@'))) || (DLINE == entry.type);
+}
+
+
+bool
+ActionBatch::add(const ActionBatch::Type type, const std::string & key)
+{
+  const std::time_t now = std::time(NULL);
+
+  ActionBatch::expire(now);
+
+  if (ActionBatch::window <= 0)
+  {
+    return true;
+  }
+
+  Pending entry;
+  entry.type = type;
+  entry.server = &server();
+  entry.key = key;
+  entry.added = now;
+
+  if (!ActionBatch::pendingSet.insert(entry).second)
+  {
+    return false;
+  }
+
+  if (ActionBatch::coversUsers(entry))
+  {
+    // A mask whose host part has no wildcards can only cover users
+    // with exactly that host
+    const std::string host((KLINE == type) ?
+      key.substr(key.find('@') + 1) : key);
+
+    if (std::string::npos == host.find_first_of("*?"))
+    {
+      entry.host = server().downCase(host);
+      ActionBatch::hosts.insert(std::make_pair(std::make_pair(entry.server,
+        entry.host), entry));
+    }
+    else
+    {
+      ActionBatch::wildcards.push_back(entry);
+    }
+  }
+
+  ActionBatch::pending.push_back(entry);
+
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// ActionBatch::kline(remote, mask)
+//
+// Description:
+//  Determines whether an automatic K-line should be sent, or whether
+//  the same mask has already been K-lined on the same servers within
+//  the last ACTION_BATCH_WINDOW seconds.
+//
+// Parameters:
+//  remote - The servers the K-line is for, or an empty list for the
+//           local server.
+//  mask   - The user@host mask to K-line.
+//
+// Return Value:
+//  The function returns true if the K-line should be sent.
+//////////////////////////////////////////////////////////////////////
+bool
+ActionBatch::kline(const StrVector & remote, const std::string & mask)
+{
+  bool result;
+
+  if (remote.empty())
+  {
+    result = ActionBatch::add(KLINE, DownCase(mask));
+  }
+  else
+  {
+    result = ActionBatch::add(REMOTE_KLINE,
+      DownCase(StrJoin(',', remote) + ' ' + mask));
+  }
+
+  if (!result)
+  {
+    ++ActionBatch::absorbedKlines;
+  }
+
+  return result;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// ActionBatch::dline(mask)
+//
+// Description:
+//  Determines whether an automatic D-line should be sent, or whether
+//  the same mask has already been D-lined within the last
+//  ACTION_BATCH_WINDOW seconds.
+//
+// Parameters:
+//  mask - The IP address or mask to D-line.
+//
+// Return Value:
+//  The function returns true if the D-line should be sent.
+//////////////////////////////////////////////////////////////////////
+bool
+ActionBatch::dline(const std::string & mask)
+{
+  bool result = ActionBatch::add(DLINE, DownCase(mask));
+
+  if (!result)
+  {
+    ++ActionBatch::absorbedDlines;
+  }
+
+  return result;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// ActionBatch::kill(userhost, ip)
+//
+// Description:
+//  Determines whether an automatic KILL should be sent, or whether the
+//  user will be removed anyway by a recent K-line or D-line on the
+//  local server.
+//
+// Parameters:
+//  userhost - The user@host of the client to kill.
+//  ip       - The client's IP address, or INADDR_NONE if unknown.
+//
+// Return Value:
+//  The function returns true if the KILL should be sent.
+//////////////////////////////////////////////////////////////////////
+bool
+ActionBatch::kill(const std::string & userhost, const BotSock::Address ip)
+{
+  ActionBatch::expire(std::time(NULL));
+
+  std::string::size_type at = userhost.find('@');
+  const bool haveIP = (INADDR_NONE != ip) && (INADDR_ANY != ip);
+  const std::string textIP(haveIP ? BotSock::inet_ntoa(ip) : "");
+  const std::string userIP(haveIP && (std::string::npos != at) ?
+    (userhost.substr(0, at + 1) + textIP) : "");
+
+  bool covered = false;
+
+  if (std::string::npos != at)
+  {
+    covered = ActionBatch::coveredByHost(userhost.substr(at + 1), userhost,
+      userIP, textIP);
+  }
+
+  if (!covered && haveIP)
+  {
+    covered = ActionBatch::coveredByHost(textIP, userhost, userIP, textIP);
+  }
+
+  for (PendingList::const_iterator pos = ActionBatch::wildcards.begin();
+    !covered && (pos != ActionBatch::wildcards.end()); ++pos)
+  {
+    covered = (pos->server == &server()) &&
+      ActionBatch::covers(*pos, userhost, userIP, textIP);
+  }
+
+  if (covered)
+  {
+    ++ActionBatch::absorbedKills;
+    return false;
+  }
+
+  return true;
+}
+
+
+// coveredByHost(host, userhost, userIP, textIP)
+//
+// Returns true if a local K-line or D-line on the given host covers
+// the user.
+//
+bool
+ActionBatch::coveredByHost(const std::string & host,
+  const std::string & userhost, const std::string & userIP,
+  const std::string & textIP)
+{
+  std::pair<HostIndex::const_iterator, HostIndex::const_iterator> range =
+    ActionBatch::hosts.equal_range(std::make_pair(&server(),
+    server().downCase(host)));
+
+  for (HostIndex::const_iterator pos = range.first; pos != range.second;
+    ++pos)
+  {
+    if (ActionBatch::covers(pos->second, userhost, userIP, textIP))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+// covers(entry, userhost, userIP, textIP)
+//
+// Returns true if a local K-line or D-line covers the user.
+//
+bool
+ActionBatch::covers(const ActionBatch::Pending & entry,
+  const std::string & userhost, const std::string & userIP,
+  const std::string & textIP)
+{
+  if (KLINE == entry.type)
+  {
+    return MatchesMask(userhost, entry.key) ||
+      (!userIP.empty() && MatchesMask(userIP, entry.key));
+  }
+  else
+  {
+    return !textIP.empty() && MatchesMask(textIP, entry.key);
+  }
+}
+
+
+void
+ActionBatch::status(BotClient * client)
+{
+  ActionBatch::expire(std::time(NULL));
+
+  client->send("Action batching: " +
+    boost::lexical_cast<std::string>(ActionBatch::pending.size()) +
+    " recent, absorbed " +
+    boost::lexical_cast<std::string>(ActionBatch::absorbedKlines) +
+    " K-lines, " +
+    boost::lexical_cast<std::string>(ActionBatch::absorbedDlines) +
+    " D-lines, " +
+    boost::lexical_cast<std::string>(ActionBatch::absorbedKills) + " kills");
+}
+
+
+void
+ActionBatch::init(void)
+{
+  vars.insert("ACTION_BATCH_WINDOW",
+      Setting::IntegerSetting(ActionBatch::window, 0));
+}
+
@@ -0,0 +1,97 @@
+#ifndef __ACTIONBATCH_H__
+#define __ACTIONBATCH_H__
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+#include <deque>
+#include <map>
+#include <set>
+#include <utility>
+#include <ctime>
+
+// OOMon Headers
+#include "strtype"
+#include "botsock.h"
+
+
+// Remembers the K-lines and D-lines issued by automatic actions for a
+// short time so that a flood of detections for the same mask results in
+// only one command to the server.  A KILL is also skipped when a K-line
+// or D-line that covers the user is already on its way.  Each server is
+// batched separately.
+class ActionBatch
+{
+public:
+  static void init(void);
+
+  static bool kline(const StrVector & remote, const std::string & mask);
+  static bool dline(const std::string & mask);
+  static bool kill(const std::string & userhost, const BotSock::Address ip);
+
+  static void status(class BotClient * client);
+
+private:
+  enum Type { KLINE, REMOTE_KLINE, DLINE };
+
+  struct Pending
+  {
+    Type type;
+    const class IRC * server;
+    std::string key;
+    std::time_t added;
+    // The host part of a local K-line or D-line without wildcards
+    std::string host;
+
+    bool operator<(const Pending & rhs) const;
+  };
+
+  // Entries in the order they were added, which is also the order they
+  // expire in
+  typedef std::deque<Pending> PendingList;
+  // The same entries, for finding duplicates
+  typedef std::set<Pending> PendingSet;
+  // Local K-lines and D-lines whose host part has no wildcards, by
+  // server and host, for finding the ones that cover a user
+  typedef std::multimap<std::pair<const class IRC *, std::string>, Pending>
+    HostIndex;
+
+  static void expire(const std::time_t now);
+  static bool add(const Type type, const std::string & key);
+  static bool coversUsers(const Pending & entry);
+  static bool covers(const Pending & entry, const std::string & userhost,
+    const std::string & userIP, const std::string & textIP);
+  static bool coveredByHost(const std::string & host,
+    const std::string & userhost, const std::string & userIP,
+    const std::string & textIP);
+
+  static PendingList pending;
+  static PendingSet pendingSet;
+  static HostIndex hosts;
+  static PendingList wildcards;
+  static unsigned long absorbedKlines, absorbedDlines, absorbedKills;
+  static int window;
+};
+
+
+#endif /* __ACTIONBATCH_H__ */
+
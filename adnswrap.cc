@@ -33,6 +33,9 @@ Adns adns;
 
 
 Adns::Adns(void)
+#ifdef HAVE_LIBADNS
+  : nfds_(0)
+#endif /* HAVE_LIBADNS */
 {
 #ifdef HAVE_LIBADNS
   int ret = adns_init(&this->state_, adns_if_nosigpipe, 0);
@@ -48,6 +51,10 @@ Adns::Adns(void)
 Adns::~Adns(void)
 {
 #ifdef HAVE_LIBADNS
+  for (int i = 0; i < this->nfds_; ++i)
+  {
+    Reactor::instance().remove(this->fds_[i].fd, this);
+  }
   adns_finish(this->state_);
 #endif /* HAVE_LIBADNS */
 }
@@ -148,31 +155,102 @@ Adns::check(Adns::Query & query)
 #endif /* HAVE_LIBADNS */
 
 
+// prePoll(timeout)
+//
+// Brings the reactor's registrations up to date with the descriptors
+// adns is currently using, and shortens the timeout (in milliseconds)
+// if adns needs to retransmit or expire a query sooner.
+//
 void
-Adns::preSelect(int & maxfd, fd_set & readfds, fd_set & writefds,
-  fd_set & exceptfds, struct timeval * & tv_mod)
-{
 #ifdef HAVE_LIBADNS
+Adns::prePoll(int & timeout)
+{
   struct timeval now;
 
   gettimeofday(&now, 0);
 
-  adns_beforeselect(this->state_, &maxfd, &readfds, &writefds, &exceptfds,
-    &tv_mod, 0, &now);
-#endif /* HAVE_LIBADNS */
+  struct pollfd fds[ADNS_POLLFDS_RECOMMENDED];
+  int nfds = ADNS_POLLFDS_RECOMMENDED;
+
+  if (0 != adns_beforepoll(this->state_, fds, &nfds, &timeout, &now))
+  {
+    nfds = 0;
+  }
+
+  Reactor & reactor = Reactor::instance();
+
+  for (int i = 0; i < this->nfds_; ++i)
+  {
+    bool stillUsed = false;
+    for (int j = 0; j < nfds; ++j)
+    {
+      if (fds[j].fd == this->fds_[i].fd)
+      {
+        stillUsed = true;
+      }
+    }
+    if (!stillUsed)
+    {
+      reactor.remove(this->fds_[i].fd, this);
+    }
+  }
+
+  for (int j = 0; j < nfds; ++j)
+  {
+    const int events = ((fds[j].events & (POLLIN | POLLPRI)) ?
+      Reactor::READ : 0) | ((fds[j].events & POLLOUT) ? Reactor::WRITE : 0);
+
+    if (!reactor.modify(fds[j].fd, this, events))
+    {
+      reactor.add(fds[j].fd, this, events);
+    }
+
+    fds[j].revents = 0;
+    this->fds_[j] = fds[j];
+  }
+  this->nfds_ = nfds;
 }
+#else
+Adns::prePoll(int &)
+{
+}
+#endif /* HAVE_LIBADNS */
 
 
 void
-Adns::postSelect(int maxfd, const fd_set & readfds, const fd_set & writefds,
-  const fd_set & exceptfds)
+Adns::postPoll(void)
 {
 #ifdef HAVE_LIBADNS
   struct timeval now;
 
   gettimeofday(&now, 0);
 
-  adns_afterselect(this->state_, maxfd, &readfds, &writefds, &exceptfds, &now);
+  adns_afterpoll(this->state_, this->fds_, this->nfds_, &now);
+
+  for (int i = 0; i < this->nfds_; ++i)
+  {
+    this->fds_[i].revents = 0;
+  }
 #endif /* HAVE_LIBADNS */
 }
 
+
+void
+#ifdef HAVE_LIBADNS
+Adns::onReady(const int fd, const int events)
+{
+  for (int i = 0; i < this->nfds_; ++i)
+  {
+    if (this->fds_[i].fd == fd)
+    {
+      this->fds_[i].revents |= ((events & Reactor::READ) ? POLLIN : 0) |
+        ((events & Reactor::WRITE) ? POLLOUT : 0);
+    }
+  }
+}
+#else
+Adns::onReady(const int, const int)
+{
+}
+#endif /* HAVE_LIBADNS */
+
@@ -33,14 +33,16 @@
 #include "oomon.h"
 #include "botsock.h"
 #include "botexcept.h"
+#include "reactor.h"
 
 
 #ifdef HAVE_LIBADNS
+# include <poll.h>
 # include <adns.h>
 #endif /* HAVE_LIBADNS */
 
 
-class Adns
+class Adns : private Reactor::Handler
 {
 public:
   Adns(void);
@@ -87,14 +89,16 @@ public:
   Adns::Answer check(Adns::Query & query);
 #endif /* HAVE_LIBADNS */
 
-  void preSelect(int & maxfd, fd_set & readfds, fd_set & writefds,
-    fd_set & exceptfds, struct timeval * & tv_mod);
-  void postSelect(int maxfd, const fd_set & readfds, const fd_set & writefds,
-    const fd_set & exceptfds);
+  void prePoll(int & timeout);
+  void postPoll(void);
 
 private:
+  virtual void onReady(const int fd, const int events);
+
 #ifdef HAVE_LIBADNS
   adns_state state_;
+  struct pollfd fds_[ADNS_POLLFDS_RECOMMENDED];
+  int nfds_;
 #endif /* HAVE_LIBADNS */
 };
 
@@ -28,8 +28,11 @@
 
 // OOMon Headers
 #include "autoaction.h"
+#include "actionbatch.h"
 #include "userhash.h"
 #include "irc.h"
+#include "journal.h"
+#include "stats.h"
 #include "util.h"
 #include "main.h"
 #include "engine.h"
@@ -203,7 +206,7 @@ doKill(const std::string & nick, const std::string & reason)
 {
   if (autoPilot())
   {
-    server.kill("Auto-Kill", nick, reason);
+    server().kill("Auto-Kill", nick, reason);
   }
   else
   {
@@ -216,18 +219,23 @@ static void
 doKline(const StrVector & remote, const std::string & mask,
     unsigned int duration, const std::string & reason)
 {
+  if (!ActionBatch::kline(remote, mask))
+  {
+    return;
+  }
+
   if (autoPilot())
   {
     if (remote.empty())
     {
-      server.kline("Auto-Kline", duration, mask, reason);
+      server().kline("Auto-Kline", duration, mask, reason);
     }
     else
     {
       for (StrVector::const_iterator pos = remote.begin(); pos != remote.end();
           ++pos)
       {
-        server.remoteKline("Auto-Kline", *pos, duration, mask, reason);
+        server().remoteKline("Auto-Kline", *pos, duration, mask, reason);
       }
     }
   }
@@ -251,9 +259,14 @@ static void
 doDline(const std::string & mask, const unsigned int duration,
   const std::string & reason)
 {
+  if (!ActionBatch::dline(mask))
+  {
+    return;
+  }
+
   if (autoPilot())
   {
-    server.dline("Auto-Dline", duration, mask, reason);
+    server().dline("Auto-Dline", duration, mask, reason);
   }
   else
   {
@@ -315,10 +328,16 @@ doAction(const std::string & nick, const std::string & userhost,
     }
     else
     {
-      ip = users.getIP(nick, userhost);
+      ip = users().getIP(nick, userhost);
     }
   }
 
+  if (AutoAction::NOTHING != action.type())
+  {
+    Journal::action(nick, user, host, ip, AutoAction::get(&action), reason);
+    Stats::count(Stats::ACTIONS);
+  }
+
   switch (action.type())
   {
   case AutoAction::NOTHING:
@@ -326,12 +345,16 @@ doAction(const std::string & nick, const std::string & userhost,
     break;
 
   case AutoAction::KILL:
-    doKill(nick, reason);
-    if (suggestKlineAfterKill && autoPilot())
+    // Don't bother if a recent K-line or D-line will remove the user
+    if (ActionBatch::kill(userhost, ip))
     {
-      std::string mask("*" + ident + "@" + domain);
-      ::SendAll(".kline " + mask + " " + reason,
-	UserFlags(UserFlags::OPER, UserFlags::KLINE));
+      doKill(nick, reason);
+      if (suggestKlineAfterKill && autoPilot())
+      {
+        std::string mask("*" + ident + "@" + domain);
+        ::SendAll(".kline " + mask + " " + reason,
+          UserFlags(UserFlags::OPER, UserFlags::KLINE));
+      }
     }
     break;
 
@@ -480,6 +503,8 @@ doAction(const UserEntryPtr user, const AutoAction & action,
   // else who just took the same nickname!
   if (user->connected() || (AutoAction::KILL != action.type()))
   {
+    IRC::Context context(user->getServer());
+
     doAction(user->getNick(), user->getUserHost(), user->getIP(), action,
         reason, suggestKlineAfterKill);
   }
@@ -0,0 +1,68 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Stand-ins for the functions normally provided by main.cc, so the
+// benchmarks can link against the rest of OOMon's objects without
+// dragging in the bot's main loop.
+
+// Std C++ Headers
+#include <string>
+
+// Std C Headers
+#include <stdlib.h>
+
+// OOMon Headers
+#include "oomon.h"
+#include "main.h"
+#include "botclient.h"
+
+
+void
+SendAll(const std::string &, const UserFlags, const WatchSet &,
+  const BotClient *)
+{
+}
+
+
+RETSIGTYPE
+gracefuldie(int)
+{
+  exit(EXIT_NOERROR);
+}
+
+
+void
+ReloadConfig(const std::string &)
+{
+}
+
+
+void
+motd(BotClient *)
+{
+}
+
+
+std::string
+getUptime(void)
+{
+  return "0 seconds";
+}
@@ -0,0 +1,208 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+
+// $Id$
+
+// Std C++ Headers
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <new>
+
+// Std C Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// OOMon Headers
+#include "strtype"
+#include "util.h"
+#include "benchutil.h"
+
+
+// Every allocation made by a benchmark goes through these, so the
+// number of allocations per operation can be reported along with the
+// time.
+static unsigned long allocations = 0;
+
+
+void *
+operator new(std::size_t size)
+{
+  ++allocations;
+
+  void * result = malloc((size > 0) ? size : 1);
+  if (NULL == result)
+  {
+    throw std::bad_alloc();
+  }
+  return result;
+}
+
+
+void *
+operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+
+void
+operator delete(void * ptr) throw()
+{
+  free(ptr);
+}
+
+
+void
+operator delete[](void * ptr) throw()
+{
+  free(ptr);
+}
+
+
+void
+operator delete(void * ptr, std::size_t) throw()
+{
+  free(ptr);
+}
+
+
+void
+operator delete[](void * ptr, std::size_t) throw()
+{
+  free(ptr);
+}
+
+
+unsigned long
+benchAllocations(void)
+{
+  return allocations;
+}
+
+
+double
+benchNow(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// benchLoadCorpus(filename, corpus)
+//
+// Description:
+//  Reads a corpus file, one entry per line.  Blank lines and lines
+//  starting with '#' are skipped.
+//
+// Parameters:
+//  filename - The file to read.
+//  corpus   - Receives the entries.
+//
+// Return Value:
+//  The function returns false if the file could not be opened.
+//////////////////////////////////////////////////////////////////////
+bool
+benchLoadCorpus(const char * filename, StrVector & corpus)
+{
+  std::ifstream file(filename);
+
+  if (!file)
+  {
+    std::cerr << "Unable to open corpus file: " << filename << std::endl;
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(file, line))
+  {
+    if (!line.empty() && (line[0] != '#'))
+    {
+      corpus.push_back(line);
+    }
+  }
+
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// benchLoadTraps(filename, filters)
+//
+// Description:
+//  Reads the "TRAP" lines of a saved oomon.settings file.
+//
+// Parameters:
+//  filename - The file to read.
+//  filters  - Receives each trap's filter and reason, in the form
+//             accepted by Filter's constructor.
+//
+// Return Value:
+//  The function returns false if the file could not be opened.
+//////////////////////////////////////////////////////////////////////
+bool
+benchLoadTraps(const char * filename, StrVector & filters)
+{
+  std::ifstream file(filename);
+
+  if (!file)
+  {
+    std::cerr << "Unable to open trap file: " << filename << std::endl;
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(file, line))
+  {
+    // TRAP <key> <action> <timeout> <filter> [<reason>]
+    if (Same(FirstWord(line), "TRAP"))
+    {
+      FirstWord(line);
+      FirstWord(line);
+      FirstWord(line);
+      filters.push_back(line);
+    }
+  }
+
+  return true;
+}
+
+
+void
+benchReport(const std::string & name, const unsigned long ops,
+  const double elapsed, const unsigned long allocations,
+  const std::string & extra)
+{
+  char allocs[32];
+  snprintf(allocs, sizeof(allocs), "%.2f",
+    static_cast<double>(allocations) / ops);
+
+  std::cout << padRight(name, 22) << ' ' <<
+    padLeft(IntToStr(static_cast<int>(elapsed / ops)), 8) << " ns/op " <<
+    padLeft(allocs, 8) << " allocs/op";
+  if (!extra.empty())
+  {
+    std::cout << "  " << extra;
+  }
+  std::cout << std::endl;
+}
@@ -0,0 +1,47 @@
+#ifndef __BENCHUTIL_H__
+#define __BENCHUTIL_H__
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+
+// $Id$
+
+// Helpers shared by the benchmarks: a monotonic clock, corpus loading,
+// allocation counting, and result reporting.
+
+// Std C++ Headers
+#include <string>
+
+// OOMon Headers
+#include "strtype"
+
+
+double benchNow(void);
+
+bool benchLoadCorpus(const char * filename, StrVector & corpus);
+bool benchLoadTraps(const char * filename, StrVector & filters);
+
+unsigned long benchAllocations(void);
+
+void benchReport(const std::string & name, const unsigned long ops,
+  const double elapsed, const unsigned long allocations,
+  const std::string & extra = "");
+
+
+#endif /* __BENCHUTIL_H__ */
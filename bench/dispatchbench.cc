@@ -0,0 +1,268 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Measures how many server lines per second IRC::onRead() can take.  The
+// first two cases only split each line and find its handler: once the
+// way onRead() used to, with SplitIRC() and a bad_lexical_cast thrown
+// for every command that isn't a numeric, and once with IRCMessage and
+// IRC's dispatch tables.  Both must recognize the same lines.  The last
+// case runs the lines through onRead() itself, handlers and all.
+
+// Std C++ Headers
+#include <iostream>
+#include <string>
+
+// Boost C++ Headers
+#include <boost/lexical_cast.hpp>
+
+// Std C Headers
+#include <stdlib.h>
+#include <unistd.h>
+
+// OOMon Headers
+#include "oomon.h"
+#include "strtype"
+#include "irc.h"
+#include "ircmsg.h"
+#include "util.h"
+#include "benchutil.h"
+
+
+static const std::string serverName("irc.example.net");
+
+
+// The commands onRead() used to look up with a chain of comparisons
+static bool
+oldCommand(const std::string & text)
+{
+  return (text == "PING") || (text == "NICK") || (text == "JOIN") ||
+    (text == "PART") || (text == "KICK") || (text == "INVITE") ||
+    (text == "NOTICE") || (text == "PRIVMSG") || (text == "WALLOPS") ||
+    (text == "ERROR");
+}
+
+
+// The numerics onRead() used to handle in its switch statement
+static bool
+oldNumeric(const int numeric)
+{
+  switch (numeric)
+  {
+    case 1: case 5: case 204: case 205: case 209: case 216: case 219:
+    case 225: case 262: case 303: case 311: case 381: case 433: case 464:
+    case 473: case 491: case 709:
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+static unsigned long
+runOld(const StrVector & lines, const int passes, double & elapsed)
+{
+  unsigned long handled = 0;
+  double start = benchNow();
+
+  for (int pass = 0; pass < passes; ++pass)
+  {
+    for (StrVector::const_iterator text = lines.begin(); text != lines.end();
+      ++text)
+    {
+      StrVector params;
+
+      if ((*text)[0] == ':')
+      {
+        SplitIRC(params, text->substr(1));
+      }
+      else
+      {
+        params.push_back(serverName);
+        SplitIRC(params, *text);
+      }
+
+      std::string from, userhost;
+      SplitFrom(params[0], from, userhost);
+
+      std::string command = params[1];
+
+      try
+      {
+        if (oldNumeric(boost::lexical_cast<int>(command)))
+        {
+          ++handled;
+        }
+      }
+      catch (const boost::bad_lexical_cast &)
+      {
+        if (oldCommand(command))
+        {
+          ++handled;
+        }
+      }
+    }
+  }
+
+  elapsed = benchNow() - start;
+
+  return handled;
+}
+
+
+static unsigned long
+runTable(const StrVector & lines, const int passes, double & elapsed)
+{
+  unsigned long handled = 0;
+  IRCMessage message;
+  double start = benchNow();
+
+  for (int pass = 0; pass < passes; ++pass)
+  {
+    for (StrVector::const_iterator text = lines.begin(); text != lines.end();
+      ++text)
+    {
+      if (message.parse(text->data(), text->length(), serverName) &&
+        (0 != IRC::findHandler(message)))
+      {
+        ++handled;
+      }
+    }
+  }
+
+  elapsed = benchNow() - start;
+
+  return handled;
+}
+
+
+static void
+runOnRead(const StrVector & lines, const int passes, double & elapsed)
+{
+  double start = benchNow();
+
+  for (int pass = 0; pass < passes; ++pass)
+  {
+    for (StrVector::const_iterator text = lines.begin(); text != lines.end();
+      ++text)
+    {
+      server().onRead(text->data(), text->length());
+    }
+  }
+
+  elapsed = benchNow() - start;
+}
+
+
+static std::string
+linesPerSecond(const unsigned long ops, const double elapsed)
+{
+  return IntToStr(static_cast<int>((ops * 1e9) / elapsed)) + " lines/sec";
+}
+
+
+int
+main(int argc, char **argv)
+{
+  int passes = 100;
+  int ch;
+
+  while ((ch = getopt(argc, argv, "n:")) != -1)
+  {
+    switch (ch)
+    {
+      case 'n':
+        passes = atoi(optarg);
+        break;
+      default:
+        std::cerr << "Usage: " << argv[0] << " [-n passes] [line_file]" <<
+          std::endl;
+        return 1;
+    }
+  }
+
+  const char * lineFile = (optind < argc) ? argv[optind] :
+    "bench/irclines.txt";
+
+  StrVector lines;
+  if (!benchLoadCorpus(lineFile, lines))
+  {
+    return 1;
+  }
+
+  // Blank lines never reach onRead()
+  StrVector corpus;
+  for (StrVector::iterator pos = lines.begin(); pos != lines.end(); ++pos)
+  {
+    if (!pos->empty())
+    {
+      corpus.push_back(*pos);
+    }
+  }
+
+  if (corpus.empty())
+  {
+    std::cerr << "Nothing to do!" << std::endl;
+    return 1;
+  }
+
+  IRC::init();
+
+  unsigned long ops = static_cast<unsigned long>(passes) * corpus.size();
+
+  std::cout << corpus.size() << " lines, " << passes << " passes" <<
+    std::endl;
+
+  double elapsed;
+  unsigned long allocs;
+
+  runOld(corpus, 1, elapsed);
+  allocs = benchAllocations();
+  unsigned long oldHandled = runOld(corpus, passes, elapsed);
+  double oldElapsed = elapsed;
+  benchReport("SplitIRC+lexical_cast", ops, oldElapsed,
+    benchAllocations() - allocs, linesPerSecond(ops, oldElapsed));
+
+  runTable(corpus, 1, elapsed);
+  allocs = benchAllocations();
+  unsigned long tableHandled = runTable(corpus, passes, elapsed);
+  benchReport("IRCMessage+tables", ops, elapsed, benchAllocations() - allocs,
+    linesPerSecond(ops, elapsed));
+
+  if (oldHandled != tableHandled)
+  {
+    std::cerr << "*** Old and new dispatch results differ!" << std::endl;
+    return 1;
+  }
+
+  std::cout << "handled: " << tableHandled << " of " << ops << std::endl;
+  if (elapsed > 0)
+  {
+    std::cout << "speedup: " << (oldElapsed / elapsed) << 'x' << std::endl;
+  }
+
+  runOnRead(corpus, 1, elapsed);
+  allocs = benchAllocations();
+  runOnRead(corpus, passes, elapsed);
+  benchReport("IRC::onRead", ops, elapsed, benchAllocations() - allocs,
+    linesPerSecond(ops, elapsed));
+
+  return 0;
+}
@@ -0,0 +1,1204 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+
+// $Id$
+
+// A stand-in for a hybrid ircd that OOMon can connect to, for measuring
+// throughput and detection latency on one machine.  It accepts a single
+// connection, answers registration, OPER, TRACE, ETRACE, and STATS K/D,
+// and once the bot has opered up it generates a steady stream of
+// connect, exit, nick change, flooder, and spambot notices along with
+// bursts of clones.  Users are drawn from synthetic nick, host, and IP
+// distributions seeded with -S, so a run can be repeated exactly.
+//
+// Everything the bot sends back is counted by command and optionally
+// logged with -o.  KLINEs, DLINEs, and KILLs are matched against the
+// users they hit and timed from the notice that gave the user away;
+// CTCP VERSION requests are timed from the user's connect notice.  The
+// matched users are removed with an exit notice, as a real server would.
+//
+// The load is open-loop: notices are queued whether or not the bot keeps
+// up, and the largest send backlog is reported along with the latencies.
+
+// Std C++ Headers
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+// Std C Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// OOMon Headers
+#include "oomon.h"
+#include "strtype"
+#include "pattern.h"
+#include "util.h"
+#include "benchutil.h"
+
+
+static volatile sig_atomic_t stopping = 0;
+
+
+static void
+onSignal(int)
+{
+  stopping = 1;
+}
+
+
+// Seconds on the benchmark clock
+static double
+now(void)
+{
+  return benchNow() / 1e9;
+}
+
+
+// xorshift64*, so that a seed gives the same users on every platform
+class Random
+{
+public:
+  explicit Random(const unsigned long seed)
+    : state_(0x9e3779b97f4a7c15ULL ^ seed) { this->next(); }
+
+  unsigned long long next(void)
+  {
+    this->state_ ^= this->state_ >> 12;
+    this->state_ ^= this->state_ << 25;
+    this->state_ ^= this->state_ >> 27;
+    return this->state_ * 2685821657736338717ULL;
+  }
+
+  // Uniform in [0, n)
+  unsigned int below(const unsigned int n)
+    { return (n > 0) ? static_cast<unsigned int>((this->next() >> 11) % n) : 0; }
+
+  // Uniform in [0, 1)
+  double uniform(void)
+    { return (this->next() >> 11) * (1.0 / 9007199254740992.0); }
+
+  // Skewed towards 0, so a few entries are much more common than the rest
+  unsigned int skewed(const unsigned int n)
+  {
+    const double u = this->uniform();
+    return static_cast<unsigned int>(u * u * u * n);
+  }
+
+private:
+  unsigned long long state_;
+};
+
+
+struct FakeUser
+{
+  std::string nick;
+  std::string user;
+  std::string host;
+  std::string ip;
+  std::string gecos;
+  double connected;	// When the connect notice was sent
+  double trigger;	// When the last notice that could give it away was sent
+  bool versionReply;	// Whether it answers CTCP VERSION
+};
+
+
+static const char * const SYLLABLES[] = {
+  "ka", "zu", "mi", "ro", "te", "la", "shi", "no", "ba", "ve", "dra", "gon",
+  "ax", "el", "ry", "tor", "qu", "in", "pho", "xe", "ni", "mo", "sk", "ate"
+};
+static const char * const ISPS[] = {
+  "dsl.westnet.example.net", "cable.eastlink.example.com",
+  "pool.bigtel.example.net", "dyn.fastnet.example.org",
+  "adsl.northisp.example.net", "dialup.oldnet.example.com",
+  "ppp.coastal.example.net", "fiber.metro.example.com"
+};
+static const char * const DOMAINS[] = {
+  "university.example.edu", "shells.example.org", "corp.example.com",
+  "hosting.example.net", "library.example.org", "lab.example.edu"
+};
+static const char * const VERSIONS[] = {
+  "mIRC v6.16 Khaled Mardam-Bey", "irssi v0.8.10 - running on Linux i686",
+  "xchat 2.4.1 Linux 2.6.11 [i686/1.20GHz]", "BitchX-1.1-final+ by panasync",
+  "Trillian v3.1 (w/ IRC Plugin)", "epic4-2.2 Linux 2.4.29"
+};
+static const char * const CHANNELS[] = {
+  "#help", "#chat", "#linux", "#mp3", "#teens", "#movies", "#oomon"
+};
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+
+// Generates users and keeps track of the ones that are still connected
+class Population
+{
+public:
+  Population(Random & random) : random_(random), serial_(0) { }
+
+  FakeUser & add(const double when)
+  {
+    FakeUser user;
+
+    user.nick = this->makeNick();
+    this->makeHost(user.host, user.ip);
+    user.user = this->makeUser(user.nick);
+    user.gecos = "Synthetic user " + IntToStr(this->serial_);
+    user.connected = user.trigger = when;
+    user.versionReply = true;
+
+    return this->insert(user);
+  }
+
+  // A clone of an existing user from the same user@host
+  FakeUser & addClone(const FakeUser & original, const double when)
+  {
+    FakeUser user(original);
+
+    user.nick = this->makeNick();
+    user.connected = user.trigger = when;
+
+    return this->insert(user);
+  }
+
+  void remove(const std::string & nick)
+  {
+    NickMap::iterator pos = this->byNick_.find(DownCase(nick));
+
+    if (pos != this->byNick_.end())
+    {
+      const std::vector<FakeUser>::size_type index = pos->second;
+
+      this->byNick_.erase(pos);
+      if (index != this->users_.size() - 1)
+      {
+        this->users_[index] = this->users_.back();
+        this->byNick_[DownCase(this->users_[index].nick)] = index;
+      }
+      this->users_.pop_back();
+    }
+  }
+
+  void rename(FakeUser & user, const std::string & newNick)
+  {
+    NickMap::iterator pos = this->byNick_.find(DownCase(user.nick));
+
+    if (pos != this->byNick_.end())
+    {
+      const std::vector<FakeUser>::size_type index = pos->second;
+
+      this->byNick_.erase(pos);
+      user.nick = newNick;
+      this->byNick_[DownCase(newNick)] = index;
+    }
+  }
+
+  FakeUser * find(const std::string & nick)
+  {
+    NickMap::iterator pos = this->byNick_.find(DownCase(nick));
+
+    return (pos == this->byNick_.end()) ? 0 : &this->users_[pos->second];
+  }
+
+  FakeUser * pick(void)
+  {
+    return this->users_.empty() ? 0 :
+      &this->users_[this->random_.below(this->users_.size())];
+  }
+
+  std::string makeNick(void)
+  {
+    std::string nick;
+
+    do
+    {
+      nick = SYLLABLES[this->random_.below(COUNT(SYLLABLES))];
+      nick += SYLLABLES[this->random_.below(COUNT(SYLLABLES))];
+      if (this->random_.below(2))
+      {
+        nick += SYLLABLES[this->random_.below(COUNT(SYLLABLES))];
+      }
+      if (this->random_.below(3) == 0)
+      {
+        nick += IntToStr(this->random_.below(100));
+      }
+      if (this->random_.below(4) == 0)
+      {
+        nick[0] = UpCase(nick[0]);
+      }
+    }
+    while (0 != this->find(nick));
+
+    return nick;
+  }
+
+  std::vector<FakeUser> & users(void) { return this->users_; }
+  std::vector<FakeUser>::size_type size(void) const
+    { return this->users_.size(); }
+
+private:
+  typedef std::map<std::string, std::vector<FakeUser>::size_type> NickMap;
+
+  FakeUser & insert(const FakeUser & user)
+  {
+    ++this->serial_;
+    this->byNick_[DownCase(user.nick)] = this->users_.size();
+    this->users_.push_back(user);
+    return this->users_.back();
+  }
+
+  std::string makeUser(const std::string & nick)
+  {
+    std::string user(DownCase(nick.substr(0, 8)));
+
+    // Most clients without identd get a tilde
+    return (this->random_.below(3) == 0) ? user : ('~' + user.substr(0, 9));
+  }
+
+  void makeHost(std::string & host, std::string & ip)
+  {
+    const unsigned int kind = this->random_.below(10);
+    const unsigned int isp = this->random_.skewed(COUNT(ISPS));
+    const unsigned int a = this->random_.below(256);
+    const unsigned int b = this->random_.below(256);
+
+    if (kind < 5)
+    {
+      // Dynamic addresses from a handful of ISPs, some much bigger than others
+      ip = "10." + IntToStr(isp + 1) + "." + IntToStr(a) + "." + IntToStr(b);
+      host = "host-" + IntToStr(isp + 1) + "-" + IntToStr(a) + "-" +
+        IntToStr(b) + "." + ISPS[isp];
+    }
+    else if (kind < 8)
+    {
+      // No reverse DNS
+      ip = "172.16." + IntToStr(a) + "." + IntToStr(b);
+      host = ip;
+    }
+    else
+    {
+      const unsigned int domain = this->random_.skewed(COUNT(DOMAINS));
+
+      ip = "192." + IntToStr(168 + domain) + "." + IntToStr(b) + "." +
+        IntToStr(a);
+      host = SYLLABLES[this->random_.below(COUNT(SYLLABLES))] +
+        IntToStr(a) + "." + DOMAINS[domain];
+    }
+  }
+
+  Random & random_;
+  std::vector<FakeUser> users_;
+  NickMap byNick_;
+  unsigned long serial_;
+};
+
+
+class Latency
+{
+public:
+  void add(const double seconds) { this->samples_.push_back(seconds); }
+
+  void report(const std::string & name, const unsigned long unmatched)
+  {
+    std::cout << padRight(name, 10) << ' ' << this->samples_.size() <<
+      " matched";
+    if (unmatched > 0)
+    {
+      std::cout << ", " << unmatched << " unmatched";
+    }
+
+    if (!this->samples_.empty())
+    {
+      std::sort(this->samples_.begin(), this->samples_.end());
+
+      double total = 0;
+      for (std::vector<double>::const_iterator pos = this->samples_.begin();
+        pos != this->samples_.end(); ++pos)
+      {
+        total += *pos;
+      }
+
+      std::cout << ", latency avg " << this->ms(total / this->samples_.size()) <<
+        " p50 " << this->ms(this->percentile(0.50)) <<
+        " p99 " << this->ms(this->percentile(0.99)) <<
+        " max " << this->ms(this->samples_.back());
+    }
+    std::cout << std::endl;
+  }
+
+private:
+  double percentile(const double fraction) const
+  {
+    return this->samples_[static_cast<std::vector<double>::size_type>(
+      fraction * (this->samples_.size() - 1))];
+  }
+
+  static std::string ms(const double seconds)
+  {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.2fms", seconds * 1000);
+    return buffer;
+  }
+
+  std::vector<double> samples_;
+};
+
+
+struct Rates
+{
+  double connects, exits, nicks, flooders, spambots, bursts;
+};
+
+
+class FakeServer
+{
+public:
+  FakeServer(const std::string & name, Random & random, const Rates & rates,
+    const unsigned int burstSize, const unsigned int repeats,
+    const unsigned int versionPercent, std::ostream * log)
+    : name_(name), random_(random), population_(random), rates_(rates),
+      burstSize_(burstSize), repeats_(repeats),
+      versionPercent_(versionPercent), log_(log), fd_(-1), gotUser_(false),
+      welcomed_(false), loading_(false), start_(0), loadStart_(0),
+      lastGenerate_(0), lastReport_(0), notices_(0), bytes_(0),
+      maxBacklog_(0), klined_(0), dlined_(0), killed_(0), unmatchedKlines_(0), unmatchedDlines_(0),
+      unmatchedKills_(0), unmatchedVersions_(0)
+  {
+    memset(&this->due_, 0, sizeof(this->due_));
+  }
+
+  void populate(const unsigned int count)
+  {
+    for (unsigned int i = 0; i < count; ++i)
+    {
+      this->population_.add(0).versionReply = this->repliesToVersion();
+    }
+  }
+
+  void run(const int fd, const double duration, const bool quiet);
+  void report(void);
+
+private:
+  void onLine(const std::string & line);
+  void generate(const double when);
+  void send(const std::string & line);
+  void numeric(const std::string & code, const std::string & text);
+  void notice(const std::string & text);
+  bool flush(void);
+
+  void welcome(void);
+  void sendTrace(const bool etrace);
+  void sendStats(const std::string & which);
+  void onKline(std::string args);
+  void onDline(std::string args);
+  void onKill(std::string args);
+  void onVersion(const std::string & target);
+
+  void connect(const double when);
+  void cloneBurst(const double when);
+  void exit(FakeUser * user, const std::string & reason);
+  void nickChange(void);
+  void flooder(const double when);
+  void spambot(const double when);
+
+  bool repliesToVersion(void)
+    { return this->random_.below(100) < this->versionPercent_; }
+
+  std::string name_, nick_;
+  Random & random_;
+  Population population_;
+  Rates rates_, due_;
+  unsigned int burstSize_, repeats_, versionPercent_;
+  std::ostream * log_;
+  int fd_;
+  std::string in_, out_;
+  bool gotUser_, welcomed_, loading_;
+  double start_, loadStart_, lastGenerate_, lastReport_;
+  unsigned long notices_, bytes_;
+  std::string::size_type maxBacklog_;
+  unsigned long klined_, dlined_, killed_;
+  unsigned long unmatchedKlines_, unmatchedDlines_, unmatchedKills_,
+    unmatchedVersions_;
+  std::map<std::string, unsigned long> commands_;
+  StrVector klines_, dlines_;
+  Latency klineLatency_, dlineLatency_, killLatency_, versionLatency_;
+};
+
+
+void
+FakeServer::send(const std::string & line)
+{
+  this->out_ += line;
+  this->out_ += "\r\n";
+
+  if (this->out_.size() > this->maxBacklog_)
+  {
+    this->maxBacklog_ = this->out_.size();
+  }
+}
+
+
+void
+FakeServer::numeric(const std::string & code, const std::string & text)
+{
+  this->send(':' + this->name_ + ' ' + code + ' ' + this->nick_ + ' ' + text);
+}
+
+
+void
+FakeServer::notice(const std::string & text)
+{
+  ++this->notices_;
+  this->send(':' + this->name_ + " NOTICE " + this->nick_ +
+    " :*** Notice -- " + text);
+}
+
+
+// Writes as much of the queue as the socket will take
+bool
+FakeServer::flush(void)
+{
+  while (!this->out_.empty())
+  {
+    const ssize_t n = ::write(this->fd_, this->out_.data(),
+      this->out_.size());
+
+    if (n < 0)
+    {
+      return (EAGAIN == errno) || (EINTR == errno);
+    }
+
+    this->bytes_ += n;
+    this->out_.erase(0, n);
+  }
+
+  return true;
+}
+
+
+void
+FakeServer::welcome(void)
+{
+  this->welcomed_ = true;
+  this->numeric("001", ":Welcome to the Internet Relay Network " +
+    this->nick_);
+  this->numeric("002", ":Your host is " + this->name_ +
+    ", running version fakeircd-" OOMON_VERSION);
+  this->numeric("005", "CASEMAPPING=rfc1459 ETRACE KNOCK NICKLEN=9 "
+    ":are supported by this server");
+  this->numeric("375", ":- " + this->name_ + " Message of the Day -");
+  this->numeric("376", ":End of /MOTD command.");
+}
+
+
+void
+FakeServer::sendTrace(const bool etrace)
+{
+  const std::vector<FakeUser> & users = this->population_.users();
+
+  for (std::vector<FakeUser>::const_iterator pos = users.begin();
+    pos != users.end(); ++pos)
+  {
+    if (etrace)
+    {
+      // :server 709 me User users nick user host ip :gecos
+      this->numeric("709", "User users " + pos->nick + ' ' + pos->user + ' ' +
+        pos->host + ' ' + pos->ip + " :" + pos->gecos);
+    }
+    else
+    {
+      // :server 205 me User users nick[user@host] (ip) 0 0
+      this->numeric("205", "User users " + pos->nick + '[' + pos->user + '@' +
+        pos->host + "] (" + pos->ip + ") 0 0");
+    }
+  }
+  this->numeric("262", this->name_ + " :End of TRACE");
+}
+
+
+void
+FakeServer::sendStats(const std::string & which)
+{
+  if (which == "K")
+  {
+    for (StrVector::const_iterator pos = this->klines_.begin();
+      pos != this->klines_.end(); ++pos)
+    {
+      // :server 216 me K host * user :reason
+      const std::string::size_type at = pos->find('@');
+      this->numeric("216", "K " + pos->substr(at + 1) + " * " +
+        pos->substr(0, at) + " :fakeircd");
+    }
+  }
+  else if (which == "D")
+  {
+    for (StrVector::const_iterator pos = this->dlines_.begin();
+      pos != this->dlines_.end(); ++pos)
+    {
+      this->numeric("225", "D " + *pos + " :fakeircd");
+    }
+  }
+  this->numeric("219", which + " :End of /STATS report");
+}
+
+
+// KLINE [minutes] user@host :reason
+void
+FakeServer::onKline(std::string args)
+{
+  std::string mask(FirstWord(args));
+  if (isNumeric(mask))
+  {
+    mask = FirstWord(args);
+  }
+
+  this->klines_.push_back(mask);
+  this->notice(this->nick_ + " added K-Line for [" + mask + "] [" +
+    ((!args.empty() && (':' == args[0])) ? args.substr(1) : args) + ']');
+
+  double trigger = -1;
+  std::vector<FakeUser> & users = this->population_.users();
+  for (std::vector<FakeUser>::size_type i = 0; i < users.size(); )
+  {
+    if (MatchesMask(users[i].user + '@' + users[i].host, mask) ||
+      MatchesMask(users[i].user + '@' + users[i].ip, mask))
+    {
+      trigger = std::max(trigger, users[i].trigger);
+      ++this->klined_;
+      // exit() moves the last user into this slot
+      this->exit(&users[i], "K-lined");
+    }
+    else
+    {
+      ++i;
+    }
+  }
+
+  if (trigger < 0)
+  {
+    ++this->unmatchedKlines_;
+  }
+  else
+  {
+    this->klineLatency_.add(now() - trigger);
+  }
+}
+
+
+// DLINE [minutes] ip :reason
+void
+FakeServer::onDline(std::string args)
+{
+  std::string mask(FirstWord(args));
+  if (isNumeric(mask))
+  {
+    mask = FirstWord(args);
+  }
+
+  this->dlines_.push_back(mask);
+
+  // Only class C blocks are written in CIDR notation by the bot
+  std::string::size_type slash = mask.find('/');
+  if (std::string::npos != slash)
+  {
+    mask = (0 == mask.substr(slash).compare("/24")) ?
+      classCMask(mask.substr(0, slash)) : mask.substr(0, slash);
+  }
+
+  double trigger = -1;
+  std::vector<FakeUser> & users = this->population_.users();
+  for (std::vector<FakeUser>::size_type i = 0; i < users.size(); )
+  {
+    if (MatchesMask(users[i].ip, mask))
+    {
+      trigger = std::max(trigger, users[i].trigger);
+      ++this->dlined_;
+      this->exit(&users[i], "D-lined");
+    }
+    else
+    {
+      ++i;
+    }
+  }
+
+  if (trigger < 0)
+  {
+    ++this->unmatchedDlines_;
+  }
+  else
+  {
+    this->dlineLatency_.add(now() - trigger);
+  }
+}
+
+
+// KILL nick :reason
+void
+FakeServer::onKill(std::string args)
+{
+  FakeUser * user = this->population_.find(FirstWord(args));
+
+  if (0 == user)
+  {
+    ++this->unmatchedKills_;
+    return;
+  }
+
+  ++this->killed_;
+  this->killLatency_.add(now() - user->trigger);
+  this->exit(user, "Killed (" + this->nick_ + ')');
+}
+
+
+void
+FakeServer::onVersion(const std::string & target)
+{
+  FakeUser * user = this->population_.find(target);
+
+  if (0 == user)
+  {
+    ++this->unmatchedVersions_;
+    return;
+  }
+
+  this->versionLatency_.add(now() - user->connected);
+
+  if (user->versionReply)
+  {
+    this->send(':' + user->nick + '!' + user->user + '@' + user->host +
+      " NOTICE " + this->nick_ + " :\001VERSION " +
+      VERSIONS[this->random_.below(COUNT(VERSIONS))] + '\001');
+  }
+}
+
+
+void
+FakeServer::onLine(const std::string & line)
+{
+  if (0 != this->log_)
+  {
+    char stamp[32];
+    snprintf(stamp, sizeof(stamp), "%.6f ", now() - this->start_);
+    *this->log_ << stamp << line << std::endl;
+  }
+
+  std::string args(line);
+  const std::string command(UpCase(FirstWord(args)));
+
+  ++this->commands_[command];
+
+  if (command == "NICK")
+  {
+    this->nick_ = FirstWord(args);
+  }
+  else if (command == "USER")
+  {
+    this->gotUser_ = true;
+  }
+  else if (command == "OPER")
+  {
+    this->numeric("381", ":You have entered... the Twilight Zone!");
+    this->send(':' + this->nick_ + " MODE " + this->nick_ + " :+o");
+    if (!this->loading_)
+    {
+      this->loading_ = true;
+      this->loadStart_ = this->lastGenerate_ = this->lastReport_ = now();
+    }
+  }
+  else if (command == "PING")
+  {
+    this->send(':' + this->name_ + " PONG " + this->name_ + " :" +
+      FirstWord(args));
+  }
+  else if ((command == "TRACE") || (command == "ETRACE"))
+  {
+    if (args.empty())
+    {
+      this->sendTrace(command == "ETRACE");
+    }
+    else
+    {
+      this->numeric("262", this->name_ + " :End of TRACE");
+    }
+  }
+  else if (command == "STATS")
+  {
+    this->sendStats(FirstWord(args));
+  }
+  else if (command == "KLINE")
+  {
+    this->onKline(args);
+  }
+  else if (command == "DLINE")
+  {
+    this->onDline(args);
+  }
+  else if (command == "KILL")
+  {
+    this->onKill(args);
+  }
+  else if (command == "PRIVMSG")
+  {
+    const std::string target(FirstWord(args));
+
+    if (0 == args.compare(0, 10, ":\001VERSION"))
+    {
+      ++this->commands_["VERSION"];
+      this->onVersion(target);
+    }
+  }
+  else if (command == "QUIT")
+  {
+    stopping = 1;
+  }
+
+  if (!this->welcomed_ && this->gotUser_ && !this->nick_.empty())
+  {
+    this->welcome();
+  }
+}
+
+
+void
+FakeServer::exit(FakeUser * user, const std::string & reason)
+{
+  this->notice("Client exiting: " + user->nick + " (" + user->user + '@' +
+    user->host + ") [" + reason + "] [" + user->ip + ']');
+  this->population_.remove(user->nick);
+}
+
+
+void
+FakeServer::connect(const double when)
+{
+  FakeUser & user = this->population_.add(when);
+
+  user.versionReply = this->repliesToVersion();
+  this->notice("Client connecting: " + user.nick + " (" + user.user + '@' +
+    user.host + ") [" + user.ip + "] {users} [" + user.gecos + ']');
+}
+
+
+void
+FakeServer::cloneBurst(const double when)
+{
+  this->connect(when);
+
+  // Copy it, since adding clones may move the original
+  const FakeUser original(this->population_.users().back());
+
+  for (unsigned int i = 1; i < this->burstSize_; ++i)
+  {
+    FakeUser & user = this->population_.addClone(original, when);
+
+    user.versionReply = original.versionReply;
+    this->notice("Client connecting: " + user.nick + " (" + user.user + '@' +
+      user.host + ") [" + user.ip + "] {users} [" + user.gecos + ']');
+  }
+}
+
+
+void
+FakeServer::nickChange(void)
+{
+  FakeUser * user = this->population_.pick();
+
+  if (0 != user)
+  {
+    const std::string oldNick(user->nick);
+
+    this->population_.rename(*user, this->population_.makeNick());
+    this->notice("Nick change: From " + oldNick + " to " + user->nick + " [" +
+      user->user + '@' + user->host + ']');
+  }
+}
+
+
+void
+FakeServer::flooder(const double when)
+{
+  FakeUser * user = this->population_.pick();
+
+  if (0 != user)
+  {
+    const std::string channel(CHANNELS[this->random_.below(COUNT(CHANNELS))]);
+
+    // Enough repeats to cross FLOODER_MAX_COUNT
+    for (unsigned int i = 0; i < this->repeats_; ++i)
+    {
+      this->notice("Possible Flooder " + user->nick + '[' + user->user + '@' +
+        user->host + "] on " + this->name_ + " target: " + channel);
+    }
+    user->trigger = when;
+  }
+}
+
+
+void
+FakeServer::spambot(const double when)
+{
+  FakeUser * user = this->population_.pick();
+
+  if (0 != user)
+  {
+    for (unsigned int i = 0; i < this->repeats_; ++i)
+    {
+      this->notice("User " + user->nick + " (" + user->user + '@' +
+        user->host + ") is a possible spambot");
+    }
+    user->trigger = when;
+  }
+}
+
+
+// Emits whatever the rates say is due since the last call
+void
+FakeServer::generate(const double when)
+{
+  const double dt = when - this->lastGenerate_;
+  this->lastGenerate_ = when;
+
+  this->due_.connects += this->rates_.connects * dt;
+  this->due_.exits += this->rates_.exits * dt;
+  this->due_.nicks += this->rates_.nicks * dt;
+  this->due_.flooders += this->rates_.flooders * dt;
+  this->due_.spambots += this->rates_.spambots * dt;
+  this->due_.bursts += this->rates_.bursts * dt;
+
+  for (; this->due_.connects >= 1; this->due_.connects -= 1)
+  {
+    this->connect(when);
+  }
+  for (; this->due_.exits >= 1; this->due_.exits -= 1)
+  {
+    FakeUser * user = this->population_.pick();
+    if (0 != user)
+    {
+      this->exit(user, "Quit: " + std::string(SYLLABLES[
+        this->random_.below(COUNT(SYLLABLES))]));
+    }
+  }
+  for (; this->due_.nicks >= 1; this->due_.nicks -= 1)
+  {
+    this->nickChange();
+  }
+  for (; this->due_.flooders >= 1; this->due_.flooders -= 1)
+  {
+    this->flooder(when);
+  }
+  for (; this->due_.spambots >= 1; this->due_.spambots -= 1)
+  {
+    this->spambot(when);
+  }
+  for (; this->due_.bursts >= 1; this->due_.bursts -= 1)
+  {
+    this->cloneBurst(when);
+  }
+}
+
+
+void
+FakeServer::run(const int fd, const double duration, const bool quiet)
+{
+  this->fd_ = fd;
+  this->start_ = now();
+
+  char buffer[4096];
+  bool open = true;
+
+  while (open && !stopping)
+  {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN | (this->out_.empty() ? 0 : POLLOUT);
+    pfd.revents = 0;
+
+    // Wake often enough for the rates to stay smooth
+    if ((::poll(&pfd, 1, 10) < 0) && (EINTR != errno))
+    {
+      break;
+    }
+
+    if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+    {
+      const ssize_t n = ::read(fd, buffer, sizeof(buffer));
+
+      if ((n == 0) || ((n < 0) && (EAGAIN != errno) && (EINTR != errno)))
+      {
+        open = false;
+      }
+      else if (n > 0)
+      {
+        this->in_.append(buffer, n);
+
+        std::string::size_type eol;
+        while (std::string::npos != (eol = this->in_.find('\n')))
+        {
+          std::string line(this->in_, 0, eol);
+          this->in_.erase(0, eol + 1);
+          if (!line.empty() && ('\r' == line[line.length() - 1]))
+          {
+            line.erase(line.length() - 1);
+          }
+          if (!line.empty())
+          {
+            this->onLine(line);
+          }
+        }
+      }
+    }
+
+    if (this->loading_)
+    {
+      const double when = now();
+
+      if ((duration > 0) && (when - this->loadStart_ >= duration))
+      {
+        break;
+      }
+
+      this->generate(when);
+
+      if (!quiet && (when - this->lastReport_ >= 5))
+      {
+        this->lastReport_ = when;
+        std::cout << "[" << static_cast<int>(when - this->loadStart_) <<
+          "s] " << this->notices_ << " notices, " << this->population_.size() <<
+          " users, backlog " << this->out_.size() << " bytes, " <<
+          this->klined_ << " klined, " << this->dlined_ << " dlined, " <<
+          this->killed_ << " killed" << std::endl;
+      }
+    }
+
+    if (open && !this->flush())
+    {
+      open = false;
+    }
+  }
+}
+
+
+void
+FakeServer::report(void)
+{
+  const double elapsed = this->loading_ ? (now() - this->loadStart_) : 0;
+
+  char rate[32];
+  snprintf(rate, sizeof(rate), "%.1f", (elapsed > 0) ?
+    (this->notices_ / elapsed) : 0.0);
+
+  std::cout << std::endl << "Sent " << this->notices_ << " notices in " <<
+    static_cast<int>(elapsed) << "s (" << rate << "/s), " <<
+    (this->bytes_ / 1024) << " KB, max backlog " <<
+    (this->maxBacklog_ / 1024) << " KB" << std::endl;
+
+  std::cout << "Received:";
+  std::string sep(" ");
+  for (std::map<std::string, unsigned long>::const_iterator pos =
+    this->commands_.begin(); pos != this->commands_.end(); ++pos)
+  {
+    std::cout << sep << pos->first << ' ' << pos->second;
+    sep = ", ";
+  }
+  std::cout << std::endl;
+
+  this->klineLatency_.report("KLINE", this->unmatchedKlines_);
+  this->dlineLatency_.report("DLINE", this->unmatchedDlines_);
+  this->killLatency_.report("KILL", this->unmatchedKills_);
+  this->versionLatency_.report("VERSION", this->unmatchedVersions_);
+
+  std::cout << this->klined_ << " users klined, " << this->dlined_ <<
+    " dlined, " << this->killed_ << " killed, " << this->population_.size() <<
+    " still connected" << std::endl;
+}
+
+
+static int
+listenOn(const int port)
+{
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+  if (fd < 0)
+  {
+    perror("socket");
+    return -1;
+  }
+
+  int on = 1;
+  ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+
+  if ((::bind(fd, reinterpret_cast<struct sockaddr *>(&addr),
+    sizeof(addr)) < 0) || (::listen(fd, 1) < 0))
+  {
+    perror("bind");
+    ::close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  std::string name("irc.fake.example");
+  int port = 6667;
+  unsigned long seed = 1;
+  unsigned int initial = 1000;
+  Rates rates = { 20, 20, 2, 0.2, 0.2, 0.2 };
+  unsigned int burstSize = 4;
+  unsigned int repeats = 3;
+  unsigned int versionPercent = 95;
+  double duration = 0;
+  const char * logFile = 0;
+  bool quiet = false;
+  int ch;
+
+  while ((ch = getopt(argc, argv, "B:b:c:e:f:k:N:n:o:p:qR:S:t:u:V:")) != -1)
+  {
+    switch (ch)
+    {
+      case 'B':
+        rates.bursts = atof(optarg);
+        break;
+      case 'b':
+        rates.spambots = atof(optarg);
+        break;
+      case 'c':
+        rates.connects = atof(optarg);
+        break;
+      case 'e':
+        rates.exits = atof(optarg);
+        break;
+      case 'f':
+        rates.flooders = atof(optarg);
+        break;
+      case 'k':
+        burstSize = atoi(optarg);
+        break;
+      case 'N':
+        name = optarg;
+        break;
+      case 'n':
+        rates.nicks = atof(optarg);
+        break;
+      case 'o':
+        logFile = optarg;
+        break;
+      case 'p':
+        port = atoi(optarg);
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      case 'R':
+        repeats = atoi(optarg);
+        break;
+      case 'S':
+        seed = strtoul(optarg, 0, 10);
+        break;
+      case 't':
+        duration = atof(optarg);
+        break;
+      case 'u':
+        initial = atoi(optarg);
+        break;
+      case 'V':
+        versionPercent = atoi(optarg);
+        break;
+      default:
+        std::cerr << "Usage: " << argv[0] << " [-p port] [-N server_name] " <<
+          "[-S seed] [-u initial_users]" << std::endl <<
+          "  [-c connects/s] [-e exits/s] [-n nick_changes/s] " <<
+          "[-f flooders/s] [-b spambots/s]" << std::endl <<
+          "  [-B clone_bursts/s] [-k clones_per_burst] " <<
+          "[-R notices_per_offender] [-V version_reply_%]" << std::endl <<
+          "  [-t seconds] [-o log_file] [-q]" << std::endl;
+        return 1;
+    }
+  }
+
+  std::ofstream logStream;
+  if (0 != logFile)
+  {
+    logStream.open(logFile);
+    if (!logStream)
+    {
+      std::cerr << "Can't write " << logFile << std::endl;
+      return 1;
+    }
+  }
+
+  const int listener = listenOn(port);
+  if (listener < 0)
+  {
+    return 1;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  signal(SIGPIPE, SIG_IGN);
+
+  Random random(seed);
+  FakeServer server(name, random, rates, burstSize, repeats, versionPercent,
+    (0 != logFile) ? &logStream : 0);
+  server.populate(initial);
+
+  std::cout << name << " listening on 127.0.0.1:" << port << std::endl;
+
+  const int fd = ::accept(listener, 0, 0);
+  ::close(listener);
+  if (fd < 0)
+  {
+    if (!stopping)
+    {
+      perror("accept");
+    }
+    return 1;
+  }
+  ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  std::cout << "Client connected" << std::endl;
+  server.run(fd, duration, quiet);
+  ::close(fd);
+
+  server.report();
+
+  return 0;
+}
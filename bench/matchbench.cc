@@ -0,0 +1,359 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+
+// $Id$
+
+// Microbenchmarks for the matching hot path: MatchesMask(),
+// RegExPattern::match(), Filter::matches(), seedrandScore(), SplitIRC(),
+// and IRCMessage::parse().  Each one runs over a corpus loaded from a file and
+// reports the time and number of memory allocations per operation.
+
+// Std C++ Headers
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Std C Headers
+#include <stdlib.h>
+#include <unistd.h>
+
+// OOMon Headers
+#include "oomon.h"
+#include "strtype"
+#include "pattern.h"
+#include "filter.h"
+#include "userentry.h"
+#include "seedrand.h"
+#include "botexcept.h"
+#include "botsock.h"
+#include "ircmsg.h"
+#include "util.h"
+#include "benchutil.h"
+
+
+typedef std::vector<PatternPtr> PatternVector;
+typedef std::vector<Filter> FilterVector;
+typedef std::vector<UserEntryPtr> UserVector;
+
+
+// Runs one benchmark: a warm-up pass, then the timed passes.  The
+// functor returns a count or checksum, which is reported per pass so the
+// compiler can't skip the work and results can be compared across runs.
+template<typename T>
+static void
+bench(const std::string & name, T & op, const unsigned long opsPerPass,
+  const int passes, const std::string & unit)
+{
+  op();
+
+  unsigned long allocs = benchAllocations();
+  unsigned long result = 0;
+  double start = benchNow();
+
+  for (int pass = 0; pass < passes; ++pass)
+  {
+    result += op();
+  }
+
+  double elapsed = benchNow() - start;
+
+  benchReport(name, opsPerPass * passes, elapsed,
+    benchAllocations() - allocs, IntToStr(result / passes) + ' ' + unit);
+}
+
+
+struct MaskBench
+{
+  const StrVector & nuh;
+  const StrVector & masks;
+
+  MaskBench(const StrVector & n, const StrVector & m) : nuh(n), masks(m) { }
+
+  unsigned long operator()(void) const
+  {
+    unsigned long hits = 0;
+    for (StrVector::const_iterator text = nuh.begin(); text != nuh.end();
+      ++text)
+    {
+      for (StrVector::const_iterator mask = masks.begin();
+        mask != masks.end(); ++mask)
+      {
+        if (MatchesMask(*text, *mask))
+        {
+          ++hits;
+        }
+      }
+    }
+    return hits;
+  }
+};
+
+
+struct RegExBench
+{
+  const StrVector & nuh;
+  const PatternVector & regexes;
+
+  RegExBench(const StrVector & n, const PatternVector & r) : nuh(n),
+    regexes(r) { }
+
+  unsigned long operator()(void) const
+  {
+    unsigned long hits = 0;
+    for (StrVector::const_iterator text = nuh.begin(); text != nuh.end();
+      ++text)
+    {
+      for (PatternVector::const_iterator regex = regexes.begin();
+        regex != regexes.end(); ++regex)
+      {
+        if ((*regex)->match(*text))
+        {
+          ++hits;
+        }
+      }
+    }
+    return hits;
+  }
+};
+
+
+struct FilterBench
+{
+  const UserVector & users;
+  const FilterVector & filters;
+
+  FilterBench(const UserVector & u, const FilterVector & f) : users(u),
+    filters(f) { }
+
+  unsigned long operator()(void) const
+  {
+    unsigned long hits = 0;
+    for (UserVector::const_iterator user = users.begin();
+      user != users.end(); ++user)
+    {
+      for (FilterVector::const_iterator filter = filters.begin();
+        filter != filters.end(); ++filter)
+      {
+        if (filter->matches(*user))
+        {
+          ++hits;
+        }
+      }
+    }
+    return hits;
+  }
+};
+
+
+struct SeedrandBench
+{
+  const StrVector & nicks;
+
+  explicit SeedrandBench(const StrVector & n) : nicks(n) { }
+
+  unsigned long operator()(void) const
+  {
+    unsigned long total = 0;
+    for (StrVector::const_iterator nick = nicks.begin(); nick != nicks.end();
+      ++nick)
+    {
+      total += seedrandScore(*nick);
+    }
+    return total;
+  }
+};
+
+
+struct SplitBench
+{
+  const StrVector & lines;
+
+  explicit SplitBench(const StrVector & l) : lines(l) { }
+
+  unsigned long operator()(void) const
+  {
+    unsigned long total = 0;
+    StrVector params;
+    for (StrVector::const_iterator line = lines.begin(); line != lines.end();
+      ++line)
+    {
+      params.clear();
+      total += SplitIRC(params, *line);
+    }
+    return total;
+  }
+};
+
+
+struct ParseBench
+{
+  const StrVector & lines;
+
+  explicit ParseBench(const StrVector & l) : lines(l) { }
+
+  unsigned long operator()(void) const
+  {
+    static const std::string serverName("irc.example.net");
+    unsigned long total = 0;
+    IRCMessage message;
+    for (StrVector::const_iterator line = lines.begin(); line != lines.end();
+      ++line)
+    {
+      if (message.parse(line->data(), line->length(), serverName))
+      {
+        total += message.size();
+      }
+    }
+    return total;
+  }
+};
+
+
+// Builds a user entry from a nick!user@host string, the way one would
+// be built from a "Client connecting" notice.
+static UserEntryPtr
+makeUser(const std::string & nuh)
+{
+  std::string::size_type bang = nuh.find('!');
+  std::string::size_type at = nuh.find('@');
+
+  if ((std::string::npos == bang) || (std::string::npos == at) || (at < bang))
+  {
+    return UserEntryPtr();
+  }
+
+  std::string host(nuh.substr(at + 1));
+
+  return UserEntryPtr(new UserEntry(nuh.substr(0, bang),
+    nuh.substr(bang + 1, at - bang - 1), host, "", "users", "",
+    BotSock::inet_addr(host), 0, false));
+}
+
+
+int
+main(int argc, char **argv)
+{
+  int passes = 5;
+  const char * nuhFile = "bench/nuh.txt";
+  const char * maskFile = "bench/masks.txt";
+  const char * trapFile = "bench/traps.txt";
+  const char * lineFile = "bench/irclines.txt";
+  int ch;
+
+  while ((ch = getopt(argc, argv, "n:u:m:t:l:")) != -1)
+  {
+    switch (ch)
+    {
+      case 'n':
+        passes = atoi(optarg);
+        break;
+      case 'u':
+        nuhFile = optarg;
+        break;
+      case 'm':
+        maskFile = optarg;
+        break;
+      case 't':
+        trapFile = optarg;
+        break;
+      case 'l':
+        lineFile = optarg;
+        break;
+      default:
+        std::cerr << "Usage: " << argv[0] << " [-n passes] [-u nuh_file] "
+          "[-m mask_file] [-t trap_file] [-l line_file]" << std::endl;
+        return 1;
+    }
+  }
+
+  StrVector nuh, masks, traps, lines;
+
+  if (!benchLoadCorpus(nuhFile, nuh) || !benchLoadCorpus(maskFile, masks) ||
+    !benchLoadTraps(trapFile, traps) || !benchLoadCorpus(lineFile, lines))
+  {
+    return 1;
+  }
+
+  StrVector nicks;
+  UserVector users;
+  for (StrVector::iterator pos = nuh.begin(); pos != nuh.end(); ++pos)
+  {
+    UserEntryPtr user(makeUser(*pos));
+    if (user)
+    {
+      users.push_back(user);
+      nicks.push_back(user->getNick());
+    }
+  }
+
+  FilterVector filters;
+  PatternVector regexes;
+  for (StrVector::iterator pos = traps.begin(); pos != traps.end(); ++pos)
+  {
+    try
+    {
+      Filter filter(*pos, Filter::FIELD_NUH, true);
+      filters.push_back(filter);
+
+      PatternPtr nuhPattern(filter.pattern(Filter::FIELD_NUH));
+      if (nuhPattern && (0 == nuhPattern->get().find('/')))
+      {
+        regexes.push_back(nuhPattern);
+      }
+    }
+    catch (OOMon::regex_error & e)
+    {
+      std::cerr << "Skipping " << *pos << ": " << e.what() << std::endl;
+    }
+    catch (Filter::bad_field & e)
+    {
+      std::cerr << "Skipping " << *pos << ": " << e.what() << std::endl;
+    }
+  }
+
+  std::cout << "Engine: " << RegExPattern::engine() << std::endl;
+  std::cout << nuh.size() << " users, " << masks.size() << " masks, " <<
+    filters.size() << " traps (" << regexes.size() << " nuh regexes), " <<
+    lines.size() << " lines, " << passes << " passes" << std::endl;
+
+  MaskBench maskBench(nuh, masks);
+  bench("MatchesMask", maskBench, nuh.size() * masks.size(), passes,
+    "matches");
+
+  RegExBench regexBench(nuh, regexes);
+  bench("RegExPattern::match", regexBench, nuh.size() * regexes.size(),
+    passes, "matches");
+
+  FilterBench filterBench(users, filters);
+  bench("Filter::matches", filterBench, users.size() * filters.size(),
+    passes, "matches");
+
+  SeedrandBench seedrandBench(nicks);
+  bench("seedrandScore", seedrandBench, nicks.size(), passes,
+    "total score");
+
+  SplitBench splitBench(lines);
+  bench("SplitIRC", splitBench, lines.size(), passes, "total count");
+
+  ParseBench parseBench(lines);
+  bench("IRCMessage::parse", parseBench, lines.size(), passes, "total count");
+
+  return 0;
+}
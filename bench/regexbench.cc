@@ -0,0 +1,225 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Compares the JIT and interpreter paths of RegExPattern::match() using
+// the regular expressions from a saved trap list (the "TRAP" lines of an
+// oomon.settings file) against a corpus of nick!user@host strings.
+
+// Std C++ Headers
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Boost C++ Headers
+#include <boost/shared_ptr.hpp>
+
+// Std C Headers
+#include <stdlib.h>
+#include <unistd.h>
+
+// OOMon Headers
+#include "oomon.h"
+#include "strtype"
+#include "pattern.h"
+#include "botexcept.h"
+#include "util.h"
+#include "benchutil.h"
+
+
+typedef std::vector<PatternPtr> PatternVector;
+
+
+// Pulls every regular expression out of a trap's filter, using the same
+// rules as Filter::Filter() and Filter::parseFilter().
+static void
+grabRegExes(std::string filter, StrVector & result)
+{
+  if (std::string::npos == filter.find('='))
+  {
+    std::string pattern(grabPattern(filter, " "));
+    if (!pattern.empty() && (pattern[0] == '/'))
+    {
+      result.push_back(pattern);
+    }
+    return;
+  }
+
+  while (!filter.empty())
+  {
+    std::string::size_type equals = filter.find('=');
+    if (std::string::npos == equals)
+    {
+      break;
+    }
+    filter.erase(0, equals + 1);
+
+    std::string pattern(grabPattern(filter, " ,"));
+    if (!pattern.empty() && (pattern[0] == '/'))
+    {
+      result.push_back(pattern);
+    }
+
+    if (filter.empty() || (filter[0] == ' '))
+    {
+      break;
+    }
+    filter.erase(0, 1);
+  }
+}
+
+
+static bool
+loadTraps(const char * filename, PatternVector & patterns)
+{
+  StrVector filters;
+
+  if (!benchLoadTraps(filename, filters))
+  {
+    return false;
+  }
+
+  for (StrVector::iterator filter = filters.begin(); filter != filters.end();
+    ++filter)
+  {
+    StrVector regexes;
+    grabRegExes(*filter, regexes);
+    for (StrVector::iterator pos = regexes.begin(); pos != regexes.end();
+      ++pos)
+    {
+      try
+      {
+        patterns.push_back(PatternPtr(new RegExPattern(*pos)));
+      }
+      catch (OOMon::regex_error & e)
+      {
+        std::cerr << "Skipping " << *pos << ": " << e.what() << std::endl;
+      }
+    }
+  }
+
+  return true;
+}
+
+
+static unsigned long
+run(const PatternVector & patterns, const StrVector & corpus,
+  const int passes, double & elapsed)
+{
+  unsigned long matches = 0;
+  double start = benchNow();
+
+  for (int pass = 0; pass < passes; ++pass)
+  {
+    for (StrVector::const_iterator text = corpus.begin();
+      text != corpus.end(); ++text)
+    {
+      for (PatternVector::const_iterator pattern = patterns.begin();
+        pattern != patterns.end(); ++pattern)
+      {
+        if ((*pattern)->match(*text))
+        {
+          ++matches;
+        }
+      }
+    }
+  }
+
+  elapsed = benchNow() - start;
+
+  return matches;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  int passes = 20;
+  int ch;
+
+  while ((ch = getopt(argc, argv, "n:")) != -1)
+  {
+    switch (ch)
+    {
+      case 'n':
+        passes = atoi(optarg);
+        break;
+      default:
+        std::cerr << "Usage: " << argv[0] <<
+          " [-n passes] [trap_file [corpus_file]]" << std::endl;
+        return 1;
+    }
+  }
+
+  const char * trapFile = (optind < argc) ? argv[optind++] : "bench/traps.txt";
+  const char * corpusFile = (optind < argc) ? argv[optind++] : "bench/nuh.txt";
+
+  PatternVector patterns;
+  StrVector corpus;
+
+  if (!loadTraps(trapFile, patterns) || !benchLoadCorpus(corpusFile, corpus))
+  {
+    return 1;
+  }
+
+  if (patterns.empty() || corpus.empty())
+  {
+    std::cerr << "Nothing to do!" << std::endl;
+    return 1;
+  }
+
+  unsigned long ops = static_cast<unsigned long>(passes) * patterns.size() *
+    corpus.size();
+
+  std::cout << "Engine: " << RegExPattern::engine() << std::endl;
+  std::cout << patterns.size() << " regex traps, " << corpus.size() <<
+    " strings, " << passes << " passes" << std::endl;
+
+  double elapsed;
+  unsigned long allocs;
+
+  RegExPattern::useJit(false);
+  run(patterns, corpus, 1, elapsed);
+  allocs = benchAllocations();
+  unsigned long interpMatches = run(patterns, corpus, passes, elapsed);
+  double interpElapsed = elapsed;
+  benchReport("interpreter", ops, interpElapsed, benchAllocations() - allocs,
+    IntToStr(interpMatches) + " matches");
+
+  RegExPattern::useJit(true);
+  run(patterns, corpus, 1, elapsed);
+  allocs = benchAllocations();
+  unsigned long jitMatches = run(patterns, corpus, passes, elapsed);
+  benchReport("jit", ops, elapsed, benchAllocations() - allocs,
+    IntToStr(jitMatches) + " matches");
+
+  if (interpMatches != jitMatches)
+  {
+    std::cerr << "*** JIT and interpreter results differ!" << std::endl;
+    return 1;
+  }
+
+  if (elapsed > 0)
+  {
+    std::cout << "speedup: " << (interpElapsed / elapsed) << 'x' << std::endl;
+  }
+
+  return 0;
+}
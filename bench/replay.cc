@@ -0,0 +1,412 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+
+// $Id$
+
+// Replays server traffic recorded with SERVER_CAPTURE through the real
+// IRC::onRead() pipeline, parsing and detection included, without a
+// server.  Anything the bot would have sent goes to a sink instead,
+// optionally written to a file so that two runs can be compared.  By
+// default the lines are replayed as fast as possible; -r keeps their
+// original pacing and -s speeds it up.  The report gives lines per
+// second, the latency of each message type's handler, what would have
+// been sent, and the state of the user table at the end.
+//
+// Lines without a timestamp are replayed too, so any file of raw server
+// lines (such as bench/irclines.txt) can be used.  Detection that
+// depends on the time between events sees the replay's own clock, so
+// results only match the original closely when paced.
+
+// Std C++ Headers
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+// Boost C++ Headers
+#include <boost/bind.hpp>
+
+// Std C Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// OOMon Headers
+#include "oomon.h"
+#include "strtype"
+#include "irc.h"
+#include "ircmsg.h"
+#include "config.h"
+#include "engine.h"
+#include "userhash.h"
+#include "timers.h"
+#include "botclient.h"
+#include "util.h"
+#include "benchutil.h"
+
+
+struct Record
+{
+  double when;		// Seconds, or -1 if the line had no timestamp
+  std::string line;
+};
+
+typedef std::vector<Record> RecordVector;
+
+
+struct HandlerStats
+{
+  HandlerStats(void) : count(0), total(0), max(0) { }
+
+  std::string name;
+  unsigned long count;
+  double total, max;	// Nanoseconds
+
+  bool operator<(const HandlerStats & other) const
+    { return this->total > other.total; }
+};
+
+typedef std::map<std::string, HandlerStats> HandlerMap;
+
+
+// Prints the user table's status the way .status shows it
+class ReplayClient : public BotClient
+{
+public:
+  virtual void send(const std::string & text)
+    { std::cout << "  " << text << std::endl; }
+  virtual UserFlags flags(void) const { return UserFlags::MASTER; }
+  virtual std::string handle(void) const { return "replay"; }
+  virtual std::string bot(void) const { return "replay"; }
+  virtual std::string id(void) const { return "replay"; }
+};
+
+
+class Sink
+{
+public:
+  Sink(std::ostream * file) : file_(file), count_(0) { }
+
+  void operator()(const std::string & text)
+  {
+    ++this->count_;
+
+    std::string copy(text);
+    ++this->commands_[UpCase(FirstWord(copy))];
+
+    if (0 != this->file_)
+    {
+      *this->file_ << text;
+    }
+  }
+
+  void report(void) const
+  {
+    std::cout << "Output: " << this->count_ << " lines";
+
+    std::string sep(" (");
+    for (std::map<std::string, unsigned long>::const_iterator pos =
+      this->commands_.begin(); pos != this->commands_.end(); ++pos)
+    {
+      std::cout << sep << pos->first << ' ' << pos->second;
+      sep = ", ";
+    }
+    std::cout << (this->commands_.empty() ? "" : ")") << std::endl;
+  }
+
+private:
+  std::ostream * file_;
+  unsigned long count_;
+  std::map<std::string, unsigned long> commands_;
+};
+
+
+static bool
+loadCapture(const char * filename, RecordVector & records)
+{
+  StrVector lines;
+
+  if (!benchLoadCorpus(filename, lines))
+  {
+    return false;
+  }
+
+  for (StrVector::iterator pos = lines.begin(); pos != lines.end(); ++pos)
+  {
+    Record record;
+    record.when = -1;
+
+    // IRC lines never start with a digit, so a leading number must be
+    // the capture's timestamp
+    const std::string::size_type space = pos->find(' ');
+    if (isdigit(static_cast<unsigned char>((*pos)[0])) &&
+      (std::string::npos != space))
+    {
+      record.when = atof(pos->substr(0, space).c_str());
+      record.line = pos->substr(space + 1);
+    }
+    else
+    {
+      record.line = *pos;
+    }
+
+    if (!record.line.empty())
+    {
+      records.push_back(record);
+    }
+  }
+
+  return true;
+}
+
+
+// Sleeps until the line's original time, scaled by the speed, has come
+static void
+pace(const Record & record, const double firstWhen, const double start,
+  const double speed)
+{
+  if ((record.when < 0) || (firstWhen < 0))
+  {
+    return;
+  }
+
+  const double due = start + ((record.when - firstWhen) * 1e9 / speed);
+  const double now = benchNow();
+
+  if (due > now)
+  {
+    usleep(static_cast<useconds_t>((due - now) / 1000));
+  }
+}
+
+
+// Captures started after the bot connected have no RPL_WELCOME to tell
+// the bot its server's name and its own nick, so they are taken from the
+// first server notice instead
+static void
+findIdentity(const RecordVector & records)
+{
+  for (RecordVector::const_iterator pos = records.begin();
+    pos != records.end(); ++pos)
+  {
+    IRCMessage message;
+
+    if (message.parse(pos->line.data(), pos->line.length(), "") &&
+      (message.size() > 3))
+    {
+      if (1 == message.numeric())
+      {
+        return;
+      }
+      else if ((message.command() == "NOTICE") &&
+        message[3].startsWith("*** Notice -- "))
+      {
+        server().setIdentity(message.prefix().str(), message[2].str());
+        std::cout << "server " << message.prefix().str() << ", nick " <<
+          message[2].str() << std::endl;
+        return;
+      }
+    }
+  }
+}
+
+
+static std::string
+handlerName(const std::string & line)
+{
+  IRCMessage message;
+
+  if (message.parse(line.data(), line.length(), "") && (message.size() > 1))
+  {
+    return message[1].str();
+  }
+
+  return "(unparsed)";
+}
+
+
+static void
+reportHandlers(const HandlerMap & handlers)
+{
+  std::vector<HandlerStats> sorted;
+  for (HandlerMap::const_iterator pos = handlers.begin();
+    pos != handlers.end(); ++pos)
+  {
+    sorted.push_back(pos->second);
+    sorted.back().name = pos->first;
+  }
+  std::sort(sorted.begin(), sorted.end());
+
+  std::cout << "Handler latency:" << std::endl;
+  for (std::vector<HandlerStats>::const_iterator pos = sorted.begin();
+    pos != sorted.end(); ++pos)
+  {
+    char line[128];
+    snprintf(line, sizeof(line), "%8lu lines %10.0f ns avg %10.0f ns max "
+      "%8.2f ms total", pos->count, pos->total / pos->count, pos->max,
+      pos->total / 1e6);
+    std::cout << "  " << padRight(pos->name, 10) << line << std::endl;
+  }
+}
+
+
+int
+main(int argc, char **argv)
+{
+  double speed = 0;
+  const char * configFile = 0;
+  const char * sinkFile = 0;
+  bool verbose = false;
+  int ch;
+
+  while ((ch = getopt(argc, argv, "c:o:rs:v")) != -1)
+  {
+    switch (ch)
+    {
+      case 'c':
+        configFile = optarg;
+        break;
+      case 'o':
+        sinkFile = optarg;
+        break;
+      case 'r':
+        speed = 1;
+        break;
+      case 's':
+        speed = atof(optarg);
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        std::cerr << "Usage: " << argv[0] << " [-c config_file] " <<
+          "[-o output_file] [-r | -s speed] [-v] [capture_file]" << std::endl;
+        return 1;
+    }
+  }
+
+  const char * captureFile = (optind < argc) ? argv[optind] :
+    "bench/irclines.txt";
+
+  RecordVector records;
+  if (!loadCapture(captureFile, records))
+  {
+    return 1;
+  }
+
+  if (records.empty())
+  {
+    std::cerr << "Nothing to do!" << std::endl;
+    return 1;
+  }
+
+  engine_init();
+  IRC::init();
+  UserHash::init();
+
+  if (0 != configFile)
+  {
+    Config replayConfig(configFile);
+    config = replayConfig;
+    config.loadSettings();
+  }
+
+  std::ofstream sinkStream;
+  if (0 != sinkFile)
+  {
+    sinkStream.open(sinkFile);
+    if (!sinkStream)
+    {
+      std::cerr << "Unable to open output file: " << sinkFile << std::endl;
+      return 1;
+    }
+  }
+
+  Sink sink(sinkStream.is_open() ? &sinkStream : 0);
+  server().setSink(boost::ref(sink));
+
+  std::cout << records.size() << " lines from " << captureFile;
+  if (speed > 0)
+  {
+    std::cout << " at " << speed << "x original pacing";
+  }
+  std::cout << std::endl;
+  findIdentity(records);
+
+  // A capture usually starts with clients the bot never saw connect,
+  // and the user table complains about each of them leaving
+  if (!verbose)
+  {
+    std::cerr.rdbuf(0);
+  }
+
+  HandlerMap handlers;
+  double elapsed = 0, timerTime = 0;
+  const double firstWhen = records.front().when;
+  const double start = benchNow();
+  const unsigned long allocs = benchAllocations();
+
+  for (RecordVector::const_iterator record = records.begin();
+    record != records.end(); ++record)
+  {
+    if (speed > 0)
+    {
+      pace(*record, firstWhen, start, speed);
+    }
+
+    const double before = benchNow();
+    server().onRead(record->line.data(), record->line.length());
+    const double taken = benchNow() - before;
+
+    // Timers that came due are not part of the line's handler
+    Timers::instance().run();
+    timerTime += benchNow() - before - taken;
+
+    HandlerStats & stats = handlers[handlerName(record->line)];
+    ++stats.count;
+    stats.total += taken;
+    if (taken > stats.max)
+    {
+      stats.max = taken;
+    }
+
+    elapsed += taken;
+  }
+
+  const double wall = benchNow() - start;
+
+  benchReport("replay", records.size(), elapsed,
+    benchAllocations() - allocs, IntToStr(static_cast<int>(records.size() *
+    1e9 / elapsed)) + " lines/sec");
+  std::cout << "wall time: " << (wall / 1e9) << " s" << std::endl;
+  std::cout << "timers: " << (timerTime / 1e6) << " ms" << std::endl;
+
+  reportHandlers(handlers);
+  sink.report();
+
+  ReplayClient client;
+  std::cout << "User table:" << std::endl;
+  users().status(&client);
+
+  return 0;
+}
+
@@ -0,0 +1,256 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Compares matching the VERSION, PRIVMSG, and NOTICE patterns of a saved
+// trap list against a corpus of message texts directly with matching them
+// behind the LiteralScanner prefilter used by TrapList::match().  The
+// match counts must agree, which also checks Pattern::literal().
+
+// Std C++ Headers
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Std C Headers
+#include <stdlib.h>
+#include <unistd.h>
+
+// OOMon Headers
+#include "oomon.h"
+#include "strtype"
+#include "pattern.h"
+#include "filter.h"
+#include "litscan.h"
+#include "botexcept.h"
+#include "util.h"
+#include "benchutil.h"
+
+
+struct ContentPattern
+{
+  PatternPtr pattern;
+  int literal;
+};
+
+typedef std::vector<ContentPattern> PatternVector;
+
+
+static void
+addPattern(const Filter & filter, const Filter::Field & field,
+  LiteralScanner & scanner, PatternVector & patterns)
+{
+  PatternPtr pattern(filter.pattern(field));
+
+  if (pattern)
+  {
+    ContentPattern content;
+    content.pattern = pattern;
+    content.literal = scanner.add(pattern->literal());
+    patterns.push_back(content);
+
+    std::cout << "  " << padRight(pattern->get(), 44) << " literal: \"" <<
+      pattern->literal() << '"' << std::endl;
+  }
+}
+
+
+static bool
+loadTraps(const char * filename, LiteralScanner & scanner,
+  PatternVector & patterns)
+{
+  StrVector filters;
+
+  if (!benchLoadTraps(filename, filters))
+  {
+    return false;
+  }
+
+  for (StrVector::iterator pos = filters.begin(); pos != filters.end(); ++pos)
+  {
+    try
+    {
+      Filter filter(*pos, Filter::FIELD_NUH, true);
+
+      addPattern(filter, Filter::FIELD_VERSION, scanner, patterns);
+      addPattern(filter, Filter::FIELD_PRIVMSG, scanner, patterns);
+      addPattern(filter, Filter::FIELD_NOTICE, scanner, patterns);
+    }
+    catch (OOMon::regex_error & e)
+    {
+      std::cerr << "Skipping " << *pos << ": " << e.what() << std::endl;
+    }
+    catch (Filter::bad_field & e)
+    {
+      std::cerr << "Skipping " << *pos << ": " << e.what() << std::endl;
+    }
+  }
+
+  return true;
+}
+
+
+static unsigned long
+runDirect(const PatternVector & patterns, const StrVector & corpus,
+  const int passes, double & elapsed)
+{
+  unsigned long matches = 0;
+  double start = benchNow();
+
+  for (int pass = 0; pass < passes; ++pass)
+  {
+    for (StrVector::const_iterator text = corpus.begin();
+      text != corpus.end(); ++text)
+    {
+      for (PatternVector::const_iterator pos = patterns.begin();
+        pos != patterns.end(); ++pos)
+      {
+        if (pos->pattern->match(*text))
+        {
+          ++matches;
+        }
+      }
+    }
+  }
+
+  elapsed = benchNow() - start;
+
+  return matches;
+}
+
+
+static unsigned long
+runPrefilter(const LiteralScanner & scanner, const PatternVector & patterns,
+  const StrVector & corpus, const int passes, double & elapsed,
+  unsigned long & evaluated)
+{
+  unsigned long matches = 0;
+  LiteralScanner::Result found;
+  double start = benchNow();
+
+  evaluated = 0;
+  for (int pass = 0; pass < passes; ++pass)
+  {
+    for (StrVector::const_iterator text = corpus.begin();
+      text != corpus.end(); ++text)
+    {
+      scanner.scan(*text, found);
+
+      for (PatternVector::const_iterator pos = patterns.begin();
+        pos != patterns.end(); ++pos)
+      {
+        if ((pos->literal < 0) || found[pos->literal])
+        {
+          ++evaluated;
+          if (pos->pattern->match(*text))
+          {
+            ++matches;
+          }
+        }
+      }
+    }
+  }
+
+  elapsed = benchNow() - start;
+
+  return matches;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  int passes = 20;
+  int ch;
+
+  while ((ch = getopt(argc, argv, "n:")) != -1)
+  {
+    switch (ch)
+    {
+      case 'n':
+        passes = atoi(optarg);
+        break;
+      default:
+        std::cerr << "Usage: " << argv[0] <<
+          " [-n passes] [trap_file [corpus_file]]" << std::endl;
+        return 1;
+    }
+  }
+
+  const char * trapFile = (optind < argc) ? argv[optind++] : "bench/traps.txt";
+  const char * corpusFile = (optind < argc) ? argv[optind++] :
+    "bench/messages.txt";
+
+  LiteralScanner scanner;
+  PatternVector patterns;
+  StrVector corpus;
+
+  std::cout << "Content patterns:" << std::endl;
+  if (!loadTraps(trapFile, scanner, patterns) ||
+    !benchLoadCorpus(corpusFile, corpus))
+  {
+    return 1;
+  }
+
+  if (patterns.empty() || corpus.empty())
+  {
+    std::cerr << "Nothing to do!" << std::endl;
+    return 1;
+  }
+
+  unsigned long ops = static_cast<unsigned long>(passes) * corpus.size();
+
+  std::cout << patterns.size() << " content patterns, " << scanner.size() <<
+    " literals (" << LiteralScanner::isa() << "), " << corpus.size() <<
+    " messages, " << passes << " passes" << std::endl;
+
+  double elapsed;
+  unsigned long evaluated;
+  unsigned long allocs;
+
+  runDirect(patterns, corpus, 1, elapsed);
+  allocs = benchAllocations();
+  unsigned long directMatches = runDirect(patterns, corpus, passes, elapsed);
+  double directElapsed = elapsed;
+  benchReport("direct", ops, directElapsed, benchAllocations() - allocs,
+    IntToStr(directMatches) + " matches");
+
+  runPrefilter(scanner, patterns, corpus, 1, elapsed, evaluated);
+  allocs = benchAllocations();
+  unsigned long prefilterMatches = runPrefilter(scanner, patterns, corpus,
+    passes, elapsed, evaluated);
+  benchReport("prefilter", ops, elapsed, benchAllocations() - allocs,
+    IntToStr(prefilterMatches) + " matches");
+
+  if (directMatches != prefilterMatches)
+  {
+    std::cerr << "*** Prefilter and direct results differ!" << std::endl;
+    return 1;
+  }
+
+  std::cout << "patterns evaluated: " << evaluated << " of " <<
+    (ops * patterns.size()) << std::endl;
+  if (elapsed > 0)
+  {
+    std::cout << "speedup: " << (directElapsed / elapsed) << 'x' << std::endl;
+  }
+
+  return 0;
+}
@@ -21,22 +21,35 @@
 
 // Std C++ headers
 #include <string>
+#include <algorithm>
 #include <cerrno>
 #include <ctime>
 
+// Boost C++ headers
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
 // Std C headers
 #include <stdio.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <string.h>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
 
 // OOMon headers
 #include "oomon.h"
 #include "botsock.h"
+#include "reactor.h"
+#include "linereader.h"
+#include "zstream.h"
 #include "botexcept.h"
 #include "botclient.h"
 #include "util.h"
@@ -48,28 +61,43 @@
 # define BOTSOCK_DEBUG
 #endif
 
-#ifdef BOTSOCK_DEBUG
-# include <boost/lexical_cast.hpp>
-#endif
-
 
 const BotSock::Address BotSock::ClassCNetMask =
   BotSock::inet_addr("255.255.255.0");
+const std::vector<char>::size_type BotSock::FRAME_HEADER;
 
 
 #ifdef BOTSOCK_DEBUG
 static unsigned long botSockCount = 0;
 #endif
 
+// Output waiting in the sockets' send queues
+static std::string::size_type queuedBytes = 0;
+static std::string::size_type peakQueuedBytes = 0;
+static unsigned long queuedSockets = 0;
+static unsigned long exceededCount = 0;
+
+// Sockets holding back compressed or batched output for flushBatches()
+static std::vector<BotSock *> heldSockets;
+
+// Most queued buffers passed to one writev() call
+static const int FLUSH_IOVECS = 16;
+
+// Input buffer size for new sockets, which is also the longest line that
+// can be read without being truncated
+static const std::vector<char>::size_type DEFAULT_BUFFER_SIZE = 2048;
+static unsigned long truncatedLines = 0;
+
 
 BotSock::BotSock(const bool blocking_, const bool lineBuffered)
-#ifdef OLD_BOTSOCK_LINEBUFFER
-  : buffer(""),
-#else
-  : bufferPos(0),
-#endif
+  : buffer(DEFAULT_BUFFER_SIZE), bufferHead(0), bufferTail(0), bufferCR(false),
+  bufferOverflow(false), outQueuePos(0), outQueueBytes(0), outQueueLimit(0),
+  outQueueExceeded(false),
   bindAddress(INADDR_ANY), timeout(0), connected(false), connecting(false),
-  listening(false), blocking(blocking_), binary(false), backlog(1)
+  listening(false), blocking(blocking_), binary(false), watched(false),
+  threaded(false), idleTimer(0), inflateStarting(false), framed(false),
+  frameStarting(false), batching(false), readyQueued(false), holding(false),
+  backlog(1), readyEvents(0)
 {
   if ((this->plug = ::socket(AF_INET, SOCK_STREAM, 0)) < 0)
   {
@@ -92,14 +120,15 @@ BotSock::BotSock(const bool blocking_, const bool lineBuffered)
 
 BotSock::BotSock(const BotSock *listener, const bool blocking,
   const bool lineBuffered)
-#ifdef OLD_BOTSOCK_LINEBUFFER
-  : buffer(""),
-#else
-  : bufferPos(0),
-#endif
+  : buffer(DEFAULT_BUFFER_SIZE), bufferHead(0), bufferTail(0), bufferCR(false),
+  bufferOverflow(false), outQueuePos(0), outQueueBytes(0), outQueueLimit(0),
+  outQueueExceeded(false),
   bindAddress(listener->bindAddress), timeout(listener->timeout),
   connected(true), connecting(false), listening(false),
-  blocking(blocking), lineBuffered(lineBuffered), backlog(listener->backlog)
+  blocking(blocking), lineBuffered(lineBuffered), watched(false),
+  threaded(false), idleTimer(0), inflateStarting(false), framed(false),
+  frameStarting(false), batching(false), readyQueued(false), holding(false),
+  backlog(listener->backlog), readyEvents(0)
 {
   struct sockaddr remotehost;
   memset(&remotehost, 0, sizeof(remotehost));
@@ -119,6 +148,7 @@ BotSock::BotSock(const BotSock *listener, const bool blocking,
   this->setBinary(listener->isBinary());
 
   this->gotActivity();
+  this->watch();
 
 #ifdef BOTSOCK_DEBUG
   ++botSockCount;
@@ -132,6 +162,15 @@ BotSock::~BotSock(void)
   --botSockCount;
 #endif
 
+  this->unwatch();
+  this->clearQueue();
+
+  if (this->holding)
+  {
+    heldSockets.erase(std::find(heldSockets.begin(), heldSockets.end(),
+      this));
+  }
+
   if (0 != ::close(this->plug))
   {
     std::cerr << "OMG!  WTF?  close() failed?!" << std::endl;
@@ -171,6 +210,7 @@ BotSock::connect(const BotSock::Address address, const BotSock::Port port)
     {
       this->gotActivity();
       this->connecting = true;
+      this->watch();
       return true;
     }
     else
@@ -188,6 +228,8 @@ BotSock::connect(const BotSock::Address address, const BotSock::Port port)
   this->connected = true;
 
   this->gotActivity();
+  this->startReader();
+  this->watch();
   
   this->connectTime = std::time(NULL);
 
@@ -238,6 +280,7 @@ BotSock::listen(const BotSock::Port port, const int backlog)
   listening = true;
 
   this->gotActivity();
+  this->watch();
 
   return true;
 }
@@ -253,349 +296,851 @@ BotSock::read(void *buffer, int size)
 int
 BotSock::write(void *buffer, int size)
 {
-  this->lastWrite = time(0);
+#ifdef HAVE_LIBZ
+  if (this->zstream)
+  {
+    std::string packed;
+
+    if (!this->zstream->deflate(static_cast<const char *>(buffer), size,
+      packed))
+    {
+      return -1;
+    }
+    this->hold();
+    if (!packed.empty() &&
+      (this->output(packed.data(), packed.length()) < 0))
+    {
+      return -1;
+    }
+
+    return size;
+  }
+#endif
 
-  return (::write(this->plug, buffer, size));
+  return this->output(static_cast<const char *>(buffer), size);
 }
 
 
 int
 BotSock::write(const std::string & text)
 {
-  this->lastWrite = time(0);
+#ifdef HAVE_LIBZ
+  if (this->zstream)
+  {
+    return this->write(const_cast<char *>(text.data()), text.length());
+  }
+#endif
 
-  return (::write(this->plug, text.c_str(), text.length()));
+  return this->output(text.data(), text.length());
 }
 
 
-bool
-BotSock::postSelect(const fd_set & readset, const fd_set & writeset)
+// write(buffer)
+//
+// Writes a buffer that may also be queued on other sockets.  It is only
+// copied if the socket is compressed.
+//
+int
+BotSock::write(const BotSock::Buffer & buffer)
 {
-  if (listening)
+#ifdef HAVE_LIBZ
+  if (this->zstream)
   {
-    if (FD_ISSET(this->plug, &readset))
-    {
-#ifdef BOTSOCK_DEBUG
-      std::cout << "BotSock::postSelect(): listener is ready for accept()" <<
-	std::endl;
-#endif
-
-      throw OOMon::ready_for_accept("Listening socket has connection waiting");
-    }
+    return this->write(const_cast<char *>(buffer->data()), buffer->length());
   }
-  else
-  {
-    if (FD_ISSET(this->plug, &readset))
-    {
-#ifdef OLD_BOTSOCK_LINEBUFFER
-      static char buff[2048];
-
-      memset(buff, 0, sizeof(buff));
 #endif
 
-#ifdef BOTSOCK_TRACE
-      std::cout << "BotSock::postSelect(): this->read()" << std::endl;
-#endif
+  return this->output(buffer);
+}
 
-#ifdef OLD_BOTSOCK_LINEBUFFER
-      int n = this->read(buff, sizeof(buff) - 1);
-#else
-      int n = this->read(this->buffer + this->bufferPos,
-        sizeof(this->buffer) - this->bufferPos);
-#endif
 
-      if (n > 0)
-      {
-#ifdef OLD_BOTSOCK_LINEBUFFER
-	buff[n] = '\0';		// Make sure it is null terminated!
+//////////////////////////////////////////////////////////////////////
+// BotSock::compress(level)
+//
+// Description:
+//  Compresses everything written to the socket from now on, and
+//  decompresses everything read from it after the line being handled.
+//  It must be called from the read handler of a line-buffered socket,
+//  so that the switch happens at the same place in the input as it did
+//  at the other end.  Compressed output is held back until flushBatch()
+//  is called.
+//
+// Parameters:
+//  level - The zlib compression level, from 1 to 9.
+//
+// Return Value:
+//  The function returns true if the socket is now compressed.
+//////////////////////////////////////////////////////////////////////
+bool
+BotSock::compress(const int level)
+{
+#ifdef HAVE_LIBZ
+  if (!this->zstream && this->isBuffering() && !this->isBinary() &&
+    !this->reader)
+  {
+    this->zstream.reset(new ZStream(level));
+    this->zinput.resize(this->buffer.size());
+    this->inflateStarting = true;
+  }
+#endif
 
-        this->gotActivity();
+  return this->isCompressed();
+}
 
-        if (this->isBinary() && (this->buffer.length() == 0))
-	{
-          return this->onRead(buff, n);
-	}
-	else if (this->isBuffering())
-	{
-	  std::string::size_type eol;
-
-          this->buffer += buff;
-
-	  while (std::string::npos !=
-	    (eol = this->buffer.find_first_of("\r\n")))
-	  {
-	    std::string line = this->buffer.substr(0, eol);
-	    this->buffer = this->buffer.substr(eol + 1);
-
-	    if (!this->onRead(line))
-	    {
-	      return false;
-	    }
-	  }
-	  return true;
-	}
-	else
-	{
-	  if (this->buffer.length() == 0)
-	  {
-            return this->onRead(buff);
-	  }
-	  else
-	  {
-	    bool result = this->onRead(buff + buffer);
-	    buffer = "";
-	    return result;
-	  }
-	}
-#else
-        this->bufferPos += n;
 
-        this->gotActivity();
+// frame()
+//
+// Splits everything read from the socket after the line being handled
+// into length-prefixed frames instead of lines.  Like compress(), it
+// must be called from the read handler of a line-buffered socket.  Each
+// frame is passed to the line handler.
+//
+bool
+BotSock::frame(void)
+{
+  if (!this->framed && this->isBuffering() && !this->isBinary() &&
+    !this->reader)
+  {
+    this->frameStarting = true;
+  }
 
-        if (this->isBinary())
-	{
-          return this->onRead(this->buffer, this->bufferPos);
-	}
-	else if (this->isBuffering())
-	{
-          char * cr;
-          char * nl;
-          do {
-            int eol = -1;
-
-            // find first end-of-line character
-            cr = reinterpret_cast<char *>(memchr(this->buffer, '\r',
-              this->bufferPos));
-            nl = reinterpret_cast<char *>(memchr(this->buffer, '\n',
-              this->bufferPos));
-            if (cr && nl)
-            {
-              if (cr < nl)
-              {
-                eol = cr - this->buffer;
-              }
-              else
-              {
-                eol = nl - this->buffer;
-              }
-            }
-            else if (cr)
-            {
-              eol = cr - this->buffer;
-            }
-            else if (nl)
-            {
-              eol = nl - this->buffer;
-            }
-
-            if (eol >= 0)
-            {
-              std::string line(this->buffer, eol);
-              if (this->bufferPos > (eol + 1))
-              {
-                memmove(this->buffer, this->buffer + eol + 1,
-                  this->bufferPos - (eol + 1));
-                this->bufferPos -= (eol + 1);
-              }
-              else
-              {
-                this->bufferPos = 0;
-              }
-
-              if (!this->onRead(line))
-              {
-                return false;
-              }
-            }
-            else if (this->bufferPos == sizeof(this->buffer))
-            {
-              std::string line(this->buffer, sizeof(this->buffer));
-              this->bufferPos = 0;
-
-              if (!this->onRead(line))
-              {
-                return false;
-              }
-            }
-          } while (cr || nl);
-
-	  return true;
-	}
-        else
-        {
-          std::string line(this->buffer, this->bufferPos);
-          this->bufferPos = 0;
+  return this->framed || this->frameStarting;
+}
 
-          if (!this->onRead(line))
-          {
-            return false;
-          }
-        }
-#endif
-      }
-      else if (n == 0)
-      {
-        std::cerr << "BotSock::postSelect(): EOF of socket" << std::endl;
 
-        return false;
-      }
-      else
-      {
-        std::cerr << "BotSock::read() error " << errno << std::endl;
+//////////////////////////////////////////////////////////////////////
+// BotSock::flushBatch()
+//
+// Description:
+//  Sends the output a compressed or batching socket has been holding
+//  back.  Everything written to a batching socket since the last flush
+//  is queued and then sent with as few writev() calls as possible.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns false if the write failed.
+//////////////////////////////////////////////////////////////////////
+bool
+BotSock::flushBatch(void)
+{
+#ifdef HAVE_LIBZ
+  if (this->zstream)
+  {
+    std::string packed;
 
-        return false;
-      }
+    if (!this->zstream->flush(packed))
+    {
+      return false;
     }
-
-    if (!this->isConnected())
+    if (!packed.empty() && (this->output(packed.data(), packed.length()) < 0))
     {
-      if (FD_ISSET(this->plug, &writeset))
-      {
-	this->connecting = false;
-        this->connected = true;
-
-        this->connectTime = std::time(NULL);
-
-        if (!this->onConnect())
-        {
-	  return false;
-        }
-      }
+      return false;
     }
   }
+#endif
 
-  if ((this->getTimeout() > 0) && (this->getIdle() > this->getTimeout()))
+  if (this->batching && !this->outQueue.empty() && this->isConnected())
   {
-    throw OOMon::timeout_error("Connection timed out");
+    if (!this->flush())
+    {
+      return false;
+    }
+    // Anything the socket wouldn't take is sent when it is writable
+    this->watch();
   }
 
   return true;
 }
 
 
+// flushBatches()
+//
+// Calls flushBatch() for each socket that has held output back since
+// the last call.  A socket whose write fails is dropped when the
+// reactor reports the error.
+//
 void
-BotSock::preSelect(fd_set & readset, fd_set & writeset) const
+BotSock::flushBatches(void)
 {
-  FD_SET(this->plug, &readset);
-  if (this->isConnecting())
+  std::vector<BotSock *> held;
+  held.swap(heldSockets);
+
+  for (std::vector<BotSock *>::iterator pos = held.begin(); pos != held.end();
+    ++pos)
   {
-    FD_SET(this->plug, &writeset);
+    (*pos)->flushBatch();
+    (*pos)->holding = false;
   }
 }
 
 
+// hold()
+//
+// Remembers that the socket has output for flushBatches() to send.
+//
 void
-BotSock::bindTo(const std::string & address)
+BotSock::hold(void)
 {
-  if (address.empty())
-  {
-    this->bindAddress = INADDR_ANY;
-  }
-  else
+  if (!this->holding)
   {
-    this->bindAddress = BotSock::nsLookup(address);
+    this->holding = true;
+    heldSockets.push_back(this);
   }
 }
 
 
-BotSock::Address
-BotSock::getLocalAddress(void) const
+//////////////////////////////////////////////////////////////////////
+// BotSock::output(data, size)
+//
+// Description:
+//  Writes as much data to the socket as it will take without blocking
+//  and queues the rest, to be sent when the reactor reports that the
+//  socket is writable.  Data written before the connection completes
+//  is queued.  Once the queue is non-empty, further data is queued
+//  behind it so that output is never reordered.  If the queue grows
+//  past the socket's limit, the connection is dropped the next time
+//  the socket is processed.
+//
+// Parameters:
+//  data - The data to write.
+//  size - The number of bytes to write.
+//
+// Return Value:
+//  The function returns the number of bytes written or queued, or -1
+//  if the write failed.
+//////////////////////////////////////////////////////////////////////
+int
+BotSock::output(const char *data, const int size)
 {
-  struct sockaddr_in localaddr;
-  socklen_t size = sizeof(localaddr);
-
-  memset(&localaddr, 0, sizeof(localaddr));
+  int written = this->writeNow(data, size);
 
-  if (-1 == ::getsockname(this->plug,
-    reinterpret_cast<struct sockaddr *>(&localaddr), &size))
+  if ((written < 0) || (written == size))
   {
-    return INADDR_NONE;
+    return written;
   }
 
-  return localaddr.sin_addr.s_addr;
+  this->enqueue(Buffer(new std::string(data + written, size - written)), 0);
+
+  return size;
 }
 
 
-BotSock::Port
-BotSock::getLocalPort(void) const
+// output(buffer)
+//
+// Like output(data, size), except that whatever can't be written right
+// away is queued by sharing the buffer rather than copying it.
+//
+int
+BotSock::output(const BotSock::Buffer & buffer)
 {
-  struct sockaddr_in localaddr;
-  socklen_t size = sizeof(localaddr);
-
-  memset(&localaddr, 0, sizeof(localaddr));
+  const int size = buffer->length();
+  int written = this->writeNow(buffer->data(), size);
 
-  if (-1 == ::getsockname(this->plug,
-    reinterpret_cast<struct sockaddr *>(&localaddr), &size))
+  if ((written < 0) || (written == size))
   {
-    return 0;
+    return written;
   }
 
-  return localaddr.sin_port;
+  this->enqueue(buffer, written);
+
+  return size;
 }
 
 
-BotSock::Address
-BotSock::getRemoteAddress(void) const
+// writeNow(data, size)
+//
+// Writes directly to the socket if nothing is queued ahead of the data
+// and output isn't being batched.  Returns the number of bytes written,
+// or -1 if the write failed.
+//
+int
+BotSock::writeNow(const char *data, const int size)
 {
-  struct sockaddr_in remoteaddr;
-  socklen_t size = sizeof(remoteaddr);
-
-  memset(&remoteaddr, 0, sizeof(remoteaddr));
+  this->lastWrite = std::time(NULL);
 
-  if (-1 == ::getpeername(this->plug,
-    reinterpret_cast<struct sockaddr *>(&remoteaddr), &size))
+  if (this->outQueue.empty() && this->isConnected() && !this->batching)
   {
-    return INADDR_NONE;
+    int written = ::write(this->plug, data, size);
+
+    if (written < 0)
+    {
+      return ((EAGAIN == errno) || (EINTR == errno)) ? 0 : -1;
+    }
+
+    return written;
   }
 
-  return remoteaddr.sin_addr.s_addr;
+  return 0;
 }
 
 
-BotSock::Port
-BotSock::getRemotePort(void) const
+// enqueue(buffer, offset)
+//
+// Queues the part of a buffer after the offset behind any output that
+// is already queued.
+//
+void
+BotSock::enqueue(const BotSock::Buffer & buffer,
+  const std::string::size_type offset)
 {
-  struct sockaddr_in remoteaddr;
-  socklen_t size = sizeof(remoteaddr);
+  const std::string::size_type size = buffer->length() - offset;
 
-  memset(&remoteaddr, 0, sizeof(remoteaddr));
+  if (this->outQueue.empty())
+  {
+    ++queuedSockets;
+    this->outQueuePos = offset;
+  }
+  this->outQueue.push_back(buffer);
+  this->outQueueBytes += size;
+  queuedBytes += size;
+  if (queuedBytes > peakQueuedBytes)
+  {
+    peakQueuedBytes = queuedBytes;
+  }
 
-  if (-1 == ::getpeername(this->plug,
-    reinterpret_cast<struct sockaddr *>(&remoteaddr), &size))
+  if ((0 != this->outQueueLimit) && (*this->outQueueLimit > 0) &&
+    (this->queued() > static_cast<std::string::size_type>(*this->outQueueLimit)))
   {
-    return 0;
+    this->outQueueExceeded = true;
+    this->ready();
   }
 
-  return remoteaddr.sin_port;
+  if (this->batching)
+  {
+    this->hold();
+  }
+  else
+  {
+    this->watch();
+  }
 }
 
 
+// flush()
+//
+// Writes queued output until the queue is empty or the socket would
+// block.  Several queued buffers are passed to each writev() call.
+// Returns false if the write failed.
+//
 bool
-BotSock::setBlocking(const bool value)
+BotSock::flush(void)
 {
-  this->blocking = value;
+  if (this->outQueue.empty())
+  {
+    return true;
+  }
 
-  if (this->plug != -1)
+  while (!this->outQueue.empty())
   {
-    int flags = ::fcntl(this->plug, F_GETFL);
+    struct iovec iov[FLUSH_IOVECS];
+    std::string::size_type total = 0;
+    int count = 0;
 
-    if (value)
+    for (std::deque<Buffer>::const_iterator pos = this->outQueue.begin();
+      (pos != this->outQueue.end()) && (count < FLUSH_IOVECS); ++pos, ++count)
     {
-      flags &= ~O_NONBLOCK;
+      const std::string::size_type skip = (0 == count) ? this->outQueuePos : 0;
+
+      iov[count].iov_base = const_cast<char *>((*pos)->data() + skip);
+      iov[count].iov_len = (*pos)->length() - skip;
+      total += iov[count].iov_len;
     }
-    else
+
+    ssize_t n = ::writev(this->plug, iov, count);
+
+    if (n < 0)
     {
-      flags |= O_NONBLOCK;
+      if ((EAGAIN == errno) || (EINTR == errno))
+      {
+        break;
+      }
+
+      std::cerr << "BotSock::write() error " << errno << std::endl;
+      return false;
     }
 
-    if (-1 == ::fcntl(this->plug, F_SETFL, flags))
+    this->outQueueBytes -= n;
+    queuedBytes -= n;
+
+    // Drop the buffers that were sent completely
+    std::string::size_type sent = n + this->outQueuePos;
+    while (!this->outQueue.empty() && (sent >= this->outQueue.front()->length()))
     {
-      std::cerr << "fcntl() failed: " << errno <<
-#if defined(HAVE_STRERROR)
-        " (" << strerror(errno) << ')' <<
-#endif
-        std::endl;
-      return false;
+      sent -= this->outQueue.front()->length();
+      this->outQueue.pop_front();
+    }
+    this->outQueuePos = sent;
+
+    if (static_cast<std::string::size_type>(n) < total)
+    {
+      // A short write means the socket buffer is full
+      break;
+    }
+  }
+
+  if (this->outQueue.empty())
+  {
+    this->outQueuePos = 0;
+    --queuedSockets;
+    this->watch();
+  }
+
+  return true;
+}
+
+
+void
+BotSock::clearQueue(void)
+{
+  if (!this->outQueue.empty())
+  {
+    queuedBytes -= this->queued();
+    --queuedSockets;
+  }
+
+  this->outQueue.clear();
+  this->outQueuePos = 0;
+  this->outQueueBytes = 0;
+  this->outQueueExceeded = false;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// BotSock::process()
+//
+// Description:
+//  Handles whatever the reactor reported the socket ready for since
+//  the last call: accepting, completing a connection, or reading and
+//  passing on the data received.  Also checks for inactivity.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns false if the connection was closed or failed.
+//  OOMon::ready_for_accept is thrown when a listening socket has a
+//  connection waiting, and OOMon::timeout_error when the socket has
+//  been idle for longer than its timeout.
+//////////////////////////////////////////////////////////////////////
+bool
+BotSock::process(void)
+{
+  const int events = this->readyEvents;
+  this->readyEvents = 0;
+  this->readyQueued = false;
+
+  if (this->outQueueExceeded)
+  {
+    std::cerr << "BotSock::process(): send queue exceeded (" <<
+      this->queued() << " bytes)" << std::endl;
+    ++exceededCount;
+
+    return false;
+  }
+
+  if (listening)
+  {
+    if (events & Reactor::READ)
+    {
+#ifdef BOTSOCK_DEBUG
+      std::cout << "BotSock::process(): listener is ready for accept()" <<
+	std::endl;
+#endif
+
+      throw OOMon::ready_for_accept("Listening socket has connection waiting");
+    }
+  }
+  else
+  {
+    if ((events & Reactor::READ) && this->reader)
+    {
+      if (!this->readLines())
+      {
+        return false;
+      }
+    }
+    else if (events & Reactor::READ)
+    {
+#ifdef BOTSOCK_TRACE
+      std::cout << "BotSock::process(): this->read()" << std::endl;
+#endif
+
+      this->makeRoom();
+
+      // Compressed input is read aside and decompressed into the buffer
+      int n = this->zstream ?
+        this->read(&this->zinput[0], this->zinput.size()) :
+        this->read(&this->buffer[this->bufferTail],
+        this->buffer.size() - this->bufferTail);
+
+      if ((n > 0) && this->zstream)
+      {
+        this->gotActivity();
+
+        return this->inflateLines(&this->zinput[0], n);
+      }
+      else if (n > 0)
+      {
+        this->bufferTail += n;
+
+        this->gotActivity();
+
+        if (this->isBinary())
+	{
+          bool result = this->onRead(&this->buffer[this->bufferHead],
+            this->bufferTail - this->bufferHead);
+          this->clearBuffer();
+          return result;
+	}
+	else if (this->isBuffering())
+	{
+          return this->split();
+	}
+        else
+        {
+          std::string text(&this->buffer[this->bufferHead],
+            this->bufferTail - this->bufferHead);
+          this->clearBuffer();
+
+          if (!this->onRead(text))
+          {
+            return false;
+          }
+        }
+      }
+      else if (n == 0)
+      {
+        std::cerr << "BotSock::process(): EOF of socket" << std::endl;
+
+        return false;
+      }
+      else if ((EAGAIN == errno) || (EINTR == errno))
+      {
+        // Nothing to read after all
+      }
+      else
+      {
+        std::cerr << "BotSock::read() error " << errno << std::endl;
+
+        return false;
+      }
+    }
+
+    if (!this->isConnected())
+    {
+      if (events & Reactor::WRITE)
+      {
+	this->connecting = false;
+        this->connected = true;
+        this->startReader();
+        this->watch();
+
+        this->connectTime = std::time(NULL);
+
+        if (!this->onConnect())
+        {
+	  return false;
+        }
+      }
+    }
+
+    if ((events & Reactor::WRITE) && this->isConnected() &&
+      !this->flush())
+    {
+      return false;
+    }
+  }
+
+  if ((this->getTimeout() > 0) && (this->getIdle() > this->getTimeout()))
+  {
+    throw OOMon::timeout_error("Connection timed out");
+  }
+
+  return true;
+}
+
+
+void
+BotSock::onReady(const int, const int events)
+{
+  this->readyEvents |= events;
+  this->ready();
+}
+
+
+// ready()
+//
+// Tells the owner the socket needs processing, unless it has already
+// been told since the socket was last processed.
+//
+void
+BotSock::ready(void)
+{
+  if (!this->readyQueued && !this->onReadyHandler.empty())
+  {
+    this->readyQueued = true;
+    this->onReadyHandler();
+  }
+}
+
+
+// watch()
+//
+// Registers the socket with the reactor, or updates its registration.
+// The socket is watched for input unless a reader thread is reading
+// it, and for output while a connection is in progress or output is
+// queued.
+//
+void
+BotSock::watch(void)
+{
+  const int events = (this->reader ? 0 : Reactor::READ) |
+    ((this->isConnecting() || !this->outQueue.empty()) ? Reactor::WRITE : 0);
+
+  if (0 == events)
+  {
+    if (this->watched)
+    {
+      Reactor::instance().remove(this->plug, this);
+      this->watched = false;
+    }
+  }
+  else if (this->watched)
+  {
+    Reactor::instance().modify(this->plug, this, events);
+  }
+  else
+  {
+    this->watched = Reactor::instance().add(this->plug, this, events);
+  }
+
+  if ((0 == this->idleTimer) && (this->timeout > 0))
+  {
+    this->armIdleTimer(this->timeout - this->getIdle() + 1);
+  }
+}
+
+
+void
+BotSock::unwatch(void)
+{
+  if (this->reader)
+  {
+    this->reader->stop();
+    this->reader.reset();
+    this->readerLine.clear();
+  }
+
+  if (this->watched)
+  {
+    Reactor::instance().remove(this->plug, this);
+    this->watched = false;
+  }
+  this->readyEvents = 0;
+  this->readyQueued = false;
+
+  Timers::instance().cancel(this->idleTimer);
+  this->idleTimer = 0;
+}
+
+
+void
+BotSock::setTimeout(const std::time_t value)
+{
+  this->timeout = value;
+
+  Timers::instance().cancel(this->idleTimer);
+  this->idleTimer = 0;
+
+  // The timer works out the real deadline when it fires
+  if ((this->watched || this->reader) && (value > 0))
+  {
+    this->armIdleTimer(1);
+  }
+}
+
+
+void
+BotSock::armIdleTimer(const double seconds)
+{
+  this->idleTimer = Timers::instance().after((seconds > 0) ? seconds : 1,
+    boost::bind(&BotSock::onIdleTimer, this));
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// BotSock::onIdleTimer()
+//
+// Description:
+//  Called by the socket's timer when it may have been idle long enough
+//  to need a keepalive or to have timed out.  It calls the idle handler
+//  if nothing has been received or sent for half the timeout, then sets
+//  the timer for whichever of those is due next.  Timing out is left to
+//  process(); once the socket has been idle too long, this timer only
+//  asks the owner to process it.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+BotSock::onIdleTimer(void)
+{
+  this->idleTimer = 0;
+
+  if (this->timeout <= 0)
+  {
+    return;
+  }
+
+  const std::time_t half = this->timeout / 2;
+
+  if (!this->onIdleHandler.empty() && this->isConnected() &&
+    (this->getIdle() > half) && (this->getWriteIdle() > half))
+  {
+    this->onIdleHandler();
+  }
+
+  if (this->getIdle() > this->timeout)
+  {
+    this->ready();
+  }
+
+  // A socket that has already timed out is checked again every second
+  // until its owner closes it
+  double wait = this->timeout - this->getIdle() + 1;
+
+  if (!this->onIdleHandler.empty())
+  {
+    const double keepalive = half + 1 -
+      std::min(this->getIdle(), this->getWriteIdle());
+
+    if ((keepalive > 0) && (keepalive < wait))
+    {
+      wait = keepalive;
+    }
+  }
+
+  this->armIdleTimer(wait);
+}
+
+
+void
+BotSock::bindTo(const std::string & address)
+{
+  if (address.empty())
+  {
+    this->bindAddress = INADDR_ANY;
+  }
+  else
+  {
+    this->bindAddress = BotSock::nsLookup(address);
+  }
+}
+
+
+BotSock::Address
+BotSock::getLocalAddress(void) const
+{
+  struct sockaddr_in localaddr;
+  socklen_t size = sizeof(localaddr);
+
+  memset(&localaddr, 0, sizeof(localaddr));
+
+  if (-1 == ::getsockname(this->plug,
+    reinterpret_cast<struct sockaddr *>(&localaddr), &size))
+  {
+    return INADDR_NONE;
+  }
+
+  return localaddr.sin_addr.s_addr;
+}
+
+
+BotSock::Port
+BotSock::getLocalPort(void) const
+{
+  struct sockaddr_in localaddr;
+  socklen_t size = sizeof(localaddr);
+
+  memset(&localaddr, 0, sizeof(localaddr));
+
+  if (-1 == ::getsockname(this->plug,
+    reinterpret_cast<struct sockaddr *>(&localaddr), &size))
+  {
+    return 0;
+  }
+
+  return localaddr.sin_port;
+}
+
+
+BotSock::Address
+BotSock::getRemoteAddress(void) const
+{
+  struct sockaddr_in remoteaddr;
+  socklen_t size = sizeof(remoteaddr);
+
+  memset(&remoteaddr, 0, sizeof(remoteaddr));
+
+  if (-1 == ::getpeername(this->plug,
+    reinterpret_cast<struct sockaddr *>(&remoteaddr), &size))
+  {
+    return INADDR_NONE;
+  }
+
+  return remoteaddr.sin_addr.s_addr;
+}
+
+
+BotSock::Port
+BotSock::getRemotePort(void) const
+{
+  struct sockaddr_in remoteaddr;
+  socklen_t size = sizeof(remoteaddr);
+
+  memset(&remoteaddr, 0, sizeof(remoteaddr));
+
+  if (-1 == ::getpeername(this->plug,
+    reinterpret_cast<struct sockaddr *>(&remoteaddr), &size))
+  {
+    return 0;
+  }
+
+  return remoteaddr.sin_port;
+}
+
+
+bool
+BotSock::setBlocking(const bool value)
+{
+  this->blocking = value;
+
+  if (this->plug != -1)
+  {
+    int flags = ::fcntl(this->plug, F_GETFL);
+
+    if (value)
+    {
+      flags &= ~O_NONBLOCK;
+    }
+    else
+    {
+      flags |= O_NONBLOCK;
+    }
+
+    if (-1 == ::fcntl(this->plug, F_SETFL, flags))
+    {
+      std::cerr << "fcntl() failed: " << errno <<
+#if defined(HAVE_STRERROR)
+        " (" << strerror(errno) << ')' <<
+#endif
+        std::endl;
+      return false;
     }
   }
   return true;
@@ -605,7 +1150,443 @@ BotSock::setBlocking(const bool value)
 void
 BotSock::setBuffering(const bool value)
 {
-  this->lineBuffered = value;
+  this->lineBuffered = value;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// BotSock::setBufferSize(size)
+//
+// Description:
+//  Changes the size of the input buffer.  Lines longer than this are
+//  truncated.  Any input that has not yet been handled is discarded,
+//  so this should be done before connecting.
+//
+// Parameters:
+//  size - The new size, in bytes.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+BotSock::setBufferSize(const std::vector<char>::size_type size)
+{
+  this->buffer.assign((size > 0) ? size : 1, 0);
+  this->clearBuffer();
+}
+
+
+void
+BotSock::clearBuffer(void)
+{
+  this->bufferHead = this->bufferTail = 0;
+  this->bufferCR = this->bufferOverflow = false;
+}
+
+
+// findEol(text, length)
+//
+// Returns a pointer to the first CR or LF character in the text, or 0 if
+// there is none.  With SSE2, 16 characters are checked at a time.
+//
+const char *
+BotSock::findEol(const char *text, const std::vector<char>::size_type length)
+{
+  const char * pos = text;
+  const char * const end = text + length;
+
+#ifdef __SSE2__
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+
+  for (; (end - pos) >= 16; pos += 16)
+  {
+    const __m128i block =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+    const int found = _mm_movemask_epi8(_mm_or_si128(
+      _mm_cmpeq_epi8(block, cr), _mm_cmpeq_epi8(block, lf)));
+
+    if (0 != found)
+    {
+      return pos + __builtin_ctz(found);
+    }
+  }
+#endif
+
+  for (; pos < end; ++pos)
+  {
+    if (('\r' == *pos) || ('\n' == *pos))
+    {
+      return pos;
+    }
+  }
+
+  return 0;
+}
+
+
+// split()
+//
+// Passes each complete line or frame in the input buffer to the line
+// handler.
+//
+bool
+BotSock::split(void)
+{
+  return this->framed ? this->splitFrames() : this->splitLines();
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// BotSock::splitLines()
+//
+// Description:
+//  Passes each complete line in the input buffer to the read handler.
+//  Lines are handed over in place, so the buffer is only ever moved
+//  when a partial line reaches the end of it.  CR, LF, and CR LF all
+//  end a line.  A line that doesn't fit in the buffer is truncated and
+//  the rest of it is discarded.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns false if a handler asked for the connection to
+//  be closed.
+//////////////////////////////////////////////////////////////////////
+bool
+BotSock::splitLines(void)
+{
+  while (this->bufferHead < this->bufferTail)
+  {
+    const char * const start = &this->buffer[this->bufferHead];
+
+    if (this->bufferCR)
+    {
+      // Skip the LF of a CR LF pair, even if it arrived separately
+      this->bufferCR = false;
+      if ('\n' == *start)
+      {
+        ++this->bufferHead;
+        continue;
+      }
+    }
+
+    const char * const eol = findEol(start,
+      this->bufferTail - this->bufferHead);
+
+    if (0 == eol)
+    {
+      if ((0 == this->bufferHead) &&
+        (this->bufferTail == this->buffer.size()))
+      {
+        // The buffer is full and there is still no end of line
+        bool result = true;
+
+        if (!this->bufferOverflow)
+        {
+          ++truncatedLines;
+          std::cerr << "BotSock::splitLines(): line longer than " <<
+            this->buffer.size() << " bytes truncated" << std::endl;
+          result = this->onLine(start, this->bufferTail);
+        }
+        this->bufferHead = this->bufferTail = 0;
+        this->bufferOverflow = true;
+
+        return result;
+      }
+      break;
+    }
+
+    const int length = eol - start;
+
+    this->bufferHead += length + 1;
+    this->bufferCR = ('\r' == *eol);
+
+    if (this->bufferOverflow)
+    {
+      // This was the end of a line that has already been truncated
+      this->bufferOverflow = false;
+    }
+    else if (!this->onLine(start, length))
+    {
+      return false;
+    }
+
+    if (this->frameStarting)
+    {
+      // The handler turned on framing, so the rest of the input is frames
+      this->frameStarting = false;
+      this->framed = true;
+      this->bufferCR = false;
+
+      if (!this->inflateStarting)
+      {
+        return this->splitFrames();
+      }
+    }
+
+    if (this->inflateStarting)
+    {
+      // The handler turned on compression, so the rest of the input is
+      // compressed
+      this->inflateStarting = false;
+      this->bufferCR = false;
+
+      const std::vector<char> rest(this->buffer.begin() + this->bufferHead,
+        this->buffer.begin() + this->bufferTail);
+      this->bufferHead = this->bufferTail = 0;
+
+      return rest.empty() || this->inflateLines(&rest[0], rest.size());
+    }
+  }
+
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// BotSock::splitFrames()
+//
+// Description:
+//  Passes each complete frame in the input buffer to the line handler.
+//  A frame is a two byte, big-endian length followed by that many bytes
+//  of data.  Frames are handed over in place, without their headers.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns false if a frame is too long to fit in the
+//  input buffer or a handler asked for the connection to be closed.
+//////////////////////////////////////////////////////////////////////
+bool
+BotSock::splitFrames(void)
+{
+  while ((this->bufferTail - this->bufferHead) >= BotSock::FRAME_HEADER)
+  {
+    const unsigned char * const header =
+      reinterpret_cast<const unsigned char *>(&this->buffer[this->bufferHead]);
+    const std::vector<char>::size_type length = (header[0] << 8) | header[1];
+
+    if ((length + BotSock::FRAME_HEADER) > this->buffer.size())
+    {
+      std::cerr << "BotSock::splitFrames(): " << length <<
+        " byte frame is too long" << std::endl;
+      return false;
+    }
+
+    if ((this->bufferTail - this->bufferHead) <
+      (length + BotSock::FRAME_HEADER))
+    {
+      break;
+    }
+
+    const char * const start =
+      &this->buffer[this->bufferHead + BotSock::FRAME_HEADER];
+
+    this->bufferHead += length + BotSock::FRAME_HEADER;
+
+    if (!this->onLine(start, length))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// BotSock::inflateLines(data, size)
+//
+// Description:
+//  Decompresses data read from a compressed socket into the input
+//  buffer, passing each complete line to the read handler as the
+//  buffer fills.
+//
+// Parameters:
+//  data - The compressed data.
+//  size - The number of bytes of compressed data.
+//
+// Return Value:
+//  The function returns false if the data was corrupt or a handler
+//  asked for the connection to be closed.
+//////////////////////////////////////////////////////////////////////
+bool
+BotSock::inflateLines(const char *data, std::size_t size)
+{
+#ifdef HAVE_LIBZ
+  for (;;)
+  {
+    this->makeRoom();
+
+    const std::size_t room = this->buffer.size() - this->bufferTail;
+    const long n = this->zstream->inflate(data, size,
+      &this->buffer[this->bufferTail], room);
+
+    if (n < 0)
+    {
+      std::cerr << "BotSock::inflateLines(): corrupt compressed input" <<
+        std::endl;
+      return false;
+    }
+
+    this->bufferTail += n;
+
+    if (!this->split())
+    {
+      return false;
+    }
+
+    if ((0 == size) && (static_cast<std::size_t>(n) < room))
+    {
+      break;
+    }
+  }
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+// makeRoom()
+//
+// Makes sure there is room at the end of the input buffer to read into.
+// The buffer is only moved when a partial line or frame has reached the
+// end of it.
+//
+void
+BotSock::makeRoom(void)
+{
+  if (this->bufferHead == this->bufferTail)
+  {
+    this->bufferHead = this->bufferTail = 0;
+  }
+  else if ((this->bufferTail == this->buffer.size()) &&
+    (this->bufferHead > 0))
+  {
+    // Only a partial line or frame is left.  Move it to the start of the
+    // buffer to make room for the rest of it.
+    memmove(&this->buffer[0], &this->buffer[this->bufferHead],
+      this->bufferTail - this->bufferHead);
+    this->bufferTail -= this->bufferHead;
+    this->bufferHead = 0;
+  }
+}
+
+
+// startReader()
+//
+// Hands reading over to a LineReader thread, if the socket asked for one
+// and is line buffered.  If the thread can't be started, the socket is
+// read as usual.
+//
+void
+BotSock::startReader(void)
+{
+  if (this->threaded && this->isBuffering() && !this->isBinary() &&
+    !this->reader)
+  {
+    this->reader.reset(new LineReader(this->plug, this->buffer.size(),
+      boost::bind(&BotSock::onReady, this, this->plug, Reactor::READ)));
+
+    if (!this->reader->start())
+    {
+      this->reader.reset();
+    }
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// BotSock::readLines()
+//
+// Description:
+//  Passes the lines the reader thread has queued to the read handler,
+//  in the order they were received.  At most one ring's worth is taken
+//  at a time, so a busy connection can't starve the others; the reader
+//  is asked to signal again if any are left.  A line carried in several
+//  slots is put back together first.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns false if the connection was closed or a
+//  handler asked for it to be closed.
+//////////////////////////////////////////////////////////////////////
+bool
+BotSock::readLines(void)
+{
+  // A handler may reset the socket, which stops the reader, but the
+  // slot being handled must stay valid until the handler returns
+  boost::shared_ptr<LineReader> reader(this->reader);
+
+  for (SpscRing<LineReader::Slot>::size_type count = reader->capacity();
+    count > 0; --count)
+  {
+    const LineReader::Slot * slot = reader->front();
+
+    if (0 == slot)
+    {
+      return true;
+    }
+
+    if (LineReader::Slot::END == slot->type)
+    {
+      if (0 == slot->length)
+      {
+        std::cerr << "BotSock::process(): EOF of socket" << std::endl;
+      }
+      else
+      {
+        std::cerr << "BotSock::read() error " << slot->length << std::endl;
+      }
+      reader->pop();
+      return false;
+    }
+
+    this->gotActivity();
+
+    if (LineReader::Slot::PARTIAL == slot->type)
+    {
+      this->readerLine.append(slot->data, slot->length);
+      reader->pop();
+      continue;
+    }
+
+    bool result;
+    if (this->readerLine.empty())
+    {
+      result = this->onLine(slot->data, slot->length);
+    }
+    else
+    {
+      this->readerLine.append(slot->data, slot->length);
+      result = this->onLine(this->readerLine.data(),
+        this->readerLine.length());
+      this->readerLine.clear();
+    }
+
+    reader->pop();
+
+    if (!result)
+    {
+      return false;
+    }
+    else if (reader != this->reader)
+    {
+      // The socket was reset by the handler
+      return true;
+    }
+  }
+
+  reader->rearm();
+
+  return true;
 }
 
 
@@ -714,6 +1695,13 @@ BotSock::bind(const BotSock::Address & address, const BotSock::Port & port)
 bool
 BotSock::reset(void)
 {
+  this->unwatch();
+  this->clearQueue();
+  this->clearBuffer();
+  this->zstream.reset();
+  this->inflateStarting = false;
+  this->framed = this->frameStarting = this->batching = false;
+
   ::close(this->plug);
 
   this->connected = this->connecting = this->listening = false;
@@ -773,6 +1761,33 @@ BotSock::registerOnBinaryReadHandler(OnBinaryReadHandler func)
 }
 
 
+void
+BotSock::registerOnLineHandler(OnLineHandler func)
+{
+  this->onLineHandler = func;
+}
+
+
+void
+BotSock::registerOnIdleHandler(OnIdleHandler func)
+{
+  this->onIdleHandler = func;
+}
+
+
+void
+BotSock::registerOnReadyHandler(OnReadyHandler func)
+{
+  this->onReadyHandler = func;
+
+  // Anything reported before the owner was listening
+  if ((0 != this->readyEvents) || this->outQueueExceeded)
+  {
+    this->ready();
+  }
+}
+
+
 bool
 BotSock::onConnect(void)
 {
@@ -836,15 +1851,52 @@ BotSock::onRead(const char *data, const int size)
 }
 
 
+bool
+BotSock::onLine(const char *data, const int size)
+{
+  if (!this->onLineHandler.empty())
+  {
+#ifdef BOTSOCK_TRACE
+    std::cout << "BotSock::onLine()" << std::endl;
+#endif
+
+    return this->onLineHandler(data, size);
+  }
+  else if (!this->onReadHandler.empty())
+  {
+    return this->onRead(std::string(data, size));
+  }
+
+  return true;
+}
+
+
 
 void
-#ifdef BOTSOCK_DEBUG
 botSockStatus(BotClient * client)
 {
+#ifdef BOTSOCK_DEBUG
   client->send("Sockets: " + boost::lexical_cast<std::string>(botSockCount));
-#else
-botSockStatus(BotClient *)
-{
 #endif
+  Reactor::instance().status(client);
+  Timers::instance().status(client);
+  LineReader::status(client);
+
+  std::string msg("Send queues: ");
+  msg += boost::lexical_cast<std::string>(queuedBytes);
+  msg += " bytes on ";
+  msg += boost::lexical_cast<std::string>(queuedSockets);
+  msg += " sockets (peak ";
+  msg += boost::lexical_cast<std::string>(peakQueuedBytes);
+  msg += " bytes, ";
+  msg += boost::lexical_cast<std::string>(exceededCount);
+  msg += " connections dropped)";
+  client->send(msg);
+
+  if (truncatedLines > 0)
+  {
+    client->send("Truncated input lines: " +
+      boost::lexical_cast<std::string>(truncatedLines));
+  }
 }
 
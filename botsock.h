@@ -24,11 +24,16 @@
 // Std C++ headers
 #include <string>
 #include <list>
+#include <deque>
+#include <vector>
 #include <ctime>
+#include <cstddef>
 
 // Boost C++ headers
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 #include <boost/function.hpp>
+#include <boost/bind.hpp>
 #include <boost/utility.hpp>
 
 // Std C headers
@@ -39,6 +44,8 @@
 
 // OOMon C++ headers
 #include "oomon.h"
+#include "reactor.h"
+#include "timers.h"
 
 
 #ifndef INADDR_NONE
@@ -49,13 +56,29 @@
 #endif
 
 
-class BotSock : private boost::noncopyable
+class BotSock : private boost::noncopyable, private Reactor::Handler
 {
 public:
   typedef boost::shared_ptr<BotSock> ptr;
+  // Output that is written unchanged to several sockets.  It is shared,
+  // not copied, by the send queues of the sockets that can't take it
+  // all right away.
+  typedef boost::shared_ptr<const std::string> Buffer;
   typedef boost::function<bool (void)> OnConnectHandler;
   typedef boost::function<bool (std::string)> OnReadHandler;
   typedef boost::function<bool (const char *, const int)> OnBinaryReadHandler;
+  // Receives each line, without its line terminator, or each frame,
+  // without its header, directly from the socket's input buffer.  The
+  // data is only valid during the call.
+  typedef boost::function<bool (const char *, const int)> OnLineHandler;
+  // Called when nothing has been received or sent for half the timeout,
+  // typically to send a PING.
+  typedef boost::function<void (void)> OnIdleHandler;
+  // Called when the socket needs to be processed: the reactor reported
+  // it ready, it timed out, or its send queue overflowed.  It is called
+  // once until process() runs, so the owner can keep a list of the
+  // sockets to process instead of processing them all.
+  typedef boost::function<void (void)> OnReadyHandler;
   typedef in_addr_t Address;
   typedef in_port_t Port;
 
@@ -74,9 +97,23 @@ public:
   int read(void *buffer, int size);
   int write(void *buffer, int size);
   int write(const std::string & text);
+  int write(const Buffer & buffer);
 
-  void preSelect(fd_set &, fd_set &) const;
-  bool postSelect(const fd_set &, const fd_set &);
+  std::string::size_type queued(void) const { return this->outQueueBytes; };
+
+  bool compress(const int level);
+  bool isCompressed(void) const { return (0 != this->zstream.get()); }
+  const class ZStream * getCompression(void) const
+    { return this->zstream.get(); }
+  bool frame(void);
+  bool isFramed(void) const { return this->framed; }
+  void setBatching(const bool value) { this->batching = value; }
+  bool isBatching(void) const { return this->batching; }
+  bool flushBatch(void);
+  static void flushBatches(void);
+  void setMaxQueue(const int & limit) { this->outQueueLimit = &limit; };
+
+  bool process(void);
 
   void bindTo(const std::string & address);
 
@@ -92,14 +129,21 @@ public:
   void setBuffering(const bool value);
   bool isBuffering(void) const { return this->lineBuffered; };
 
+  void setBufferSize(const std::vector<char>::size_type size);
+  std::vector<char>::size_type getBufferSize(void) const
+    { return this->buffer.size(); };
+
   bool isConnected(void) const { return this->connected; };
   bool isConnecting(void) const { return this->connecting; };
   bool isListening(void) const { return this->listening; };
 
+  void setThreaded(const bool value) { this->threaded = value; };
+  bool isThreaded(void) const { return this->threaded; };
+
   void setBinary(const bool value) { this->binary = value; };
   bool isBinary(void) const { return this->binary; };
 
-  void setTimeout(const std::time_t value) { this->timeout = value; };
+  void setTimeout(const std::time_t value);
   std::time_t getTimeout(void) const { return this->timeout; };
   std::time_t getIdle(void) const
     { return (std::time(NULL) - this->lastActivity); };
@@ -112,6 +156,9 @@ public:
   void registerOnConnectHandler(OnConnectHandler func);
   void registerOnReadHandler(OnReadHandler func);
   void registerOnBinaryReadHandler(OnBinaryReadHandler func);
+  void registerOnLineHandler(OnLineHandler func);
+  void registerOnIdleHandler(OnIdleHandler func);
+  void registerOnReadyHandler(OnReadyHandler func);
 
   static Address nsLookup(const std::string & address);
   static std::string nsLookup(const BotSock::Address & address);
@@ -122,26 +169,42 @@ public:
   static bool sameClassC(const BotSock::Address & ip1,
     const BotSock::Address & ip2);
 
+  static const char * findEol(const char *text,
+    const std::vector<char>::size_type length);
+
   static const BotSock::Address ClassCNetMask;
 
-  class FDSetter
-  {
-  public:
-    FDSetter(fd_set & readset, fd_set & writeset) : readset_(readset),
-      writeset_(writeset) { }
-    void operator()(BotSock::ptr s)
-    {
-      s->preSelect(this->readset_, this->writeset_);
-    }
-  private:
-    fd_set & readset_;
-    fd_set & writeset_;
-  };
+  // Size of the big-endian length in front of each frame
+  static const std::vector<char>::size_type FRAME_HEADER = 2;
 
 private:
   bool onConnect(void);
   bool onRead(const std::string & text);
   bool onRead(const char *data, const int size);
+  bool onLine(const char *data, const int size);
+  bool split(void);
+  bool splitLines(void);
+  bool splitFrames(void);
+  bool inflateLines(const char *data, std::size_t size);
+  void makeRoom(void);
+  void startReader(void);
+  bool readLines(void);
+  void clearBuffer(void);
+
+  virtual void onReady(const int fd, const int events);
+  void ready(void);
+  void hold(void);
+  void watch(void);
+  void unwatch(void);
+  void armIdleTimer(const double seconds);
+  void onIdleTimer(void);
+
+  int output(const char *data, const int size);
+  int output(const Buffer & buffer);
+  int writeNow(const char *data, const int size);
+  void enqueue(const Buffer & buffer, const std::string::size_type offset);
+  bool flush(void);
+  void clearQueue(void);
 
   void setOptions(void);
   bool bind(const BotSock::Address & address = INADDR_ANY,
@@ -150,32 +213,70 @@ private:
   OnConnectHandler onConnectHandler;
   OnReadHandler onReadHandler;
   OnBinaryReadHandler onBinaryReadHandler;
-#ifdef OLD_BOTSOCK_LINEBUFFER
-  std::string buffer;
-#else
-  char buffer[2048];
-  int bufferPos;
-#endif
+  OnLineHandler onLineHandler;
+  OnIdleHandler onIdleHandler;
+  OnReadyHandler onReadyHandler;
+  std::vector<char> buffer;
+  std::vector<char>::size_type bufferHead, bufferTail;
+  bool bufferCR, bufferOverflow;
+  std::deque<Buffer> outQueue;
+  std::string::size_type outQueuePos;		// Sent from the first buffer
+  std::string::size_type outQueueBytes;
+  const int *outQueueLimit;
+  bool outQueueExceeded;
   Address bindAddress;
   std::time_t timeout, lastActivity, lastWrite, connectTime;
   bool connected, connecting, listening, blocking, lineBuffered, binary;
-  int plug, backlog;
+  bool watched, threaded;
+  Timers::Id idleTimer;
+  boost::shared_ptr<class LineReader> reader;
+  boost::shared_ptr<class ZStream> zstream;
+  std::vector<char> zinput;
+  bool inflateStarting;
+  bool framed, frameStarting, batching;
+  bool readyQueued, holding;
+  std::string readerLine;
+  int plug, backlog, readyEvents;
 };
 
 
-template <typename t>
-class FDSetter
+// The sockets of one kind that have asked their owner to process them.
+// Each is held weakly, so one closed in the meantime is just skipped.
+template <class T>
+class ReadyList
 {
 public:
-  FDSetter(fd_set & readset, fd_set & writeset) : readset_(readset),
-    writeset_(writeset) { }
-  void operator()(t node)
+  typedef boost::shared_ptr<T> Ptr;
+
+  // The handler to register with a socket added to the owner's list
+  BotSock::OnReadyHandler handler(const Ptr & sock)
+    { return boost::bind(&ReadyList::add, this, boost::weak_ptr<T>(sock)); }
+
+  // Processes the sockets that are ready, and removes those the
+  // processor returns true for from the owner's list.  Sockets that
+  // become ready meanwhile are left for the next call.
+  template <class Processor>
+  void process(std::list<Ptr> & sockets, Processor processor)
   {
-    node->preSelect(this->readset_, this->writeset_);
+    std::vector<boost::weak_ptr<T> > ready;
+    ready.swap(this->ready_);
+
+    for (typename std::vector<boost::weak_ptr<T> >::const_iterator pos =
+      ready.begin(); pos != ready.end(); ++pos)
+    {
+      Ptr sock(pos->lock());
+
+      if (sock && processor(sock))
+      {
+        sockets.remove(sock);
+      }
+    }
   }
+
 private:
-  fd_set & readset_;
-  fd_set & writeset_;
+  void add(const boost::weak_ptr<T> & sock) { this->ready_.push_back(sock); }
+
+  std::vector<boost::weak_ptr<T> > ready_;
 };
 
 
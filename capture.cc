@@ -0,0 +1,166 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+
+// Boost C++ Headers
+#include <boost/lexical_cast.hpp>
+
+// Std C Headers
+#include <stdio.h>
+#include <sys/time.h>
+
+// OOMon Headers
+#include "oomon.h"
+#include "capture.h"
+#include "log.h"
+#include "vars.h"
+#include "botclient.h"
+
+
+std::ofstream Capture::file;
+std::string Capture::filename;
+unsigned long Capture::lines = 0;
+Timers::Id Capture::flushTimer = 0;
+
+
+void
+Capture::write(const char *text, const int size)
+{
+  struct timeval now;
+  gettimeofday(&now, 0);
+
+  char stamp[32];
+  const int length = snprintf(stamp, sizeof(stamp), "%ld.%06ld ",
+    static_cast<long>(now.tv_sec), static_cast<long>(now.tv_usec));
+
+  Capture::file.write(stamp, length);
+  Capture::file.write(text, size);
+  Capture::file.put('\n');
+
+  ++Capture::lines;
+}
+
+
+// The file is written through the stream's buffer, so it is flushed
+// every few seconds rather than after every line
+void
+Capture::flush(void)
+{
+  Capture::file.flush();
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Capture::start(filename)
+//
+// Description:
+//  Starts appending server input to a file, after stopping any capture
+//  already in progress.
+//
+// Parameters:
+//  filename - The capture file.
+//
+// Return Value:
+//  The function returns false if the file could not be opened.
+//////////////////////////////////////////////////////////////////////
+bool
+Capture::start(const std::string & filename)
+{
+  Capture::stop();
+
+  Capture::file.clear();
+  Capture::file.open(filename.c_str(), std::ios::out | std::ios::app);
+
+  if (!Capture::file.is_open())
+  {
+    return false;
+  }
+
+  Capture::filename = filename;
+  Capture::lines = 0;
+  Capture::flushTimer = Timers::instance().every(5, Capture::flush);
+
+  Log::Write("Capturing server input to " + filename);
+
+  return true;
+}
+
+
+void
+Capture::stop(void)
+{
+  if (Capture::file.is_open())
+  {
+    Capture::file.close();
+    Timers::instance().cancel(Capture::flushTimer);
+    Capture::flushTimer = 0;
+
+    Log::Write("Captured " + boost::lexical_cast<std::string>(Capture::lines) +
+      " lines of server input to " + Capture::filename);
+  }
+
+  Capture::filename.erase();
+}
+
+
+std::string
+Capture::getFilename(void)
+{
+  return Capture::filename;
+}
+
+
+std::string
+Capture::setFilename(const std::string & newValue)
+{
+  if (newValue.empty())
+  {
+    Capture::stop();
+  }
+  else if (!Capture::start(newValue))
+  {
+    return "*** Unable to open " + newValue + " for writing!";
+  }
+
+  return "";
+}
+
+
+void
+Capture::init(void)
+{
+  vars.insert("SERVER_CAPTURE", Setting(Capture::getFilename,
+    Capture::setFilename));
+}
+
+
+void
+Capture::status(BotClient * client)
+{
+  if (Capture::active())
+  {
+    client->send("Capturing server input to " + Capture::filename + " (" +
+      boost::lexical_cast<std::string>(Capture::lines) + " lines)");
+  }
+}
+
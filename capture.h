@@ -0,0 +1,63 @@
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <fstream>
+#include <string>
+
+// OOMon Headers
+#include "timers.h"
+
+
+// Records every line received from the IRC server, with the time it
+// arrived, so that an incident can be replayed later with bench/replay.
+// Each line of the capture file is the time in seconds since the epoch,
+// with microseconds, followed by a space and the raw line.  Capturing
+// is started and stopped by setting SERVER_CAPTURE to a file name.
+class Capture
+{
+public:
+  static void init(void);
+
+  static bool active(void) { return Capture::file.is_open(); }
+  static void write(const char *text, const int size);
+
+  static bool start(const std::string & filename);
+  static void stop(void);
+
+  static void status(class BotClient * client);
+
+private:
+  static std::string getFilename(void);
+  static std::string setFilename(const std::string & newValue);
+  static void flush(void);
+
+  static std::ofstream file;
+  static std::string filename;
+  static unsigned long lines;
+  static Timers::Id flushTimer;
+};
+
+
+#endif /* __CAPTURE_H__ */
+
@@ -35,6 +35,8 @@
 #include "proxylist.h"
 #include "main.h"
 #include "log.h"
+#include "journal.h"
+#include "stats.h"
 #include "engine.h"
 #include "userhash.h"
 #include "arglist.h"
@@ -46,6 +48,8 @@
 #include "dnsbl.h"
 #include "defaults.h"
 #include "irc.h"
+#include "actionbatch.h"
+#include "capture.h"
 
 
 #ifdef DEBUG
@@ -67,7 +71,10 @@ CommandParser::CommandParser(void)
   this->addCommand("LINKS", &CommandParser::cmdLinks, UserFlags::AUTHED);
   this->addCommand("MOTD", &CommandParser::cmdMotd, UserFlags::AUTHED);
   this->addCommand("STATUS", &CommandParser::cmdStatus, UserFlags::AUTHED);
+  this->addCommand("STATS", &CommandParser::cmdStats, UserFlags::AUTHED);
   this->addCommand("VERSION", &CommandParser::cmdVersion, UserFlags::AUTHED);
+  this->addCommand("ON", &CommandParser::cmdOn, UserFlags::AUTHED,
+    EXACT_ONLY);
 
   // UserFlags::CHANOP commands
   this->addCommand("JOIN", &CommandParser::cmdJoin, UserFlags::CHANOP);
@@ -207,6 +214,8 @@ CommandParser::parse(BotClient * from, const std::string & command,
   {
     if (cmd->flags == (from->flags() & cmd->flags))
     {
+      Stats::Timer timer(Stats::COMMAND);
+
       cmd->func(from, cmd->name, parameters);
     }
     else
@@ -244,17 +253,70 @@ void
 CommandParser::cmdStatus(BotClient * from, const std::string &,
   std::string)
 {
-  users.status(from);
+  const IRC::List & servers = IRC::list();
+
+  for (IRC::List::const_iterator pos = servers.begin(); pos != servers.end();
+    ++pos)
+  {
+    IRC::Context context(*pos);
+
+    if (servers.size() > 1)
+    {
+      from->send("Server: " + server().getAddress() + " (" +
+        server().getServerName() + ")");
+    }
+    users().status(from);
+    server().status(from);
+  }
   ::status(from);
-  server.status(from);
+  ActionBatch::status(from);
+  Capture::status(from);
+  Journal::status(from);
+  Log::status(from);
   clients.status(from);
+  remotes.status(from);
   proxies.status(from);
   dnsbl.status(from);
   patternStatus(from);
+  TrapList::status(from);
   botSockStatus(from);
 }
 
 
+void
+CommandParser::cmdStats(BotClient * from, const std::string & command,
+  std::string parameters)
+{
+  std::string what(UpCase(FirstWord(parameters)));
+
+  if (what.empty())
+  {
+    Stats::report(from);
+  }
+  else if (what == "PARSERS")
+  {
+    const IRC::List & servers = IRC::list();
+
+    for (IRC::List::const_iterator pos = servers.begin();
+      pos != servers.end(); ++pos)
+    {
+      IRC::Context context(*pos);
+
+      if (servers.size() > 1)
+      {
+        from->send("Server: " + server().getAddress() + " (" +
+          server().getServerName() + ")");
+      }
+      server().parserStatus(from);
+    }
+  }
+  else
+  {
+    CommandParser::syntax(command, "[parsers]");
+  }
+}
+
+
 void
 CommandParser::cmdKline(BotClient * from, const std::string & command,
   std::string parameters)
@@ -341,7 +403,7 @@ CommandParser::cmdKline(BotClient * from, const std::string & command,
         ::SendAll("KLINE " + parm + " (" + reason + " [" +
 	  from->handleAndBot() + "])", UserFlags::OPER, WATCH_KLINES, from);
       }
-      server.kline(from->handleAndBot(), minutes, parm, reason);
+      server().kline(from->handleAndBot(), minutes, parm, reason);
     }
     else
     {
@@ -365,7 +427,7 @@ CommandParser::cmdUnkline(BotClient * from, const std::string &,
   {
     ::SendAll("UNKLINE " + target + " [" + from->handleAndBot() + "]",
       UserFlags::OPER, WATCH_KLINES, from);
-    server.unkline(from->handleAndBot(), target);
+    server().unkline(from->handleAndBot(), target);
   }
   else
   {
@@ -406,7 +468,7 @@ CommandParser::cmdDline(BotClient * from, const std::string &,
         ::SendAll("DLINE " + parm + " (" + parameters + " [" +
 	  from->handleAndBot() + "])", UserFlags::OPER, WATCH_DLINES, from);
       }
-      server.dline(from->handleAndBot(), minutes, parm, parameters);
+      server().dline(from->handleAndBot(), minutes, parm, parameters);
     }
     else
     {
@@ -430,7 +492,7 @@ CommandParser::cmdUndline(BotClient * from, const std::string &,
   {
     ::SendAll("UNDLINE " + target + " [" + from->handleAndBot() + "]",
       UserFlags::OPER, WATCH_KLINES, from);
-    server.undline(from->handleAndBot(), target);
+    server().undline(from->handleAndBot(), target);
   }
   else
   {
@@ -439,6 +501,33 @@ CommandParser::cmdUndline(BotClient * from, const std::string &,
 }
 
 
+// Runs a command with another server current
+void
+CommandParser::cmdOn(BotClient * from, const std::string & command,
+  std::string parameters)
+{
+  std::string name(FirstWord(parameters));
+  std::string subcommand(FirstWord(parameters));
+
+  if (subcommand.empty())
+  {
+    CommandParser::syntax(command, "<server> <command> [<parameters>]");
+  }
+  else
+  {
+    IRC * irc = IRC::find(name);
+
+    if (0 == irc)
+    {
+      throw CommandParser::exception("*** No such server: " + name);
+    }
+
+    IRC::Context context(irc);
+    this->parse(from, subcommand, parameters);
+  }
+}
+
+
 void
 CommandParser::cmdJoin(BotClient *, const std::string & command,
   std::string parameters)
@@ -448,7 +537,7 @@ CommandParser::cmdJoin(BotClient *, const std::string & command,
 
   if (!channel.empty())
   {
-    server.join(channel, key);
+    server().join(channel, key);
   }
   else
   {
@@ -466,7 +555,7 @@ CommandParser::cmdOp(BotClient *, const std::string & command,
 
   if (!channel.empty() && !nick.empty())
   {
-    server.op(channel, nick);
+    server().op(channel, nick);
   }
   else
   {
@@ -483,7 +572,7 @@ CommandParser::cmdPart(BotClient *, const std::string & command,
 
   if (!channel.empty())
   {
-    server.part(channel);
+    server().part(channel);
   }
   else
   {
@@ -505,7 +594,7 @@ CommandParser::cmdKill(BotClient * from, const std::string & command,
   {
     ::SendAll("KILL " + nick + " ((" + from->handleAndBot() + ") " +
       parameters + ")", UserFlags::OPER, WATCH_KILLS, from);
-    server.kill(from->handleAndBot(), nick, parameters);
+    server().kill(from->handleAndBot(), nick, parameters);
   }
 }
 
@@ -568,7 +657,7 @@ CommandParser::cmdKilllist(BotClient * from, const std::string & command,
       notice += ']';
       ::SendAll(notice, UserFlags::OPER, WATCH_KILLS, from);
 
-      users.findUsers(from, filter, action);
+      users().findUsers(from, filter, action);
     }
   }
   catch (OOMon::regex_error & e)
@@ -588,7 +677,7 @@ CommandParser::cmdReload(BotClient * from, const std::string & command,
 {
   if (command == "trace")
   {
-    server.retrace(from->handleAndBot());
+    server().retrace(from->handleAndBot());
   }
   else
   {
@@ -596,15 +685,15 @@ CommandParser::cmdReload(BotClient * from, const std::string & command,
 
     if (parm == "USERS")
     {
-      server.retrace(from->handleAndBot());
+      server().retrace(from->handleAndBot());
     }
     else if (parm == "KLINES")
     {
-      server.reloadKlines(from->handleAndBot());
+      server().reloadKlines(from->handleAndBot());
     }
     else if (parm == "DLINES")
     {
-      server.reloadDlines(from->handleAndBot());
+      server().reloadDlines(from->handleAndBot());
     }
     else if (parm == "CONFIG")
     {
@@ -732,7 +821,7 @@ CommandParser::cmdList(BotClient * from, const std::string & command,
         action.swap(tmp);
       }
 
-      users.findUsers(from, filter, action);
+      users().findUsers(from, filter, action);
     }
   }
   catch (OOMon::regex_error & e)
@@ -767,7 +856,7 @@ CommandParser::cmdFindu(BotClient * from, const std::string & command,
 
       ActionPtr action(Action::parse(from, filter.rest(), formats));
 
-      users.findUsers(from, filter, action);
+      users().findUsers(from, filter, action);
     }
   }
   catch (OOMon::regex_error & e)
@@ -839,14 +928,14 @@ CommandParser::cmdFindk(BotClient * from, const std::string & command,
 
       if (args.haveUnary("-remove"))
       {
-        int removed = server.findAndRemoveK(from->handleAndBot(), pattern.get(),
-          searchPerms, searchTemps, searchReason);
+        int removed = server().findAndRemoveK(from->handleAndBot(),
+          pattern.get(), searchPerms, searchTemps, searchReason);
         from->send("*** " + boost::lexical_cast<std::string>(removed) +
 	  " K-lines removed.");
       }
       else
       {
-        server.findK(from, pattern.get(), args.haveUnary("-count"),
+        server().findK(from, pattern.get(), args.haveUnary("-count"),
 	  searchPerms, searchTemps, searchReason);
       }
     }
@@ -912,14 +1001,14 @@ CommandParser::cmdFindd(BotClient * from, const std::string & command,
 
       if (args.haveUnary("-remove"))
       {
-        int removed = server.findAndRemoveD(from->handleAndBot(), pattern.get(),
-          searchPerms, searchTemps, searchReason);
+        int removed = server().findAndRemoveD(from->handleAndBot(),
+          pattern.get(), searchPerms, searchTemps, searchReason);
         from->send("*** " + boost::lexical_cast<std::string>(removed) +
 	  " D-lines removed.");
       }
       else
       {
-        server.findD(from, pattern.get(), args.haveUnary("-count"),
+        server().findD(from, pattern.get(), args.haveUnary("-count"),
 	  searchPerms, searchTemps, searchReason);
       }
     }
@@ -937,7 +1026,7 @@ CommandParser::cmdClass(BotClient * from, const std::string &,
 {
   std::string className = FirstWord(parameters);
 
-  users.reportClasses(from, className);
+  users().reportClasses(from, className);
 }
 
 
@@ -964,11 +1053,11 @@ CommandParser::cmdDomains(BotClient * from, const std::string & command,
   {
     if (command == "domains")
     {
-      users.reportDomains(from, min);
+      users().reportDomains(from, min);
     }
     else if (command == "nets")
     {
-      users.reportNets(from, min);
+      users().reportNets(from, min);
     }
   }
   else
@@ -996,19 +1085,19 @@ CommandParser::cmdMulti(BotClient * from, const std::string & command,
 
   if ((command == "multi") || (command == "bots"))
   {
-    users.reportMulti(from, min);
+    users().reportMulti(from, min);
   }
   else if (command == "hmulti")
   {
-    users.reportHMulti(from, min);
+    users().reportHMulti(from, min);
   }
   else if (command == "umulti")
   {
-    users.reportUMulti(from, min);
+    users().reportUMulti(from, min);
   }
   else if ((command == "vmulti") || (command == "vbots"))
   {
-    users.reportVMulti(from, min);
+    users().reportVMulti(from, min);
   }
 }
 
@@ -1019,11 +1108,11 @@ CommandParser::cmdClones(BotClient * from, const std::string & command,
 {
   if (0 == command.compare("vclones"))
   {
-    users.reportVClones(from);
+    users().reportVClones(from);
   }
   else
   {
-    users.reportClones(from);
+    users().reportClones(from);
   }
 }
 
@@ -1073,7 +1162,7 @@ CommandParser::cmdSeedrand(BotClient * from, const std::string &,
       pattern = smartPattern(parameters, true);
     }
 
-    users.reportSeedrand(from, pattern, threshhold,
+    users().reportSeedrand(from, pattern, threshhold,
       args.haveUnary("-count"));
   }
   catch (OOMon::regex_error & e)
@@ -1094,7 +1183,7 @@ CommandParser::cmdDie(BotClient * from, const std::string &,
       parameters + ")", UserFlags::NONE(), WatchSet(), from);
     Log::Write("DIE requested by " + from->handleAndBot() + " (" +
       parameters + ")");
-    server.quit(parameters);
+    server().quit(parameters);
   }
   else
   {
@@ -1111,7 +1200,7 @@ CommandParser::cmdRaw(BotClient * from, const std::string &,
   std::string parameters)
 {
   Log::Write("RAW by " + from->handleAndBot() + ": " + parameters);
-  server.write(parameters + "\n");
+  server().write(parameters + "\n", IRC::PRIORITY_ENFORCE);
 }
 
 
@@ -1156,7 +1245,7 @@ CommandParser::cmdSpamsub(BotClient * from, const std::string &, std::string)
   ::SendAll(notice, UserFlags::OPER);
   Log::Write(notice);
 
-  server.subSpamTrap(true);
+  server().subSpamTrap(true);
 }
 
 
@@ -1169,7 +1258,7 @@ CommandParser::cmdSpamunsub(BotClient * from, const std::string &, std::string)
   ::SendAll(notice, UserFlags::OPER);
   Log::Write(notice);
 
-  server.subSpamTrap(false);
+  server().subSpamTrap(false);
 }
 
 
@@ -1202,7 +1291,7 @@ void
 CommandParser::cmdTest(BotClient *, const std::string &,
   std::string parameters)
 {
-  server.onServerNotice(parameters);
+  server().onServerNotice(parameters);
 }
 
 
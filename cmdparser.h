@@ -133,6 +133,10 @@ private:
     std::string parameters);
   void cmdStatus(class BotClient *from, const std::string & command,
     std::string parameters);
+  void cmdStats(class BotClient *from, const std::string & command,
+    std::string parameters);
+  void cmdOn(class BotClient *from, const std::string & command,
+    std::string parameters);
 
   void cmdJoin(class BotClient *from, const std::string & command,
     std::string parameters);
@@ -580,23 +580,32 @@ Config::parseRLine(const StrVector & fields)
 void
 Config::parseSLine(const StrVector & fields)
 {
-  this->serverAddress_ = fields[0];
-  if (serverAddress_.empty())
+  Config::Server entry;
+
+  entry.address = fields[0];
+  if (entry.address.empty())
   {
     throw Config::syntax_error("no server address");
   }
 
   try
   {
-    this->serverPort_ = boost::lexical_cast<BotSock::Port>(fields[1]);
+    entry.port = boost::lexical_cast<BotSock::Port>(fields[1]);
   }
   catch (boost::bad_lexical_cast)
   {
     throw Config::bad_port_number();
   }
 
-  this->serverPassword_ = fields[2];
-  this->channels_ = fields[3];
+  entry.password = fields[2];
+  entry.channels = fields[3];
+
+  if (this->servers_.empty())
+  {
+    this->serverAddress_ = entry.address;
+    this->serverPort_ = entry.port;
+  }
+  this->servers_.push_back(entry);
 }
 
 
@@ -1233,31 +1242,6 @@ Config::loadSettings(void)
 }
 
 
-//////////////////////////////////////////////////////////////////////
-// haveChannel(channel)
-//
-// Description:
-//  Determines whether a channel is listed in the bot's config file.
-//
-// Parameters:
-//  channel - The channel to look for in the config file.
-//
-// Return Value:
-//  The function returns true if the channel is listed in the config
-//  file and false otherwise.
-//////////////////////////////////////////////////////////////////////
-bool
-Config::haveChannel(const std::string & channel) const
-{
-  StrVector channels;
-
-  StrSplit(channels, server.downCase(this->channels_), ",");
-
-  return (channels.end() != std::find(channels.begin(), channels.end(),
-    server.downCase(channel)));
-}
-
-
 UserFlags
 Config::userFlags(const std::string & text, const bool remote)
 {
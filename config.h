@@ -25,6 +25,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 #include <bitset>
 
 // Boost C++ Headers
@@ -65,12 +66,21 @@ class Config
     std::string operName(void) const { return this->operName_; }
     std::string operPassword(void) const { return this->operPassword_; }
 
+    // One for each S: line, in the order they appear
+    struct Server
+    {
+      std::string address;
+      BotSock::Port port;
+      std::string password;
+      std::string channels;
+    };
+    typedef std::vector<Server> ServerVector;
+
+    const ServerVector & servers(void) const { return this->servers_; }
+
+    // The first server
     std::string serverAddress(void) const { return this->serverAddress_; }
     BotSock::Port serverPort(void) const { return this->serverPort_; }
-    std::string serverPassword(void) const { return this->serverPassword_; }
-    std::string channels(void) const { return this->channels_; }
-
-    bool haveChannel(const std::string & channel) const;
 
     std::string logFilename(void) const { return this->logFilename_; }
     std::string motdFilename(void) const { return this->motdFilename_; }
@@ -206,10 +216,9 @@ class Config
     std::string realName_;
     std::string operName_;
     std::string operPassword_;
+    Config::ServerVector servers_;
     std::string serverAddress_;
     BotSock::Port serverPort_;
-    std::string serverPassword_;
-    std::string channels_;
     Config::PatternList proxyMatches_;
     StrVector proxySendLines_;
     BotSock::Address proxyTargetAddress_;
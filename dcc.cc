@@ -53,6 +53,7 @@
 #endif
 
 
+int DCC::sendQ(DEFAULT_DCC_SENDQ);
 bool DCC::ignoreUnknownCommand(DEFAULT_IGNORE_UNKNOWN_COMMAND);
 bool DCC::statspShowIdle(DEFAULT_STATSP_SHOW_IDLE);
 bool DCC::statspShowUserhost(DEFAULT_STATSP_SHOW_USERHOST);
@@ -63,6 +64,7 @@ DCC::DCC(const std::string & nick, const std::string & userhost,
   const BotSock::Address ircIp)
   : sock_(false, true), flags_(UserFlags::NONE())
 {
+  this->sock_.setMaxQueue(DCC::sendQ);
   this->sock_.registerOnConnectHandler(boost::bind(&DCC::onConnect, this));
   this->sock_.registerOnReadHandler(boost::bind(&DCC::onRead, this, _1));
   this->sock_.setBuffering(true);
@@ -81,6 +83,7 @@ DCC::DCC(const std::string & nick, const std::string & userhost,
 DCC::DCC(DCC *listener)
   : sock_(&listener->sock_, false, true), flags_(UserFlags::NONE())
 {
+  this->sock_.setMaxQueue(DCC::sendQ);
   this->sock_.registerOnConnectHandler(boost::bind(&DCC::onConnect, this));
   this->sock_.registerOnReadHandler(boost::bind(&DCC::onRead, this, _1));
   this->sock_.setBuffering(true);
@@ -294,7 +297,7 @@ DCC::cmdAuth(BotClient *from, const std::string &, std::string parameters)
 
     this->loadConfig();
 
-    if (this->flags().has(UserFlags::MASTER) && !server.opered())
+    if (this->flags().has(UserFlags::MASTER) && !server().opered())
     {
       from->send("*** I am not opered up!");
     }
@@ -397,6 +400,43 @@ DCC::send(const std::string & message)
 void
 DCC::send(const std::string & message, const UserFlags flags,
   const WatchSet & watches)
+{
+  if (this->wants(flags, watches))
+  {
+#ifdef DCC_DEBUG
+    std::cout << "DCC << " << message << std::endl;
+#endif
+    this->send(message);
+  }
+}
+
+
+// send(line, flags, watches)
+//
+// Like send(message, flags, watches), but the line is already terminated
+// and is shared with the other clients it is sent to.
+//
+void
+DCC::send(const BotSock::Buffer & line, const UserFlags flags,
+  const WatchSet & watches)
+{
+  if (this->isConnected() && this->wants(flags, watches))
+  {
+#ifdef DCC_DEBUG
+    std::cout << "DCC << " << *line;
+#endif
+    this->sock_.write(line);
+  }
+}
+
+
+// wants(flags, watches)
+//
+// Returns true if the client has the flags and watches required to see
+// a status message.
+//
+bool
+DCC::wants(const UserFlags flags, const WatchSet & watches) const
 {
   if ((flags == UserFlags::NONE()) || (flags == (this->flags() & flags)))
   {
@@ -406,12 +446,9 @@ DCC::send(const std::string & message, const UserFlags flags,
       std::cout << "DCC client not watching this type of message" << std::endl;
 #endif
       // Missing watch...don't display status message
-      return;
+      return false;
     }
-#ifdef DCC_DEBUG
-    std::cout << "DCC << " << message << std::endl;
-#endif
-    this->send(message);
+    return true;
   }
   else
   {
@@ -419,6 +456,7 @@ DCC::send(const std::string & message, const UserFlags flags,
     std::cout << "DCC::send(): DCC not connected or lacks required flags" <<
       std::endl;
 #endif
+    return false;
   }
 }
 
@@ -592,7 +630,7 @@ DCC::cmdLocops(BotClient *from, const std::string & command,
 {
   if (!parameters.empty())
   {
-    server.locops("(" + from->handle() + ") " + parameters);
+    server().locops("(" + from->handle() + ") " + parameters);
   }
   else
   {
@@ -601,23 +639,17 @@ DCC::cmdLocops(BotClient *from, const std::string & command,
 }
 
 
-void
-DCC::preSelect(fd_set & readset, fd_set & writeset)
-{
-  this->sock_.preSelect(readset, writeset);
-}
-
-
 bool
-DCC::postSelect(const fd_set & readset, const fd_set & writeset)
+DCC::process(void)
 {
-  return this->sock_.postSelect(readset, writeset);
+  return this->sock_.process();
 }
 
 
 void
 DCC::init(void)
 {
+  vars.insert("DCC_SENDQ", Setting::IntegerSetting(DCC::sendQ, 0));
   vars.insert("IGNORE_UNKNOWN_COMMAND",
       Setting::BooleanSetting(DCC::ignoreUnknownCommand));
   vars.insert("STATSP_SHOW_IDLE",
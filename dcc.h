@@ -56,6 +56,8 @@ public:
   void chat(const std::string & text);
   void send(const std::string & message, const UserFlags flags,
     const WatchSet & watches = WatchSet());
+  void send(const BotSock::Buffer & line, const UserFlags flags,
+    const WatchSet & watches);
 
   virtual void send(const std::string & message);
   virtual UserFlags flags(void) const { return this->flags_; }
@@ -82,8 +84,9 @@ public:
   BotSock::Port getLocalPort(void) const { return this->sock_.getLocalPort(); }
   bool isConnected(void) const { return this->sock_.isConnected(); }
 
-  void preSelect(fd_set & readset, fd_set & writeset);
-  bool postSelect(const fd_set & readset, const fd_set & writeset);
+  bool process(void);
+  void registerOnReadyHandler(BotSock::OnReadyHandler func)
+    { this->sock_.registerOnReadyHandler(func); }
 
   std::time_t idleTime(void) const { return this->sock_.getIdle(); }
 
@@ -102,12 +105,14 @@ private:
   std::string id_;
   UserFlags flags_;
 
+  static int sendQ;
   static bool ignoreUnknownCommand;
   static bool statspShowIdle;
   static bool statspShowUserhost;
   static bool unauthedMayChat;
 
   bool parse(std::string text);
+  bool wants(const UserFlags flags, const WatchSet & watches) const;
 
   void addCommands(void);
 
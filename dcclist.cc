@@ -68,7 +68,7 @@ DCCList::connect(const BotSock::Address address, const int port,
 
     if (newClient->connect(ntohl(address), port, nick, userhost, ircIp))
     {
-      this->connections.push_back(newClient);
+      this->addConnection(newClient);
       return true;
     }
     else
@@ -100,13 +100,15 @@ DCCList::listen(const std::string & nick, const std::string & userhost,
     {
       std::string request("DCC CHAT chat ");
       request += boost::lexical_cast<std::string>(htonl(
-	server.getLocalAddress()));
+	server().getLocalAddress()));
       request += ' ';
       request += boost::lexical_cast<std::string>(htons(
 	newListener->getLocalPort()));
 
-      server.ctcp(nick, request);
-      listeners.push_back(newListener);
+      server().ctcp(nick, request);
+      newListener->registerOnReadyHandler(
+        this->readyListeners.handler(newListener));
+      this->listeners.push_back(newListener);
       return true;
     }
     else
@@ -121,20 +123,6 @@ DCCList::listen(const std::string & nick, const std::string & userhost,
 }
 
 
-// preSelect(readset)
-//
-// Do this if you want to be able to receive data :P
-//
-void
-DCCList::preSelect(fd_set & readset, fd_set & writeset)
-{
-  FDSetter<DCCPtr> fds(readset, writeset);
-
-  std::for_each(this->listeners.begin(), this->listeners.end(), fds);
-  std::for_each(this->connections.begin(), this->connections.end(), fds);
-}
-
-
 bool
 DCCList::ListenProcessor::operator()(DCCPtr listener)
 {
@@ -142,12 +130,12 @@ DCCList::ListenProcessor::operator()(DCCPtr listener)
 
   try
   {
-    remove = !listener->postSelect(this->readset_, this->writeset_);
+    remove = !listener->process();
   }
   catch (OOMon::ready_for_accept)
   {
 #ifdef DCCLIST_DEBUG
-    std::cout << "DCC::postSelect() threw exception: ready_for_accept" <<
+    std::cout << "DCC::process() threw exception: ready_for_accept" <<
       std::endl;
 #endif
 
@@ -169,7 +157,7 @@ DCCList::ListenProcessor::operator()(DCCPtr listener)
 
     if (addClient && newConnection->onConnect())
     {
-      this->connections_.push_back(newConnection);
+      this->list_.addConnection(newConnection);
     }
   }
   catch (OOMon::timeout_error)
@@ -189,25 +177,25 @@ DCCList::ClientProcessor::operator()(DCCPtr client)
 
   try
   {
-    remove = !client->postSelect(this->readset_, this->writeset_);
+    remove = !client->process();
   }
   catch (OOMon::timeout_error)
   {
     remove = true;
 #ifdef DCCLIST_DEBUG
-    std::cout << "DCC::postSelect() threw exception: timeout_error" <<
+    std::cout << "DCC::process() threw exception: timeout_error" <<
       std::endl;
 #endif
     if (!client->isConnected())
     {
-      server.notice(client->nick(), "DCC CHAT connection timed out.");
+      server().notice(client->nick(), "DCC CHAT connection timed out.");
       Log::Write(client->userhost() + " timed out on DCC connect");
     }
   }
   catch (OOMon::errno_error & e)
   {
     remove = true;
-    std::cerr << "DCC::postSelect() threw exception: errno_error: " <<
+    std::cerr << "DCC::process() threw exception: errno_error: " <<
       e.what() << std::endl;
   }
 
@@ -221,20 +209,24 @@ DCCList::ClientProcessor::operator()(DCCPtr client)
 }
 
 
-// postSelect(readset, writeset)
+// process()
 //
-// Processes any received data at each DCC connection.
-//
-// Returns true if no errors ocurred.
+// Processes each DCC listener and connection that is ready.
 //
 void
-DCCList::postSelect(const fd_set & readset, const fd_set & writeset)
+DCCList::process(void)
 {
-  ListenProcessor lp(readset, writeset, this->connections);
-  this->listeners.remove_if(lp);
-    
-  ClientProcessor cp(readset, writeset);
-  this->connections.remove_if(cp);
+  this->readyListeners.process(this->listeners, ListenProcessor(*this));
+  this->readyConnections.process(this->connections, ClientProcessor());
+}
+
+
+void
+DCCList::addConnection(DCCPtr connection)
+{
+  connection->registerOnReadyHandler(
+    this->readyConnections.handler(connection));
+  this->connections.push_back(connection);
 }
 
 
@@ -342,15 +334,19 @@ DCCList::statsP(StrList & output)
 // sendAll()
 //
 // Writes a status message to all connections with the required flags and
-// watches.
+// watches.  The line is built once and shared by every connection.
 //
 void
 DCCList::sendAll(const std::string & message, const UserFlags flags,
   const WatchSet & watches, const BotClient *skip)
 {
-  SendFilter filter(message, flags, watches, skip);
+  if (!this->connections.empty())
+  {
+    SendFilter filter(BotSock::Buffer(new std::string(message + '\n')), flags,
+      watches, skip);
 
-  std::for_each(this->connections.begin(), this->connections.end(), filter);
+    std::for_each(this->connections.begin(), this->connections.end(), filter);
+  }
 }
 
 
@@ -391,10 +387,7 @@ DCCList::sendAll(const std::string & from, const std::string & skipId,
     UserFlags f = UserFlags(flags, ',');
     WatchSet w = WatchSet::getWatchValues(watches);
 
-    std::string notice("[");
-    notice += from;
-    notice += "] ";
-    notice += text;
+    BotSock::Buffer notice(new std::string("[" + from + "] " + text + '\n'));
 
     for (SockList::iterator pos = this->connections.begin();
       pos != this->connections.end(); ++pos)
@@ -46,8 +46,7 @@ public:
   bool listen(const std::string & nick, const std::string & userhost,
     const BotSock::Address ircIp);
 
-  void preSelect(fd_set & readset, fd_set & writeset);
-  void postSelect(const fd_set & readset, const fd_set & writeset);
+  void process(void);
 
   void sendAll(const std::string & message,
     const UserFlags flags = UserFlags::NONE(),
@@ -75,50 +74,45 @@ private:
   typedef std::list<DCCPtr> SockList;
   SockList connections;
   SockList listeners;
+  ReadyList<DCC> readyConnections;
+  ReadyList<DCC> readyListeners;
 
   DCCPtr find(const std::string & id) const;
+  void addConnection(DCCPtr connection);
 
   class ListenProcessor
   {
   public:
-    ListenProcessor(const fd_set & readset, const fd_set & writeset,
-      SockList & connections) : readset_(readset), writeset_(writeset),
-      connections_(connections) { }
+    ListenProcessor(DCCList & list) : list_(list) { }
     bool operator()(DCCPtr listener);
   private:
-    const fd_set & readset_;
-    const fd_set & writeset_;
-    SockList & connections_;
+    DCCList & list_;
   };
 
   class ClientProcessor
   {
   public:
-    ClientProcessor(const fd_set & readset, const fd_set & writeset)
-      : readset_(readset), writeset_(writeset) { }
+    ClientProcessor(void) { }
     bool operator()(DCCPtr listener);
-  private:
-    const fd_set & readset_;
-    const fd_set & writeset_;
   };
 
   class SendFilter
   {
   public:
-    SendFilter(const std::string & message, const UserFlags flags, 
+    SendFilter(const BotSock::Buffer & line, const UserFlags flags, 
       const WatchSet & watches, const class BotClient *skip = 0)
-      : message_(message), flags_(flags), watches_(watches), skip_(skip) { }
+      : line_(line), flags_(flags), watches_(watches), skip_(skip) { }
 
     void operator()(DCCPtr client)
     {
       if (this->skip_ != client.get())
       {
-        client->send(this->message_, this->flags_, this->watches_);
+        client->send(this->line_, this->flags_, this->watches_);
       }
     }
 
   private:
-    const std::string message_;
+    const BotSock::Buffer line_;
     const UserFlags flags_;
     const WatchSet watches_;
     const BotClient * skip_;
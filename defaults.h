@@ -26,6 +26,7 @@
 //        to customize your OOMon settings.
 
 
+#define DEFAULT_ACTION_BATCH_WINDOW	60
 #define DEFAULT_AUTO_KLINE_HOST		true
 #define DEFAULT_AUTO_KLINE_HOST_REASON	"Clones are prohibited"
 #define DEFAULT_AUTO_KLINE_HOST_TIME	1440
@@ -61,6 +62,7 @@
 #define DEFAULT_CTCPVERSION_TIMEOUT_REASON "No CTCP VERSION reply"
 #define DEFAULT_DEFAULT_DLINE_TIMEOUT	0
 #define DEFAULT_DEFAULT_KLINE_TIMEOUT	0
+#define DEFAULT_DCC_SENDQ		262144
 #define DEFAULT_DNSBL_PROXY_ACTION	AutoAction::KLINE_HOST
 #define DEFAULT_DNSBL_PROXY_ACTION_TIME 0
 #define DEFAULT_DNSBL_PROXY_ENABLE	false
@@ -103,6 +105,11 @@
 #define DEFAULT_LINKS_FLOOD_MAX_COUNT	2
 #define DEFAULT_LINKS_FLOOD_MAX_TIME	600
 #define DEFAULT_LINKS_FLOOD_REASON	"LINKS flooding"
+#define DEFAULT_LOG_FLUSH_INTERVAL	1
+#define DEFAULT_LOG_QUEUE_SIZE		4194304
+#define DEFAULT_LOG_ROTATE_INTERVAL	0
+#define DEFAULT_LOG_ROTATE_KEEP		7
+#define DEFAULT_LOG_ROTATE_SIZE		0
 #define DEFAULT_MOTD_FLOOD_ACTION	AutoAction::KILL
 #define DEFAULT_MOTD_FLOOD_ACTION_TIME  0
 #define DEFAULT_MOTD_FLOOD_MAX_COUNT	2
@@ -123,7 +130,12 @@
 #define DEFAULT_OPERFAIL_MAX_COUNT	2
 #define DEFAULT_OPERFAIL_MAX_TIME	300
 #define DEFAULT_OPERFAIL_REASON		"Too many failed oper attempts. Wrong server?"
+#define DEFAULT_PATTERN_CACHE_SIZE	256
+#define DEFAULT_REGEX_JIT		true
 #define DEFAULT_RELAY_MSGS_TO_LOCOPS	false
+#define DEFAULT_REMOTE_COMPRESSION	6
+#define DEFAULT_REMOTE_FRAMING		true
+#define DEFAULT_REMOTE_SENDQ		1048576
 #define DEFAULT_SCAN_CACHE      	true
 #define DEFAULT_SCAN_CACHE_SIZE 	5000
 #define DEFAULT_SCAN_CACHE_EXPIRE 	(60 * 2)
@@ -145,6 +157,11 @@
 #define DEFAULT_SEEDRAND_FORMAT		"%_%_%s%_--%_%n%_(%@)%-%i"
 #define DEFAULT_SEEDRAND_REASON		"Possible drone (score: %s)"
 #define DEFAULT_SEEDRAND_REPORT_MIN	4500
+#define DEFAULT_SERVER_PACE_QUEUE	262144
+#define DEFAULT_SERVER_READ_THREAD	true
+#define DEFAULT_SERVER_SEND_BURST	20
+#define DEFAULT_SERVER_SEND_RATE	4
+#define DEFAULT_SERVER_SENDQ		1048576
 #define DEFAULT_SERVER_TIMEOUT		300
 #define DEFAULT_SERVICES_CHECK_INTERVAL	1
 #define DEFAULT_SERVICES_CLONE_LIMIT	4
@@ -160,11 +177,13 @@
 #define DEFAULT_SPAMTRAP_MIN_SCORE	10
 #define DEFAULT_SPAMTRAP_NICK		"spamtrap"
 #define DEFAULT_SPAMTRAP_USERHOST	"spamtrap@spam.trap"
+#define DEFAULT_STATS_FILE		""
 #define DEFAULT_STATS_FLOOD_ACTION	AutoAction::KILL
 #define DEFAULT_STATS_FLOOD_ACTION_TIME 0
 #define DEFAULT_STATS_FLOOD_MAX_COUNT	2
 #define DEFAULT_STATS_FLOOD_MAX_TIME	600
 #define DEFAULT_STATS_FLOOD_REASON	"STATS flooding"
+#define DEFAULT_STATS_INTERVAL		15
 #define DEFAULT_STATSP_CASE_INSENSITIVE	false
 #define DEFAULT_STATSP_MESSAGE		""
 #define DEFAULT_STATSP_REPLY		true
@@ -41,6 +41,8 @@
 #include "vars.h"
 #include "autoaction.h"
 #include "log.h"
+#include "journal.h"
+#include "stats.h"
 #include "main.h"
 #include "watch.h"
 #include "botclient.h"
@@ -271,6 +273,8 @@ Dnsbl::openProxyDetected(const UserEntryPtr user, const std::string & zone)
   notice += user->getTextIP();
   notice += ']';
   Log::Write(notice);
+  Journal::dnsbl(user, zone);
+  Stats::count(Stats::PROXIES);
   ::SendAll(notice, UserFlags::OPER, WATCH_DNSBL);
 
   doAction(user, Dnsbl::action, reason.format(Dnsbl::reason), false);
@@ -256,7 +256,7 @@ klineClones(const bool kline, const std::string & rate,
         if (autoKlineNet && autoPilot_ && kline)
         {
           Notice = "Adding auto-kline for *@" + Net + " :" + text;
-          server.kline("Auto-Kline", autoKlineNetTime, "*@" + Net, text);
+          server().kline("Auto-Kline", autoKlineNetTime, "*@" + Net, text);
         }
         else
         {
@@ -270,7 +270,7 @@ klineClones(const bool kline, const std::string & rate,
         if (autoKlineNoident && autoPilot_ && kline)
         {
           Notice = "Adding auto-kline for ~*@" + Net + " :" + text;
-          server.kline("Auto-Kline", autoKlineNoidentTime, "~*@" + Net, text);
+          server().kline("Auto-Kline", autoKlineNoidentTime, "~*@" + Net, text);
         }
         else
         {
@@ -286,8 +286,8 @@ klineClones(const bool kline, const std::string & rate,
       {
         Notice = "Adding auto-kline for *" + User + "@" + Net + " :" + text;
 
-        server.kline("Auto-Kline", autoKlineUsernetTime, "*" + User + "@" + Net,
-            text);
+        server().kline("Auto-Kline", autoKlineUsernetTime,
+            "*" + User + "@" + Net, text);
       }
       else
       {
@@ -304,7 +304,7 @@ klineClones(const bool kline, const std::string & rate,
     if (autoKlineHost && autoPilot_ && kline)
     {
       Notice = "Adding auto-kline for *@" + Host + " :" + text;
-      server.kline("Auto-Kline", autoKlineHostTime, "*@" + Host, text);
+      server().kline("Auto-Kline", autoKlineHostTime, "*@" + Host, text);
     }
     else
     {
@@ -343,7 +343,7 @@ klineClones(const bool kline, const std::string & rate,
         {
           Notice = "Adding auto-kline for *@" + Host + " :" + text;
 
-          server.kline("Auto-Kline", autoKlineHostTime, "*@" + Host, text);
+          server().kline("Auto-Kline", autoKlineHostTime, "*@" + Host, text);
         }
         else
         {
@@ -358,7 +358,7 @@ klineClones(const bool kline, const std::string & rate,
         {
           Notice = "Adding auto-kline for *" + User + "@" + suggestedHost +
             " :" + text;
-          server.kline("Auto-Kline", autoKlineUserhostTime,
+          server().kline("Auto-Kline", autoKlineUserhostTime,
               "*" + User + "@" + suggestedHost, text);
         }
         else
@@ -376,8 +376,8 @@ klineClones(const bool kline, const std::string & rate,
       {
         Notice = "Adding auto-kline for ~*@" + suggestedHost + " :" + text;
 
-        server.kline("Auto-Kline", autoKlineNoidentTime, "~*@" + suggestedHost,
-            text);
+        server().kline("Auto-Kline", autoKlineNoidentTime,
+            "~*@" + suggestedHost, text);
       }
       else
       {
@@ -509,7 +509,7 @@ addToNickChangeList(const std::string & userhost, const std::string & oldNick,
 
       bool exempt(false);
       BotSock::Address ip(INADDR_NONE);
-      UserEntryPtr user(users.findUser(oldNick, userhost));
+      UserEntryPtr user(users().findUser(oldNick, userhost));
       if (user)
       {
         ip = user->getIP();
@@ -572,7 +572,7 @@ onTraceUser(const std::string & Type, const std::string & Class,
     IP = IP.substr(1, IP.length() - 2);
   }
 
-  users.add(Nick, UserHost, IP, true, (0 == Type.compare("Oper")), Class);
+  users().add(Nick, UserHost, IP, true, (0 == Type.compare("Oper")), Class);
 }
 
 
@@ -606,7 +606,7 @@ onTraceUser(const std::string & Type, const std::string & Class,
     IP = IP.substr(1, IP.length() - 2);
   }
 
-  users.add(Nick, UserHost, IP, true, (0 == Type.compare("Oper")), Class);
+  users().add(Nick, UserHost, IP, true, (0 == Type.compare("Oper")), Class);
 }
 
 
@@ -622,7 +622,7 @@ onETraceUser(const std::string & Type, const std::string & Class,
   if (Type.empty() || Nick.empty() || User.empty() || Host.empty())
     return;
 
-  users.add(Nick, User + '@' + Host, IP, true, (0 == Type.compare("Oper")),
+  users().add(Nick, User + '@' + Host, IP, true, (0 == Type.compare("Oper")),
     Class, Gecos);
 }
 
@@ -667,7 +667,7 @@ onClientConnect(std::string text)
 
   connects.onNotice(nick + ' ' + userhost + ' ' + ipString);
 
-  users.add(nick, userhost, ipString, false, false, classString, gecos);
+  users().add(nick, userhost, ipString, false, false, classString, gecos);
 
   ::SendAll("Connected: " + copy, UserFlags::OPER, WATCH_CONNECTS);
 
@@ -707,7 +707,7 @@ onClientExit(std::string text)
     ip = BotSock::inet_addr(ipString);
   }
 
-  users.remove(nick, userhost, ip);
+  users().remove(nick, userhost, ip);
   ::SendAll("Disconnected: " + copy, UserFlags::CONN, WATCH_DISCONNECTS);
 
   return true;
@@ -728,8 +728,8 @@ onCsClones(std::string text)
 
   // Rejecting clonebot: nick (user@host)
   // Clonebot killed: nick (user@host)
-  std::string first(server.downCase(FirstWord(text)));
-  std::string second(server.downCase(FirstWord(text)));
+  std::string first(server().downCase(FirstWord(text)));
+  std::string second(server().downCase(FirstWord(text)));
 
   std::string nick(FirstWord(text));
 
@@ -760,7 +760,7 @@ onCsClones(std::string text)
 
     BotSock::Address ip(INADDR_NONE);
     std::string className;
-    UserEntryPtr find(users.findUser(nick, userhost));
+    UserEntryPtr find(users().findUser(nick, userhost));
     if (find)
     {
       ip = find->getIP();
@@ -802,7 +802,7 @@ onCsNickFlood(std::string text)
   bool exempt = false;
 
   BotSock::Address ip(INADDR_NONE);
-  UserEntryPtr user(users.findUser(nick, userhost));
+  UserEntryPtr user(users().findUser(nick, userhost));
   if (user)
   {
     ip = user->getIP();
@@ -854,8 +854,8 @@ onNickChange(std::string text)
   ::SendAll("Nick change: " + nick1 + " -> " + nick2 + " (" + userhost + ")",
     UserFlags::NICK, WATCH_NICK_CHANGES);
 
-  addToNickChangeList(server.downCase(userhost), nick1, nick2);
-  users.updateNick(nick1, userhost, nick2);
+  addToNickChangeList(server().downCase(userhost), nick1, nick2);
+  users().updateNick(nick1, userhost, nick2);
 
   return true;
 }
@@ -883,10 +883,10 @@ onKillNotice(std::string text)
   std::cout << "target = " << target << std::endl;
 #endif /* ENGINE_DEBUG */
 
-  if (users.have(target))
+  if (users().have(target))
   {
     // We only want to report kills on local users
-    if (server.downCase(FirstWord(text)) != "from")
+    if (server().downCase(FirstWord(text)) != "from")
       return false;
 
     // Killer's nick
@@ -896,7 +896,7 @@ onKillNotice(std::string text)
   std::cout << "killer = " << killer << std::endl;
 #endif /* ENGINE_DEBUG */
 
-    bool global(!users.have(killer));
+    bool global(!users().have(killer));
 
     if ((std::string::npos != killer.find('@')) || 
       (std::string::npos != killer.find('!')) || 
@@ -904,7 +904,7 @@ onKillNotice(std::string text)
     {
       // We don't want to see server kills :P
 
-      if (server.downCase(FirstWord(text)) != "path:")
+      if (server().downCase(FirstWord(text)) != "path:")
 	return false;
 
       // Kill path - we don't use this
@@ -944,7 +944,7 @@ onLinksNotice(std::string text)
     notice += text;
     notice += ']';
 
-    if (0 == server.downCase(FirstWord(text)).compare("links"))
+    if (0 == server().downCase(FirstWord(text)).compare("links"))
     {
       if (!text.empty() && (text[0] == '\''))
       {
@@ -984,7 +984,7 @@ onTraceNotice(std::string text)
     notice += text;
     notice += ']';
 
-    if (0 == server.downCase(FirstWord(text)).compare("trace"))
+    if (0 == server().downCase(FirstWord(text)).compare("trace"))
     {
       result = traceLookers.onNotice(notice, text);
     }
@@ -1005,7 +1005,7 @@ onMotdNotice(std::string text)
     notice += text;
     notice += ']';
 
-    if (0 == server.downCase(FirstWord(text)).compare("motd"))
+    if (0 == server().downCase(FirstWord(text)).compare("motd"))
     {
       result = motdLookers.onNotice(notice, text);
     }
@@ -1026,7 +1026,7 @@ onInfoNotice(std::string text)
     notice += text;
     notice += ']';
 
-    if (0 == server.downCase(FirstWord(text)).compare("info"))
+    if (0 == server().downCase(FirstWord(text)).compare("info"))
     {
       result = infoLookers.onNotice(notice, text);
     }
@@ -1045,7 +1045,7 @@ onStatsNotice(std::string text)
   notice += text;
   notice += ']';
 
-  if (0 == server.downCase(FirstWord(text)).compare("stats"))
+  if (0 == server().downCase(FirstWord(text)).compare("stats"))
   {
     std::string statsType = FirstWord(text);
 
@@ -1054,13 +1054,13 @@ onStatsNotice(std::string text)
     {
       std::string copy = text;
 
-      if (server.downCase(FirstWord(copy)) != "requested")
+      if (server().downCase(FirstWord(copy)) != "requested")
       {
         // broken.  ignore it.
         return false;
       }
 
-      if (server.downCase(FirstWord(copy)) != "by")
+      if (server().downCase(FirstWord(copy)) != "by")
       {
         // broken.  ignore it.
         return false;
@@ -1089,7 +1089,7 @@ onStatsNotice(std::string text)
         output.push_back(statspMessage);
       }
 
-      server.notice(std::string(nick), output);
+      server().notice(std::string(nick), output);
 
       result = true;
     }
@@ -1236,16 +1236,16 @@ onOperNotice(std::string text)
     userhost.erase(userhost.end() - 1);
   }
 
-  if ("is" != server.downCase(FirstWord(text)))
+  if ("is" != server().downCase(FirstWord(text)))
     return false;
-  if ("now" != server.downCase(FirstWord(text)))
+  if ("now" != server().downCase(FirstWord(text)))
     return false;
-  if ("an" != server.downCase(FirstWord(text)))
+  if ("an" != server().downCase(FirstWord(text)))
     return false;;
-  if ("operator" != server.downCase(FirstWord(text)))
+  if ("operator" != server().downCase(FirstWord(text)))
     return false;;
 
-  users.updateOper(nick, userhost, true);
+  users().updateOper(nick, userhost, true);
 
   return true;
 }
@@ -1291,7 +1291,7 @@ checkForSpoof(const std::string & nick, const std::string & user,
         std::string::size_type lastDot = host.rfind('.');
         if (std::string::npos != lastDot)
         {
-          std::string tld = server.downCase(host.substr(lastDot + 1));
+          std::string tld = server().downCase(host.substr(lastDot + 1));
 
           std::string::size_type len = tld.length();
 
@@ -1390,7 +1390,7 @@ onClearTempKlines(std::string text)
     {
       ::SendAll(notice, UserFlags::OPER, WATCH_KLINES);
       Log::Write(notice);
-      server.reloadKlines();
+      server().reloadKlines();
       result = true;
     }
   }
@@ -1415,7 +1415,7 @@ onClearTempDlines(std::string text)
     {
       ::SendAll(notice, UserFlags::OPER, WATCH_KLINES);
       Log::Write(notice);
-      server.reloadDlines();
+      server().reloadDlines();
       result = true;
     }
   }
@@ -1429,7 +1429,7 @@ onGlineRequest(std::string text)
 {
   std::string nuh(FirstWord(text));
 
-  if ("on" != server.downCase(FirstWord(text)))
+  if ("on" != server().downCase(FirstWord(text)))
     return false;
 
   std::string serverName(FirstWord(text));
@@ -1438,16 +1438,16 @@ onGlineRequest(std::string text)
 
   std::string voodoo;
 
-  if (0 == server.downCase(ishas).compare("is"))
+  if (0 == server().downCase(ishas).compare("is"))
   {
-    if ("requesting" != server.downCase(FirstWord(text)))
+    if ("requesting" != server().downCase(FirstWord(text)))
       return false;
 
     voodoo = " requested ";
   }
-  else if (0 == server.downCase(ishas).compare("has"))
+  else if (0 == server().downCase(ishas).compare("has"))
   {
-    if ("triggered" != server.downCase(FirstWord(text)))
+    if ("triggered" != server().downCase(FirstWord(text)))
       return false;
     
     voodoo = " triggered ";
@@ -1457,10 +1457,10 @@ onGlineRequest(std::string text)
     return false;
   }
 
-  if ("gline" != server.downCase(FirstWord(text)))
+  if ("gline" != server().downCase(FirstWord(text)))
     return false;
 
-  if ("for" != server.downCase(FirstWord(text)))
+  if ("for" != server().downCase(FirstWord(text)))
     return false;
 
   std::string mask(FirstWord(text));
@@ -1497,7 +1497,7 @@ onLineActive(std::string text)
 {
   std::string notice(text);
 
-  std::string lineType(server.downCase(FirstWord(text)));
+  std::string lineType(server().downCase(FirstWord(text)));
 
   Watch w;
 
@@ -1546,15 +1546,15 @@ onMaskHostNotice(std::string text)
 
   std::string nick(FirstWord(text));
 
-  if (0 == server.downCase(FirstWord(text)).compare("masking:"))
+  if (0 == server().downCase(FirstWord(text)).compare("masking:"))
   {
     std::string realHost(FirstWord(text));
 
-    if (0 == server.downCase(FirstWord(text)).compare("as"))
+    if (0 == server().downCase(FirstWord(text)).compare("as"))
     {
       std::string fakeHost(FirstWord(text));
 
-      users.setMaskHost(nick, realHost, fakeHost);
+      users().setMaskHost(nick, realHost, fakeHost);
 
       result = true;
     }
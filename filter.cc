@@ -270,6 +270,15 @@ Filter::matches(const Filter::Field & field) const
 }
 
 
+PatternPtr
+Filter::pattern(const Filter::Field & field) const
+{
+  FieldMap::const_iterator pos = this->fields_.find(field);
+
+  return (this->fields_.end() != pos) ? pos->second : PatternPtr();
+}
+
+
 FormatSet
 Filter::formats(void) const
 {
@@ -62,6 +62,8 @@ public:
   bool matches(const UserEntryPtr user) const;
   bool matches(const Filter::Field & field) const;
 
+  PatternPtr pattern(const Filter::Field & field) const;
+
   FormatSet formats(void) const;
 
   std::string get(void) const;
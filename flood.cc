@@ -66,7 +66,7 @@ FloodList::addFlood(const std::string & nick, const std::string & userhost,
 
         bool exempt(false);
         BotSock::Address ip(INADDR_NONE);
-        UserEntryPtr find(users.findUser(nick, userhost));
+        UserEntryPtr find(users().findUser(nick, userhost));
         if (find)
         {
           ip = find->getIP();
@@ -117,13 +117,13 @@ bool
 FloodList::onNotice(const std::string & notice, std::string text,
   std::time_t now)
 {
-  if (server.downCase(FirstWord(text)) != "requested")
+  if (server().downCase(FirstWord(text)) != "requested")
   {
     // broken.  ignore it.
     return false;
   }
 
-  if (server.downCase(FirstWord(text)) != "by")
+  if (server().downCase(FirstWord(text)) != "by")
   {
     // broken.  ignore it.
     return false;
@@ -146,7 +146,7 @@ FloodList::onNotice(const std::string & notice, std::string text,
            ((userhost[0] == '(') &&
             (userhost[userhost.length() - 1] == ')'))))
   {
-    userhost = server.downCase(userhost.substr(1, userhost.length() - 2));
+    userhost = server().downCase(userhost.substr(1, userhost.length() - 2));
   }
 
   // Remove brackets/parentheses from serverName
@@ -156,17 +156,18 @@ FloodList::onNotice(const std::string & notice, std::string text,
            ((serverName[0] == '(') &&
             (serverName[serverName.length() - 1] == ')'))))
   {
-    serverName = server.downCase(serverName.substr(1, serverName.length() - 2));
+    serverName = server().downCase(serverName.substr(1,
+      serverName.length() - 2));
   }
 
   /* Don't complain about opers */
-  if (!config.isOper(userhost, users.getIP(nick, userhost)) &&
-      !users.isOper(nick, userhost))
+  if (!config.isOper(userhost, users().getIP(nick, userhost)) &&
+      !users().isOper(nick, userhost))
   {
     ::SendAll(notice, UserFlags::OPER, this->watch_);
 
-    this->addFlood(nick, userhost, now, server.same(serverName,
-      server.getServerName()));
+    this->addFlood(nick, userhost, now, server().same(serverName,
+      server().getServerName()));
   }
 
   return true;
@@ -70,7 +70,7 @@ Http::onConnect()
   if (INADDR_NONE == dst)
   {
     port = config.serverPort();
-    dst = server.getRemoteAddress();
+    dst = server().getRemoteAddress();
   }
 
   std::string buffer("CONNECT ");
@@ -67,7 +67,7 @@ HttpPost::onConnect(void)
   if (INADDR_NONE == dst)
   {
     port = config.serverPort();
-    dst = server.getRemoteAddress();
+    dst = server().getRemoteAddress();
   }
 
   std::string buffer("POST http://");
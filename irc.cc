@@ -23,6 +23,7 @@
 #include <iostream>
 #include <string>
 #include <cerrno>
+#include <algorithm>
 #include <ctime>
 
 // Boost C++ Headers
@@ -30,7 +31,14 @@
 #include <boost/lexical_cast.hpp>
 
 // Std C Headers
+#include <sys/time.h>
 #include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
 
 // OOMon Headers
 #include "strtype"
@@ -38,6 +46,7 @@
 #include "irc.h"
 #include "config.h"
 #include "log.h"
+#include "stats.h"
 #include "main.h"
 #include "util.h"
 #include "engine.h"
@@ -50,6 +59,8 @@
 #include "pattern.h"
 #include "botclient.h"
 #include "defaults.h"
+#include "timers.h"
+#include "capture.h"
 
 
 #ifdef DEBUG
@@ -57,11 +68,16 @@
 #endif
 
 
-IRC server;
+IRC * IRC::current_ = 0;
 
 
 bool IRC::operNickInReason_(DEFAULT_OPER_NICK_IN_REASON);
 bool IRC::relayMsgsToLocops_(DEFAULT_RELAY_MSGS_TO_LOCOPS);
+bool IRC::readThread_(DEFAULT_SERVER_READ_THREAD);
+int IRC::paceQueue_(DEFAULT_SERVER_PACE_QUEUE);
+int IRC::sendBurst_(DEFAULT_SERVER_SEND_BURST);
+int IRC::sendRate_(DEFAULT_SERVER_SEND_RATE);
+int IRC::serverSendQ_(DEFAULT_SERVER_SENDQ);
 int IRC::serverTimeout_(DEFAULT_SERVER_TIMEOUT);
 bool IRC::trackPermDlines_(DEFAULT_TRACK_PERM_DLINES);
 bool IRC::trackPermKlines_(DEFAULT_TRACK_PERM_KLINES);
@@ -71,9 +87,22 @@ std::string IRC::umode_(DEFAULT_UMODE);
 int IRC::userCountDeltaMax_(DEFAULT_USER_COUNT_DELTA_MAX);
 
 
-IRC::IRC(): sock_(false, true), supportETrace(false), supportKnock(false),
-  caseMapping(CASEMAP_RFC1459), klines('K'), dlines('D')
+IRC::IRC(): sock_(false, true), users_(this), nextConnectAttempt_(0),
+  connectWait_(1), sendQueueBytes_(0), sendQueueExceeded_(false),
+  sendTokens_(0), lastRefill_(0), supportETrace(false),
+  supportKnock(false), caseMapping(CASEMAP_RFC1459), klines('K'), dlines('D')
 {
+  this->entry_.port = 0;
+  this->sock_.setMaxQueue(IRC::serverSendQ_);
+  // Read bursts of TRACE and STATS replies in as few calls as possible
+  this->sock_.setBufferSize(16384);
+  for (int i = 0; i < PRIORITY_COUNT; ++i)
+  {
+    this->sendStats_[i].sent = 0;
+    this->sendStats_[i].dropped = 0;
+    this->sendStats_[i].totalWait = 0;
+    this->sendStats_[i].maxWait = 0;
+  }
   this->amIAnOper = false;
   this->serverName = "";
   this->gettingKlines = false;
@@ -83,10 +112,13 @@ IRC::IRC(): sock_(false, true), supportETrace(false), supportKnock(false),
   this->gettingTrace = false;
   this->myNick = "";
   this->lastUserDeltaCheck = 0;
-  this->lastCtcpVersionTimeoutCheck = 0;
 
   this->sock_.registerOnConnectHandler(boost::bind(&IRC::onConnect, this));
-  this->sock_.registerOnReadHandler(boost::bind(&IRC::onRead, this, _1));
+  this->sock_.registerOnLineHandler(boost::bind(&IRC::onRead, this, _1, _2));
+  this->sock_.registerOnIdleHandler(boost::bind(&IRC::onIdle, this));
+
+  Timers::instance().every(10, boost::bind(&IRC::checkVersionTimeout, this));
+  Timers::instance().every(10, boost::bind(&IRC::checkUserDelta, this));
 
   addServerNoticeParser("Client connecting: *", ::onClientConnect);
   addServerNoticeParser("Client exiting: *", ::onClientExit);
@@ -140,36 +172,267 @@ IRC::IRC(): sock_(false, true), supportETrace(false), supportKnock(false),
 }
 
 
+//////////////////////////////////////////////////////////////////////
+// IRC::list()
+//
+// Description:
+//  Returns every server, in the order of the config file's S: lines.
+//  There is always at least one, which is created the first time it
+//  is needed and never destroyed.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns the list of servers.
+//////////////////////////////////////////////////////////////////////
+static IRC::List &
+serverList(void)
+{
+  static IRC::List * list = 0;
+
+  if (0 == list)
+  {
+    list = new IRC::List;
+    list->push_back(new IRC);
+  }
+
+  return *list;
+}
+
+
+const IRC::List &
+IRC::list(void)
+{
+  return serverList();
+}
+
+
+IRC &
+IRC::current(void)
+{
+  return (0 != IRC::current_) ? *IRC::current_ : *serverList().front();
+}
+
+
+IRC::Context::Context(IRC * irc) : previous_(IRC::current_)
+{
+  if (0 != irc)
+  {
+    IRC::current_ = irc;
+  }
+}
+
+
+IRC::Context::~Context(void)
+{
+  IRC::current_ = this->previous_;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// IRC::find(name)
+//
+// Description:
+//  Finds a server by its position in the config file (starting at 1),
+//  the address it was configured with, or the name it gave itself.
+//
+// Parameters:
+//  name - The number, address, or name of the server.
+//
+// Return Value:
+//  The function returns the server, or 0 if there is no such server.
+//////////////////////////////////////////////////////////////////////
+IRC *
+IRC::find(const std::string & name)
+{
+  const IRC::List & list = serverList();
+
+  if (isNumeric(name))
+  {
+    const IRC::List::size_type index = atoi(name.c_str());
+
+    return ((index > 0) && (index <= list.size())) ? list[index - 1] : 0;
+  }
+
+  for (IRC::List::const_iterator pos = list.begin(); pos != list.end(); ++pos)
+  {
+    if (Same(name, (*pos)->entry_.address) ||
+      Same(name, (*pos)->serverName))
+    {
+      return *pos;
+    }
+  }
+
+  return 0;
+}
+
+
+UserHash &
+users(void)
+{
+  return IRC::current().users();
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// IRC::configure()
+//
+// Description:
+//  Gives each server its S: line from the config file, adding servers
+//  as needed.  Servers are never removed, since users and queued
+//  actions may still refer to them; one whose S: line is gone simply
+//  disconnects and stays that way.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+IRC::configure(void)
+{
+  IRC::List & list = serverList();
+  const Config::ServerVector & entries = config.servers();
+
+  while (list.size() < entries.size())
+  {
+    list.push_back(new IRC);
+  }
+
+  for (IRC::List::size_type i = 0; i < list.size(); ++i)
+  {
+    if (i < entries.size())
+    {
+      list[i]->setServer(entries[i]);
+    }
+    else
+    {
+      list[i]->entry_ = Config::Server();
+      list[i]->entry_.port = 0;
+      if (list[i]->isConnected() || list[i]->isConnecting())
+      {
+        list[i]->quit("Server removed from configuration");
+      }
+    }
+  }
+}
+
+
+std::string
+IRC::getAddress(void) const
+{
+  return this->entry_.address + ':' +
+    boost::lexical_cast<std::string>(this->entry_.port);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// IRC::reconnect(now)
+//
+// Description:
+//  Connects to the server if it isn't connected, waiting longer after
+//  each failed attempt, up to two minutes.
+//
+// Parameters:
+//  now - The current time.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+IRC::reconnect(const std::time_t now)
+{
+  if (this->entry_.address.empty() || this->isConnected() ||
+    this->isConnecting() || (now < this->nextConnectAttempt_))
+  {
+    return;
+  }
+
+  this->nextConnectAttempt_ = now + this->connectWait_;
+  Timers::instance().after(this->connectWait_, Timers::Callback());
+
+  std::string notice("Connecting to IRC server at ");
+  notice += this->getAddress();
+#ifdef IRC_DEBUG
+  std::cout << notice << std::endl;
+#endif
+  Log::Write(notice);
+  this->bindTo(config.hostname());
+  if (this->connect(this->entry_.address, this->entry_.port))
+  {
+    // Success!
+    this->connectWait_ = 1;
+  }
+  else
+  {
+    if (this->connectWait_ < 120)
+    {
+      this->connectWait_ *= 2;
+    }
+    std::string notice("Connect failed");
+#ifdef IRC_DEBUG
+    std::cout << notice << std::endl;
+#endif
+    Log::Write(notice);
+    this->reset();
+  }
+}
+
+
 bool
-IRC::postSelect(const fd_set & readset, const fd_set & writeset)
+IRC::haveChannel(const std::string & channel) const
 {
-  std::time_t now = std::time(0);
+  StrVector channels;
+
+  StrSplit(channels, this->downCase(this->entry_.channels), ",");
 
-  // If we've been idle for half the timeout period, send a PING to make
-  // sure the connection is still good!
-  if (this->isConnected() && (this->getIdle() > (this->getTimeout() / 2)) &&
-    (this->getWriteIdle() > (this->getTimeout() / 2)))
+  return (channels.end() != std::find(channels.begin(), channels.end(),
+    this->downCase(channel)));
+}
+
+
+bool
+IRC::process(void)
+{
+  if (this->sendQueueExceeded_)
   {
-    this->write("PING :" + this->myNick + '\n');
+    std::cerr << "IRC::process(): paced send queue exceeded (" <<
+      this->sendQueueBytes_ << " bytes)" << std::endl;
+
+    return false;
   }
 
-  if ((now - this->lastCtcpVersionTimeoutCheck) > 10)
+  if (this->isConnected())
   {
-    users.checkVersionTimeout();
-    this->lastCtcpVersionTimeoutCheck = now;
+    this->drainQueue();
   }
 
-  return this->sock_.postSelect(readset, writeset);
+  return this->sock_.process();
+}
+
+
+// If we've been idle for half the timeout period, send a PING to make
+// sure the connection is still good!
+void
+IRC::onIdle(void)
+{
+  IRC::Context context(this);
+
+  this->write("PING :" + this->myNick + '\n');
 }
 
 
 bool
 IRC::onConnect()
 {
-  Log::Write("Connected to IRC server");
+  IRC::Context context(this);
+
+  Log::Write("Connected to IRC server at " + this->getAddress());
 
   // Send password (if necessary)
-  std::string password(config.serverPassword());
+  std::string password(this->entry_.password);
   if (!password.empty())
   {
     this->write("PASS " + password + "\n");
@@ -191,401 +454,898 @@ IRC::onConnect()
 }
 
 
+static double
+timeNow(void)
+{
+  struct timeval now;
+
+  gettimeofday(&now, 0);
+
+  return now.tv_sec + (now.tv_usec / 1000000.0);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// IRC::write(text, priority)
+//
+// Description:
+//  Sends a line to the server, pacing the output so as not to exceed
+//  the server's flood limits.  Each line takes a token from a bucket
+//  that refills at SERVER_SEND_RATE lines per second, up to
+//  SERVER_SEND_BURST lines.  A line is queued if the bucket is empty
+//  or if lines of the same or higher priority are already waiting;
+//  process() sends queued lines, highest priority first, as tokens
+//  become available.  PRIORITY_CONTROL lines are always sent at once.
+//  If more than SERVER_PACE_QUEUE bytes are queued, the oldest
+//  PRIORITY_BULK lines are dropped to make room.
+//
+// Parameters:
+//  text     - The line to send, including its newline.
+//  priority - The class of the line.
+//  onDrop   - Called if the line is queued and later dropped.
+//
+// Return Value:
+//  The function returns the number of bytes sent or queued, or -1 if
+//  the write failed.
+//////////////////////////////////////////////////////////////////////
 int
-IRC::write(const std::string & text)
+IRC::write(const std::string & text, const IRC::Priority priority,
+  const IRC::OnDropHandler & onDrop)
 {
-#ifdef IRC_DEBUG
-  std::cout << "IRC << " << text;
-#endif
+  const double now = timeNow();
 
-  return this->sock_.write(text);
+  this->drainQueue();
+
+  bool waiting = false;
+  for (int i = PRIORITY_ENFORCE; i <= priority; ++i)
+  {
+    if (!this->sendQueue_[i].empty())
+    {
+      waiting = true;
+    }
+  }
+
+  if ((PRIORITY_CONTROL == priority) || (IRC::sendRate_ <= 0) ||
+    (!waiting && (this->sendTokens_ >= 1)) || !this->sink_.empty())
+  {
+    return this->send(text, priority, now, now);
+  }
+
+  QueuedLine line;
+  line.text = text;
+  line.queued = now;
+  line.onDrop = onDrop;
+  this->sendQueue_[priority].push_back(line);
+  this->sendQueueBytes_ += text.length();
+
+  this->limitQueue();
+
+  return text.length();
 }
 
 
+//////////////////////////////////////////////////////////////////////
+// IRC::limitQueue()
+//
+// Description:
+//  Keeps the send queues within SERVER_PACE_QUEUE bytes by dropping
+//  the oldest PRIORITY_BULK lines.  Other lines are never dropped; if
+//  they alone are over the limit, the connection is dropped the next
+//  time it is processed, as when SERVER_SENDQ is exceeded.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
 void
-IRC::quit(const std::string & message)
+IRC::limitQueue(void)
 {
-#ifdef IRC_DEBUG
-  std::cout << "Disconnecting from server." << std::endl;
-#endif
+  if (IRC::paceQueue_ <= 0)
+  {
+    return;
+  }
 
-  this->write("QUIT :" + message + "\n");
-  Log::Write("Disconnecting from server: " + message);
-  this->reset();
+  const std::string::size_type limit = IRC::paceQueue_;
 
-  this->amIAnOper = 0;
+  while ((this->sendQueueBytes_ > limit) &&
+    !this->sendQueue_[PRIORITY_BULK].empty())
+  {
+    this->dropLine(PRIORITY_BULK);
+  }
+
+  if (this->sendQueueBytes_ > limit)
+  {
+    this->sendQueueExceeded_ = true;
+  }
 }
 
 
-bool
-IRC::onRead(std::string text)
+// dropLine(priority)
+//
+// Drops the oldest queued line of a class.
+//
+void
+IRC::dropLine(const IRC::Priority priority)
 {
-  if (text.empty())
-    return true;
+  QueuedLine line(this->sendQueue_[priority].front());
+  this->sendQueue_[priority].pop_front();
+  this->sendQueueBytes_ -= line.text.length();
+  ++this->sendStats_[priority].dropped;
 
+  if (!line.onDrop.empty())
+  {
+    line.onDrop();
+  }
+}
+
+
+int
+IRC::send(const std::string & text, const IRC::Priority priority,
+  const double queued, const double now)
+{
 #ifdef IRC_DEBUG
-  std::cout << "IRC >> " << text << std::endl;
+  std::cout << "IRC << " << text;
 #endif
 
-  StrVector params;
+  QueueStats & stats = this->sendStats_[priority];
+  const double wait = now - queued;
 
-  if (text[0] == ':')
+  ++stats.sent;
+  stats.totalWait += wait;
+  if (wait > stats.maxWait)
   {
-    SplitIRC(params, text.substr(1));
+    stats.maxWait = wait;
   }
-  else
+
+  // Control lines use up the burst too, but never wait for it
+  this->sendTokens_ = (this->sendTokens_ >= 1) ? (this->sendTokens_ - 1) : 0;
+
+  if (!this->sink_.empty())
   {
-    params.push_back(serverName);
+    this->sink_(text);
+    return text.length();
+  }
+
+  return this->sock_.write(text);
+}
+
 
-    SplitIRC(params, text);
+void
+IRC::refillTokens(const double now)
+{
+  if (IRC::sendRate_ <= 0)
+  {
+    this->sendTokens_ = IRC::sendBurst_;
+  }
+  else if (this->lastRefill_ > 0)
+  {
+    this->sendTokens_ += (now - this->lastRefill_) * IRC::sendRate_;
+    if (this->sendTokens_ > IRC::sendBurst_)
+    {
+      this->sendTokens_ = IRC::sendBurst_;
+    }
+  }
+  else
+  {
+    this->sendTokens_ = IRC::sendBurst_;
   }
 
-  std::string from, userhost;
-  SplitFrom(params[0], from, userhost);
+  this->lastRefill_ = now;
+}
 
-  std::string command = params[1];
 
-  try
+// drainQueue()
+//
+// Sends as many queued lines as there are tokens for, highest priority
+// first.
+//
+void
+IRC::drainQueue(void)
+{
+  const double now = timeNow();
+
+  this->refillTokens(now);
+
+  for (int i = PRIORITY_ENFORCE; i < PRIORITY_COUNT; ++i)
   {
-    int numeric = boost::lexical_cast<int>(command);
+    LineQueue & queue = this->sendQueue_[i];
 
-    switch (numeric)
+    while (!queue.empty() && (this->sendTokens_ >= 1))
     {
-      case 001:
-        serverName = from;
-        // Oper up
-        this->write("OPER " + config.operName() + " " + config.operPassword() +
-            "\n");
-        this->klines.Clear();
-        this->dlines.Clear();
-        this->gettingDlines = false;
-        this->gettingKlines = false;
-        this->gettingTempDlines = false;
-        this->gettingTempKlines = false;
-        this->gettingTrace = false;
-        {
-          std::string channels(config.channels());
-          if (!channels.empty())
-          {
-            this->write("JOIN " + channels + "\n");
-          }
-        }
-	initFloodTables();
-        break;
-      case 005:
-        for (StrVector::size_type idx = 3; idx < params.size(); ++idx)
-        {
-          if (params[idx] == "ETRACE")
-	  {
-	    this->supportETrace = true;
-	  }
-	  else if (params[idx] == "KNOCK")
-	  {
-	    this->supportKnock = true;
-	  }
-	  else if (params[idx].substr(0, 12) == "CASEMAPPING=")
-	  {
-	    std::string map = params[idx].substr(12);
+      QueuedLine line(queue.front());
+      queue.pop_front();
+      this->sendQueueBytes_ -= line.text.length();
+      this->send(line.text, static_cast<IRC::Priority>(i), line.queued, now);
+    }
+  }
+}
 
-	    if (Same(map, "ascii"))
-	    {
-	      this->caseMapping = CASEMAP_ASCII;
-	    }
-	    else if (Same(map, "strict-rfc1459"))
-	    {
-	      this->caseMapping = CASEMAP_STRICT_RFC1459;
-	    }
-	    else
-	    {
-	      this->caseMapping = CASEMAP_RFC1459;
-	    }
-	  }
-	}
-	break;
-      case 204:	// ontraceuser(body)
-      case 205:	// ontraceuser(body)
-        if (this->gettingTrace && (params.size() > 6))
-        {
-          if ((params[6][0] == '[') && (params.size() > 7))
-	  {
-            // [hybrid7-rc6] IRC >> :plasma.toast.pc 204 OOMon Oper opers OOMon [toast@Plasma.Toast.PC] (192.168.1.1) 0 0
-            onTraceUser(params[3], params[4], params[5], params[6], params[7]);
-	  }
-	  else
-	  {
-            // [hybrid6] IRC >> :plasma.toast.pc 205 OOMon User 1 Toast[toast@Plasma.Toast.PC] (192.168.1.1) 000000005 000000005
-            onTraceUser(params[3], params[4], params[5], params[6]);
-	  }
-        }
-        break;
-      case 209:
-      case 262:
-        if (this->gettingTrace)
-        {
-          this->gettingTrace = false;
-	  users.resetUserCountDelta();
-          ::SendAll("*** TRACE complete.", UserFlags::OPER);
-        }
-        break;
-      case 216:
-        // IRC >> :plasma.engr.arizona.edu 216 OOMon K *.monkeys.org * * foo llalalala (1998/03/03 11.18)
-        // IRC >> :plasma.engr.arizona.edu 216 OOMon K *bork.com * *hork moo la la la (1998/03/03 11.18)
-        if ((params.size() > 6) &&
-                (((params[3] == "K") && IRC::trackPermKlines_) ||
-                 ((params[3] == "k") && IRC::trackTempKlines_)))
-        {
-	  std::string reason = (params.size() > 7) ? params[7] : "";
-	  for (StrVector::size_type pos = 8; pos < params.size(); pos++)
-	  {
-	    reason += " " + params[pos];
-	  }
-	  this->klines.Add(params[6] + "@" + params[4], reason,
-	    params[3] == "k");
-        }
-        break;
-      case 219:
-	if (params.size() >= 3)
-	{
-          if (params[3] == "K")
-          {
-            this->gettingKlines = false;
-          }
-          else if (params[3] == "D")
-          {
-            this->gettingDlines = false;
-          }
-          else if (params[3] == "k")
-          {
-            this->gettingTempKlines = false;
-          }
-          else if (params[3] == "d")
-          {
-            this->gettingTempDlines = false;
-          }
-	}
-        break;
-      case 225:
-        // IRC >> :plasma.toast.pc 225 ToastFOO D 1.2.3.4 :foo (2003/1/9 17.27)
-        if ((params.size() > 4) &&
-                (((params[3] == "D") && IRC::trackPermDlines_) ||
-                 ((params[3] == "d") && IRC::trackTempDlines_)))
-        {
-	  std::string reason = (params.size() > 5) ? params[5] : "";
-	  for (StrVector::size_type pos = 6; pos < params.size(); pos++)
-	  {
-	    reason += " " + params[pos];
-	  }
-	  this->dlines.Add(params[4], reason, params[3] == "d");
-        }
-        break;
-      case 303:
-        if (params.size() >= 4)
-	{
-	  services.onIson(params[3]);
-        }
-        break;
-      case 311:	/* RPL_WHOISUSER */
-        if (params.size() > 5)
-        {
-	  // :plasma.toast.pc 311 Toast Toast toast Plasma.Toast.PC * :i
-	  std::string nick = params[3];
-
-	  if (this->same(nick, Services::spamtrapNick()))
-	  {
-	    std::string userhost = params[4] + '@' + params[5];
 
-	    if (this->same(userhost, Services::spamtrapUserhost()))
-	    {
-	      services.pollSpamtrap();
-	    }
-	  }
-	}
-        break;
-      case 381:
-        {
-	  this->amIAnOper = true;
+//////////////////////////////////////////////////////////////////////
+// IRC::queueDelay(priority)
+//
+// Description:
+//  Estimates how long a line written now with the given priority will
+//  wait in the send queue.
+//
+// Parameters:
+//  priority - The class of the line.
+//
+// Return Value:
+//  The function returns the estimated delay in seconds.
+//////////////////////////////////////////////////////////////////////
+std::time_t
+IRC::queueDelay(const IRC::Priority priority) const
+{
+  if ((PRIORITY_CONTROL == priority) || (IRC::sendRate_ <= 0))
+  {
+    return 0;
+  }
+
+  double ahead = 1;
+  for (int i = PRIORITY_ENFORCE; i <= priority; ++i)
+  {
+    ahead += this->sendQueue_[i].size();
+  }
+
+  const double delay = (ahead - this->sendTokens_) / IRC::sendRate_;
+
+  return (delay > 0) ? static_cast<std::time_t>(delay + 0.5) : 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// IRC::pacingTimeout()
+//
+// Description:
+//  Calculates how long the main loop may wait before the next queued
+//  line can be sent.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns the number of milliseconds until a token will
+//  be available, or -1 if nothing is queued.
+//////////////////////////////////////////////////////////////////////
+int
+IRC::pacingTimeout(void) const
+{
+  bool waiting = false;
+  for (int i = PRIORITY_ENFORCE; i < PRIORITY_COUNT; ++i)
+  {
+    if (!this->sendQueue_[i].empty())
+    {
+      waiting = true;
+    }
+  }
+
+  if (!waiting || !this->isConnected())
+  {
+    return -1;
+  }
+  else if (IRC::sendRate_ <= 0)
+  {
+    return 0;
+  }
+
+  const double ready = this->lastRefill_ +
+    ((1 - this->sendTokens_) / IRC::sendRate_);
+  const double remaining = ready - timeNow();
+
+  return (remaining > 0) ? static_cast<int>(remaining * 1000) + 1 : 0;
+}
+
+
+void
+IRC::reset(void)
+{
+  this->sock_.reset();
+
+  // Whatever is still queued was meant for the old connection
+  for (int i = PRIORITY_ENFORCE; i < PRIORITY_COUNT; ++i)
+  {
+    while (!this->sendQueue_[i].empty())
+    {
+      this->dropLine(static_cast<IRC::Priority>(i));
+    }
+  }
+  this->sendQueueExceeded_ = false;
+}
+
+
+void
+IRC::quit(const std::string & message)
+{
+#ifdef IRC_DEBUG
+  std::cout << "Disconnecting from server." << std::endl;
+#endif
+
+  this->write("QUIT :" + message + "\n");
+  Log::Write("Disconnecting from server: " + message);
+  this->reset();
+
+  this->amIAnOper = 0;
+}
+
+
+// Handlers for numeric replies, indexed directly by the numeric.  Any
+// numeric without a handler is ignored.
+IRC::MessageHandler IRC::numericHandlers_[IRC::NUMERIC_COUNT];
+
+// Handlers for commands, in the slot picked by IRC::commandSlot().  The
+// hash is perfect for the commands handled here, which initDispatch()
+// checks; anything else either lands in an empty slot or fails the
+// name comparison.
+IRC::CommandHandler IRC::commandHandlers_[IRC::COMMAND_SLOTS];
+
+
+// commandSlot(name)
+//
+// Hashes a command name from its first two characters and its length.
+//
+inline unsigned int
+IRC::commandSlot(const IRCMessage::Token & name)
+{
+  return (static_cast<unsigned char>(name[0]) +
+    (static_cast<unsigned char>(name[1]) << 1) + name.length()) &
+    (IRC::COMMAND_SLOTS - 1);
+}
+
+
+void
+IRC::addNumeric(const int numeric, const IRC::MessageHandler handler)
+{
+  IRC::numericHandlers_[numeric] = handler;
+}
+
+
+void
+IRC::addCommand(const char *name, const IRC::MessageHandler handler)
+{
+  const IRCMessage::Token token(name, strlen(name));
+  IRC::CommandHandler & slot = IRC::commandHandlers_[IRC::commandSlot(token)];
+
+  if (0 != slot.name)
+  {
+    std::cerr << "IRC::addCommand(): " << name << " collides with " <<
+      slot.name << std::endl;
+    abort();
+  }
+
+  slot.name = name;
+  slot.handler = handler;
+}
+
+
+void
+IRC::initDispatch(void)
+{
+  IRC::addNumeric(1, &IRC::rplWelcome);
+  IRC::addNumeric(5, &IRC::rplISupport);
+  IRC::addNumeric(204, &IRC::rplTrace);		// RPL_TRACEOPERATOR
+  IRC::addNumeric(205, &IRC::rplTrace);		// RPL_TRACEUSER
+  IRC::addNumeric(209, &IRC::rplTraceEnd);	// RPL_TRACECLASS
+  IRC::addNumeric(262, &IRC::rplTraceEnd);	// RPL_TRACEEND
+  IRC::addNumeric(216, &IRC::rplStatsKLine);
+  IRC::addNumeric(219, &IRC::rplEndOfStats);
+  IRC::addNumeric(225, &IRC::rplStatsDLine);
+  IRC::addNumeric(303, &IRC::rplIson);
+  IRC::addNumeric(311, &IRC::rplWhoisUser);
+  IRC::addNumeric(381, &IRC::rplYoureOper);
+  IRC::addNumeric(433, &IRC::errNicknameInUse);
+  IRC::addNumeric(464, &IRC::errPasswdMismatch);
+  IRC::addNumeric(473, &IRC::errInviteOnlyChan);
+  IRC::addNumeric(491, &IRC::errNoOperHost);
+  IRC::addNumeric(709, &IRC::rplETrace);
+
+  IRC::addCommand("PING", &IRC::msgPing);
+  IRC::addCommand("NICK", &IRC::msgNick);
+  IRC::addCommand("JOIN", &IRC::msgJoin);
+  IRC::addCommand("PART", &IRC::msgPart);
+  IRC::addCommand("KICK", &IRC::msgKick);
+  IRC::addCommand("INVITE", &IRC::msgInvite);
+  IRC::addCommand("NOTICE", &IRC::msgNotice);
+  IRC::addCommand("PRIVMSG", &IRC::msgPrivmsg);
+  IRC::addCommand("WALLOPS", &IRC::msgWallops);
+  IRC::addCommand("ERROR", &IRC::msgError);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// IRC::findHandler(message)
+//
+// Description:
+//  Looks up the handler for a message: numeric replies are looked up
+//  directly by number, and commands by a perfect hash of their names.
+//
+// Parameters:
+//  message - The parsed message.
+//
+// Return Value:
+//  The function returns the handler, or 0 if the message is ignored.
+//////////////////////////////////////////////////////////////////////
+IRC::MessageHandler
+IRC::findHandler(const IRCMessage & message)
+{
+  const int numeric = message.numeric();
+
+  if (numeric >= 0)
+  {
+    return IRC::numericHandlers_[numeric];
+  }
+
+  const IRCMessage::Token & command = message.command();
+  const IRC::CommandHandler & slot =
+    IRC::commandHandlers_[IRC::commandSlot(command)];
+
+  if ((0 != slot.name) && (command == slot.name))
+  {
+    return slot.handler;
+  }
+
+  return 0;
+}
+
+
+bool
+IRC::onRead(const char *text, const int size)
+{
+  if (0 == size)
+    return true;
+
+  IRC::Context context(this);
+
+  Stats::count(Stats::LINES);
+
+  if (Capture::active())
+  {
+    Capture::write(text, size);
+  }
+
+#ifdef IRC_DEBUG
+  std::cout << "IRC >> ";
+  std::cout.write(text, size);
+  std::cout << std::endl;
+#endif
+
+  IRCMessage message;
+
+  if (message.parse(text, size, serverName))
+  {
+    const IRC::MessageHandler handler = IRC::findHandler(message);
+
+    if (0 != handler)
+    {
+      (this->*handler)(message);
+    }
+  }
+
+  return true;
+}
+
+
+void
+IRC::rplWelcome(const IRCMessage & params)
+{
+  serverName = params.nick().str();
+  // Oper up
+  this->write("OPER " + config.operName() + " " + config.operPassword() +
+      "\n");
+  this->klines.Clear();
+  this->dlines.Clear();
+  this->gettingDlines = false;
+  this->gettingKlines = false;
+  this->gettingTempDlines = false;
+  this->gettingTempKlines = false;
+  this->gettingTrace = false;
+  {
+    std::string channels(this->entry_.channels);
+    if (!channels.empty())
+    {
+      this->write("JOIN " + channels + "\n");
+    }
+  }
+  initFloodTables();
+}
+
+
+void
+IRC::rplISupport(const IRCMessage & params)
+{
+  for (IRCMessage::size_type idx = 3; idx < params.size(); ++idx)
+  {
+    if (params[idx] == "ETRACE")
+    {
+      this->supportETrace = true;
+    }
+    else if (params[idx] == "KNOCK")
+    {
+      this->supportKnock = true;
+    }
+    else if (params[idx].startsWith("CASEMAPPING="))
+    {
+      std::string map = params[idx].substr(12).str();
+
+      if (Same(map, "ascii"))
+      {
+        this->caseMapping = CASEMAP_ASCII;
+      }
+      else if (Same(map, "strict-rfc1459"))
+      {
+        this->caseMapping = CASEMAP_STRICT_RFC1459;
+      }
+      else
+      {
+        this->caseMapping = CASEMAP_RFC1459;
+      }
+    }
+  }
+}
+
+
+void
+IRC::rplTrace(const IRCMessage & params)
+{
+  if (this->gettingTrace && (params.size() > 6))
+  {
+    if ((params[6][0] == '[') && (params.size() > 7))
+    {
+      // [hybrid7-rc6] IRC >> :plasma.toast.pc 204 OOMon Oper opers OOMon [toast@Plasma.Toast.PC] (192.168.1.1) 0 0
+      onTraceUser(params[3].str(), params[4].str(), params[5].str(),
+        params[6].str(), params[7].str());
+    }
+    else
+    {
+      // [hybrid6] IRC >> :plasma.toast.pc 205 OOMon User 1 Toast[toast@Plasma.Toast.PC] (192.168.1.1) 000000005 000000005
+      onTraceUser(params[3].str(), params[4].str(), params[5].str(),
+        params[6].str());
+    }
+  }
+}
+
+
+void
+IRC::rplTraceEnd(const IRCMessage &)
+{
+  if (this->gettingTrace)
+  {
+    this->gettingTrace = false;
+    users().resetUserCountDelta();
+    ::SendAll("*** TRACE complete.", UserFlags::OPER);
+  }
+}
+
+
+void
+IRC::rplStatsKLine(const IRCMessage & params)
+{
+  // IRC >> :plasma.engr.arizona.edu 216 OOMon K *.monkeys.org * * foo llalalala (1998/03/03 11.18)
+  // IRC >> :plasma.engr.arizona.edu 216 OOMon K *bork.com * *hork moo la la la (1998/03/03 11.18)
+  if ((params.size() > 6) &&
+          (((params[3] == "K") && IRC::trackPermKlines_) ||
+           ((params[3] == "k") && IRC::trackTempKlines_)))
+  {
+    std::string reason = (params.size() > 7) ? params[7].str() : "";
+    for (IRCMessage::size_type pos = 8; pos < params.size(); pos++)
+    {
+      reason += " " + params[pos].str();
+    }
+    this->klines.Add(params[6].str() + "@" + params[4].str(), reason,
+      params[3] == "k");
+  }
+}
+
+
+void
+IRC::rplEndOfStats(const IRCMessage & params)
+{
+  if (params.size() >= 3)
+  {
+    if (params[3] == "K")
+    {
+      this->gettingKlines = false;
+    }
+    else if (params[3] == "D")
+    {
+      this->gettingDlines = false;
+    }
+    else if (params[3] == "k")
+    {
+      this->gettingTempKlines = false;
+    }
+    else if (params[3] == "d")
+    {
+      this->gettingTempDlines = false;
+    }
+  }
+}
+
+
+void
+IRC::rplStatsDLine(const IRCMessage & params)
+{
+  // IRC >> :plasma.toast.pc 225 ToastFOO D 1.2.3.4 :foo (2003/1/9 17.27)
+  if ((params.size() > 4) &&
+          (((params[3] == "D") && IRC::trackPermDlines_) ||
+           ((params[3] == "d") && IRC::trackTempDlines_)))
+  {
+    std::string reason = (params.size() > 5) ? params[5].str() : "";
+    for (IRCMessage::size_type pos = 6; pos < params.size(); pos++)
+    {
+      reason += " " + params[pos].str();
+    }
+    this->dlines.Add(params[4].str(), reason, params[3] == "d");
+  }
+}
+
+
+void
+IRC::rplIson(const IRCMessage & params)
+{
+  if (params.size() >= 4)
+  {
+    services.onIson(params[3].str());
+  }
+}
+
+
+void
+IRC::rplWhoisUser(const IRCMessage & params)
+{
+  if (params.size() > 5)
+  {
+    // :plasma.toast.pc 311 Toast Toast toast Plasma.Toast.PC * :i
+    std::string nick = params[3].str();
+
+    if (this->same(nick, Services::spamtrapNick()))
+    {
+      std::string userhost = params[4].str() + '@' + params[5].str();
+
+      if (this->same(userhost, Services::spamtrapUserhost()))
+      {
+        services.pollSpamtrap();
+      }
+    }
+  }
+}
+
+
+void
+IRC::rplYoureOper(const IRCMessage &)
+{
+  this->amIAnOper = true;
 #ifdef USE_FLAGS
-	  this->write("FLAGS +ALL\n");
+  this->write("FLAGS +ALL\n");
 #endif
-          this->umode(IRC::umode_);
-          this->trace();
-	  this->reloadDlines();
-	  this->reloadKlines();
-        }
-	break;
-      case 433:
-	if (params.size() > 3)
-	{
-	  std::string to = params[2];
-	  std::string usedNick = params[3];
+  this->umode(IRC::umode_);
+  this->trace();
+  this->reloadDlines();
+  this->reloadKlines();
+}
 
-	  if (to == "*")
-	  {
-	    if (usedNick.length() < 9)
-	    {
-	      this->myNick = usedNick + "_";
-	    }
-	    else
-	    {
-	      this->myNick = usedNick.substr(1) + usedNick.substr(0, 1);
-	    }
-	    this->write("NICK " + this->myNick + "\n");
-	  }
-	}
-	break;
-      case 464:        /* ERR_PASSWDMISMATCH */
-        Log::Write("Unable to OPER up due to incorrect password!");
-        break;
-      case 473:		/* ERR_INVITEONLYCHAN */
-	if (params.size() > 3)
-	{
-	  std::string channel = params[3];
 
-          // If the IRC server supports the KNOCK command and the invite-only
-	  // channel is listed in the bot's config file, issue a KNOCK.
-	  if (this->supportKnock && config.haveChannel(channel))
-	  {
-	    this->knock(channel);
-	  }
-	}
-	break;
-      case 491:        /* ERR_NOOPERHOST */
-        Log::Write("Unable to OPER up due to incorrect oper name or insufficient privileges from IRC server!");
-        break;
-      case 709:
-        if (this->gettingTrace && (params.size() > 9))
-        {
-          // :plasma.toast.pc 709 toast Oper opers toast toast Plasma.Toast.PC 192.168.1.1 :gecos information goes here
-          onETraceUser(params[3], params[4], params[5], params[6], params[7],
-	    params[8], params[9]);
-        }
-	break;
-      default:
-	// Just ignore all other numerics
-	break;
+void
+IRC::errNicknameInUse(const IRCMessage & params)
+{
+  if (params.size() > 3)
+  {
+    std::string to = params[2].str();
+    std::string usedNick = params[3].str();
+
+    if (to == "*")
+    {
+      if (usedNick.length() < 9)
+      {
+        this->myNick = usedNick + "_";
+      }
+      else
+      {
+        this->myNick = usedNick.substr(1) + usedNick.substr(0, 1);
+      }
+      this->write("NICK " + this->myNick + "\n");
     }
   }
-  catch (boost::bad_lexical_cast)
+}
+
+
+void
+IRC::errPasswdMismatch(const IRCMessage &)
+{
+  Log::Write("Unable to OPER up due to incorrect password!");
+}
+
+
+void
+IRC::errInviteOnlyChan(const IRCMessage & params)
+{
+  if (params.size() > 3)
   {
-    switch (IRC::getCommand(command))
+    std::string channel = params[3].str();
+
+    // If the IRC server supports the KNOCK command and the invite-only
+    // channel is listed in the bot's config file, issue a KNOCK.
+    if (this->supportKnock && this->haveChannel(channel))
     {
-      case IRC_PING:
-	if (params.size() > 2)
-	{
-          this->write("PONG " + params[2] + "\n");
-	}
-	else
-	{
-          this->write("PONG\n");
-	}
-        break;
-      case IRC_NICK:
-	if (params.size() > 2)
-	{
-	  if (this->same(from, this->myNick))
-	  {
-	    this->myNick = params[2];
-	  }
-	}
-	break;
-      case IRC_JOIN:
-	if ((params.size() >= 3) && this->same(from, this->myNick))
-	{
-	  Log::Write("Joined channel " + params[2]);
-	}
-	break;
-      case IRC_PART:
-	if ((params.size() >= 3) && this->same(from, this->myNick))
-	{
-	  Log::Write("Parted channel " + params[2]);
-	}
-	break;
-      case IRC_KICK:
-	if ((params.size() >= 5) && this->same(params[3], this->myNick))
-	{
-	  Log::Write("Kicked from channel " + params[2] + " by " + from + 
-	    " (" + params[4] + ')');
-	}
-	break;
-      case IRC_INVITE:
-	if (params.size() >= 3)
-	{
-	  std::string to = params[2];
-	  std::string channel = params[3];
+      this->knock(channel);
+    }
+  }
+}
+
+
+void
+IRC::errNoOperHost(const IRCMessage &)
+{
+  Log::Write("Unable to OPER up due to incorrect oper name or insufficient privileges from IRC server!");
+}
+
+
+void
+IRC::rplETrace(const IRCMessage & params)
+{
+  if (this->gettingTrace && (params.size() > 9))
+  {
+    // :plasma.toast.pc 709 toast Oper opers toast toast Plasma.Toast.PC 192.168.1.1 :gecos information goes here
+    onETraceUser(params[3].str(), params[4].str(), params[5].str(),
+      params[6].str(), params[7].str(), params[8].str(), params[9].str());
+  }
+}
+
+
+void
+IRC::msgPing(const IRCMessage & params)
+{
+  if (params.size() > 2)
+  {
+    this->write("PONG " + params[2].str() + "\n");
+  }
+  else
+  {
+    this->write("PONG\n");
+  }
+}
+
+
+void
+IRC::msgNick(const IRCMessage & params)
+{
+  if (params.size() > 2)
+  {
+    if (this->same(params.nick(), this->myNick))
+    {
+      this->myNick = params[2].str();
+    }
+  }
+}
+
+
+void
+IRC::msgJoin(const IRCMessage & params)
+{
+  if ((params.size() >= 3) && this->same(params.nick(), this->myNick))
+  {
+    Log::Write("Joined channel " + params[2].str());
+  }
+}
+
+
+void
+IRC::msgPart(const IRCMessage & params)
+{
+  if ((params.size() >= 3) && this->same(params.nick(), this->myNick))
+  {
+    Log::Write("Parted channel " + params[2].str());
+  }
+}
+
+
+void
+IRC::msgKick(const IRCMessage & params)
+{
+  if ((params.size() >= 5) && this->same(params[3], this->myNick))
+  {
+    Log::Write("Kicked from channel " + params[2].str() + " by " +
+      params.nick().str() + " (" + params[4].str() + ')');
+  }
+}
+
+
+void
+IRC::msgInvite(const IRCMessage & params)
+{
+  if (params.size() > 3)
+  {
+    std::string to = params[2].str();
+    std::string channel = params[3].str();
+
+    // Make sure the INVITE was directed at the bot
+    if (this->same(to, this->myNick))
+    {
+      // Is the channel listed in the config file?
+      if (this->haveChannel(channel))
+      {
+        // Yes, so accept the invite by joining the channel!
+        this->join(channel);
+      }
+
+      Log::Write("Invited to channel " + channel + " by " +
+        params.nick().str() + '.');
+    }
+  }
+}
+
+
+void
+IRC::msgNotice(const IRCMessage & params)
+{
+  if (params.size() > 3)
+  {
+    this->onNotice(params.nick().str(), params.userhost().str(),
+      params[2].str(), params[3].str());
+  }
+}
 
-          // Make sure the INVITE was directed at the bot
-          if (this->same(to, this->myNick))
-	  {
-	    // Is the channel listed in the config file?
-	    if (config.haveChannel(channel))
-	    {
-	      // Yes, so accept the invite by joining the channel!
-	      this->join(channel);
-	    }
 
-	    Log::Write("Invited to channel " + params[3] + " by " + from + '.');
-	  }
-	}
-	break;
-      case IRC_NOTICE:
-	if (params.size() > 3)
-        {
-	  this->onNotice(from, userhost, params[2], params[3]);
-        }
-        break;
-      case IRC_PRIVMSG:
-        if (params.size() > 3)
-	{
-          this->onPrivmsg(from, userhost, params[2], params[3]);
-        }
-        break;
-      case IRC_WALLOPS:
-	if (params.size() > 2)
-        {
-	  std::string text = params[2];
-	  std::string wallopsType = "WALLOPS";
-
-	  if ((text.length() > 11) && (text.substr(0, 11) == "OPERWALL - "))
-	  {
-	    wallopsType = "OPERWALL";
-	    text = text.substr(11, std::string::npos);
-	  }
-	  else if ((text.length() > 9) && (text.substr(0, 9) == "LOCOPS - "))
-	  {
-	    wallopsType = "LOCOPS";
-	    text = text.substr(9, std::string::npos);
-	  }
-	  else if ((text.length() > 10) && (text.substr(0, 10) == "WALLOPS - "))
-	  {
-	    text = text.substr(10, std::string::npos);
-	  }
+void
+IRC::msgPrivmsg(const IRCMessage & params)
+{
+  if (params.size() > 3)
+  {
+    this->onPrivmsg(params.nick().str(), params.userhost().str(),
+      params[2].str(), params[3].str());
+  }
+}
 
-          clients.sendAll("[" + from + ":" + wallopsType + "] " + text,
-	    UserFlags::WALLOPS, WATCH_WALLOPS);
-        }
-        break;
-      case IRC_ERROR:
-	if (params.size() > 2)
-	{
-	  Log::Write(params[2]);
-	}
-	break;
-      default:
-	// Ignore all other IRC commands
-	break;
+
+void
+IRC::msgWallops(const IRCMessage & params)
+{
+  if (params.size() > 2)
+  {
+    const std::string from = params.nick().str();
+    std::string text = params[2].str();
+    std::string wallopsType = "WALLOPS";
+
+    if ((text.length() > 11) && (text.substr(0, 11) == "OPERWALL - "))
+    {
+      wallopsType = "OPERWALL";
+      text = text.substr(11, std::string::npos);
+    }
+    else if ((text.length() > 9) && (text.substr(0, 9) == "LOCOPS - "))
+    {
+      wallopsType = "LOCOPS";
+      text = text.substr(9, std::string::npos);
+    }
+    else if ((text.length() > 10) && (text.substr(0, 10) == "WALLOPS - "))
+    {
+      text = text.substr(10, std::string::npos);
     }
+
+    clients.sendAll("[" + from + ":" + wallopsType + "] " + text,
+      UserFlags::WALLOPS, WATCH_WALLOPS);
   }
+}
 
-  return true;
+
+void
+IRC::msgError(const IRCMessage & params)
+{
+  if (params.size() > 2)
+  {
+    Log::Write(params[2].str());
+  }
 }
 
+
 void
 IRC::onCtcp(const std::string & from, const std::string & userhost,
   const std::string & to, std::string text)
 {
   std::string command = this->upCase(FirstWord(text));
 
-  BotSock::Address ip = users.getIP(from, userhost);
+  BotSock::Address ip = users().getIP(from, userhost);
 
   if ((0 == command.compare("DCC")) && (this->same(to, this->myNick)))
   {
@@ -695,7 +1455,7 @@ IRC::onCtcpReply(const std::string & from, const std::string & userhost,
       notice += text;
       ::SendAll(notice, UserFlags::OPER, WATCH_CTCPVERSIONS);
 
-      users.onVersionReply(from, userhost, text);
+      users().onVersionReply(from, userhost, text);
     }
   }
 }
@@ -740,7 +1500,7 @@ IRC::onPrivmsg(const std::string & from, const std::string & userhost,
       {
 	this->locops(msg);
       }
-      users.onPrivmsg(from, userhost, text);
+      users().onPrivmsg(from, userhost, text);
     }
   }
 }
@@ -806,7 +1566,7 @@ IRC::onNotice(const std::string & from, const std::string & userhost,
 
       Log::Write(notice);
       ::SendAll("(IRC) " + notice, UserFlags::OPER, WATCH_NOTICES);
-      users.onNotice(from, userhost, text);
+      users().onNotice(from, userhost, text);
     }
   }
 }
@@ -815,7 +1575,7 @@ IRC::onNotice(const std::string & from, const std::string & userhost,
 void
 IRC::notice(const std::string & to, const std::string & text)
 {
-  this->write("NOTICE " + to + " :" + text + "\n");
+  this->write("NOTICE " + to + " :" + text + "\n", IRC::PRIORITY_MESSAGE);
 }
 
 
@@ -832,28 +1592,30 @@ IRC::notice(const std::string & to, const StrList & text)
 void
 IRC::msg(const std::string & to, const std::string & text)
 {
-  this->write("PRIVMSG " + to + " :" + text + "\n");
+  this->write("PRIVMSG " + to + " :" + text + "\n", IRC::PRIORITY_MESSAGE);
 }
 
 
 void
-IRC::ctcp(const std::string & to, const std::string & text)
+IRC::ctcp(const std::string & to, const std::string & text,
+  const IRC::Priority priority, const IRC::OnDropHandler & onDrop)
 {
-  this->write("PRIVMSG " + to + " :\001" + text + "\001\n");
+  this->write("PRIVMSG " + to + " :\001" + text + "\001\n", priority, onDrop);
 }
 
 
 void
 IRC::ctcpReply(const std::string & to, const std::string & text)
 {
-  this->write("NOTICE " + to + " :\001" + text + "\001\n");
+  this->write("NOTICE " + to + " :\001" + text + "\001\n",
+    IRC::PRIORITY_MESSAGE);
 }
 
 
 void
 IRC::isOn(const std::string & text)
 {
-  this->write("ISON " + text + "\n");
+  this->write("ISON " + text + "\n", IRC::PRIORITY_QUERY);
 }
 
 
@@ -880,11 +1642,11 @@ IRC::kline(const std::string & from, const unsigned int minutes,
 
   if (IRC::operNickInReason_)
   {
-    this->write(line + " [" + from + "]\n");
+    this->write(line + " [" + from + "]\n", IRC::PRIORITY_ENFORCE);
   }
   else
   {
-    this->write(line + "\n");
+    this->write(line + "\n", IRC::PRIORITY_ENFORCE);
   }
   Log::Write(line + " [" + from + "]");
 }
@@ -916,11 +1678,11 @@ IRC::remoteKline(const std::string & from, const std::string & to,
 
   if (IRC::operNickInReason_)
   {
-    this->write(line + " [" + from + "]\n");
+    this->write(line + " [" + from + "]\n", IRC::PRIORITY_ENFORCE);
   }
   else
   {
-    this->write(line + "\n");
+    this->write(line + "\n", IRC::PRIORITY_ENFORCE);
   }
   Log::Write(line + " [" + from + "]");
 }
@@ -929,7 +1691,7 @@ IRC::remoteKline(const std::string & from, const std::string & to,
 void
 IRC::unkline(const std::string & from, const std::string & target)
 {
-  this->write("UNKLINE " + target + "\n");
+  this->write("UNKLINE " + target + "\n", IRC::PRIORITY_ENFORCE);
   Log::Write("UNKLINE " + target + " [" + from + "]");
 }
 
@@ -952,11 +1714,11 @@ IRC::dline(const std::string & from, const unsigned int minutes,
 
   if (IRC::operNickInReason_)
   {
-    this->write(line + " [" + from + "]\n");
+    this->write(line + " [" + from + "]\n", IRC::PRIORITY_ENFORCE);
   }
   else
   {
-    this->write(line + "\n");
+    this->write(line + "\n", IRC::PRIORITY_ENFORCE);
   }
   Log::Write(line + " [" + from + "]");
 }
@@ -965,7 +1727,7 @@ IRC::dline(const std::string & from, const unsigned int minutes,
 void
 IRC::undline(const std::string & from, const std::string & target)
 {
-  this->write("UNDLINE " + target + "\n");
+  this->write("UNDLINE " + target + "\n", IRC::PRIORITY_ENFORCE);
   Log::Write("UNDLINE " + target + " [" + from + "]");
 }
 
@@ -978,11 +1740,12 @@ IRC::kill(const std::string & from, const std::string & target,
 
   if (IRC::operNickInReason_)
   {
-    this->write(line + " :(" + from + ") " + reason + "\n");
+    this->write(line + " :(" + from + ") " + reason + "\n",
+      IRC::PRIORITY_ENFORCE);
   }
   else
   {
-    this->write(line + " :" + reason + "\n");
+    this->write(line + " :" + reason + "\n", IRC::PRIORITY_ENFORCE);
   }
   Log::Write(line + " ((" + from + ") " + reason + ")");
 }
@@ -993,20 +1756,20 @@ IRC::trace(const std::string & target)
 {
   if (target.empty())
   {
-    users.clear();
+    users().clear();
     this->gettingTrace = true;
     if (this->supportETrace)
     {
-      this->write("ETRACE\n");
+      this->write("ETRACE\n", IRC::PRIORITY_QUERY);
     }
     else
     {
-      this->write("TRACE\n");
+      this->write("TRACE\n", IRC::PRIORITY_QUERY);
     }
   }
   else
   {
-    this->write("TRACE " + target + '\n');
+    this->write("TRACE " + target + '\n', IRC::PRIORITY_QUERY);
   }
 }
 
@@ -1016,7 +1779,7 @@ IRC::statsL(const std::string & nick)
 {
   if (!nick.empty())
   {
-    this->write("STATS L " + nick + '\n');
+    this->write("STATS L " + nick + '\n', IRC::PRIORITY_QUERY);
   }
 }
 
@@ -1036,12 +1799,12 @@ IRC::reloadKlines(void)
   if (IRC::trackPermKlines_)
   {
     this->gettingKlines = true;
-    this->write("STATS K\n");
+    this->write("STATS K\n", IRC::PRIORITY_QUERY);
   }
   if (IRC::trackTempKlines_)
   {
     this->gettingTempKlines = true;
-    this->write("STATS k\n");
+    this->write("STATS k\n", IRC::PRIORITY_QUERY);
   }
 }
 
@@ -1061,12 +1824,12 @@ IRC::reloadDlines(void)
   if (IRC::trackPermDlines_)
   {
     this->gettingDlines = true;
-    this->write("STATS D\n");
+    this->write("STATS D\n", IRC::PRIORITY_QUERY);
   }
   if (IRC::trackTempDlines_)
   {
     this->gettingTempDlines = true;
-    this->write("STATS d\n");
+    this->write("STATS d\n", IRC::PRIORITY_QUERY);
   }
 }
 
@@ -1118,7 +1881,7 @@ IRC::findAndRemoveD(const std::string & from, const Pattern *userhost,
 void
 IRC::op(const std::string & channel, const std::string & nick)
 {
-  this->write("MODE " + channel + " +o " + nick + "\n");
+  this->write("MODE " + channel + " +o " + nick + "\n", IRC::PRIORITY_ENFORCE);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -1136,7 +1899,7 @@ IRC::op(const std::string & channel, const std::string & nick)
 void
 IRC::join(const std::string & channel)
 {
-  this->write("JOIN " + channel + "\n");
+  this->write("JOIN " + channel + "\n", IRC::PRIORITY_QUERY);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -1155,7 +1918,7 @@ IRC::join(const std::string & channel)
 void
 IRC::join(const std::string & channel, const std::string & key)
 {
-  this->write("JOIN " + channel + " " + key + "\n");
+  this->write("JOIN " + channel + " " + key + "\n", IRC::PRIORITY_QUERY);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -1173,7 +1936,7 @@ IRC::join(const std::string & channel, const std::string & key)
 void
 IRC::part(const std::string & channel)
 {
-  this->write("PART " + channel + "\n");
+  this->write("PART " + channel + "\n", IRC::PRIORITY_QUERY);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -1191,7 +1954,7 @@ IRC::part(const std::string & channel)
 void
 IRC::knock(const std::string & channel)
 {
-  this->write("KNOCK " + channel + "\n");
+  this->write("KNOCK " + channel + "\n", IRC::PRIORITY_QUERY);
 
   std::string msg("*** Sent knock to channel ");
   msg += channel;
@@ -1227,6 +1990,48 @@ IRC::status(BotClient * client) const
   {
     client->send("D: lines: " + boost::lexical_cast<std::string>(dlineCount));
   }
+
+  static const char * const names[PRIORITY_COUNT] = { "control", "enforce",
+    "query", "message", "bulk" };
+
+  client->send("Send pacing: " +
+    boost::lexical_cast<std::string>(IRC::sendRate_) + " lines/sec, burst " +
+    boost::lexical_cast<std::string>(IRC::sendBurst_));
+  for (int i = 0; i < PRIORITY_COUNT; ++i)
+  {
+    const QueueStats & stats = this->sendStats_[i];
+
+    if ((stats.sent > 0) || (stats.dropped > 0) ||
+      !this->sendQueue_[i].empty())
+    {
+      const double avgWait = (stats.sent > 0) ?
+        (stats.totalWait / stats.sent) : 0;
+
+      client->send("  " + padLeft(names[i], 8) + ": " +
+        boost::lexical_cast<std::string>(this->sendQueue_[i].size()) +
+        " queued, " + boost::lexical_cast<std::string>(stats.sent) +
+        " sent, " + boost::lexical_cast<std::string>(stats.dropped) +
+        " dropped, wait avg " +
+        boost::lexical_cast<std::string>(static_cast<int>(avgWait * 1000)) +
+        "ms max " +
+        boost::lexical_cast<std::string>(static_cast<int>(stats.maxWait *
+        1000)) + "ms");
+    }
+  }
+}
+
+
+unsigned long
+IRC::queued(void) const
+{
+  unsigned long result = 0;
+
+  for (int i = 0; i < PRIORITY_COUNT; ++i)
+  {
+    result += this->sendQueue_[i].size();
+  }
+
+  return result;
 }
 
 
@@ -1250,7 +2055,7 @@ IRC::subSpamTrap(const bool sub)
 void
 IRC::whois(const std::string & nick)
 {
-  this->write("WHOIS " + nick + '\n');
+  this->write("WHOIS " + nick + '\n', IRC::PRIORITY_QUERY);
 }
 
 
@@ -1264,118 +2069,84 @@ IRC::umode(const std::string & mode)
 void
 IRC::locops(const std::string & text)
 {
-  this->write("LOCOPS :" + text + '\n');
+  this->write("LOCOPS :" + text + '\n', IRC::PRIORITY_MESSAGE);
+}
+
+
+void
+IRC::checkVersionTimeout(void)
+{
+  IRC::Context context(this);
+
+  this->users_.checkVersionTimeout();
 }
 
 
 void
 IRC::checkUserDelta(void)
 {
+  IRC::Context context(this);
+
   std::time_t now = std::time(NULL);
   std::time_t lapse = now - this->lastUserDeltaCheck;
+  int delta = users().getUserCountDelta();
 
-  if (lapse >= 10)
+  if ((this->lastUserDeltaCheck > 0) && (delta > IRC::userCountDeltaMax_))
   {
-    int delta = users.getUserCountDelta();
-
-    if ((this->lastUserDeltaCheck > 0) && (delta > IRC::userCountDeltaMax_))
-    {
-      std::string msg("*** User count increased by ");
-      msg += boost::lexical_cast<std::string>(delta);
-      msg += " in ";
-      msg += boost::lexical_cast<std::string>(lapse);
-      msg += " seconds.";
+    std::string msg("*** User count increased by ");
+    msg += boost::lexical_cast<std::string>(delta);
+    msg += " in ";
+    msg += boost::lexical_cast<std::string>(lapse);
+    msg += " seconds.";
 
-      clients.sendAll(msg, UserFlags::OPER);
-      Log::Write(msg);
-    }
-    this->lastUserDeltaCheck = now;
-  }
-}
-
-
-IRCCommand
-IRC::getCommand(const std::string & text)
-{
-  if (text == "PING")
-    return IRC_PING;
-  else if (text == "NICK")
-    return IRC_NICK;
-  else if (text == "JOIN")
-    return IRC_JOIN;
-  else if (text == "PART")
-    return IRC_PART;
-  else if (text == "KICK")
-    return IRC_KICK;
-  else if (text == "INVITE")
-    return IRC_INVITE;
-  else if (text == "NOTICE")
-    return IRC_NOTICE;
-  else if (text == "PRIVMSG")
-    return IRC_PRIVMSG;
-  else if (text == "WALLOPS")
-    return IRC_WALLOPS;
-  else if (text == "ERROR")
-    return IRC_ERROR;
-  else
-    return IRC_UNKNOWN;
+    clients.sendAll(msg, UserFlags::OPER);
+    Log::Write(msg);
+  }
+  this->lastUserDeltaCheck = now;
 }
 
 
-//////////////////////////////////////////////////////////////////////
-// IRC::upCase(c)
-//
-// Description:
-//  Converts a character to upper-case.
-//
-// Parameters:
-//  c - An upper or lower-case character.
-//
-// Return Value:
-//  The function returns the upper-case representation of the
-//  character.
-//////////////////////////////////////////////////////////////////////
-char
-IRC::upCase(const char c) const
+
+
+// The CASEMAPPING variants differ only in how far past 'z' they fold:
+// rfc1459 maps {|}~ to [\]^, strict-rfc1459 stops short of ~, and ascii
+// folds letters only.  This is the last lower-case character of each,
+// in CaseMapping order.
+static const unsigned char lastLower[3] = { '~', '}', 'z' };
+
+// The tables are built from constant expressions so they are ready
+// before any constructor runs.
+#define UP(c, last) static_cast<char>(((c) >= 'a') && ((c) <= (last)) ? \
+  (c) - 32 : (c))
+#define DOWN(c, last) static_cast<char>(((c) >= 'A') && \
+  ((c) <= (last) - 32) ? (c) + 32 : (c))
+#define ROW(f, b, last) \
+  f((b) + 0, last), f((b) + 1, last), f((b) + 2, last), f((b) + 3, last), \
+  f((b) + 4, last), f((b) + 5, last), f((b) + 6, last), f((b) + 7, last), \
+  f((b) + 8, last), f((b) + 9, last), f((b) + 10, last), f((b) + 11, last), \
+  f((b) + 12, last), f((b) + 13, last), f((b) + 14, last), f((b) + 15, last)
+#define TABLE(f, last) { \
+  ROW(f, 0x00, last), ROW(f, 0x10, last), ROW(f, 0x20, last), \
+  ROW(f, 0x30, last), ROW(f, 0x40, last), ROW(f, 0x50, last), \
+  ROW(f, 0x60, last), ROW(f, 0x70, last), ROW(f, 0x80, last), \
+  ROW(f, 0x90, last), ROW(f, 0xa0, last), ROW(f, 0xb0, last), \
+  ROW(f, 0xc0, last), ROW(f, 0xd0, last), ROW(f, 0xe0, last), \
+  ROW(f, 0xf0, last) }
+
+const char IRC::upCaseTable_[3][256] =
 {
-  char result;
+  TABLE(UP, '~'), TABLE(UP, '}'), TABLE(UP, 'z')
+};
 
-  if (this->caseMapping == CASEMAP_ASCII)
-  {
-    if ((c >= 97) && (c <= 122))
-    {
-      result = static_cast<char>((c - 32));
-    }
-    else
-    {
-      result = c;
-    }
-  }
-  else if (this->caseMapping == CASEMAP_STRICT_RFC1459)
-  {
-    if ((c >= 97) && (c <= 125))
-    {
-      result = static_cast<char>((c - 32));
-    }
-    else
-    {
-      result = c;
-    }
-  }
-  else /* this->caseMapping == CASEMAP_RFC1459 */
-  {
-    if ((c >= 97) && (c <= 126))
-    {
-      result = static_cast<char>((c - 32));
-    }
-    else
-    {
-      result = c;
-    }
-  }
+const char IRC::downCaseTable_[3][256] =
+{
+  TABLE(DOWN, '~'), TABLE(DOWN, '}'), TABLE(DOWN, 'z')
+};
 
-  return result;
-}
+#undef TABLE
+#undef ROW
+#undef DOWN
+#undef UP
 
 
 //////////////////////////////////////////////////////////////////////
@@ -1393,52 +2164,12 @@ IRC::upCase(const char c) const
 std::string
 IRC::upCase(const std::string & text) const
 {
-  std::string result;
+  const char * table = IRC::upCaseTable_[this->caseMapping];
+  std::string result(text);
 
-  if (this->caseMapping == CASEMAP_ASCII)
-  {
-    for (std::string::const_iterator pos = text.begin(); pos != text.end();
-      ++pos)
-    {
-      if ((*pos >= 97) && (*pos <= 122))
-      {
-        result += static_cast<char>((*pos - 32));
-      }
-      else
-      {
-        result += static_cast<char>(*pos);
-      }
-    }
-  }
-  else if (this->caseMapping == CASEMAP_STRICT_RFC1459)
-  {
-    for (std::string::const_iterator pos = text.begin(); pos != text.end();
-      ++pos)
-    {
-      if ((*pos >= 97) && (*pos <= 125))
-      {
-        result += static_cast<char>((*pos - 32));
-      }
-      else
-      {
-        result += static_cast<char>(*pos);
-      }
-    }
-  }
-  else /* this->caseMapping == CASEMAP_RFC1459 */
+  for (std::string::iterator pos = result.begin(); pos != result.end(); ++pos)
   {
-    for (std::string::const_iterator pos = text.begin(); pos != text.end();
-      ++pos)
-    {
-      if ((*pos >= 97) && (*pos <= 126))
-      {
-        result += static_cast<char>((*pos - 32));
-      }
-      else
-      {
-        result += static_cast<char>(*pos);
-      }
-    }
+    *pos = table[static_cast<unsigned char>(*pos)];
   }
 
   return result;
@@ -1446,150 +2177,172 @@ IRC::upCase(const std::string & text) const
 
 
 //////////////////////////////////////////////////////////////////////
-// IRC::downCase(c)
+// IRC::downCase(text)
 //
 // Description:
-//  Converts a character to lower-case.
+//  Converts a string to all lower-case characters.
 //
 // Parameters:
-//  c - An upper or lower-case character.
+//  text - A string containing upper and/or lower-case characters.
 //
 // Return Value:
-//  The function returns the lower-case representation of the
-//  character.
+//  The function returns the lower-case representation of the string.
 //////////////////////////////////////////////////////////////////////
-char
-IRC::downCase(const char c) const
+std::string
+IRC::downCase(const std::string & text) const
 {
-  char result;
+  const char * table = IRC::downCaseTable_[this->caseMapping];
+  std::string result(text);
 
-  if (this->caseMapping == CASEMAP_ASCII)
-  {
-    if ((c >= 65) && (c <= 90))
-    {
-      result = static_cast<char>((c + 32));
-    }
-    else
-    {
-      result = c;
-    }
-  }
-  else if (this->caseMapping == CASEMAP_STRICT_RFC1459)
+  for (std::string::iterator pos = result.begin(); pos != result.end(); ++pos)
   {
-    if ((c >= 65) && (c <= 93))
-    {
-      result = static_cast<char>((c + 32));
-    }
-    else
-    {
-      result = c;
-    }
-  }
-  else /* this->caseMapping == CASEMAP_RFC1459 */
-  {
-    if ((c >= 65) && (c <= 94))
-    {
-      result = static_cast<char>((c + 32));
-    }
-    else
-    {
-      result = c;
-    }
+    *pos = table[static_cast<unsigned char>(*pos)];
   }
 
   return result;
 }
 
 
+#ifdef __SSE2__
+// Upper-cases 16 characters at once.  Shifting the lower-case range down
+// to start at -128 lets a single signed compare find it.
+static inline __m128i
+upCaseBlock(const __m128i x, const __m128i bias, const __m128i limit)
+{
+  const __m128i lower = _mm_cmplt_epi8(_mm_add_epi8(x, bias), limit);
+  return _mm_andnot_si128(_mm_and_si128(lower, _mm_set1_epi8(0x20)), x);
+}
+#endif
+
+
 //////////////////////////////////////////////////////////////////////
-// IRC::downCase(text)
+// IRC::same(text1, length1, text2, length2)
 //
 // Description:
-//  Converts a string to all lower-case characters.
+//  Case-insensitively compares two strings without copying either of
+//  them.
 //
 // Parameters:
-//  text - A string containing upper and/or lower-case characters.
+//  text1   - The first string.
+//  length1 - The length of the first string.
+//  text2   - The second string.
+//  length2 - The length of the second string.
 //
 // Return Value:
-//  The function returns the lower-case representation of the string.
+//  The function returns true if both strings match.
 //////////////////////////////////////////////////////////////////////
-std::string
-IRC::downCase(const std::string & text) const
+bool
+IRC::same(const char *text1, const std::string::size_type length1,
+  const char *text2, const std::string::size_type length2) const
 {
-  std::string result;
+  const std::string::size_type length = length1;
 
-  if (this->caseMapping == CASEMAP_ASCII)
+  if (length != length2)
   {
-    for (std::string::const_iterator pos = text.begin(); pos != text.end();
-      ++pos)
-    {
-      if ((*pos >= 65) && (*pos <= 90))
-      {
-        result += static_cast<char>((*pos + 32));
-      }
-      else
-      {
-        result += static_cast<char>(*pos);
-      }
-    }
+    return false;
   }
-  else if (this->caseMapping == CASEMAP_STRICT_RFC1459)
+
+  const char * a = text1;
+  const char * b = text2;
+  std::string::size_type pos = 0;
+
+#ifdef __SSE2__
+  const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80 - 'a'));
+  const __m128i limit = _mm_set1_epi8(static_cast<char>(-128 +
+    (lastLower[this->caseMapping] - 'a' + 1)));
+
+  for (; pos + 16 <= length; pos += 16)
   {
-    for (std::string::const_iterator pos = text.begin(); pos != text.end();
-      ++pos)
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a +
+      pos));
+    const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b +
+      pos));
+
+    if (0xffff != _mm_movemask_epi8(_mm_cmpeq_epi8(
+      upCaseBlock(x, bias, limit), upCaseBlock(y, bias, limit))))
     {
-      if ((*pos >= 65) && (*pos <= 93))
-      {
-        result += static_cast<char>((*pos + 32));
-      }
-      else
-      {
-        result += static_cast<char>(*pos);
-      }
+      return false;
     }
   }
-  else /* this->caseMapping == CASEMAP_RFC1459 */
+#endif
+
+  const char * table = IRC::upCaseTable_[this->caseMapping];
+  for (; pos < length; ++pos)
   {
-    for (std::string::const_iterator pos = text.begin(); pos != text.end();
-      ++pos)
+    if (table[static_cast<unsigned char>(a[pos])] !=
+      table[static_cast<unsigned char>(b[pos])])
     {
-      if ((*pos >= 65) && (*pos <= 94))
-      {
-        result += static_cast<char>((*pos + 32));
-      }
-      else
-      {
-        result += static_cast<char>(*pos);
-      }
+      return false;
     }
   }
 
-  return result;
+  return true;
 }
 
 
 //////////////////////////////////////////////////////////////////////
-// IRC::same(text1, text2)
+// IRC::hash(text)
 //
 // Description:
-//  Case-insensitively compares two strings.
+//  Hashes a string case-insensitively without copying it.  Strings
+//  that IRC::same() considers equal always hash to the same value.
+//  Eight characters at a time are upper-cased with bitwise arithmetic
+//  before being mixed in.
 //
 // Parameters:
-//  text1  - The first string.
-//  text2  - The second string.
+//  text - The string to hash.
 //
 // Return Value:
-//  The function returns true if both strings match.
+//  The function returns the string's hash value.
 //////////////////////////////////////////////////////////////////////
-bool
-IRC::same(const std::string & text1, const std::string & text2) const
+unsigned int
+IRC::hash(const std::string & text) const
 {
-  return (0 == this->upCase(text1).compare(this->upCase(text2)));
+  const uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t highBits = ones * 0x80;
+  const uint64_t fromLower = ones * (0x80 - 'a');
+  const uint64_t pastLower = ones * (0x7f - lastLower[this->caseMapping]);
+  const uint64_t prime = 1099511628211ULL;
+
+  const std::string::size_type length = text.length();
+  const char * data = text.data();
+  uint64_t result = 14695981039346656037ULL;
+  std::string::size_type pos = 0;
+
+  for (; pos + 8 <= length; pos += 8)
+  {
+    uint64_t word;
+    memcpy(&word, data + pos, sizeof(word));
+
+    // Each byte's high bit ends up set if it is ASCII, at least 'a', and
+    // no further than the mapping's last lower-case character.  Adding
+    // to the low seven bits can never carry into the next byte.
+    const uint64_t low = word & ~highBits;
+    const uint64_t lower = (low + fromLower) & ~(low + pastLower) & ~word &
+      highBits;
+
+    result = (result ^ (word & ~(lower >> 2))) * prime;
+  }
+
+  const char * table = IRC::upCaseTable_[this->caseMapping];
+  for (; pos < length; ++pos)
+  {
+    result = (result ^ static_cast<unsigned char>(
+      table[static_cast<unsigned char>(data[pos])])) * prime;
+  }
+
+  // Whole-word multiplies leave the low bits weak, so finish with a
+  // full avalanche.
+  result ^= result >> 33;
+  result *= 0xff51afd7ed558ccdULL;
+  result ^= result >> 33;
+
+  return static_cast<unsigned int>(result);
 }
 
 
 IRC::Parser::Parser(const std::string & pattern, const ParserFunction func)
-  : func_(func)
+  : func_(func), calls_(0), matches_(0), totalTime_(0), maxTime_(0)
 {
   this->pattern_.reset(new ClusterPattern(pattern));
 }
@@ -1599,7 +2352,8 @@ IRC::Parser::Parser(const std::string & pattern, const ParserFunction func)
 // IRC::Parser::match(text)
 //
 // Description:
-//  Compares the text against the parser's pattern.
+//  Compares the text against the parser's pattern, and passes it to
+//  the parser's function if it matches.
 //
 // Parameters:
 //  text - The text to compare against the pattern.
@@ -1609,12 +2363,14 @@ IRC::Parser::Parser(const std::string & pattern, const ParserFunction func)
 //  the caller should stop parsing the text.
 //////////////////////////////////////////////////////////////////////
 bool
-IRC::Parser::match(std::string text) const
+IRC::Parser::match(const std::string & text)
 {
   bool result = false;
 
+  ++this->calls_;
   if (this->pattern_->match(text))
   {
+    ++this->matches_;
     result = this->func_(text);
   }
 
@@ -1622,6 +2378,31 @@ IRC::Parser::match(std::string text) const
 }
 
 
+// Adds the time taken by one call to match()
+void
+IRC::Parser::charge(const double seconds)
+{
+  this->totalTime_ += seconds;
+  if (seconds > this->maxTime_)
+  {
+    this->maxTime_ = seconds;
+  }
+}
+
+
+std::string
+IRC::Parser::getString(void) const
+{
+  return padLeft(boost::lexical_cast<std::string>(this->calls_), 10) +
+    padLeft(boost::lexical_cast<std::string>(this->matches_), 10) +
+    padLeft(Stats::formatSeconds(this->totalTime_), 9) +
+    padLeft(Stats::formatSeconds((this->calls_ > 0) ?
+    (this->totalTime_ / this->calls_) : 0), 9) +
+    padLeft(Stats::formatSeconds(this->maxTime_), 9) + "  " +
+    this->pattern_->get();
+}
+
+
 //////////////////////////////////////////////////////////////////////
 // IRC::addServerNotice(pattern, func)
 //
@@ -1647,8 +2428,63 @@ IRC::addServerNoticeParser(const std::string & pattern,
 void
 IRC::onServerNotice(const std::string & text)
 {
-  std::find_if(this->serverNotices.begin(), this->serverNotices.end(),
-    boost::bind(&Parser::match, _1, text));
+  Stats::Timer timer(Stats::NOTICE);
+
+  // Each parser is charged the time since the previous one finished, so
+  // timing them costs only one clock read apiece
+  double last = Timers::now();
+
+  for (ParserVector::iterator pos = this->serverNotices.begin();
+    pos != this->serverNotices.end(); ++pos)
+  {
+    const bool handled = pos->match(text);
+    const double now = Timers::now();
+
+    pos->charge(now - last);
+    last = now;
+
+    if (handled)
+    {
+      break;
+    }
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// IRC::parserStatus(client)
+//
+// Description:
+//  Lists the server notice parsers, most expensive first, with how
+//  many notices each has been given, how many matched its pattern,
+//  and the total, average, and longest time spent in it.
+//
+// Parameters:
+//  client - The client to send the list to.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+IRC::parserStatus(BotClient * client) const
+{
+  std::vector<const Parser *> sorted;
+
+  for (ParserVector::const_iterator pos = this->serverNotices.begin();
+    pos != this->serverNotices.end(); ++pos)
+  {
+    sorted.push_back(&*pos);
+  }
+  std::stable_sort(sorted.begin(), sorted.end(), Parser::moreTime);
+
+  client->send(padLeft("calls", 10) + padLeft("matches", 10) +
+    padLeft("total", 9) + padLeft("avg", 9) + padLeft("max", 9) +
+    "  pattern");
+  for (std::vector<const Parser *>::const_iterator pos = sorted.begin();
+    pos != sorted.end(); ++pos)
+  {
+    client->send((*pos)->getString());
+  }
 }
 
 
@@ -1694,7 +2530,11 @@ IRC::setServerTimeout(const std::string & newValue)
     if (timeout >= 30)
     {
       IRC::serverTimeout_ = timeout;
-      server.setTimeout(timeout);
+      for (IRC::List::const_iterator pos = IRC::list().begin();
+        pos != IRC::list().end(); ++pos)
+      {
+        (*pos)->setTimeout(timeout);
+      }
     }
     else
     {
@@ -1712,16 +2552,11 @@ IRC::setServerTimeout(const std::string & newValue)
 }
 
 
-void
-IRC::preSelect(fd_set & r, fd_set & w) const
-{
-  this->sock_.preSelect(r, w);
-}
-
-
 bool
 IRC::connect(const std::string & address, const BotSock::Port port)
 {
+  this->sock_.setThreaded(IRC::readThread_);
+
   return this->sock_.connect(address, port);
 }
 
@@ -1744,11 +2579,20 @@ void
 IRC::init(void)
 {
   KlineList::init();
+  IRC::initDispatch();
 
   vars.insert("OPER_NICK_IN_REASON",
       Setting::BooleanSetting(IRC::operNickInReason_));
   vars.insert("RELAY_MSGS_TO_LOCOPS",
       Setting::BooleanSetting(IRC::relayMsgsToLocops_));
+  vars.insert("SERVER_PACE_QUEUE",
+      Setting::IntegerSetting(IRC::paceQueue_, 0));
+  vars.insert("SERVER_READ_THREAD",
+      Setting::BooleanSetting(IRC::readThread_));
+  vars.insert("SERVER_SEND_BURST",
+      Setting::IntegerSetting(IRC::sendBurst_, 1));
+  vars.insert("SERVER_SEND_RATE", Setting::IntegerSetting(IRC::sendRate_, 0));
+  vars.insert("SERVER_SENDQ", Setting::IntegerSetting(IRC::serverSendQ_, 0));
   vars.insert("SERVER_TIMEOUT", Setting(IRC::getServerTimeout,
         IRC::setServerTimeout));
   vars.insert("TRACK_PERM_DLINES",
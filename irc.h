@@ -23,10 +23,13 @@
 
 // Std C++ Headers
 #include <string>
+#include <deque>
+#include <vector>
 #include <ctime>
 
 // Boost C++ Headers
 #include <boost/function.hpp>
+#include <boost/utility.hpp>
 
 // OOMon Headers
 #include "strtype"
@@ -35,37 +38,88 @@
 #include "botsock.h"
 #include "klines.h"
 #include "pattern.h"
+#include "ircmsg.h"
+#include "config.h"
+#include "userhash.h"
 
 
-enum IRCCommand
-{
-  IRC_UNKNOWN, IRC_PING, IRC_NICK, IRC_JOIN, IRC_PART, IRC_KICK, IRC_INVITE,
-  IRC_NOTICE, IRC_PRIVMSG, IRC_WALLOPS, IRC_ERROR
-};
-
 enum CaseMapping
 {
   CASEMAP_RFC1459, CASEMAP_STRICT_RFC1459, CASEMAP_ASCII
 };
 
 
-class IRC
+// One connection to an IRC server.  Each server has its own users,
+// K-lines, D-lines, and case mapping; everything else is shared.  Input
+// from a server is handled with that server current, so that server()
+// and users() refer to it, and automatic actions against a user are
+// sent to the server the user is on.
+class IRC : private boost::noncopyable
 {
 public:
   IRC();
 
   typedef boost::function<bool(std::string)> ParserFunction;
 
-  void preSelect(fd_set & r, fd_set & w) const;
-  bool postSelect(const fd_set & readset, const fd_set & writeset);
+  // Classes of output to the server, highest priority first.  Lines
+  // are paced to stay within the server's flood limits, and a queued
+  // line is never sent ahead of one with a higher priority.
+  enum Priority
+  {
+    PRIORITY_CONTROL,	// Registration, PING/PONG, QUIT; never paced
+    PRIORITY_ENFORCE,	// K-lines, D-lines, kills, raw commands
+    PRIORITY_QUERY,	// TRACE, STATS, and other requests for information
+    PRIORITY_MESSAGE,	// NOTICEs and PRIVMSGs
+    PRIORITY_BULK,	// CTCP VERSION requests to connecting clients
+    PRIORITY_COUNT
+  };
+
+  // Called if a line is dropped from the send queues instead of sent
+  typedef boost::function<void (void)> OnDropHandler;
+
+  typedef std::vector<IRC *> List;
+
+  // Every server, in the order of the S: lines.  The first is current
+  // whenever no other has been made so.
+  static const List & list(void);
+  static IRC & current(void);
+  static IRC * find(const std::string & name);
+  static void configure(void);
+
+  // Makes a server current for as long as the Context exists
+  class Context : private boost::noncopyable
+  {
+  public:
+    explicit Context(IRC * irc);
+    ~Context(void);
+
+  private:
+    IRC * previous_;
+  };
+
+  UserHash & users(void) { return this->users_; }
+  const UserHash & users(void) const { return this->users_; }
 
-  int write(const std::string & text);
+  void setServer(const Config::Server & entry) { this->entry_ = entry; }
+  std::string getAddress(void) const;
+  bool haveChannel(const std::string & channel) const;
+
+  void reconnect(const std::time_t now);
+  bool process(void);
+
+  int write(const std::string & text,
+    const Priority priority = PRIORITY_CONTROL,
+    const OnDropHandler & onDrop = OnDropHandler());
+  std::time_t queueDelay(const Priority priority) const;
+  int pacingTimeout(void) const;
 
   void quit(const std::string & Message = "Normal termination");
   void notice(const std::string &, const std::string &);
   void notice(const std::string &, const StrList &);
   void msg(const std::string &, const std::string &);
-  void ctcp(const std::string &, const std::string &);
+  void ctcp(const std::string &, const std::string &,
+    const Priority priority = PRIORITY_MESSAGE,
+    const OnDropHandler & onDrop = OnDropHandler());
   void ctcpReply(const std::string &, const std::string &);
   void isOn(const std::string &);
   void kline(const std::string & from, const unsigned int minutes,
@@ -113,14 +167,36 @@ public:
   void checkUserDelta(void);
 
   void status(class BotClient * client) const;
+  void parserStatus(class BotClient * client) const;
+  unsigned long queued(void) const;
 
   bool onConnect(void);
+  void onIdle(void);
 
-  char upCase(const char c) const;
+  char upCase(const char c) const
+  {
+    return IRC::upCaseTable_[this->caseMapping][static_cast<unsigned char>(c)];
+  }
   std::string upCase(const std::string & text) const;
-  char downCase(const char c) const;
+  char downCase(const char c) const
+  {
+    return
+      IRC::downCaseTable_[this->caseMapping][static_cast<unsigned char>(c)];
+  }
   std::string downCase(const std::string & text) const;
-  bool same(const std::string & text1, const std::string & text2) const;
+  bool same(const std::string & text1, const std::string & text2) const
+  {
+    return this->same(text1.data(), text1.length(), text2.data(),
+      text2.length());
+  }
+  bool same(const IRCMessage::Token & text1, const std::string & text2) const
+  {
+    return this->same(text1.data(), text1.length(), text2.data(),
+      text2.length());
+  }
+  bool same(const char *text1, const std::string::size_type length1,
+    const char *text2, const std::string::size_type length2) const;
+  unsigned int hash(const std::string & text) const;
 
   void onServerNotice(const std::string & text);
 
@@ -137,7 +213,7 @@ public:
   BotSock::Address getRemoteAddress(void) const;
   void bindTo(const std::string & name) { this->sock_.bindTo(name); }
   bool connect(const std::string & address, const BotSock::Port port);
-  void reset(void) { this->sock_.reset(); }
+  void reset(void);
 
   static bool validNick(const std::string & nick);
 
@@ -146,9 +222,20 @@ public:
 
   static void init(void);
 
-protected:
-  bool onRead(std::string text);
+  bool onRead(const char *text, const int size);
+
+  typedef void (IRC::*MessageHandler)(const IRCMessage & params);
+  static MessageHandler findHandler(const IRCMessage & message);
 
+  // Output is passed to the sink instead of the server, unpaced.  This
+  // is used to replay captured traffic without a server.
+  typedef boost::function<void(const std::string &)> Sink;
+  void setSink(Sink sink) { this->sink_ = sink; }
+  // Sets up what registration would have, for a capture started later
+  void setIdentity(const std::string & server, const std::string & nick)
+    { this->serverName = server; this->myNick = nick; }
+
+protected:
   void addServerNoticeParser(const std::string & pattern,
     const ParserFunction func);
 
@@ -157,14 +244,49 @@ private:
   {
   public:
     Parser(const std::string & pattern, const ParserFunction func);
-    bool match(std::string text) const;
+    bool match(const std::string & text);
+    void charge(const double seconds);
+    std::string getString(void) const;
+    static bool moreTime(const Parser * lhs, const Parser * rhs)
+      { return lhs->totalTime_ > rhs->totalTime_; }
   private:
     PatternPtr pattern_;
     ParserFunction func_;
+    unsigned long calls_;
+    unsigned long matches_;
+    double totalTime_;
+    double maxTime_;
   };
   typedef std::vector<Parser> ParserVector;
 
+  struct QueuedLine
+  {
+    std::string text;
+    double queued;
+    OnDropHandler onDrop;
+  };
+  typedef std::deque<QueuedLine> LineQueue;
+
+  struct QueueStats
+  {
+    unsigned long sent;
+    unsigned long dropped;
+    double totalWait;
+    double maxWait;
+  };
+
   BotSock sock_;
+  Sink sink_;
+  Config::Server entry_;
+  UserHash users_;
+  std::time_t nextConnectAttempt_;
+  std::time_t connectWait_;
+  LineQueue sendQueue_[PRIORITY_COUNT];
+  QueueStats sendStats_[PRIORITY_COUNT];
+  std::string::size_type sendQueueBytes_;
+  bool sendQueueExceeded_;
+  double sendTokens_;
+  double lastRefill_;
   ParserVector serverNotices;
   bool amIAnOper;
   bool gettingTrace;
@@ -180,10 +302,20 @@ private:
   KlineList klines;
   KlineList dlines;
   std::time_t lastUserDeltaCheck;
-  std::time_t lastCtcpVersionTimeoutCheck;
+
+  // One row per CaseMapping, indexed by unsigned character
+  static const char upCaseTable_[3][256];
+  static const char downCaseTable_[3][256];
+
+  static IRC * current_;
 
   static bool operNickInReason_;
   static bool relayMsgsToLocops_;
+  static bool readThread_;
+  static int paceQueue_;
+  static int sendBurst_;
+  static int sendRate_;
+  static int serverSendQ_;
   static int serverTimeout_;
   static bool trackPermDlines_;
   static bool trackPermKlines_;
@@ -201,14 +333,69 @@ private:
   void onNotice(const std::string & from, const std::string & userhost,
     const std::string & to, std::string text);
 
+  void checkVersionTimeout(void);
+
+  void refillTokens(double now);
+  void drainQueue(void);
+  void limitQueue(void);
+  void dropLine(const Priority priority);
+  int send(const std::string & text, const Priority priority,
+    const double queued, const double now);
+
   static std::string getServerTimeout(void);
   static std::string setServerTimeout(const std::string & newValue);
 
-  static IRCCommand getCommand(const std::string & text);
+  struct CommandHandler
+  {
+    const char *name;
+    MessageHandler handler;
+  };
+
+  enum { NUMERIC_COUNT = 1000, COMMAND_SLOTS = 32 };
+
+  static MessageHandler numericHandlers_[NUMERIC_COUNT];
+  static CommandHandler commandHandlers_[COMMAND_SLOTS];
+
+  static unsigned int commandSlot(const IRCMessage::Token & name);
+  static void addNumeric(const int numeric, const MessageHandler handler);
+  static void addCommand(const char *name, const MessageHandler handler);
+  static void initDispatch(void);
+
+  void rplWelcome(const IRCMessage & params);
+  void rplISupport(const IRCMessage & params);
+  void rplTrace(const IRCMessage & params);
+  void rplTraceEnd(const IRCMessage & params);
+  void rplStatsKLine(const IRCMessage & params);
+  void rplEndOfStats(const IRCMessage & params);
+  void rplStatsDLine(const IRCMessage & params);
+  void rplIson(const IRCMessage & params);
+  void rplWhoisUser(const IRCMessage & params);
+  void rplYoureOper(const IRCMessage & params);
+  void errNicknameInUse(const IRCMessage & params);
+  void errPasswdMismatch(const IRCMessage & params);
+  void errInviteOnlyChan(const IRCMessage & params);
+  void errNoOperHost(const IRCMessage & params);
+  void rplETrace(const IRCMessage & params);
+
+  void msgPing(const IRCMessage & params);
+  void msgNick(const IRCMessage & params);
+  void msgJoin(const IRCMessage & params);
+  void msgPart(const IRCMessage & params);
+  void msgKick(const IRCMessage & params);
+  void msgInvite(const IRCMessage & params);
+  void msgNotice(const IRCMessage & params);
+  void msgPrivmsg(const IRCMessage & params);
+  void msgWallops(const IRCMessage & params);
+  void msgError(const IRCMessage & params);
 };
 
 
-extern IRC server;
+// The current server
+inline IRC &
+server(void)
+{
+  return IRC::current();
+}
 
 
 #endif /* __IRC_H__ */
@@ -0,0 +1,136 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+
+// OOMon Headers
+#include "ircmsg.h"
+
+
+//////////////////////////////////////////////////////////////////////
+// IRCMessage::parse(line, length, defaultPrefix)
+//
+// Description:
+//  Splits a line received from an IRC server in a single pass.  Runs
+//  of spaces separate tokens, and a parameter beginning with ':' takes
+//  the rest of the line.  The prefix is split into a nick and userhost
+//  if it is in nick!user@host form; otherwise the nick is the whole
+//  prefix (a server name) and the userhost is empty.
+//
+// Parameters:
+//  line          - The line, without its line terminator.
+//  length        - The length of the line.
+//  defaultPrefix - The prefix to use if the line doesn't have one.
+//                  This must also outlive the message.
+//
+// Return Value:
+//  The function returns false if the line has no command.
+//////////////////////////////////////////////////////////////////////
+bool
+IRCMessage::parse(const char *line, const std::string::size_type length,
+  const std::string & defaultPrefix)
+{
+  const char *pos = line;
+  const char * const end = line + length;
+
+  this->count_ = 0;
+  this->numeric_ = -1;
+
+  if ((pos < end) && (':' == *pos))
+  {
+    const char *start = ++pos;
+    while ((pos < end) && (' ' != *pos))
+    {
+      ++pos;
+    }
+    this->tokens_[this->count_++] = Token(start, pos - start);
+  }
+  else
+  {
+    this->tokens_[this->count_++] = Token(defaultPrefix.data(),
+      defaultPrefix.length());
+  }
+
+  while (pos < end)
+  {
+    if (' ' == *pos)
+    {
+      ++pos;
+    }
+    else if ((':' == *pos) || (this->count_ == (MAX_PARAMS + 1)))
+    {
+      if (':' == *pos)
+      {
+        ++pos;
+      }
+      this->tokens_[this->count_++] = Token(pos, end - pos);
+      pos = end;
+    }
+    else
+    {
+      const char *start = pos;
+      while ((pos < end) && (' ' != *pos))
+      {
+        ++pos;
+      }
+      this->tokens_[this->count_++] = Token(start, pos - start);
+    }
+  }
+
+  if (this->count_ < 2)
+  {
+    return false;
+  }
+
+  const Token & from = this->tokens_[0];
+  const char *bang = static_cast<const char *>(memchr(from.data(), '!',
+    from.length()));
+  if (0 == bang)
+  {
+    this->nick_ = from;
+    this->userhost_ = Token();
+  }
+  else
+  {
+    this->nick_ = Token(from.data(), bang - from.data());
+    this->userhost_ = Token(bang + 1, from.length() - (bang - from.data()) - 1);
+  }
+
+  const Token & command = this->tokens_[1];
+  if ((command.length() > 0) && (command.length() <= 3))
+  {
+    int value = 0;
+    std::string::size_type i = 0;
+    for (; (i < command.length()) && (command[i] >= '0') &&
+      (command[i] <= '9'); ++i)
+    {
+      value = (value * 10) + (command[i] - '0');
+    }
+    if (i == command.length())
+    {
+      this->numeric_ = value;
+    }
+  }
+
+  return true;
+}
+
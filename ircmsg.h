@@ -0,0 +1,109 @@
+#ifndef __IRCMSG_H__
+#define __IRCMSG_H__
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+
+// Std C Headers
+#include <string.h>
+
+
+// A line received from an IRC server, split into its prefix, command,
+// and parameters without copying any of it.  Each token points into the
+// original line, so the line must outlive the message.
+class IRCMessage
+{
+public:
+  // RFC 1459 allows no more than 15 parameters.  Anything past the
+  // 14th is left in the 15th, as if it had been prefixed with ':'.
+  enum { MAX_PARAMS = 15 };
+
+  class Token
+  {
+  public:
+    Token(void) : data_(""), length_(0) { }
+    Token(const char *data, const std::string::size_type length)
+      : data_(data), length_(length) { }
+
+    const char *data(void) const { return this->data_; }
+    std::string::size_type length(void) const { return this->length_; }
+    bool empty(void) const { return 0 == this->length_; }
+    char operator[](const std::string::size_type pos) const
+      { return (pos < this->length_) ? this->data_[pos] : '\0'; }
+
+    std::string str(void) const
+      { return std::string(this->data_, this->length_); }
+
+    bool operator==(const char *text) const
+    {
+      return (0 == strncmp(this->data_, text, this->length_)) &&
+        ('\0' == text[this->length_]);
+    }
+    bool operator!=(const char *text) const { return !(*this == text); }
+    bool startsWith(const char *text) const
+    {
+      const std::string::size_type len = strlen(text);
+      return (len <= this->length_) && (0 == memcmp(this->data_, text, len));
+    }
+    Token substr(const std::string::size_type pos) const
+    {
+      return (pos < this->length_) ?
+        Token(this->data_ + pos, this->length_ - pos) : Token();
+    }
+
+  private:
+    const char *data_;
+    std::string::size_type length_;
+  };
+
+  // The message's tokens are indexed the way SplitIRC() numbers them:
+  // 0 is the prefix, 1 is the command, and the parameters follow.
+  typedef int size_type;
+
+  IRCMessage(void) : count_(0), numeric_(-1) { }
+
+  bool parse(const char *line, const std::string::size_type length,
+    const std::string & defaultPrefix);
+
+  size_type size(void) const { return this->count_; }
+  const Token & operator[](const size_type index) const
+    { return this->tokens_[index]; }
+
+  const Token & prefix(void) const { return this->tokens_[0]; }
+  const Token & command(void) const { return this->tokens_[1]; }
+  const Token & nick(void) const { return this->nick_; }
+  const Token & userhost(void) const { return this->userhost_; }
+
+  // Returns the command as a number, or -1 if it isn't a numeric reply
+  int numeric(void) const { return this->numeric_; }
+
+private:
+  Token tokens_[MAX_PARAMS + 2];
+  Token nick_, userhost_;
+  size_type count_;
+  int numeric_;
+};
+
+
+#endif /* __IRCMSG_H__ */
+
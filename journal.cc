@@ -0,0 +1,455 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+
+// Boost C++ Headers
+#include <boost/lexical_cast.hpp>
+
+// OOMon Headers
+#include "oomon.h"
+#include "journal.h"
+#include "irc.h"
+#include "log.h"
+#include "util.h"
+#include "vars.h"
+#include "botclient.h"
+
+
+// A new string table is started once this many strings are defined
+static const unsigned long MAX_STRINGS = 65536;
+
+// Records are collected in memory and written once this much is waiting
+static const std::string::size_type WRITE_BYTES = 65536;
+
+
+std::ofstream Journal::file;
+std::string Journal::filename;
+std::string Journal::record;
+std::string Journal::buffer;
+Journal::StringMap Journal::strings;
+std::time_t Journal::lastTime = 0;
+unsigned long Journal::events = 0;
+unsigned long Journal::bytes = 0;
+unsigned long Journal::writeErrors = 0;
+Timers::Id Journal::flushTimer = 0;
+
+
+// Seven bits per byte, lowest first, with the top bit set on every
+// byte but the last
+static void
+appendVarint(std::string & out, unsigned long value)
+{
+  while (value >= 0x80)
+  {
+    out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+
+void
+Journal::putVarint(const unsigned long value)
+{
+  appendVarint(Journal::record, value);
+}
+
+
+void
+Journal::putLiteral(const std::string & text)
+{
+  Journal::putVarint(0);
+  Journal::putVarint(text.length());
+  Journal::record += text;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Journal::putString(text)
+//
+// Description:
+//  Adds a reference to a string to the current record.  The first time
+//  a string is used, a STRING record defining it is written ahead of
+//  the current record.
+//
+// Parameters:
+//  text - The string.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+Journal::putString(const std::string & text)
+{
+  StringMap::iterator pos = Journal::strings.find(text);
+
+  if (Journal::strings.end() == pos)
+  {
+    pos = Journal::strings.insert(StringMap::value_type(text,
+      Journal::strings.size())).first;
+
+    // 1 byte for the type and 1 for the time, which hasn't changed
+    appendVarint(Journal::buffer, text.length() + 2);
+    Journal::buffer += static_cast<char>(Journal::STRING);
+    Journal::buffer += '\0';
+    Journal::buffer += text;
+  }
+
+  Journal::putVarint(pos->second + 1);
+}
+
+
+void
+Journal::putAddress(const BotSock::Address & ip)
+{
+  Journal::record.append(reinterpret_cast<const char *>(&ip), 4);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Journal::begin(type, nick, user, host, domain, ip)
+//
+// Description:
+//  Starts a new record with the fields every user event has.  If the
+//  string table has grown too large, a RESET record is written first.
+//
+// Parameters:
+//  type   - The record type.
+//  nick   - The user's nick.
+//  user   - The user's username.
+//  host   - The user's hostname.
+//  domain - The user's domain.
+//  ip     - The user's IP address.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+Journal::begin(const Type type, const std::string & nick,
+  const std::string & user, const std::string & host,
+  const std::string & domain, const BotSock::Address & ip)
+{
+  if (Journal::strings.size() >= MAX_STRINGS)
+  {
+    Journal::strings.clear();
+    Journal::lastTime = 0;
+    Journal::record = static_cast<char>(Journal::RESET);
+    Journal::putVarint(0);
+    Journal::end();
+  }
+
+  const std::time_t now = std::time(0);
+  const long delta = static_cast<long>(now - Journal::lastTime);
+  Journal::lastTime = now;
+
+  Journal::record = static_cast<char>(type);
+  Journal::putVarint((static_cast<unsigned long>(delta) << 1) ^
+    static_cast<unsigned long>(delta >> (sizeof(long) * 8 - 1)));
+  Journal::putString(server().getServerName());
+  Journal::putString(nick);
+  Journal::putString(user);
+  Journal::putString(host);
+  Journal::putString(domain);
+  Journal::putAddress(ip);
+}
+
+
+void
+Journal::begin(const Type type, const UserEntryPtr user)
+{
+  Journal::begin(type, user->getNick(), user->getUser(), user->getHost(),
+    user->getDomain(), user->getIP());
+}
+
+
+// end()
+//
+// Adds the current record to the buffer, preceded by its length.
+//
+void
+Journal::end(void)
+{
+  appendVarint(Journal::buffer, Journal::record.length());
+  Journal::buffer += Journal::record;
+
+  if (Journal::buffer.length() >= WRITE_BYTES)
+  {
+    Journal::flush();
+  }
+}
+
+
+void
+Journal::connect(const UserEntryPtr user)
+{
+  if (Journal::active())
+  {
+    Journal::begin(Journal::CONNECT, user);
+    Journal::putString(user->getClass());
+    Journal::putLiteral(user->getGecos());
+    Journal::end();
+    ++Journal::events;
+  }
+}
+
+
+void
+Journal::exit(const std::string & nick, const std::string & user,
+  const std::string & host, const BotSock::Address & ip)
+{
+  if (Journal::active())
+  {
+    Journal::begin(Journal::EXIT, nick, user, host, getDomain(host, false),
+      ip);
+    Journal::end();
+    ++Journal::events;
+  }
+}
+
+
+void
+Journal::nickChange(const UserEntryPtr user, const std::string & oldNick)
+{
+  if (Journal::active())
+  {
+    Journal::begin(Journal::NICK, oldNick, user->getUser(), user->getHost(),
+      user->getDomain(), user->getIP());
+    Journal::putString(user->getNick());
+    Journal::end();
+    ++Journal::events;
+  }
+}
+
+
+void
+Journal::trap(const UserEntryPtr user, const unsigned int key,
+  const std::string & action)
+{
+  if (Journal::active())
+  {
+    Journal::begin(Journal::TRAP, user);
+    Journal::putVarint(key);
+    Journal::putString(action);
+    Journal::end();
+    ++Journal::events;
+  }
+}
+
+
+void
+Journal::proxy(const UserEntryPtr user, const BotSock::Port port,
+  const std::string & type)
+{
+  if (Journal::active())
+  {
+    Journal::begin(Journal::PROXY, user);
+    Journal::putVarint(port);
+    Journal::putString(type);
+    Journal::end();
+    ++Journal::events;
+  }
+}
+
+
+void
+Journal::dnsbl(const UserEntryPtr user, const std::string & zone)
+{
+  if (Journal::active())
+  {
+    Journal::begin(Journal::DNSBL, user);
+    Journal::putString(zone);
+    Journal::end();
+    ++Journal::events;
+  }
+}
+
+
+void
+Journal::action(const std::string & nick, const std::string & user,
+  const std::string & host, const BotSock::Address & ip,
+  const std::string & action, const std::string & reason)
+{
+  if (Journal::active())
+  {
+    Journal::begin(Journal::ACTION, nick, user, host, getDomain(host, false),
+      ip);
+    Journal::putString(action);
+    Journal::putLiteral(reason);
+    Journal::end();
+    ++Journal::events;
+  }
+}
+
+
+// The records are collected in a buffer of our own, so they are
+// written every few seconds rather than one at a time
+void
+Journal::flush(void)
+{
+  if (Journal::buffer.empty())
+  {
+    return;
+  }
+
+  Journal::file.write(Journal::buffer.data(), Journal::buffer.length());
+  Journal::file.flush();
+
+  if (!Journal::file)
+  {
+    // A failed stream drops everything written to it after this, so
+    // stop rather than lose events without a word
+    ++Journal::writeErrors;
+    Journal::buffer.clear();
+    Log::Write("*** Error writing to " + Journal::filename +
+      " -- journaling stopped");
+    Journal::stop();
+    return;
+  }
+
+  Journal::bytes += Journal::buffer.length();
+  Journal::buffer.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Journal::start(filename)
+//
+// Description:
+//  Starts appending events to a journal file, after stopping any
+//  journal already in progress.  Every run starts with the journal
+//  header and a RESET record, even in an existing file, so a reader
+//  can find its place again if the last run was cut off partway
+//  through a record.
+//
+// Parameters:
+//  filename - The journal file.
+//
+// Return Value:
+//  The function returns false if the file could not be opened.
+//////////////////////////////////////////////////////////////////////
+bool
+Journal::start(const std::string & filename)
+{
+  Journal::stop();
+
+  Journal::file.clear();
+  Journal::file.open(filename.c_str(),
+    std::ios::out | std::ios::app | std::ios::binary);
+
+  if (!Journal::file.is_open())
+  {
+    return false;
+  }
+
+  Journal::buffer = JOURNAL_MAGIC;
+  Journal::buffer += static_cast<char>(JOURNAL_VERSION);
+
+  Journal::strings.clear();
+  Journal::lastTime = 0;
+  Journal::record = static_cast<char>(Journal::RESET);
+  Journal::putVarint(0);
+  Journal::end();
+
+  Journal::filename = filename;
+  Journal::events = 0;
+  Journal::bytes = 0;
+  Journal::flushTimer = Timers::instance().every(5, Journal::flush);
+
+  Log::Write("Journaling events to " + filename);
+
+  return true;
+}
+
+
+void
+Journal::stop(void)
+{
+  if (Journal::file.is_open())
+  {
+    Journal::flush();
+    Journal::file.close();
+    Timers::instance().cancel(Journal::flushTimer);
+    Journal::flushTimer = 0;
+    Journal::strings.clear();
+
+    Log::Write("Journaled " + boost::lexical_cast<std::string>(Journal::events)
+      + " events to " + Journal::filename);
+  }
+
+  Journal::filename.erase();
+}
+
+
+std::string
+Journal::getFilename(void)
+{
+  return Journal::filename;
+}
+
+
+std::string
+Journal::setFilename(const std::string & newValue)
+{
+  if (newValue.empty())
+  {
+    Journal::stop();
+  }
+  else if (!Journal::start(newValue))
+  {
+    return "*** Unable to open " + newValue + " for writing!";
+  }
+
+  return "";
+}
+
+
+void
+Journal::init(void)
+{
+  vars.insert("EVENT_JOURNAL", Setting(Journal::getFilename,
+    Journal::setFilename));
+}
+
+
+void
+Journal::status(BotClient * client)
+{
+  if (Journal::active())
+  {
+    client->send("Journaling events to " + Journal::filename + " (" +
+      boost::lexical_cast<std::string>(Journal::events) + " events, " +
+      boost::lexical_cast<std::string>(Journal::bytes +
+      Journal::buffer.length()) + " bytes, " +
+      boost::lexical_cast<std::string>(Journal::strings.size()) +
+      " strings)");
+  }
+
+  if (Journal::writeErrors > 0)
+  {
+    client->send("Journal: " +
+      boost::lexical_cast<std::string>(Journal::writeErrors) +
+      " write errors");
+  }
+}
+
@@ -0,0 +1,132 @@
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+
+// $Id$
+
+// Std C++ Headers
+#include <fstream>
+#include <map>
+#include <string>
+#include <ctime>
+
+// OOMon Headers
+#include "botsock.h"
+#include "timers.h"
+#include "userentry.h"
+
+
+// Records connects, exits, nick changes, trap matches, open proxies, and
+// automatic actions in a compact binary file that can be searched after
+// an incident with readjournal.  Journaling is started and stopped by
+// setting EVENT_JOURNAL to a file name.
+//
+// The file starts with JOURNAL_MAGIC and JOURNAL_VERSION, followed by
+// records.  Each record is its length as a varint followed by that many
+// bytes: the record type, the number of seconds since the previous
+// record as a zigzag varint, and the fields.  Strings are numbered in
+// the order STRING records define them, and are referred to by number
+// plus one; 0 is followed by a length and the bytes of a string that is
+// used only once.  A RESET record starts a new string table and times
+// over from 0.
+//
+// Every other record begins with the server name, nick, user, host,
+// domain, and the IP address as 4 bytes in network order, and has a few
+// more fields depending on its type:
+//
+//   CONNECT - class, gecos
+//   EXIT    - (none)
+//   NICK    - new nick
+//   TRAP    - trap number (varint), trap action
+//   PROXY   - port (varint), proxy type
+//   DNSBL   - zone
+//   ACTION  - action, reason
+//
+// Every time journaling starts, the magic, version, and a RESET record
+// are written again, even in the middle of a file.  readjournal uses
+// them to find its place again after a record cut short by a bot that
+// stopped partway through writing it.
+class Journal
+{
+public:
+  enum Type
+  {
+    STRING, RESET, CONNECT, EXIT, NICK, TRAP, PROXY, DNSBL, ACTION
+  };
+
+  static void init(void);
+
+  static bool active(void) { return Journal::file.is_open(); }
+
+  static void connect(const UserEntryPtr user);
+  static void exit(const std::string & nick, const std::string & user,
+    const std::string & host, const BotSock::Address & ip);
+  static void nickChange(const UserEntryPtr user, const std::string & oldNick);
+  static void trap(const UserEntryPtr user, const unsigned int key,
+    const std::string & action);
+  static void proxy(const UserEntryPtr user, const BotSock::Port port,
+    const std::string & type);
+  static void dnsbl(const UserEntryPtr user, const std::string & zone);
+  static void action(const std::string & nick, const std::string & user,
+    const std::string & host, const BotSock::Address & ip,
+    const std::string & action, const std::string & reason);
+
+  static bool start(const std::string & filename);
+  static void stop(void);
+
+  static void status(class BotClient * client);
+
+private:
+  typedef std::map<std::string, unsigned long> StringMap;
+
+  static void begin(const Type type, const std::string & nick,
+    const std::string & user, const std::string & host,
+    const std::string & domain, const BotSock::Address & ip);
+  static void begin(const Type type, const UserEntryPtr user);
+  static void end(void);
+  static void putVarint(const unsigned long value);
+  static void putString(const std::string & text);
+  static void putLiteral(const std::string & text);
+  static void putAddress(const BotSock::Address & ip);
+
+  static std::string getFilename(void);
+  static std::string setFilename(const std::string & newValue);
+  static void flush(void);
+
+  static std::ofstream file;
+  static std::string filename;
+  static std::string record;
+  static std::string buffer;
+  static StringMap strings;
+  static std::time_t lastTime;
+  static unsigned long events;
+  static unsigned long bytes;
+  static unsigned long writeErrors;
+  static Timers::Id flushTimer;
+};
+
+
+// The first bytes of every journal file
+#define JOURNAL_MAGIC "OOMJ"
+#define JOURNAL_VERSION 1
+
+
+#endif /* __JOURNAL_H__ */
@@ -75,7 +75,7 @@ JupeJoinList::checkJupe(const std::string & nick,
 
     bool exempt(false);
     BotSock::Address ip(INADDR_NONE);
-    UserEntryPtr find(users.findUser(nick, entry.userhost));
+    UserEntryPtr find(users().findUser(nick, entry.userhost));
     if (find)
     {
       ip = find->getIP();
@@ -116,8 +116,8 @@ JupeJoinList::add(const std::string & nick, const std::string & userhost,
   for (std::list<JupeJoinEntry>::iterator pos = this->list.begin();
     pos != this->list.end(); ++pos)
   {
-    if (server.same(pos->userhost, userhost) &&
-        (JupeJoinList::ignoreChannel || server.same(pos->channel, channel)))
+    if (server().same(pos->userhost, userhost) &&
+        (JupeJoinList::ignoreChannel || server().same(pos->channel, channel)))
     {
       foundEntry = true;
 
@@ -175,7 +175,7 @@ JupeJoinList::onNotice(const std::string & notice)
 
   // User ToastTEst (toast@Plasma.Toast.PC) is attempting to join locally juped channel #jupedchan
 
-  if (0 != server.downCase(FirstWord(text)).compare("user"))
+  if (0 != server().downCase(FirstWord(text)).compare("user"))
     return false;
 
   std::string nick = FirstWord(text);
@@ -187,19 +187,19 @@ JupeJoinList::onNotice(const std::string & notice)
     userhost.erase(userhost.end() - 1);
   }
 
-  if (0 != server.downCase(FirstWord(text)).compare("is"))
+  if (0 != server().downCase(FirstWord(text)).compare("is"))
     return false;
-  if (0 != server.downCase(FirstWord(text)).compare("attempting"))
+  if (0 != server().downCase(FirstWord(text)).compare("attempting"))
     return false;
-  if (0 != server.downCase(FirstWord(text)).compare("to"))
+  if (0 != server().downCase(FirstWord(text)).compare("to"))
     return false;
-  if (0 != server.downCase(FirstWord(text)).compare("join"))
+  if (0 != server().downCase(FirstWord(text)).compare("join"))
     return false;
-  if (0 != server.downCase(FirstWord(text)).compare("locally"))
+  if (0 != server().downCase(FirstWord(text)).compare("locally"))
     return false;
-  if (0 != server.downCase(FirstWord(text)).compare("juped"))
+  if (0 != server().downCase(FirstWord(text)).compare("juped"))
     return false;
-  if (0 != server.downCase(FirstWord(text)).compare("channel"))
+  if (0 != server().downCase(FirstWord(text)).compare("channel"))
     return false;
 
   std::string channel = FirstWord(text);
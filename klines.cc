@@ -114,11 +114,11 @@ KlineList::findAndRemove(const std::string & from, const Pattern *pattern,
       {
         if (lineType == 'K')
         {
-          server.unkline(from, pos->getUserhost());
+          server().unkline(from, pos->getUserhost());
         }
         else if (lineType == 'D')
         {
-          server.undline(from, pos->getUserhost());
+          server().undline(from, pos->getUserhost());
         }
         matches++;
       }
@@ -147,31 +147,31 @@ KlineList::parseAndAdd(std::string text)
 {
   std::string who = FirstWord(text); // kline adder
 
-  if (0 != server.downCase(FirstWord(text)).compare("added"))
+  if (0 != server().downCase(FirstWord(text)).compare("added"))
     return false;
 
   bool temporary = false;
   std::string time;
 
-  if (0 == server.downCase(FirstWord(text)).compare("temporary"))
+  if (0 == server().downCase(FirstWord(text)).compare("temporary"))
   {
     temporary = true;
 
     time = FirstWord(text);
 
-    if (0 != server.downCase(FirstWord(text)).compare("min."))
+    if (0 != server().downCase(FirstWord(text)).compare("min."))
       return false;
 
     std::string type = FirstWord(text);
 
-    if ((lineType == 'K') && (0 != server.downCase(type).compare("k-line")))
+    if ((lineType == 'K') && (0 != server().downCase(type).compare("k-line")))
       return false;
     else if ((lineType == 'D') &&
-      (0 != server.downCase(type).compare("d-line")))
+      (0 != server().downCase(type).compare("d-line")))
       return false;
   }
 
-  if (0 != server.downCase(FirstWord(text)).compare("for"))
+  if (0 != server().downCase(FirstWord(text)).compare("for"))
     return false;
 
   // This won't work all the time, since a badly entered kline might
@@ -235,15 +235,15 @@ KlineList::parseAndAdd(std::string text)
 bool
 KlineList::onExpireNotice(std::string text)
 {
-  if (0 != server.downCase(FirstWord(text)).compare("temporary"))
+  if (0 != server().downCase(FirstWord(text)).compare("temporary"))
     return false;
   if ((lineType == 'K') &&
-    (0 != server.downCase(FirstWord(text)).compare("k-line")))
+    (0 != server().downCase(FirstWord(text)).compare("k-line")))
     return false;
   if ((lineType == 'D') &&
-    (0 != server.downCase(FirstWord(text)).compare("d-line")))
+    (0 != server().downCase(FirstWord(text)).compare("d-line")))
     return false;
-  if (0 != server.downCase(FirstWord(text)).compare("for"))
+  if (0 != server().downCase(FirstWord(text)).compare("for"))
     return false;
 
   std::string mask = FirstWord(text);
@@ -252,7 +252,7 @@ KlineList::onExpireNotice(std::string text)
     mask = mask.substr(1, mask.length() - 2);
   }
 
-  if (0 != server.downCase(FirstWord(text)).compare("expired"))
+  if (0 != server().downCase(FirstWord(text)).compare("expired"))
     return false;
 
   Remove(mask);
@@ -267,37 +267,39 @@ KlineList::parseAndRemove(std::string text)
 {
   std::string who = FirstWord(text); // kline adder
 
-  if (0 != server.downCase(FirstWord(text)).compare("has"))
+  if (0 != server().downCase(FirstWord(text)).compare("has"))
     return false;
-  if (0 != server.downCase(FirstWord(text)).compare("removed"))
+  if (0 != server().downCase(FirstWord(text)).compare("removed"))
     return false;
-  if (0 != server.downCase(FirstWord(text)).compare("the"))
+  if (0 != server().downCase(FirstWord(text)).compare("the"))
     return false;
 
   std::string temp = FirstWord(text);
   bool temporary = false;
 
-  if (0 == server.downCase(temp).compare("temporary"))
+  if (0 == server().downCase(temp).compare("temporary"))
   {
     temporary = true;
 
     if (lineType == 'K')
     {
-      if (0 != server.downCase(FirstWord(text)).compare("k-line"))
+      if (0 != server().downCase(FirstWord(text)).compare("k-line"))
         return false;
     }
     else if (lineType == 'D')
     {
-      if (0 != server.downCase(FirstWord(text)).compare("d-line"))
+      if (0 != server().downCase(FirstWord(text)).compare("d-line"))
         return false;
     }
   }
-  else if ((lineType == 'K') && (0 != server.downCase(temp).compare("k-line")))
+  else if ((lineType == 'K') &&
+    (0 != server().downCase(temp).compare("k-line")))
     return false;
-  else if ((lineType == 'D') && (0 != server.downCase(temp).compare("d-line")))
+  else if ((lineType == 'D') &&
+    (0 != server().downCase(temp).compare("d-line")))
     return false;
 
-  if (0 != server.downCase(FirstWord(text)).compare("for:"))
+  if (0 != server().downCase(FirstWord(text)).compare("for:"))
     return false;
 
   // Again, spaces in the kline mask will screw this up.
@@ -0,0 +1,577 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+#include <cerrno>
+
+// Boost C++ Headers
+#include <boost/lexical_cast.hpp>
+
+// Std C Headers
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+// OOMon Headers
+#include "oomon.h"
+#include "linereader.h"
+#include "botsock.h"
+#include "botclient.h"
+#include "timers.h"
+
+
+// Number of slots in each reader's ring, about 1 MB
+static const SpscRing<LineReader::Slot>::size_type RING_SLOTS = 1024;
+
+// Statistics for all readers.  The reader threads update them with
+// atomic operations, so they may be read at any time.
+static unsigned long runningReaders = 0;
+static unsigned long lineCount = 0;
+static unsigned long stallCount = 0;
+static unsigned long stallMicros = 0;
+static unsigned long truncatedCount = 0;
+static unsigned long peakDepth = 0;
+
+
+static bool
+makePipe(int fds[2])
+{
+  if (-1 == ::pipe(fds))
+  {
+    fds[0] = fds[1] = -1;
+    return false;
+  }
+
+  for (int i = 0; i < 2; ++i)
+  {
+    ::fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    ::fcntl(fds[i], F_SETFL, ::fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+  }
+
+  return true;
+}
+
+
+static void
+closePipe(int fds[2])
+{
+  for (int i = 0; i < 2; ++i)
+  {
+    if (-1 != fds[i])
+    {
+      ::close(fds[i]);
+      fds[i] = -1;
+    }
+  }
+}
+
+
+LineReader::LineReader(const int fd,
+  const std::vector<char>::size_type bufferSize, OnReadyHandler onReady)
+  : fd_(fd), bufferSize_((bufferSize > 0) ? bufferSize : 1),
+  onReady_(onReady), ring_(RING_SLOTS), signalled_(0), waiting_(0),
+  running_(false)
+{
+  this->wakePipe_[0] = this->wakePipe_[1] = -1;
+  this->stopPipe_[0] = this->stopPipe_[1] = -1;
+  this->roomPipe_[0] = this->roomPipe_[1] = -1;
+}
+
+
+LineReader::~LineReader(void)
+{
+  this->stop();
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// LineReader::start()
+//
+// Description:
+//  Starts the reader thread.  From now on, only the reader may read
+//  from the socket.  The thread blocks every signal, so that signal
+//  handlers always run on the main thread.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns false if the thread could not be started, or
+//  if OOMon was built without thread support.  The caller should then
+//  read from the socket itself.
+//////////////////////////////////////////////////////////////////////
+bool
+LineReader::start(void)
+{
+#ifdef HAVE_PTHREAD_H
+  if (this->running_)
+  {
+    return true;
+  }
+
+  if (!makePipe(this->wakePipe_) || !makePipe(this->stopPipe_) ||
+    !makePipe(this->roomPipe_) ||
+    !Reactor::instance().add(this->wakePipe_[0], this, Reactor::READ))
+  {
+    closePipe(this->wakePipe_);
+    closePipe(this->stopPipe_);
+    closePipe(this->roomPipe_);
+    return false;
+  }
+
+  sigset_t all, saved;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &saved);
+  this->running_ = (0 == pthread_create(&this->thread_, 0, LineReader::main,
+    this));
+  pthread_sigmask(SIG_SETMASK, &saved, 0);
+
+  if (!this->running_)
+  {
+    Reactor::instance().remove(this->wakePipe_[0], this);
+    closePipe(this->wakePipe_);
+    closePipe(this->stopPipe_);
+    closePipe(this->roomPipe_);
+    return false;
+  }
+
+  ++runningReaders;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// LineReader::stop()
+//
+// Description:
+//  Stops the reader thread and waits for it to exit.  This must be
+//  done before the socket is closed.  Lines already in the ring can
+//  still be read afterwards.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+LineReader::stop(void)
+{
+#ifdef HAVE_PTHREAD_H
+  if (this->running_)
+  {
+    const char stop = 0;
+    while ((-1 == ::write(this->stopPipe_[1], &stop, 1)) && (EINTR == errno))
+    {
+    }
+    pthread_join(this->thread_, 0);
+    this->running_ = false;
+    --runningReaders;
+
+    Reactor::instance().remove(this->wakePipe_[0], this);
+    closePipe(this->wakePipe_);
+    closePipe(this->stopPipe_);
+    closePipe(this->roomPipe_);
+  }
+#endif
+}
+
+
+// pop()
+//
+// Frees the slot at the front of the ring, and wakes the reader if it
+// is waiting for room.  The fence pairs with the one in reserve(), so
+// either the reader sees the free slot or this sees it waiting.
+//
+void
+LineReader::pop(void)
+{
+  this->ring_.pop();
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if ((0 != __atomic_load_n(&this->waiting_, __ATOMIC_RELAXED)) &&
+    (0 != __atomic_exchange_n(&this->waiting_, 0, __ATOMIC_SEQ_CST)))
+  {
+    const char wake = 0;
+    ::write(this->roomPipe_[1], &wake, 1);
+  }
+}
+
+
+// rearm()
+//
+// Makes sure the main thread is told about the lines still in the
+// ring, after it has stopped reading them to give other sockets a turn.
+//
+void
+LineReader::rearm(void)
+{
+  if ((-1 != this->wakePipe_[1]) &&
+    (0 == __atomic_exchange_n(&this->signalled_, 1, __ATOMIC_SEQ_CST)))
+  {
+    const char wake = 0;
+    ::write(this->wakePipe_[1], &wake, 1);
+  }
+}
+
+
+// onReady()
+//
+// Called by the reactor on the main thread when the reader has added
+// lines to the ring.  The flag is cleared before the owner empties the
+// ring, so anything added afterwards signals again.
+//
+void
+LineReader::onReady(const int fd, const int)
+{
+  char drain[64];
+  while (::read(fd, drain, sizeof(drain)) > 0)
+  {
+  }
+
+  __atomic_store_n(&this->signalled_, 0, __ATOMIC_SEQ_CST);
+
+  if (!this->onReady_.empty())
+  {
+    this->onReady_();
+  }
+}
+
+
+// Everything from here to status() runs on the reader thread, and must
+// not touch anything but the reader itself and the statistics above.
+
+void *
+LineReader::main(void * arg)
+{
+  static_cast<LineReader *>(arg)->run();
+
+  return 0;
+}
+
+
+void
+LineReader::signal(void)
+{
+  if (0 == __atomic_exchange_n(&this->signalled_, 1, __ATOMIC_SEQ_CST))
+  {
+    const char wake = 0;
+    ::write(this->wakePipe_[1], &wake, 1);
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// LineReader::reserve()
+//
+// Description:
+//  Returns the next free slot in the ring.  If the ring is full, the
+//  main thread is woken up to empty it, and the reader sleeps until
+//  pop() tells it there is room or it is told to stop.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns the slot, or 0 if the reader should stop.
+//////////////////////////////////////////////////////////////////////
+LineReader::Slot *
+LineReader::reserve(void)
+{
+  Slot * slot = this->ring_.reserve();
+
+  if (0 != slot)
+  {
+    return slot;
+  }
+
+  __atomic_add_fetch(&stallCount, 1, __ATOMIC_RELAXED);
+  const double start = Timers::now();
+  this->signal();
+
+  for (;;)
+  {
+    __atomic_store_n(&this->waiting_, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (0 != (slot = this->ring_.reserve()))
+    {
+      break;
+    }
+
+    struct pollfd fds[2];
+    fds[0].fd = this->roomPipe_[0];
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = this->stopPipe_[0];
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+
+    if ((-1 == ::poll(fds, 2, -1)) && (EINTR != errno))
+    {
+      break;
+    }
+
+    if (0 != fds[1].revents)
+    {
+      break;
+    }
+
+    char drain[64];
+    while (::read(this->roomPipe_[0], drain, sizeof(drain)) > 0)
+    {
+    }
+  }
+
+  __atomic_store_n(&this->waiting_, 0, __ATOMIC_SEQ_CST);
+
+  __atomic_add_fetch(&stallMicros,
+    static_cast<unsigned long>((Timers::now() - start) * 1000000),
+    __ATOMIC_RELAXED);
+
+  return slot;
+}
+
+
+// deliver(data, length)
+//
+// Copies a line into as many slots as it needs.  Returns false if the
+// reader was told to stop while waiting for room.
+//
+bool
+LineReader::deliver(const char *data, int length)
+{
+  do
+  {
+    Slot * slot = this->reserve();
+    if (0 == slot)
+    {
+      return false;
+    }
+
+    const int part = (length > SLOT_DATA) ? SLOT_DATA : length;
+
+    slot->type = (part < length) ? Slot::PARTIAL : Slot::LINE;
+    slot->length = part;
+    memcpy(slot->data, data, part);
+    this->ring_.commit();
+
+    data += part;
+    length -= part;
+  }
+  while (length > 0);
+
+  __atomic_add_fetch(&lineCount, 1, __ATOMIC_RELAXED);
+
+  const unsigned long depth = this->ring_.size();
+  unsigned long peak = __atomic_load_n(&peakDepth, __ATOMIC_RELAXED);
+  while ((depth > peak) && !__atomic_compare_exchange_n(&peakDepth, &peak,
+    depth, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+  {
+  }
+
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// LineReader::run()
+//
+// Description:
+//  The reader thread.  It waits for input, splits it into lines just
+//  as BotSock::splitLines() does, and signals the main thread once per
+//  read.  When the connection is closed or fails, an END slot carrying
+//  the error is added and the thread exits.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+LineReader::run(void)
+{
+  std::vector<char> buffer(this->bufferSize_);
+  std::vector<char>::size_type head = 0, tail = 0;
+  bool cr = false, overflow = false;
+  int error = 0;
+
+  for (;;)
+  {
+    struct pollfd fds[2];
+    fds[0].fd = this->fd_;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = this->stopPipe_[0];
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+
+    if (-1 == ::poll(fds, 2, -1))
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+      error = errno;
+      break;
+    }
+
+    if (0 != fds[1].revents)
+    {
+      return;
+    }
+
+    if (head == tail)
+    {
+      head = tail = 0;
+    }
+    else if ((tail == buffer.size()) && (head > 0))
+    {
+      memmove(&buffer[0], &buffer[head], tail - head);
+      tail -= head;
+      head = 0;
+    }
+
+    const int n = ::read(this->fd_, &buffer[tail], buffer.size() - tail);
+
+    if (0 == n)
+    {
+      break;
+    }
+    else if (n < 0)
+    {
+      if ((EAGAIN == errno) || (EINTR == errno))
+      {
+        continue;
+      }
+      error = errno;
+      break;
+    }
+
+    tail += n;
+
+    while (head < tail)
+    {
+      const char * const start = &buffer[head];
+
+      if (cr)
+      {
+        cr = false;
+        if ('\n' == *start)
+        {
+          ++head;
+          continue;
+        }
+      }
+
+      const char * const eol = BotSock::findEol(start, tail - head);
+
+      if (0 == eol)
+      {
+        if ((0 == head) && (tail == buffer.size()))
+        {
+          if (!overflow)
+          {
+            __atomic_add_fetch(&truncatedCount, 1, __ATOMIC_RELAXED);
+            if (!this->deliver(start, tail))
+            {
+              return;
+            }
+          }
+          head = tail = 0;
+          overflow = true;
+        }
+        break;
+      }
+
+      const int length = eol - start;
+
+      head += length + 1;
+      cr = ('\r' == *eol);
+
+      if (overflow)
+      {
+        overflow = false;
+      }
+      else if (!this->deliver(start, length))
+      {
+        return;
+      }
+    }
+
+    this->signal();
+  }
+
+  Slot * slot = this->reserve();
+  if (0 != slot)
+  {
+    slot->type = Slot::END;
+    slot->length = error;
+    this->ring_.commit();
+    this->signal();
+  }
+}
+
+
+void
+LineReader::status(BotClient * client)
+{
+  if ((0 == runningReaders) && (0 == lineCount))
+  {
+    return;
+  }
+
+  std::string msg("Input threads: ");
+  msg += boost::lexical_cast<std::string>(runningReaders);
+  msg += " running, ";
+  msg += boost::lexical_cast<std::string>(
+    __atomic_load_n(&lineCount, __ATOMIC_RELAXED));
+  msg += " lines, peak queue ";
+  msg += boost::lexical_cast<std::string>(
+    __atomic_load_n(&peakDepth, __ATOMIC_RELAXED));
+  msg += " of ";
+  msg += boost::lexical_cast<std::string>(RING_SLOTS);
+  msg += " slots, ";
+  msg += boost::lexical_cast<std::string>(
+    __atomic_load_n(&stallCount, __ATOMIC_RELAXED));
+  msg += " stalls (";
+  msg += boost::lexical_cast<std::string>(
+    __atomic_load_n(&stallMicros, __ATOMIC_RELAXED) / 1000);
+  msg += " ms)";
+  client->send(msg);
+
+  const unsigned long truncated =
+    __atomic_load_n(&truncatedCount, __ATOMIC_RELAXED);
+  if (truncated > 0)
+  {
+    client->send("Truncated threaded input lines: " +
+      boost::lexical_cast<std::string>(truncated));
+  }
+}
+
@@ -0,0 +1,109 @@
+#ifndef __LINEREADER_H__
+#define __LINEREADER_H__
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <vector>
+
+// Boost C++ Headers
+#include <boost/function.hpp>
+#include <boost/utility.hpp>
+
+// OOMon Headers
+#include "oomon.h"
+#include "reactor.h"
+#include "spscring.h"
+
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+
+// Reads lines from a socket on a thread of its own and passes them to
+// the main thread through a SpscRing, so that reading from the socket
+// never waits for the main thread to finish matching the last batch.
+// The reader splits lines the same way BotSock does; lines longer than
+// a slot are carried in several consecutive slots.  When the ring
+// fills up, the reader stops reading until there is room again, which
+// leaves the data in the kernel's socket buffer.  Lines always come out
+// in the order they were received.
+class LineReader : public Reactor::Handler, private boost::noncopyable
+{
+public:
+  typedef boost::function<void (void)> OnReadyHandler;
+
+  enum { SLOT_DATA = 1016 };
+
+  struct Slot
+  {
+    enum Type
+    {
+      LINE,		// A whole line, or the end of one
+      PARTIAL,		// Part of a line continued in the next slot
+      END		// The connection was closed; length is the errno
+    };
+
+    int type;
+    int length;
+    char data[SLOT_DATA];
+  };
+
+  LineReader(const int fd, const std::vector<char>::size_type bufferSize,
+    OnReadyHandler onReady);
+  virtual ~LineReader(void);
+
+  bool start(void);
+  void stop(void);
+
+  // Called only by the main thread
+  const Slot * front(void) const { return this->ring_.front(); }
+  void pop(void);
+  SpscRing<Slot>::size_type capacity(void) const
+    { return this->ring_.capacity(); }
+  void rearm(void);
+
+  static void status(class BotClient * client);
+
+private:
+  virtual void onReady(const int fd, const int events);
+
+  static void * main(void * arg);
+  void run(void);
+  bool deliver(const char *data, int length);
+  Slot * reserve(void);
+  void signal(void);
+
+  const int fd_;
+  const std::vector<char>::size_type bufferSize_;
+  OnReadyHandler onReady_;
+  SpscRing<Slot> ring_;
+  int wakePipe_[2], stopPipe_[2], roomPipe_[2];
+  int signalled_, waiting_;
+  bool running_;
+#ifdef HAVE_PTHREAD_H
+  pthread_t thread_;
+#endif
+};
+
+
+#endif /* __LINEREADER_H__ */
+
@@ -101,7 +101,8 @@ bool Links::Link(const std::string & parent, const std::string & name)
   return false;
 }
 
-bool Links::Unlink(const std::string & name)
+bool Links::Unlink(const std::string & name,
+  std::list<std::string> * removed)
 {
   for (std::list<Links>::iterator pos = Children.begin();
     pos != Children.end(); ++pos)
@@ -112,6 +113,10 @@ bool Links::Unlink(const std::string & name)
 	std::cout << "Unlinking " << pos->getName() << " from " << Name <<
 	  std::endl;
       #endif
+      if (0 != removed)
+      {
+        pos->getNames(*removed);
+      }
       Children.erase(pos);
       return true;
     }
@@ -119,7 +124,7 @@ bool Links::Unlink(const std::string & name)
   for (std::list<Links>::iterator pos = Children.begin();
     pos != Children.end(); ++pos)
   {
-    if (pos->Unlink(name))
+    if (pos->Unlink(name, removed))
     {
       return true;
     }
@@ -172,3 +177,16 @@ Links::getBotList(BotLinkList & list) const
   }
 }
 
+
+// Lists the names of this server and every server linked below it
+void
+Links::getNames(std::list<std::string> & names) const
+{
+  names.push_back(this->getName());
+  for (std::list<Links>::const_iterator pos = Children.begin();
+    pos != Children.end(); ++pos)
+  {
+    pos->getNames(names);
+  }
+}
+
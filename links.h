@@ -52,8 +52,9 @@ public:
   bool Link(const std::string &, const std::string &);	// Connect a
 					// server somewhere in
 					// a tree
-  bool Unlink(const std::string &);	// Disconnect a server from
-				// the tree
+  bool Unlink(const std::string &,	// Disconnect a server from
+    std::list<std::string> * = 0);	// the tree, listing the
+				// servers that went with it
   void setName(const std::string &);	// Set the root's name
 
   std::string getName() const	// Get the root's name
@@ -63,6 +64,7 @@ public:
 
   void getLinks(class BotClient * client, const std::string &) const;
   void getBotList(BotLinkList &) const;
+  void getNames(std::list<std::string> &) const;
 };
 
 #endif /* __LINKS_H__ */
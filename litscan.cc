@@ -0,0 +1,399 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+#include <vector>
+
+// OOMon Headers
+#include "litscan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define LITSCAN_X86 1
+# include <immintrin.h>
+#endif
+
+
+enum ScanIsa
+{
+  ISA_SCALAR, ISA_SSE2, ISA_AVX2
+};
+
+
+static ScanIsa
+bestIsa(void)
+{
+#ifdef LITSCAN_X86
+  static int isa = -1;
+
+  if (isa < 0)
+  {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+      isa = ISA_AVX2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+      isa = ISA_SSE2;
+    }
+    else
+    {
+      isa = ISA_SCALAR;
+    }
+  }
+
+  return static_cast<ScanIsa>(isa);
+#else
+  return ISA_SCALAR;
+#endif
+}
+
+
+// Only ASCII letters are folded, so a literal can never match a byte
+// that is not itself ASCII.
+static inline unsigned char
+fold(const unsigned char c)
+{
+  return ((c >= 'A') && (c <= 'Z')) ? (c | 0x20) : c;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// LiteralScanner::add(literal)
+//
+// Description:
+//  Adds a literal to the set of strings to look for.  Adding the same
+//  literal (ignoring case) more than once returns the same index.
+//
+// Parameters:
+//  literal - The string to search for.
+//
+// Return Value:
+//  The function returns the literal's index in the scan() results, or
+//  -1 if the literal is empty.
+//////////////////////////////////////////////////////////////////////
+int
+LiteralScanner::add(const std::string & literal)
+{
+  if (literal.empty())
+  {
+    return -1;
+  }
+
+  std::string folded(literal);
+  for (std::string::iterator pos = folded.begin(); pos != folded.end(); ++pos)
+  {
+    *pos = fold(*pos);
+  }
+
+  for (std::vector<std::string>::size_type i = 0; i < this->literals_.size();
+    ++i)
+  {
+    if (this->literals_[i] == folded)
+    {
+      return i;
+    }
+  }
+
+  int index = this->literals_.size();
+  this->literals_.push_back(folded);
+
+  Key key;
+  key.first = folded[0];
+  key.second = (folded.length() > 1) ? static_cast<unsigned char>(folded[1]) :
+    -1;
+  this->byFirst_[key.first].push_back(index);
+
+  // A single-character literal makes any longer key with the same first
+  // character redundant, and vice versa, so keep only the broadest key.
+  bool redundant = false;
+  for (std::vector<Key>::iterator pos = this->keys_.begin();
+    pos != this->keys_.end(); )
+  {
+    if ((pos->first == key.first) && ((pos->second == -1) ||
+      (pos->second == key.second)))
+    {
+      redundant = true;
+      break;
+    }
+    else if ((pos->first == key.first) && (key.second == -1))
+    {
+      pos = this->keys_.erase(pos);
+    }
+    else
+    {
+      ++pos;
+    }
+  }
+  if (!redundant)
+  {
+    this->keys_.push_back(key);
+  }
+
+  return index;
+}
+
+
+void
+LiteralScanner::clear(void)
+{
+  this->literals_.clear();
+  this->keys_.clear();
+  for (int i = 0; i < 256; ++i)
+  {
+    this->byFirst_[i].clear();
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// LiteralScanner::check(text, pos, found, remaining)
+//
+// Description:
+//  Compares every literal that has not been found yet and starts with
+//  the same character as text[pos] against the text at that position.
+//
+// Parameters:
+//  text      - The text being scanned.
+//  pos       - The candidate position.
+//  found     - Bits are set here for each literal found.
+//  remaining - The number of literals not found yet.
+//
+// Return Value:
+//  The function returns true if every literal has now been found.
+//////////////////////////////////////////////////////////////////////
+bool
+LiteralScanner::check(const std::string & text,
+  const std::string::size_type pos, Result & found,
+  std::string::size_type & remaining) const
+{
+  const std::vector<int> & bucket =
+    this->byFirst_[fold(static_cast<unsigned char>(text[pos]))];
+  const std::string::size_type avail = text.length() - pos;
+
+  for (std::vector<int>::const_iterator index = bucket.begin();
+    index != bucket.end(); ++index)
+  {
+    const std::string & literal = this->literals_[*index];
+
+    if (!found[*index] && (literal.length() <= avail))
+    {
+      std::string::size_type i = 1;
+      while ((i < literal.length()) &&
+        (fold(static_cast<unsigned char>(text[pos + i])) ==
+        static_cast<unsigned char>(literal[i])))
+      {
+        ++i;
+      }
+      if (i == literal.length())
+      {
+        found.set(*index);
+        if (0 == --remaining)
+        {
+          return true;
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
+
+#ifdef LITSCAN_X86
+__attribute__((target("sse2"))) static inline __m128i
+fold128(const __m128i x)
+{
+  // Shift 'A'..'Z' down to -128..-103 so one signed compare finds them
+  const __m128i t = _mm_add_epi8(x, _mm_set1_epi8(static_cast<char>(0x80 - 'A')));
+  const __m128i upper = _mm_cmplt_epi8(t, _mm_set1_epi8(-128 + 26));
+  return _mm_or_si128(x, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+
+__attribute__((target("sse2"))) std::string::size_type
+LiteralScanner::scanSse2(const std::string & text, Result & found,
+  std::string::size_type & remaining) const
+{
+  const char * data = text.data();
+  const std::string::size_type length = text.length();
+  std::string::size_type pos = 0;
+
+  // Each block also looks at the following byte, so stop one short
+  for (; pos + 17 <= length; pos += 16)
+  {
+    const __m128i a = fold128(_mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(data + pos)));
+    const __m128i b = fold128(_mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(data + pos + 1)));
+
+    __m128i hits = _mm_setzero_si128();
+    for (std::vector<Key>::const_iterator key = this->keys_.begin();
+      key != this->keys_.end(); ++key)
+    {
+      __m128i hit = _mm_cmpeq_epi8(a, _mm_set1_epi8(key->first));
+      if (key->second >= 0)
+      {
+        hit = _mm_and_si128(hit, _mm_cmpeq_epi8(b,
+          _mm_set1_epi8(static_cast<char>(key->second))));
+      }
+      hits = _mm_or_si128(hits, hit);
+    }
+
+    unsigned int mask = _mm_movemask_epi8(hits);
+    while (0 != mask)
+    {
+      if (this->check(text, pos + __builtin_ctz(mask), found, remaining))
+      {
+        return length;
+      }
+      mask &= mask - 1;
+    }
+  }
+
+  return pos;
+}
+
+
+__attribute__((target("avx2"))) static inline __m256i
+fold256(const __m256i x)
+{
+  const __m256i t = _mm256_add_epi8(x,
+    _mm256_set1_epi8(static_cast<char>(0x80 - 'A')));
+  const __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26), t);
+  return _mm256_or_si256(x, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+
+__attribute__((target("avx2"))) std::string::size_type
+LiteralScanner::scanAvx2(const std::string & text, Result & found,
+  std::string::size_type & remaining) const
+{
+  const char * data = text.data();
+  const std::string::size_type length = text.length();
+  std::string::size_type pos = 0;
+
+  for (; pos + 33 <= length; pos += 32)
+  {
+    const __m256i a = fold256(_mm256_loadu_si256(
+      reinterpret_cast<const __m256i *>(data + pos)));
+    const __m256i b = fold256(_mm256_loadu_si256(
+      reinterpret_cast<const __m256i *>(data + pos + 1)));
+
+    __m256i hits = _mm256_setzero_si256();
+    for (std::vector<Key>::const_iterator key = this->keys_.begin();
+      key != this->keys_.end(); ++key)
+    {
+      __m256i hit = _mm256_cmpeq_epi8(a, _mm256_set1_epi8(key->first));
+      if (key->second >= 0)
+      {
+        hit = _mm256_and_si256(hit, _mm256_cmpeq_epi8(b,
+          _mm256_set1_epi8(static_cast<char>(key->second))));
+      }
+      hits = _mm256_or_si256(hits, hit);
+    }
+
+    unsigned int mask = _mm256_movemask_epi8(hits);
+    while (0 != mask)
+    {
+      if (this->check(text, pos + __builtin_ctz(mask), found, remaining))
+      {
+        return length;
+      }
+      mask &= mask - 1;
+    }
+  }
+
+  return pos;
+}
+#endif /* LITSCAN_X86 */
+
+
+//////////////////////////////////////////////////////////////////////
+// LiteralScanner::scan(text, found)
+//
+// Description:
+//  Finds every literal that appears in a block of text, ignoring ASCII
+//  case.  Scanning stops as soon as all of the literals have been
+//  found.
+//
+// Parameters:
+//  text  - The text to scan.
+//  found - Receives one bit per literal, set if the literal was found.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+LiteralScanner::scan(const std::string & text, Result & found) const
+{
+  found.resize(this->literals_.size());
+  found.reset();
+
+  std::string::size_type remaining = this->literals_.size();
+  if (0 == remaining)
+  {
+    return;
+  }
+
+  std::string::size_type pos = 0;
+
+#ifdef LITSCAN_X86
+  switch (bestIsa())
+  {
+    case ISA_AVX2:
+      pos = this->scanAvx2(text, found, remaining);
+      break;
+    case ISA_SSE2:
+      pos = this->scanSse2(text, found, remaining);
+      break;
+    case ISA_SCALAR:
+      break;
+  }
+#endif
+
+  for (; pos < text.length(); ++pos)
+  {
+    if (this->check(text, pos, found, remaining))
+    {
+      break;
+    }
+  }
+}
+
+
+std::string
+LiteralScanner::isa(void)
+{
+  switch (bestIsa())
+  {
+    case ISA_AVX2:
+      return "AVX2";
+    case ISA_SSE2:
+      return "SSE2";
+    case ISA_SCALAR:
+      break;
+  }
+
+  return "scalar";
+}
+
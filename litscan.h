@@ -0,0 +1,77 @@
+#ifndef __LITSCAN_H__
+#define __LITSCAN_H__
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+#include <vector>
+
+// Boost C++ Headers
+#include <boost/dynamic_bitset.hpp>
+
+
+// Finds which of a set of literal strings appear in a block of text,
+// ignoring ASCII case, in a single pass over the text.  On x86 CPUs
+// candidate positions are located 16 or 32 bytes at a time with SSE2 or
+// AVX2, whichever is the best the CPU supports.
+class LiteralScanner
+{
+public:
+  typedef boost::dynamic_bitset<> Result;
+
+  LiteralScanner(void) { }
+
+  int add(const std::string & literal);
+  void clear(void);
+
+  std::vector<std::string>::size_type size(void) const
+  {
+    return this->literals_.size();
+  }
+  bool empty(void) const { return this->literals_.empty(); }
+
+  void scan(const std::string & text, Result & found) const;
+
+  static std::string isa(void);
+
+private:
+  struct Key
+  {
+    unsigned char first;
+    int second;		// -1 for single-character literals
+  };
+
+  std::vector<std::string> literals_;
+  std::vector<Key> keys_;
+  std::vector<int> byFirst_[256];
+
+  bool check(const std::string & text, const std::string::size_type pos,
+    Result & found, std::string::size_type & remaining) const;
+  std::string::size_type scanSse2(const std::string & text, Result & found,
+    std::string::size_type & remaining) const;
+  std::string::size_type scanAvx2(const std::string & text, Result & found,
+    std::string::size_type & remaining) const;
+};
+
+
+#endif /* __LITSCAN_H__ */
+
@@ -19,15 +19,37 @@
 
 // $Id$
 
-#include <fstream>
+// Std C++ Headers
+#include <algorithm>
 #include <iostream>
 #include <string>
+#include <cerrno>
+#include <ctime>
 
+// Boost C++ Headers
+#include <boost/lexical_cast.hpp>
+
+// Std C Headers
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// OOMon Headers
 #include "oomon.h"
 #include "log.h"
 #include "config.h"
 #include "main.h"
 #include "util.h"
+#include "vars.h"
+#include "timers.h"
+#include "defaults.h"
+#include "botclient.h"
+
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
 
 
 #ifdef DEBUG
@@ -35,37 +57,468 @@
 #endif
 
 
-std::ofstream Log::logfile;
+// The writer is woken before the flush interval is up once this much
+// has been queued
+static const std::string::size_type FLUSH_BYTES = 65536;
+
+static int queueSize(DEFAULT_LOG_QUEUE_SIZE);
+static int flushInterval(DEFAULT_LOG_FLUSH_INTERVAL);
+static int rotateSize(DEFAULT_LOG_ROTATE_SIZE);
+static int rotateInterval(DEFAULT_LOG_ROTATE_INTERVAL);
+static int rotateKeep(DEFAULT_LOG_ROTATE_KEEP);
+
+// The queue of formatted lines, shared with the writer thread and only
+// touched while holding the lock
+static std::string queue;
+static unsigned long queuedLines = 0;
+static bool flushNow = false;
+static bool stopping = false;
+
+// The log file, which belongs to the writer thread while it runs
+static std::string filename;
+static int fd = -1;
+static off_t fileSize = 0;
+static std::time_t fileOpened = 0;
+
+// Used only by the main thread
+static std::time_t stampTime = 0;
+static std::string stamp;
+static bool overflowing = false;
+static bool running = false;
+static Timers::Id flushTimer = 0;
+
+// Statistics.  The writer thread updates its counters with atomic
+// operations, so they may be read at any time.
+static unsigned long writtenLines = 0;
+static unsigned long droppedLines = 0;
+static unsigned long overflowCount = 0;
+static unsigned long peakQueued = 0;
+static unsigned long rotationCount = 0;
+static unsigned long writeErrors = 0;
+
+#ifdef HAVE_PTHREAD_H
+static pthread_t writer;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+#endif
+
+
+// Holds the queue lock for as long as it exists
+class QueueLock
+{
+public:
+#ifdef HAVE_PTHREAD_H
+  QueueLock(void) { pthread_mutex_lock(&lock); }
+  ~QueueLock(void) { pthread_mutex_unlock(&lock); }
+#endif
+};
+
+
 bool Log::IsOpen = false;
 
-void Log::Start()
+
+static bool
+openFile(void)
+{
+  fd = ::open(filename.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0666);
+  if (-1 == fd)
+  {
+    return false;
+  }
+  ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+  struct stat info;
+  fileSize = (0 == ::fstat(fd, &info)) ? info.st_size : 0;
+  fileOpened = std::time(0);
+
+  return true;
+}
+
+
+static void
+closeFile(void)
+{
+  if (-1 != fd)
+  {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// rotate()
+//
+// Description:
+//  Renames the log file to <name>.1, after renaming each older copy
+//  up to LOG_ROTATE_KEEP to the next number, and opens a new one.
+//  The oldest copy is overwritten.  If LOG_ROTATE_KEEP is 0, the log
+//  file is simply started over.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+static void
+rotate(void)
+{
+  const int keep = __atomic_load_n(&rotateKeep, __ATOMIC_RELAXED);
+
+  closeFile();
+
+  if (keep > 0)
+  {
+    for (int i = keep - 1; i > 0; --i)
+    {
+      ::rename((filename + '.' + boost::lexical_cast<std::string>(i)).c_str(),
+        (filename + '.' + boost::lexical_cast<std::string>(i + 1)).c_str());
+    }
+    ::rename(filename.c_str(), (filename + ".1").c_str());
+  }
+  else
+  {
+    ::unlink(filename.c_str());
+  }
+
+  openFile();
+
+  __atomic_add_fetch(&rotationCount, 1, __ATOMIC_RELAXED);
+}
+
+
+// writeBatch(batch, lines)
+//
+// Appends a batch of lines to the log file, rotating it first if it
+// has grown too large or too old.  Called by the writer thread, or by
+// the main thread if there is no writer.
+//
+static void
+writeBatch(const std::string & batch, const unsigned long lines)
+{
+  const int size = __atomic_load_n(&rotateSize, __ATOMIC_RELAXED);
+  const int age = __atomic_load_n(&rotateInterval, __ATOMIC_RELAXED);
+
+  if ((-1 != fd) && (((size > 0) && (fileSize >= size)) ||
+    ((age > 0) && (std::time(0) - fileOpened >= age))))
+  {
+    rotate();
+  }
+
+  if (-1 == fd)
+  {
+    __atomic_add_fetch(&writeErrors, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  const char *data = batch.data();
+  std::string::size_type left = batch.length();
+
+  while (left > 0)
+  {
+    const ssize_t n = ::write(fd, data, left);
+
+    if (n < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+      __atomic_add_fetch(&writeErrors, 1, __ATOMIC_RELAXED);
+      break;
+    }
+
+    data += n;
+    left -= n;
+    fileSize += n;
+  }
+
+  __atomic_add_fetch(&writtenLines, lines, __ATOMIC_RELAXED);
+}
+
+
+// drain()
+//
+// Writes out everything queued so far.  The lock is only held while
+// taking the queue, not while writing it.
+//
+static void
+drain(std::string & batch)
+{
+  unsigned long lines;
+
+  {
+    QueueLock guard;
+
+    batch.swap(queue);
+    lines = queuedLines;
+    queuedLines = 0;
+    flushNow = false;
+  }
+
+  if (!batch.empty())
+  {
+    writeBatch(batch, lines);
+    batch.clear();
+  }
+}
+
+
+// flush()
+//
+// Writes the queue from the main thread when there is no writer thread.
+//
+static void
+flush(void)
+{
+  static std::string batch;
+
+  drain(batch);
+}
+
+
+#ifdef HAVE_PTHREAD_H
+//////////////////////////////////////////////////////////////////////
+// writerMain(arg)
+//
+// Description:
+//  The writer thread.  It sleeps until LOG_FLUSH_INTERVAL has passed
+//  or it is woken because enough has been queued, writes out the whole
+//  queue, and goes back to sleep.  When told to stop, it writes out
+//  whatever is left and exits.  Apart from the queue, it touches only
+//  the log file and the statistics.
+//
+// Parameters:
+//  arg - Unused.
+//
+// Return Value:
+//  The function always returns 0.
+//////////////////////////////////////////////////////////////////////
+static void *
+writerMain(void *)
+{
+  std::string batch;
+  bool done = false;
+
+  while (!done)
+  {
+    pthread_mutex_lock(&lock);
+    while (!flushNow && !stopping)
+    {
+      const int interval = __atomic_load_n(&flushInterval, __ATOMIC_RELAXED);
+
+      if (interval > 0)
+      {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += interval;
+
+        if (ETIMEDOUT == pthread_cond_timedwait(&wake, &lock, &deadline))
+        {
+          break;
+        }
+      }
+      else
+      {
+        pthread_cond_wait(&wake, &lock);
+      }
+    }
+    done = stopping;
+    pthread_mutex_unlock(&lock);
+
+    drain(batch);
+  }
+
+  return 0;
+}
+#endif
+
+
+void
+Log::Start()
 {
   if (!IsOpen)
   {
 #ifdef LOG_DEBUG
     std::cout << "Opening log file for append" << std::endl;
 #endif
-    logfile.open(config.logFilename().c_str(), std::ios::app);
+    filename = config.logFilename();
+    openFile();
+    stopping = false;
+
+#ifdef HAVE_PTHREAD_H
+    // The writer must not take signals meant for the main thread
+    sigset_t all, saved;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    running = (0 == pthread_create(&writer, 0, writerMain, 0));
+    pthread_sigmask(SIG_SETMASK, &saved, 0);
+#endif
+
+    if (!running)
+    {
+      flushTimer = Timers::instance().every(1, flush);
+    }
+
     IsOpen = true;
   }
 }
 
-void Log::Write(const std::string & Text)
+
+//////////////////////////////////////////////////////////////////////
+// Log::Write(Text)
+//
+// Description:
+//  Queues a line for the log file, prefixed with the time.  The time
+//  is only formatted again when the second changes.  If the queue is
+//  already holding LOG_QUEUE_SIZE bytes, the line is dropped.
+//
+// Parameters:
+//  Text - The line to log.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+Log::Write(const std::string & Text)
 {
   if (IsOpen)
   {
-    logfile << '[' << ::timeStamp(TIMESTAMP_LOG) << "] " << Text << std::endl;
+    const std::time_t now = std::time(0);
+
+    if (now != stampTime)
+    {
+      stampTime = now;
+      stamp = '[' + ::timeStamp(TIMESTAMP_LOG, now) + "] ";
+    }
+
+    const std::string::size_type limit =
+      static_cast<std::string::size_type>(queueSize);
+    bool signal = false;
+
+    {
+      QueueLock guard;
+
+      if (queue.length() + stamp.length() + Text.length() + 1 > limit)
+      {
+        ++droppedLines;
+        if (!overflowing)
+        {
+          overflowing = true;
+          ++overflowCount;
+        }
+        return;
+      }
+      overflowing = false;
+
+      queue += stamp;
+      queue += Text;
+      queue += '\n';
+      ++queuedLines;
+
+      if (queue.length() > peakQueued)
+      {
+        peakQueued = queue.length();
+      }
+
+      if (!flushNow && ((0 == flushInterval) ||
+        (queue.length() >= std::min(FLUSH_BYTES, limit / 2))))
+      {
+        flushNow = true;
+        signal = true;
+#ifdef HAVE_PTHREAD_H
+        if (running)
+        {
+          pthread_cond_signal(&wake);
+        }
+#endif
+      }
+    }
+
+    if (signal && !running)
+    {
+      flush();
+    }
   }
 }
 
-void Log::Stop()
+
+void
+Log::Stop()
 {
   if (IsOpen)
   {
 #ifdef LOG_DEBUG
     std::cout << "Closing log file" << std::endl;
 #endif
-    logfile.close();
+#ifdef HAVE_PTHREAD_H
+    if (running)
+    {
+      {
+        QueueLock guard;
+        stopping = true;
+        pthread_cond_signal(&wake);
+      }
+      pthread_join(writer, 0);
+      running = false;
+    }
+#endif
+
+    if (0 != flushTimer)
+    {
+      Timers::instance().cancel(flushTimer);
+      flushTimer = 0;
+      flush();
+    }
+
+    closeFile();
     IsOpen = false;
   }
 }
+
+
+void
+Log::init(void)
+{
+  vars.insert("LOG_FLUSH_INTERVAL",
+      Setting::IntegerSetting(flushInterval, 0));
+  vars.insert("LOG_QUEUE_SIZE", Setting::IntegerSetting(queueSize, 4096));
+  vars.insert("LOG_ROTATE_INTERVAL",
+      Setting::IntegerSetting(rotateInterval, 0));
+  vars.insert("LOG_ROTATE_KEEP", Setting::IntegerSetting(rotateKeep, 0));
+  vars.insert("LOG_ROTATE_SIZE", Setting::IntegerSetting(rotateSize, 0));
+}
+
+
+unsigned long
+Log::queued(void)
+{
+  QueueLock guard;
+
+  return queue.length();
+}
+
+
+void
+Log::status(BotClient * client)
+{
+  const unsigned long queued = Log::queued();
+
+  client->send("Log: " + boost::lexical_cast<std::string>(
+    __atomic_load_n(&writtenLines, __ATOMIC_RELAXED)) + " lines written, " +
+    boost::lexical_cast<std::string>(queued) + " bytes queued (peak " +
+    boost::lexical_cast<std::string>(peakQueued) + "), " +
+    boost::lexical_cast<std::string>(
+    __atomic_load_n(&rotationCount, __ATOMIC_RELAXED)) + " rotations" +
+    (running ? "" : ", no writer thread"));
+
+  if ((droppedLines > 0) || (writeErrors > 0))
+  {
+    client->send("Log: " + boost::lexical_cast<std::string>(droppedLines) +
+      " lines dropped in " + boost::lexical_cast<std::string>(overflowCount) +
+      " overflows, " + boost::lexical_cast<std::string>(
+      __atomic_load_n(&writeErrors, __ATOMIC_RELAXED)) + " write errors");
+  }
+}
+
@@ -22,18 +22,28 @@
 // $Id$
 
 // C++ Headers
-#include <fstream>
 #include <string>
 
+
+// Writes the log file.  Lines are formatted and queued by the main
+// thread, and a writer thread appends them to the file in batches, so a
+// slow disk can't hold up the monitor bot during a flood.  The queue is
+// written whenever LOG_FLUSH_INTERVAL passes or enough has built up.
+// When the queue is full, new lines are dropped and counted rather than
+// waiting for the disk.  The writer also rotates the file once it
+// reaches LOG_ROTATE_SIZE or LOG_ROTATE_INTERVAL.  Without thread
+// support the queue is written by the main thread instead.
 class Log
 {
 private:
-  static std::ofstream logfile;
   static bool IsOpen;
 public:
+  static void init(void);
   static void Start();
   static void Write(const std::string & Text);
   static void Stop();
+  static void status(class BotClient * client);
+  static unsigned long queued(void);
 };
 
 #endif /* __LOG_H__ */
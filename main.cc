@@ -42,6 +42,10 @@
 // OOMon Headers
 #include "oomon.h"
 #include "main.h"
+#include "actionbatch.h"
+#include "capture.h"
+#include "journal.h"
+#include "stats.h"
 #include "config.h"
 #include "irc.h"
 #include "services.h"
@@ -52,13 +56,18 @@
 #include "dcc.h"
 #include "watch.h"
 #include "remotelist.h"
+#include "remote.h"
+#include "botsock.h"
 #include "botexcept.h"
 #include "botclient.h"
 #include "userdb.h"
 #include "adnswrap.h"
+#include "reactor.h"
+#include "timers.h"
 #include "dnsbl.h"
 #include "engine.h"
 #include "userhash.h"
+#include "pattern.h"
 
 
 #ifdef DEBUG
@@ -84,6 +93,11 @@ SendAll(const std::string & message, const UserFlags flags,
 {
   clients.sendAll(message, flags, watches, skip);
 
+  if (remotes.empty())
+  {
+    return;
+  }
+
   if ((0 == skip) || Same(skip->bot(), config.nickname()))
   {
     remotes.sendBroadcast(config.nickname(), message,
@@ -99,34 +113,60 @@ SendAll(const std::string & message, const UserFlags flags,
 }
 
 
+// Sends a QUIT to every server that is connected
+static void
+quitAll(const std::string & message)
+{
+  for (IRC::List::const_iterator pos = IRC::list().begin();
+    pos != IRC::list().end(); ++pos)
+  {
+    if ((*pos)->isConnected())
+    {
+      (*pos)->quit(message);
+    }
+  }
+}
+
+
+// Set by the signal handlers and acted on by process(), since almost
+// nothing (the log included) is safe to touch from inside a handler
+static volatile std::sig_atomic_t caughtSignal = 0;
+static volatile std::sig_atomic_t caughtHangup = 0;
+
+
 RETSIGTYPE
 gracefuldie(int sig)
+{
+  if ((sig == SIGTERM) || (sig == SIGINT))
+  {
+    caughtSignal = sig;
+  }
+  else
+  {
+    // Nothing can be trusted after a crash
+    abort();
+  }
+}
+
+
+// terminated(sig)
+//
+// Shuts down after gracefuldie() has caught a SIGTERM or SIGINT.
+//
+static void
+terminated(const int sig)
 {
   if (sig == SIGTERM)
   {
     ::SendAll("Caught SIGTERM -- OOMon terminating");
     Log::Write("Caught SIGTERM -- OOMon stopped");
-    if (server.isConnected())
-    {
-      server.quit();
-    }
+    quitAll("Normal termination");
   }
-  else if (sig == SIGINT)
+  else
   {
     ::SendAll("Caught SIGINT -- OOMon terminating");
     Log::Write("Caught SIGINT -- OOMon stopped");
-    if (server.isConnected())
-    {
-      server.quit("Caught SIGINT -- User pressed Ctrl+C?");
-    }
-  }
-  else
-  {
-    if (server.isConnected())
-    {
-      server.quit("Abnormal termination!");
-    }
-    abort();
+    quitAll("Caught SIGINT -- User pressed Ctrl+C?");
   }
 
   Log::Stop();
@@ -146,6 +186,7 @@ reload(void)
     Log::Stop();
     Log::Start();
     config.loadSettings();
+    IRC::configure();
     remotes.listen();
     try
     {
@@ -183,10 +224,7 @@ hangup(int sig)
 {
   if (sig == SIGHUP)
   {
-    std::string notice("Caught SIGHUP -- Reloading config");
-    Log::Write(notice);
-    ::SendAll("*** " + notice, UserFlags::OPER);
-    reload();
+    caughtHangup = 1;
     std::signal(SIGHUP, hangup);
   }
 }
@@ -195,111 +233,98 @@ hangup(int sig)
 bool
 process()
 {
-  std::time_t nextConnectAttempt(0);
-  std::time_t attemptWait(1);
-
   for (;;)
   {
-    std::time_t now(time(0));
+    if (caughtSignal)
+    {
+      terminated(caughtSignal);
+    }
 
-    if (!server.isConnected() && !server.isConnecting() &&
-        (now >= nextConnectAttempt))
+    if (caughtHangup)
     {
-      nextConnectAttempt = now + attemptWait;
+      caughtHangup = 0;
 
-      std::string notice("Connecting to IRC server at ");
-      notice += config.serverAddress();
-      notice += ':';
-      notice += boost::lexical_cast<std::string>(config.serverPort());
-#ifdef MAIN_DEBUG
-      std::cout << notice << std::endl;
-#endif
+      std::string notice("Caught SIGHUP -- Reloading config");
       Log::Write(notice);
-      server.bindTo(config.hostname());
-      if (server.connect(config.serverAddress(), config.serverPort()))
-      {
-        // Success!
-        attemptWait = 1;
-      }
-      else
-      {
-        if (attemptWait < 120)
-        {
-          attemptWait *= 2;
-        }
-        std::string notice("Connect failed");
-#ifdef MAIN_DEBUG
-        std::cout << notice << std::endl;
-#endif
-        Log::Write(notice);
-	server.reset();
-      }
+      ::SendAll("*** " + notice, UserFlags::OPER);
+      reload();
     }
 
-    fd_set readfds, writefds, exceptfds;
-    FD_ZERO(&readfds);
-    FD_ZERO(&writefds);
-    FD_ZERO(&exceptfds);
-    int maxfd = 0;
+    const IRC::List & servers = IRC::list();
+
+    std::time_t now(time(0));
+
+    for (IRC::List::const_iterator irc = servers.begin(); irc != servers.end();
+      ++irc)
+    {
+      (*irc)->reconnect(now);
+    }
 
-    struct timeval time_out;
-    time_out.tv_sec = 5;
-    time_out.tv_usec = 0;
+    int timeout = Timers::instance().timeout();
+    adns.prePoll(timeout);
 
-    struct timeval * tv_mod = &time_out;
-    adns.preSelect(maxfd, readfds, writefds, exceptfds, tv_mod);
-    server.preSelect(readfds, writefds);
-    clients.preSelect(readfds, writefds);
-    remotes.preSelect(readfds, writefds);
-    proxies.preSelect(readfds, writefds);
+    for (IRC::List::const_iterator irc = servers.begin(); irc != servers.end();
+      ++irc)
+    {
+      int pace = (*irc)->pacingTimeout();
+      if ((pace >= 0) && ((timeout < 0) || (pace < timeout)))
+      {
+        timeout = pace;
+      }
+    }
 
-    int fds = select(FD_SETSIZE, &readfds, &writefds, NULL, tv_mod);
+    int fds = Reactor::instance().wait(timeout);
 
     if (fds >= 0)
     {
-      adns.postSelect(maxfd, readfds, writefds, exceptfds);
+      Timers::instance().run();
 
-      try
+      adns.postPoll();
+
+      for (IRC::List::const_iterator irc = servers.begin();
+        irc != servers.end(); ++irc)
       {
-        if ((server.isConnected() || server.isConnecting()) &&
-          !server.postSelect(readfds, writefds))
+        IRC::Context context(*irc);
+
+        try
         {
-          std::string notice("Disconnected from IRC server.");
+          if (((*irc)->isConnected() || (*irc)->isConnecting()) &&
+            !(*irc)->process())
+          {
+            std::string notice("Disconnected from IRC server at " +
+              (*irc)->getAddress());
 #ifdef MAIN_DEBUG
-          std::cout << notice << std::endl;
+            std::cout << notice << std::endl;
 #endif
-          Log::Write(notice);
-          server.reset();
+            Log::Write(notice);
+            (*irc)->reset();
+          }
+        }
+        catch (OOMon::timeout_error)
+        {
+          std::cerr << "Connection to IRC server timed out." << std::endl;
+          (*irc)->quit("Server inactive for " +
+            boost::lexical_cast<std::string>((*irc)->getIdle()) + " seconds");
         }
       }
-      catch (OOMon::timeout_error)
-      {
-        std::cerr << "Connection to IRC server timed out." << std::endl;
-        server.quit("Server inactive for " +
-	  boost::lexical_cast<std::string>(server.getIdle()) + " seconds");
-      }
-
-      server.checkUserDelta();
 
-      clients.postSelect(readfds, writefds);
+      clients.process();
 
-      remotes.postSelect(readfds, writefds);
+      remotes.process();
 
 #ifdef HAVE_LIBADNS
       dnsbl.process();
 #endif /* HAVE_LIBADNS */
 
-      proxies.postSelect(readfds, writefds);
-
-      if (server.isConnected())
-      {
-        services.check();
-      }
+      proxies.process();
     }
     else if (fds == -1)
     {
       // some sort of error occurred (probably EINTR because of signal)
     }
+
+    // Send everything the botnet links were given during this pass
+    BotSock::flushBatches();
   }
   return true;
 }
@@ -373,11 +398,18 @@ initModules(void)
   Config::init();
   CommandParser::init();
   IRC::init();
+  ActionBatch::init();
+  Capture::init();
+  Journal::init();
+  Stats::init();
+  Log::init();
   DCC::init();
+  Remote::init();
   Services::init();
   UserHash::init();
   Dnsbl::init();
   ProxyList::init();
+  RegExPattern::init();
 }
 
 
@@ -450,6 +482,7 @@ main(int argc, char **argv)
   initModules();
 
   config.loadSettings();
+  IRC::configure();
 
   if (alreadyRunning())
   {
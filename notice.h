@@ -246,8 +246,8 @@ public:
       this->userhost + ")", UserFlags::OPER, WATCH_FLOODERS);
 
     doAction(this->nick, this->userhost,
-        ::users.getIP(this->nick, this->userhost), flooderAction, flooderReason,
-        true);
+        ::users().getIP(this->nick, this->userhost), flooderAction,
+        flooderReason, true);
   }
 
   bool expired(const std::time_t interval) const
@@ -337,8 +337,8 @@ public:
       this->userhost + ")", UserFlags::OPER, WATCH_SPAMBOTS);
 
     doAction(this->nick, this->userhost,
-        ::users.getIP(this->nick, this->userhost), spambotAction, spambotReason,
-        true);
+        ::users().getIP(this->nick, this->userhost), spambotAction,
+        spambotReason, true);
   }
 
   bool expired(const std::time_t interval) const
@@ -414,8 +414,8 @@ public:
       this->userhost + ")", UserFlags::OPER, WATCH_TOOMANYS);
 
     doAction(this->nick, this->userhost,
-        ::users.getIP(this->nick, this->userhost), toomanyAction, toomanyReason,
-        true);
+        ::users().getIP(this->nick, this->userhost), toomanyAction,
+        toomanyReason, true);
   }
 
   bool expired(const std::time_t interval) const
@@ -491,7 +491,7 @@ public:
       this->userhost + ")", UserFlags::OPER, WATCH_CONNFLOOD);
 
     doAction(this->nick, this->userhost,
-        ::users.getIP(this->nick, this->userhost), connectFloodAction,
+        ::users().getIP(this->nick, this->userhost), connectFloodAction,
         connectFloodReason, true);
   }
 
@@ -539,25 +539,25 @@ public:
     // Failed OPER attempt - host mismatch by ToastTEST (toast@cs6669210-179.austin.rr.com)
     std::string copy = notice;
 
-    if (server.downCase(FirstWord(copy)) != "failed")
+    if (server().downCase(FirstWord(copy)) != "failed")
       throw OOMon::notice_parse_error("operfail notice");
 
-    if (server.downCase(FirstWord(copy)) != "oper")
+    if (server().downCase(FirstWord(copy)) != "oper")
       throw OOMon::notice_parse_error("operfail notice");
 
-    if (server.downCase(FirstWord(copy)) != "attempt")
+    if (server().downCase(FirstWord(copy)) != "attempt")
       throw OOMon::notice_parse_error("operfail notice");
 
-    if (server.downCase(FirstWord(copy)) != "-")
+    if (server().downCase(FirstWord(copy)) != "-")
       throw OOMon::notice_parse_error("operfail notice");
 
-    if (server.downCase(FirstWord(copy)) != "host")
+    if (server().downCase(FirstWord(copy)) != "host")
       throw OOMon::notice_parse_error("operfail notice");
 
-    if (server.downCase(FirstWord(copy)) != "mismatch")
+    if (server().downCase(FirstWord(copy)) != "mismatch")
       throw OOMon::notice_parse_error("operfail notice");
 
-    if (server.downCase(FirstWord(copy)) != "by")
+    if (server().downCase(FirstWord(copy)) != "by")
       throw OOMon::notice_parse_error("operfail notice");
 
     this->nick = FirstWord(copy);
@@ -585,7 +585,7 @@ public:
       " (" + this->userhost + ")", UserFlags::OPER, WATCH_OPERFAILS);
 
     doAction(this->nick, this->userhost,
-        ::users.getIP(this->nick, this->userhost), operfailAction,
+        ::users().getIP(this->nick, this->userhost), operfailAction,
         operfailReason, true);
   }
 
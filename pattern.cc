@@ -21,6 +21,9 @@
 
 // Std C++ Headers
 #include <string>
+#include <cctype>
+#include <list>
+#include <map>
 
 // Boost C++ Headers
 #include <boost/lexical_cast.hpp>
@@ -34,8 +37,13 @@
 #include "botexcept.h"
 #include "util.h"
 #include "irc.h"
+#include "vars.h"
+#include "defaults.h"
 
-#if defined(HAVE_LIBPCRE)
+#if defined(HAVE_LIBPCRE2)
+# define PCRE2_CODE_UNIT_WIDTH 8
+# include <pcre2.h>
+#elif defined(HAVE_LIBPCRE)
 # include <pcre.h>
 #elif defined(HAVE_POSIX_REGEX)
 # include <regex.h>
@@ -47,6 +55,377 @@ static unsigned long patternCount = 0;
 #endif
 
 
+bool RegExPattern::useJit_(DEFAULT_REGEX_JIT);
+
+
+// Patterns never change once they are built, so everyone asking for the
+// same pattern can share one copy.  The cache keeps the most recently
+// used patterns at the front of the list.
+typedef std::list<std::pair<std::string, PatternPtr> > PatternLru;
+typedef std::map<std::string, PatternLru::iterator> PatternIndex;
+
+static PatternLru cacheLru;
+static PatternIndex cacheIndex;
+static int cacheSize(DEFAULT_PATTERN_CACHE_SIZE);
+static unsigned long cacheHits = 0;
+static unsigned long cacheMisses = 0;
+
+
+// Drops the least recently used patterns until the cache fits, which
+// also takes care of PATTERN_CACHE_SIZE being lowered.
+static void
+trimCache(void)
+{
+  while (cacheIndex.size() > static_cast<PatternIndex::size_type>(cacheSize))
+  {
+    cacheIndex.erase(cacheLru.back().first);
+    cacheLru.pop_back();
+  }
+}
+
+
+#if defined(HAVE_LIBPCRE2)
+//////////////////////////////////////////////////////////////////////
+// jitContext()
+//
+// Description:
+//  Returns the match context used for all JIT matches.  The context
+//  and its JIT stack are allocated once and shared by every pattern,
+//  so matching never allocates memory.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns the shared match context, or NULL if it could
+//  not be allocated (in which case PCRE2 uses its default stack).
+//////////////////////////////////////////////////////////////////////
+static pcre2_match_context *
+jitContext(void)
+{
+  static pcre2_match_context * context = NULL;
+
+  if (NULL == context)
+  {
+    context = pcre2_match_context_create(NULL);
+    if (NULL != context)
+    {
+      pcre2_jit_stack * stack = pcre2_jit_stack_create(32 * 1024, 512 * 1024,
+        NULL);
+      if (NULL != stack)
+      {
+        pcre2_jit_stack_assign(context, NULL, stack);
+      }
+    }
+  }
+
+  return context;
+}
+#endif
+
+
+// Characters that upCase() maps differently depending on the server's
+// CASEMAPPING.  Leaving them out of literals lets the trap prefilter
+// fold case the same way no matter what the server uses.
+static const std::string MAPPED_CHARS("[]\\^{}|~");
+
+
+static bool
+isLiteralChar(const char c)
+{
+  return (c >= 0x20) && (c <= 0x7e) &&
+    (std::string::npos == MAPPED_CHARS.find(c));
+}
+
+
+static void
+keepLongest(std::string & best, std::string & run)
+{
+  if (run.length() > best.length())
+  {
+    best = run;
+  }
+  run.clear();
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// maskLiteral(mask, special)
+//
+// Description:
+//  Finds the longest run of non-wildcard characters in a cluster mask.
+//  Every string the mask matches must contain that run.
+//
+// Parameters:
+//  mask    - The cluster mask.
+//  special - Whether '#', '&', and '%' are wildcards (nick masks).
+//
+// Return Value:
+//  The function returns the longest literal run in the mask.
+//////////////////////////////////////////////////////////////////////
+static std::string
+maskLiteral(const std::string & mask, const bool special)
+{
+  std::string best;
+  std::string run;
+
+  for (std::string::const_iterator pos = mask.begin(); pos != mask.end();
+    ++pos)
+  {
+    const char c = *pos;
+    if ((c == '*') || (c == '?') ||
+      (special && ((c == '#') || (c == '&') || (c == '%'))) ||
+      !isLiteralChar(c))
+    {
+      keepLongest(best, run);
+    }
+    else
+    {
+      run += c;
+    }
+  }
+  keepLongest(best, run);
+
+  return best;
+}
+
+
+// Skips a bracket expression starting at re[pos], returning the position
+// of the first character after it, or npos if it can't be parsed safely.
+static std::string::size_type
+skipClass(const std::string & re, std::string::size_type pos)
+{
+  ++pos;
+  if ((pos < re.length()) && (re[pos] == '^'))
+  {
+    ++pos;
+  }
+  if ((pos < re.length()) && (re[pos] == ']'))
+  {
+    ++pos;
+  }
+
+  while (pos < re.length())
+  {
+    const char c = re[pos];
+    if (c == ']')
+    {
+      return pos + 1;
+    }
+    else if (c == '\\')
+    {
+      // PCRE and POSIX disagree about backslashes in bracket expressions
+      return std::string::npos;
+    }
+    else if ((c == '[') && (pos + 1 < re.length()) &&
+      ((re[pos + 1] == ':') || (re[pos + 1] == '.') || (re[pos + 1] == '=')))
+    {
+      std::string::size_type end = re.find(std::string(1, re[pos + 1]) + ']',
+        pos + 2);
+      if (std::string::npos == end)
+      {
+        return std::string::npos;
+      }
+      pos = end + 2;
+    }
+    else
+    {
+      ++pos;
+    }
+  }
+
+  return std::string::npos;
+}
+
+
+// Skips a parenthesized group starting at re[pos], returning the position
+// of the first character after it, or npos if it can't be parsed safely.
+static std::string::size_type
+skipGroup(const std::string & re, std::string::size_type pos)
+{
+  int depth = 0;
+
+  while (pos < re.length())
+  {
+    const char c = re[pos];
+    if (c == '\\')
+    {
+      pos += 2;
+    }
+    else if (c == '[')
+    {
+      pos = skipClass(re, pos);
+      if (std::string::npos == pos)
+      {
+        return std::string::npos;
+      }
+    }
+    else if (c == '(')
+    {
+      // Inline options such as (?x) or (?i) change how the rest of the
+      // expression is read.
+      if ((pos + 2 < re.length()) && (re[pos + 1] == '?') &&
+        (re[pos + 2] != ':'))
+      {
+        return std::string::npos;
+      }
+      ++depth;
+      ++pos;
+    }
+    else if (c == ')')
+    {
+      ++pos;
+      if (0 == --depth)
+      {
+        return pos;
+      }
+    }
+    else
+    {
+      ++pos;
+    }
+  }
+
+  return std::string::npos;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// regexLiteral(re)
+//
+// Description:
+//  Finds the longest run of plain characters outside of any group,
+//  bracket expression, or quantifier in a regular expression.  Every
+//  string the expression matches must contain that run.  Anything the
+//  parser doesn't fully understand (top-level alternation, inline
+//  options, back-references, etc.) yields no literal at all.
+//
+// Parameters:
+//  re - The regular expression, without slashes or flags.
+//
+// Return Value:
+//  The function returns the longest required literal, or an empty
+//  string if there isn't one.
+//////////////////////////////////////////////////////////////////////
+static std::string
+regexLiteral(const std::string & re)
+{
+  std::string best;
+  std::string run;
+  std::string::size_type pos = 0;
+  const std::string::size_type len = re.length();
+
+  while (pos < len)
+  {
+    const char c = re[pos];
+    bool literal = false;
+
+    switch (c)
+    {
+      case '|':
+      case ')':
+      case '{':
+        return "";
+
+      case '(':
+        pos = skipGroup(re, pos);
+        if (std::string::npos == pos)
+        {
+          return "";
+        }
+        keepLongest(best, run);
+        break;
+
+      case '[':
+        pos = skipClass(re, pos);
+        if (std::string::npos == pos)
+        {
+          return "";
+        }
+        keepLongest(best, run);
+        break;
+
+      case '\\':
+        if (pos + 1 >= len)
+        {
+          return "";
+        }
+        else if (isalnum(static_cast<unsigned char>(re[pos + 1])))
+        {
+          // Character types, assertions, and control characters
+          if (std::string::npos ==
+            std::string("dDwWsSbBAzZhHvVRGKntrfea").find(re[pos + 1]))
+          {
+            return "";
+          }
+          keepLongest(best, run);
+        }
+        else if (isLiteralChar(re[pos + 1]) &&
+          (std::string::npos == std::string("<>`'").find(re[pos + 1])))
+        {
+          run += re[pos + 1];
+          literal = true;
+        }
+        else
+        {
+          keepLongest(best, run);
+        }
+        pos += 2;
+        break;
+
+      default:
+        if ((c != '.') && (c != '^') && (c != '$') && (c != '*') &&
+          (c != '+') && (c != '?') && isLiteralChar(c))
+        {
+          run += c;
+          literal = true;
+        }
+        else
+        {
+          keepLongest(best, run);
+        }
+        ++pos;
+        break;
+    }
+
+    // A quantifier may follow any atom
+    if (pos < len)
+    {
+      const char q = re[pos];
+      if ((q == '*') || (q == '?') || (q == '+') || ((q == '{') &&
+        (pos + 1 < len) && isdigit(static_cast<unsigned char>(re[pos + 1]))))
+      {
+        if (literal && (q != '+'))
+        {
+          // The character is optional
+          run.erase(run.length() - 1);
+        }
+        keepLongest(best, run);
+
+        if (q == '{')
+        {
+          pos = re.find('}', pos);
+          if (std::string::npos == pos)
+          {
+            return "";
+          }
+        }
+        ++pos;
+
+        // Lazy and possessive quantifiers
+        if ((pos < len) && ((re[pos] == '?') || (re[pos] == '+')))
+        {
+          ++pos;
+        }
+      }
+    }
+  }
+  keepLongest(best, run);
+
+  return best;
+}
+
+
 Pattern::Pattern(const std::string & text) : pattern_(text)
 {
 #ifdef PATTERN_DEBUG
@@ -63,7 +442,8 @@ Pattern::~Pattern(void)
 }
 
 
-RegExPattern::RegExPattern(const std::string & text) : Pattern(text)
+RegExPattern::RegExPattern(const std::string & text) : Pattern(text),
+  jit_(false)
 {
   std::string realPattern;
   bool insensitive = false;
@@ -119,7 +499,37 @@ RegExPattern::RegExPattern(const std::string & text) : Pattern(text)
     realPattern = text;
   }
 
-#if defined(HAVE_LIBPCRE)
+  this->literal_ = regexLiteral(realPattern);
+
+#if defined(HAVE_LIBPCRE2)
+  int errcode;
+  PCRE2_SIZE erroffset;
+
+  this->regex = pcre2_compile(
+    reinterpret_cast<PCRE2_SPTR>(realPattern.c_str()), realPattern.length(),
+    insensitive ? PCRE2_CASELESS : 0, &errcode, &erroffset, NULL);
+  if (NULL == this->regex)
+  {
+    PCRE2_UCHAR buffer[128];
+    pcre2_get_error_message(errcode, buffer, sizeof(buffer));
+    throw OOMon::regex_error(std::string(reinterpret_cast<char *>(buffer)));
+  }
+
+  // JIT compilation can fail for reasons that have nothing to do with the
+  // pattern (no JIT support on this platform, W^X memory policies, etc.),
+  // so fall back to the interpreter rather than rejecting the pattern.
+  this->jit_ = (0 == pcre2_jit_compile(this->regex, PCRE2_JIT_COMPLETE));
+
+  // We only ever need to know whether the pattern matched, so a single
+  // ovector pair is plenty.  Allocating it here keeps match() from having
+  // to allocate anything.
+  this->matchData = pcre2_match_data_create(1, NULL);
+  if (NULL == this->matchData)
+  {
+    pcre2_code_free(this->regex);
+    throw OOMon::regex_error("Unable to allocate match data");
+  }
+#elif defined(HAVE_LIBPCRE)
   const char *errstr = NULL;
   int erroffset;
 
@@ -131,7 +541,17 @@ RegExPattern::RegExPattern(const std::string & text) : Pattern(text)
     throw OOMon::regex_error(error);
   }
 
+#ifdef PCRE_STUDY_JIT_COMPILE
+  this->extra = pcre_study(this->regex, PCRE_STUDY_JIT_COMPILE, &errstr);
+  if (NULL != this->extra)
+  {
+    int jit = 0;
+    pcre_fullinfo(this->regex, this->extra, PCRE_INFO_JIT, &jit);
+    this->jit_ = (jit != 0);
+  }
+#else
   this->extra = pcre_study(this->regex, 0, &errstr);
+#endif
 #elif defined(HAVE_POSIX_REGEX)
   if (int result = regcomp(&this->regex, realPattern.c_str(),
     REG_EXTENDED | REG_NOSUB | (insensitive ? REG_ICASE : 0)))
@@ -148,11 +568,18 @@ RegExPattern::RegExPattern(const std::string & text) : Pattern(text)
 
 RegExPattern::~RegExPattern()
 {
-#if defined(HAVE_LIBPCRE)
+#if defined(HAVE_LIBPCRE2)
+  pcre2_match_data_free(this->matchData);
+  pcre2_code_free(this->regex);
+#elif defined(HAVE_LIBPCRE)
   pcre_free(this->regex);
   if (NULL != this->extra)
   {
+#ifdef PCRE_STUDY_JIT_COMPILE
+    pcre_free_study(this->extra);
+#else
     pcre_free(this->extra);
+#endif
   }
 #elif defined(HAVE_POSIX_REGEX)
   regfree(&this->regex);
@@ -163,9 +590,55 @@ RegExPattern::~RegExPattern()
 bool
 RegExPattern::match(const std::string & text) const
 {
-#if defined(HAVE_LIBPCRE)
-  int result = pcre_exec(this->regex, this->extra, text.c_str(), text.length(),
-    0, 0, NULL, 0);
+#if defined(HAVE_LIBPCRE2)
+  PCRE2_SPTR subject = reinterpret_cast<PCRE2_SPTR>(text.data());
+  int result;
+
+  if (this->jit_ && RegExPattern::useJit_)
+  {
+    result = pcre2_jit_match(this->regex, subject, text.length(), 0, 0,
+      this->matchData, jitContext());
+  }
+  else
+  {
+    result = pcre2_match(this->regex, subject, text.length(), 0,
+      PCRE2_NO_JIT, this->matchData, NULL);
+  }
+
+  if (result >= 0)
+  {
+    return true;
+  }
+  else if (result == PCRE2_ERROR_NOMATCH)
+  {
+    return false;
+  }
+  else
+  {
+    PCRE2_UCHAR buffer[128];
+    pcre2_get_error_message(result, buffer, sizeof(buffer));
+    throw OOMon::regex_error(std::string("pcre2_match returned ") +
+      reinterpret_cast<char *>(buffer));
+  }
+#elif defined(HAVE_LIBPCRE)
+  int result;
+
+#ifdef PCRE_STUDY_JIT_COMPILE
+  if (this->jit_ && !RegExPattern::useJit_)
+  {
+    // Force the interpreter by hiding the JIT code from pcre_exec()
+    pcre_extra noJit(*this->extra);
+    noJit.flags &= ~PCRE_EXTRA_EXECUTABLE_JIT;
+    result = pcre_exec(this->regex, &noJit, text.c_str(), text.length(),
+      0, 0, NULL, 0);
+  }
+  else
+#endif
+  {
+    result = pcre_exec(this->regex, this->extra, text.c_str(), text.length(),
+      0, 0, NULL, 0);
+  }
+
   if (result >= 0)
   {
     return true;
@@ -201,24 +674,142 @@ RegExPattern::match(const std::string & text) const
 }
 
 
+//////////////////////////////////////////////////////////////////////
+// RegExPattern::engine()
+//
+// Description:
+//  Describes the regular expression library OOMon was built with.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns a short, human-readable description of the
+//  regular expression engine and its JIT status.
+//////////////////////////////////////////////////////////////////////
+std::string
+RegExPattern::engine(void)
+{
+  std::string result;
+
+#if defined(HAVE_LIBPCRE2)
+  uint32_t haveJit = 0;
+  pcre2_config(PCRE2_CONFIG_JIT, &haveJit);
+
+  result = "PCRE2";
+#elif defined(HAVE_LIBPCRE)
+  int haveJit = 0;
+# ifdef PCRE_CONFIG_JIT
+  pcre_config(PCRE_CONFIG_JIT, &haveJit);
+# endif
+
+  result = "PCRE";
+#elif defined(HAVE_POSIX_REGEX)
+  int haveJit = 0;
+
+  result = "POSIX";
+#else
+  int haveJit = 0;
+
+  result = "none";
+#endif
+
+  if (!haveJit)
+  {
+    result += " (no JIT)";
+  }
+  else if (RegExPattern::useJit_)
+  {
+    result += " (JIT)";
+  }
+  else
+  {
+    result += " (JIT disabled)";
+  }
+
+  return result;
+}
+
+
+void
+RegExPattern::init(void)
+{
+  vars.insert("PATTERN_CACHE_SIZE", Setting::IntegerSetting(cacheSize, 0));
+  vars.insert("REGEX_JIT", Setting::BooleanSetting(RegExPattern::useJit_));
+}
+
+
+std::string
+ClusterPattern::literal(void) const
+{
+  return maskLiteral(this->get(), false);
+}
+
+
+std::string
+NickClusterPattern::literal(void) const
+{
+  return maskLiteral(this->get(), true);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// smartPattern(text, nick)
+//
+// Description:
+//  Builds the right kind of pattern for a string: a regular expression
+//  if it is surrounded by slashes, otherwise a cluster mask.  Recently
+//  used patterns are kept in a cache, so asking for the same pattern
+//  again doesn't recompile it.
+//
+// Parameters:
+//  text - The pattern text.
+//  nick - Whether a cluster mask should use the nick wildcards.
+//
+// Return Value:
+//  The function returns the pattern.
+//////////////////////////////////////////////////////////////////////
 PatternPtr
 smartPattern(const std::string & text, const bool nick)
 {
-  if ((text.length() > 0) && (text[0] == '/'))
+  const bool regex = (text.length() > 0) && (text[0] == '/');
+
+  // Regular expressions ignore the nick flag, so they share an entry
+  std::string key(1, regex ? 'r' : (nick ? 'n' : 'c'));
+  key += text;
+
+  PatternIndex::iterator pos = cacheIndex.find(key);
+  if (cacheIndex.end() != pos)
   {
-    PatternPtr tmp(new RegExPattern(text));
-    return tmp;
+    ++cacheHits;
+    cacheLru.splice(cacheLru.begin(), cacheLru, pos->second);
+    return pos->second->second;
+  }
+
+  ++cacheMisses;
+
+  PatternPtr result;
+  if (regex)
+  {
+    result.reset(new RegExPattern(text));
   }
   else if (nick)
   {
-    PatternPtr tmp(new NickClusterPattern(text));
-    return tmp;
+    result.reset(new NickClusterPattern(text));
   }
   else
   {
-    PatternPtr tmp(new ClusterPattern(text));
-    return tmp;
+    result.reset(new ClusterPattern(text));
   }
+
+  if (cacheSize > 0)
+  {
+    cacheLru.push_front(std::make_pair(key, result));
+    cacheIndex[key] = cacheLru.begin();
+  }
+  trimCache();
+
+  return result;
 }
 
 
@@ -354,7 +945,7 @@ SMatch(std::string TEST, std::string MASK, bool special)
 bool
 MatchesMask(std::string TEST, std::string MASK, bool special)
 {
-  return SMatch(server.upCase(TEST), server.upCase(MASK), special);
+  return SMatch(server().upCase(TEST), server().upCase(MASK), special);
 }
 
 
@@ -436,13 +1027,25 @@ grabPattern(std::string & input, const std::string & delimiters)
 
 
 void
-#ifdef PATTERN_DEBUG
 patternStatus(BotClient * client)
 {
+  client->send("RegEx engine: " + RegExPattern::engine());
+  trimCache();
+  if (cacheSize > 0)
+  {
+    std::string cache("Pattern cache: ");
+    cache += boost::lexical_cast<std::string>(cacheIndex.size());
+    cache += '/';
+    cache += boost::lexical_cast<std::string>(cacheSize);
+    cache += " (";
+    cache += boost::lexical_cast<std::string>(cacheHits);
+    cache += " hits, ";
+    cache += boost::lexical_cast<std::string>(cacheMisses);
+    cache += " misses)";
+    client->send(cache);
+  }
+#ifdef PATTERN_DEBUG
   client->send("Patterns: " + boost::lexical_cast<std::string>(patternCount));
-#else
-patternStatus(BotClient *)
-{
 #endif
 }
 
@@ -36,7 +36,10 @@
 #include "oomon.h"
 #include "botclient.h"
 
-#if defined(HAVE_LIBPCRE)
+#if defined(HAVE_LIBPCRE2)
+# define PCRE2_CODE_UNIT_WIDTH 8
+# include <pcre2.h>
+#elif defined(HAVE_LIBPCRE)
 # include <pcre.h>
 #elif defined(HAVE_POSIX_REGEX)
 # include <regex.h>
@@ -59,6 +62,10 @@ public:
 
   virtual bool match(const std::string & text) const = 0;
 
+  // Returns a string that any text matching this pattern must contain,
+  // ignoring ASCII case, or an empty string if there is no such string.
+  virtual std::string literal(void) const { return ""; }
+
 protected:
   const std::string pattern_;
 };
@@ -74,6 +81,8 @@ public:
   {
     return MatchesMask(text, this->get());
   }
+
+  virtual std::string literal(void) const;
 };
 
 
@@ -87,6 +96,8 @@ public:
   {
     return MatchesMask(text, this->get(), true);
   }
+
+  virtual std::string literal(void) const;
 };
 
 
@@ -98,13 +109,30 @@ public:
 
   virtual bool match(const std::string & text) const;
 
+  virtual std::string literal(void) const { return this->literal_; }
+
+  bool jit(void) const { return this->jit_; }
+
+  static std::string engine(void);
+  static bool useJit(void) { return RegExPattern::useJit_; }
+  static void useJit(const bool value) { RegExPattern::useJit_ = value; }
+
+  static void init(void);
+
 private:
-#if defined(HAVE_LIBPCRE)
+#if defined(HAVE_LIBPCRE2)
+  pcre2_code * regex;
+  pcre2_match_data * matchData;
+#elif defined(HAVE_LIBPCRE)
   pcre * regex;
   pcre_extra * extra;
 #elif defined(HAVE_POSIX_REGEX)
   regex_t regex;
 #endif
+  bool jit_;
+  std::string literal_;
+
+  static bool useJit_;
 };
 
 
@@ -54,6 +54,8 @@
 #include "httppost.h"
 #include "config.h"
 #include "log.h"
+#include "journal.h"
+#include "stats.h"
 #include "util.h"
 #include "main.h"
 #include "engine.h"
@@ -61,6 +63,7 @@
 #include "vars.h"
 #include "format.h"
 #include "defaults.h"
+#include "timers.h"
 
 
 #ifdef DEBUG
@@ -76,13 +79,16 @@ std::string Proxy::exec(DEFAULT_SCAN_PROXY_EXEC);
 
 
 Proxy::Proxy(const UserEntryPtr user)
-  : BotSock(), detectedProxy_(false), user_(user), timeout_(0)
+  : BotSock(), detectedProxy_(false), user_(user), timeout_(0),
+  started_(Timers::now())
 {
 }
 
 
 Proxy::~Proxy(void)
 {
+  Stats::record(Stats::PROXY_SCAN, Timers::now() - this->started_);
+
 #ifdef PROXY_DEBUG
   std::cout << "Proxy checker ending..." << std::endl;
 #endif
@@ -117,6 +123,8 @@ Proxy::detectedProxy(void)
   notice += "]";
   ::SendAll(notice, UserFlags::OPER, WATCH_PROXYSCANS);
   Log::Write(notice);
+  Journal::proxy(this->user_, this->port(), this->typeName());
+  Stats::count(Stats::PROXIES);
 
   doAction(this->user_, Proxy::action, reason.format(Proxy::reason), false);
 
@@ -74,6 +74,7 @@ private:
   const UserEntryPtr user_;
   BotSock::Port port_;
   std::time_t timeout_;
+  const double started_;
 
   static AutoAction action;
   static std::string exec;
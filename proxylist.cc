@@ -62,6 +62,7 @@
 #include "irc.h"
 #include "vars.h"
 #include "defaults.h"
+#include "timers.h"
 
 
 #ifdef DEBUG
@@ -87,6 +88,8 @@ ProxyList proxies;
 ProxyList::ProxyList(void) : safeHosts(ProxyList::cacheSize), cacheHits(0),
   cacheMisses(0)
 {
+  Timers::instance().every(10, boost::bind(&ProxyList::expireCache, this));
+  Timers::instance().every(1, boost::bind(&ProxyList::expireScans, this));
 }
 
 
@@ -115,6 +118,7 @@ ProxyList::connect(ProxyPtr newProxy, const BotSock::Port port)
     return false;
   }
 
+  newProxy->registerOnReadyHandler(this->readyScanners.handler(newProxy));
   this->scanners.push_back(newProxy);
 
   return true;
@@ -210,18 +214,6 @@ ProxyList::check(const UserEntryPtr user)
 }
 
 
-// preSelect(readset, writeset)
-//
-// Do this if you want to be able to receive data :P
-//
-void
-ProxyList::preSelect(fd_set & readset, fd_set & writeset)
-{
-  std::for_each(this->scanners.begin(), this->scanners.end(),
-    BotSock::FDSetter(readset, writeset));
-}
-
-
 bool
 ProxyList::ProxyProcessor::operator()(ProxyPtr proxy)
 {
@@ -229,7 +221,7 @@ ProxyList::ProxyProcessor::operator()(ProxyPtr proxy)
 
   try
   {
-    remove = !proxy->postSelect(this->readset_, this->writeset_);
+    remove = !proxy->process();
   }
   catch (OOMon::timeout_error)
   {
@@ -244,19 +236,24 @@ ProxyList::ProxyProcessor::operator()(ProxyPtr proxy)
 }
 
 
-// postSelect(readset, writeset)
+// process()
 //
 // Processes any received data at each proxy connection.
 //
+// Expire any old proxy cache entries
 void
-ProxyList::postSelect(const fd_set & readset, const fd_set & writeset)
+ProxyList::expireCache(void)
 {
-  // Expire any old proxy cache entries
   std::time_t now = std::time(NULL);
   ProxyList::CacheEntry empty;
   std::replace_if(this->safeHosts.begin(), this->safeHosts.end(),
     boost::bind(&ProxyList::CacheEntry::isExpired, _1, now), empty);
+}
 
+
+void
+ProxyList::process(void)
+{
   // Process queue
   while (!this->queuedScans.empty() &&
       (static_cast<int>(this->scanners.size()) < ProxyList::maxCount))
@@ -273,11 +270,15 @@ ProxyList::postSelect(const fd_set & readset, const fd_set & writeset)
     }
   }
 
-  // Process active scans
-  ProxyList::ProxyProcessor p(readset, writeset);
-  this->scanners.remove_if(p);
+  // Process active scans that are ready
+  this->readyScanners.process(this->scanners, ProxyList::ProxyProcessor());
+}
 
-  // Remove any expired scans
+
+// Remove any expired scans
+void
+ProxyList::expireScans(void)
+{
   this->scanners.remove_if(boost::bind(&Proxy::expired, _1));
 }
 
@@ -56,8 +56,9 @@ public:
   void check(const UserEntryPtr user);
   bool connect(ProxyPtr newProxy, const BotSock::Port port);
 
-  void preSelect(fd_set & readset, fd_set & writeset);
-  void postSelect(const fd_set & readset, const fd_set & writeset);
+  void process(void);
+  void expireCache(void);
+  void expireScans(void);
 
   bool isChecking(const BotSock::Address &, const BotSock::Port,
       Proxy::Protocol) const;
@@ -69,6 +70,8 @@ public:
       const Proxy::Protocol & type);
 
   void status(class BotClient * client) const;
+  unsigned long scanning(void) const { return this->scanners.size(); }
+  unsigned long queued(void) const { return this->queuedScans.size(); }
 
   static int cacheExpire;
 
@@ -83,16 +86,13 @@ private:
 
   typedef std::list<ProxyPtr> SockList;
   SockList scanners;
+  ReadyList<Proxy> readyScanners;
 
   class ProxyProcessor : public std::unary_function<ProxyPtr, bool>
   {
   public:
-    explicit ProxyProcessor(const fd_set & readset, const fd_set & writeset)
-      : readset_(readset), writeset_(writeset) { }
+    ProxyProcessor(void) { }
     bool operator()(ProxyPtr proxy);
-  private:
-    const fd_set & readset_;
-    const fd_set & writeset_;
   };
 
   class ProxyIsChecking : public std::unary_function<ProxyPtr, bool>
@@ -0,0 +1,448 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cerrno>
+
+// Boost C++ Headers
+#include <boost/lexical_cast.hpp>
+
+// Std C Headers
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+// OOMon Headers
+#include "oomon.h"
+#include "reactor.h"
+#include "botexcept.h"
+#include "botclient.h"
+
+
+// Number of ready descriptors collected by the first epoll_wait()
+static const std::vector<Reactor::Handler *>::size_type INITIAL_BATCH = 64;
+
+
+#ifdef HAVE_SYS_EPOLL_H
+enum { CONTROL_ADD = EPOLL_CTL_ADD, CONTROL_MOD = EPOLL_CTL_MOD,
+  CONTROL_DEL = EPOLL_CTL_DEL };
+#else
+enum { CONTROL_ADD, CONTROL_MOD, CONTROL_DEL };
+#endif
+
+
+//////////////////////////////////////////////////////////////////////
+// Reactor::instance()
+//
+// Description:
+//  Returns the reactor, creating it the first time it is needed.  It
+//  is never destroyed, so sockets belonging to other global objects
+//  may still unregister themselves while the program exits.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns a reference to the reactor.
+//////////////////////////////////////////////////////////////////////
+Reactor &
+Reactor::instance(void)
+{
+  static Reactor * reactor = new Reactor;
+
+  return *reactor;
+}
+
+
+Reactor::Reactor(void) : count_(0), wakeups_(0), dispatched_(0)
+#ifdef HAVE_SYS_EPOLL_H
+  , ready_(INITIAL_BATCH)
+#else
+  , dirty_(false)
+#endif
+{
+#ifdef HAVE_SYS_EPOLL_H
+  if (-1 == (this->epfd_ = ::epoll_create(INITIAL_BATCH)))
+  {
+    throw OOMon::errno_error("epoll_create() failed");
+  }
+  ::fcntl(this->epfd_, F_SETFD, FD_CLOEXEC);
+#endif
+}
+
+
+#ifdef HAVE_SYS_EPOLL_H
+bool
+Reactor::control(const int op, const int fd, const int events)
+{
+  struct epoll_event ev;
+
+  ev.events = 0;
+  if (events & Reactor::READ)
+  {
+    ev.events |= EPOLLIN | EPOLLPRI;
+  }
+  if (events & Reactor::WRITE)
+  {
+    ev.events |= EPOLLOUT;
+  }
+  if (events & Reactor::EDGE)
+  {
+    ev.events |= EPOLLET;
+  }
+
+  // Keep the generation with the descriptor so that events collected
+  // for a descriptor that has since been closed and reused are ignored
+  ev.data.u64 = static_cast<unsigned int>(fd) |
+    (static_cast<uint64_t>(this->entries_[fd].generation) << 32);
+
+  if (-1 == ::epoll_ctl(this->epfd_, op, fd, &ev))
+  {
+    if (CONTROL_DEL != op)
+    {
+      std::cerr << "epoll_ctl() failed: " << errno <<
+#if defined(HAVE_STRERROR)
+        " (" << strerror(errno) << ')' <<
+#endif
+        std::endl;
+    }
+    return false;
+  }
+
+  return true;
+}
+#else
+bool
+Reactor::control(const int, const int, const int)
+{
+  this->dirty_ = true;
+
+  return true;
+}
+#endif
+
+
+//////////////////////////////////////////////////////////////////////
+// Reactor::add(fd, handler, events)
+//
+// Description:
+//  Starts watching a file descriptor.  The handler is called from
+//  wait() whenever the descriptor is ready for any of the events.
+//
+// Parameters:
+//  fd      - The file descriptor.
+//  handler - The handler to call when the descriptor is ready.
+//  events  - Reactor::READ and/or Reactor::WRITE, plus Reactor::EDGE
+//            for edge-triggered notification.
+//
+// Return Value:
+//  The function returns true if the descriptor is now being watched.
+//////////////////////////////////////////////////////////////////////
+bool
+Reactor::add(const int fd, Reactor::Handler * handler, const int events)
+{
+  if ((fd < 0) || (0 == handler))
+  {
+    return false;
+  }
+
+  if (static_cast<std::vector<Entry>::size_type>(fd) >= this->entries_.size())
+  {
+    Entry empty = { 0, 0, 0 };
+    this->entries_.resize(fd + 1, empty);
+  }
+
+  Entry & entry = this->entries_[fd];
+
+  if (0 != entry.handler)
+  {
+    // The descriptor was closed and reused without being removed first
+    this->control(CONTROL_DEL, fd, 0);
+    entry.handler = 0;
+    --this->count_;
+  }
+
+  entry.handler = handler;
+  entry.events = events;
+  ++entry.generation;
+
+  if (!this->control(CONTROL_ADD, fd, events))
+  {
+    entry.handler = 0;
+    return false;
+  }
+
+  ++this->count_;
+
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Reactor::modify(fd, handler, events)
+//
+// Description:
+//  Changes the events a watched file descriptor is waited on for.
+//  Nothing is done if the events have not changed.
+//
+// Parameters:
+//  fd      - The file descriptor.
+//  handler - The handler the descriptor was registered with.
+//  events  - The new set of events.
+//
+// Return Value:
+//  The function returns true if the change was made.
+//////////////////////////////////////////////////////////////////////
+bool
+Reactor::modify(const int fd, Reactor::Handler * handler, const int events)
+{
+  if ((fd < 0) ||
+    (static_cast<std::vector<Entry>::size_type>(fd) >= this->entries_.size()) ||
+    (this->entries_[fd].handler != handler))
+  {
+    return false;
+  }
+
+  if (this->entries_[fd].events == events)
+  {
+    return true;
+  }
+
+  this->entries_[fd].events = events;
+
+  return this->control(CONTROL_MOD, fd, events);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Reactor::remove(fd, handler)
+//
+// Description:
+//  Stops watching a file descriptor.  This must be done before the
+//  descriptor is closed.  Nothing is done unless the descriptor is
+//  still registered to the same handler, so a stale descriptor number
+//  cannot unregister whoever has reused it.
+//
+// Parameters:
+//  fd      - The file descriptor.
+//  handler - The handler the descriptor was registered with.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+Reactor::remove(const int fd, Reactor::Handler * handler)
+{
+  if ((fd < 0) ||
+    (static_cast<std::vector<Entry>::size_type>(fd) >= this->entries_.size()) ||
+    (this->entries_[fd].handler != handler) || (0 == handler))
+  {
+    return;
+  }
+
+  this->control(CONTROL_DEL, fd, 0);
+
+  this->entries_[fd].handler = 0;
+  this->entries_[fd].events = 0;
+  --this->count_;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Reactor::wait(timeout)
+//
+// Description:
+//  Waits for any watched descriptor to become ready and calls the
+//  handler of each one that is.  Errors and hang-ups are reported as
+//  both Reactor::READ and Reactor::WRITE.  Handlers may add and remove
+//  descriptors, including their own.
+//
+// Parameters:
+//  timeout - The maximum number of milliseconds to wait, or -1 to
+//            wait indefinitely.
+//
+// Return Value:
+//  The function returns the number of ready descriptors, or -1 if the
+//  wait was interrupted or failed.
+//////////////////////////////////////////////////////////////////////
+int
+Reactor::wait(const int timeout)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  int n = ::epoll_wait(this->epfd_, &this->ready_[0], this->ready_.size(),
+    timeout);
+
+  if (n < 0)
+  {
+    return -1;
+  }
+
+  ++this->wakeups_;
+
+  for (int i = 0; i < n; ++i)
+  {
+    const uint64_t data = this->ready_[i].data.u64;
+    const int fd = static_cast<int>(data & 0xffffffff);
+    const unsigned int generation = static_cast<unsigned int>(data >> 32);
+    const unsigned int revents = this->ready_[i].events;
+
+    // An earlier handler may have removed or replaced this descriptor
+    if ((this->entries_[fd].handler != 0) &&
+      (this->entries_[fd].generation == generation))
+    {
+      int events = 0;
+      if (revents & (EPOLLERR | EPOLLHUP))
+      {
+        events = Reactor::READ | Reactor::WRITE;
+      }
+      else
+      {
+        if (revents & (EPOLLIN | EPOLLPRI))
+        {
+          events |= Reactor::READ;
+        }
+        if (revents & EPOLLOUT)
+        {
+          events |= Reactor::WRITE;
+        }
+      }
+
+      ++this->dispatched_;
+      this->entries_[fd].handler->onReady(fd, events);
+    }
+  }
+
+  // A full batch means more descriptors may have been ready than fit;
+  // they are still pending and will be collected next time, but a
+  // larger batch avoids the extra trip.
+  if ((static_cast<std::vector<struct epoll_event>::size_type>(n) ==
+    this->ready_.size()) && (this->ready_.size() < this->count_))
+  {
+    this->ready_.resize(this->ready_.size() * 2);
+  }
+
+  return n;
+#else
+  if (this->dirty_)
+  {
+    this->pollfds_.clear();
+    this->generations_.clear();
+    for (std::vector<Entry>::size_type fd = 0; fd < this->entries_.size();
+      ++fd)
+    {
+      const Entry & entry = this->entries_[fd];
+
+      if (0 != entry.handler)
+      {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = ((entry.events & Reactor::READ) ? POLLIN : 0) |
+          ((entry.events & Reactor::WRITE) ? POLLOUT : 0);
+        pfd.revents = 0;
+        this->pollfds_.push_back(pfd);
+        this->generations_.push_back(entry.generation);
+      }
+    }
+    this->dirty_ = false;
+  }
+
+  // Handlers may change the registrations, so work from a copy
+  std::vector<struct pollfd> pollfds(this->pollfds_);
+  std::vector<unsigned int> generations(this->generations_);
+
+  int n = ::poll(pollfds.empty() ? 0 : &pollfds[0], pollfds.size(), timeout);
+
+  if (n < 0)
+  {
+    return -1;
+  }
+
+  ++this->wakeups_;
+
+  for (std::vector<struct pollfd>::size_type i = 0;
+    (i < pollfds.size()) && (n > 0); ++i)
+  {
+    const int fd = pollfds[i].fd;
+    const int revents = pollfds[i].revents;
+
+    if (0 != revents)
+    {
+      if ((this->entries_[fd].handler != 0) &&
+        (this->entries_[fd].generation == generations[i]))
+      {
+        int events = 0;
+        if (revents & (POLLERR | POLLHUP | POLLNVAL))
+        {
+          events = Reactor::READ | Reactor::WRITE;
+        }
+        else
+        {
+          if (revents & POLLIN)
+          {
+            events |= Reactor::READ;
+          }
+          if (revents & POLLOUT)
+          {
+            events |= Reactor::WRITE;
+          }
+        }
+
+        ++this->dispatched_;
+        this->entries_[fd].handler->onReady(fd, events);
+      }
+    }
+  }
+
+  return n;
+#endif
+}
+
+
+std::string
+Reactor::backend(void)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  return "epoll";
+#else
+  return "poll";
+#endif
+}
+
+
+void
+Reactor::status(BotClient * client) const
+{
+  std::string msg("Event loop: ");
+  msg += Reactor::backend();
+  msg += ", ";
+  msg += boost::lexical_cast<std::string>(this->count_);
+  msg += " descriptors, ";
+  msg += boost::lexical_cast<std::string>(this->wakeups_);
+  msg += " wakeups, ";
+  msg += boost::lexical_cast<std::string>(this->dispatched_);
+  msg += " events";
+
+  client->send(msg);
+}
+
@@ -0,0 +1,103 @@
+#ifndef __REACTOR_H__
+#define __REACTOR_H__
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+#include <vector>
+
+// Boost C++ Headers
+#include <boost/utility.hpp>
+
+// OOMon Headers
+#include "oomon.h"
+
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#else
+# include <poll.h>
+#endif
+
+
+// Waits for I/O readiness on any number of file descriptors.  Each
+// descriptor is registered once, along with the Handler to call when it
+// becomes ready, and stays registered until it is removed.  Linux uses
+// epoll, so the cost of a wakeup depends only on the number of ready
+// descriptors; elsewhere poll() is used.  Neither has a FD_SETSIZE limit.
+class Reactor : private boost::noncopyable
+{
+public:
+  enum Event
+  {
+    READ = 0x01,
+    WRITE = 0x02,
+    EDGE = 0x04		// Edge-triggered (epoll only)
+  };
+
+  class Handler
+  {
+  public:
+    virtual ~Handler(void) { }
+    virtual void onReady(const int fd, const int events) = 0;
+  };
+
+  static Reactor & instance(void);
+
+  bool add(const int fd, Handler * handler, const int events);
+  bool modify(const int fd, Handler * handler, const int events);
+  void remove(const int fd, Handler * handler);
+
+  int wait(const int timeout);
+
+  std::vector<Handler *>::size_type size(void) const { return this->count_; }
+
+  static std::string backend(void);
+  void status(class BotClient * client) const;
+
+private:
+  Reactor(void);
+
+  struct Entry
+  {
+    Handler * handler;
+    int events;
+    unsigned int generation;
+  };
+
+  bool control(const int op, const int fd, const int events);
+
+  std::vector<Entry> entries_;
+  std::vector<Handler *>::size_type count_;
+  unsigned long wakeups_, dispatched_;
+#ifdef HAVE_SYS_EPOLL_H
+  int epfd_;
+  std::vector<struct epoll_event> ready_;
+#else
+  std::vector<struct pollfd> pollfds_;
+  std::vector<unsigned int> generations_;
+  bool dirty_;
+#endif
+};
+
+
+#endif /* __REACTOR_H__ */
+
@@ -0,0 +1,952 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+
+// $Id$
+
+// Searches the binary event journals written when EVENT_JOURNAL is set.
+// Events can be selected by time, type, nick, host, and IP address or
+// CIDR block, and are either listed, counted by type, or counted by
+// domain.  Each file is read in large blocks and decoded in place, and
+// the nick and host patterns are matched once per distinct string
+// rather than once per event, so it runs about as fast as the disk.
+
+// Std C++ Headers
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+// Std C Headers
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+// OOMon Headers
+#include "oomon.h"
+#include "journal.h"
+
+
+static const char * const typeNames[] =
+{
+  "string", "reset", "connect", "exit", "nick", "trap", "proxy", "dnsbl",
+  "action"
+};
+
+static const int TYPE_COUNT = sizeof(typeNames) / sizeof(typeNames[0]);
+
+// Files are read this much at a time
+static const std::vector<char>::size_type READ_SIZE = 1048576;
+
+
+// A string field of a record: either an entry in the string table or a
+// literal stored in the record itself
+struct Field
+{
+  long id;			// -1 for a literal
+  const char *data;
+  unsigned long length;
+
+  std::string str(void) const { return std::string(this->data, this->length); }
+};
+
+
+struct Event
+{
+  int type;
+  std::time_t when;
+  Field server, nick, user, host, domain;
+  unsigned long ip;		// Host order
+  unsigned long number;		// Trap number or proxy port
+  Field extra, text;		// New nick, class, action, zone, etc.
+};
+
+
+struct Options
+{
+  Options(void) : start(0), end(0), types(0), ipMask(0), ipBits(-1),
+    byDomain(false), byType(false) { }
+
+  std::time_t start, end;
+  unsigned int types;		// Bit per Journal::Type, 0 for all
+  std::string nickMask, hostMask;
+  unsigned long ipMask;
+  int ipBits;			// -1 for any address
+  bool byDomain, byType;
+};
+
+
+// Matches a pattern containing * and ? against lowercase text.  Unlike
+// fnmatch(), [ and ] are not special, since they are common in nicks.
+static bool
+wildMatch(const char *pattern, const char *text, const char *end)
+{
+  const char *star = 0, *resume = 0;
+
+  while (text < end)
+  {
+    if ('*' == *pattern)
+    {
+      star = ++pattern;
+      resume = text;
+    }
+    else if (('?' == *pattern) ||
+      (static_cast<unsigned char>(*pattern) ==
+      std::tolower(static_cast<unsigned char>(*text))))
+    {
+      ++pattern;
+      ++text;
+    }
+    else if (0 != star)
+    {
+      pattern = star;
+      text = ++resume;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  while ('*' == *pattern)
+  {
+    ++pattern;
+  }
+
+  return ('\0' == *pattern);
+}
+
+
+static std::string
+lowerCase(std::string text)
+{
+  for (std::string::iterator pos = text.begin(); pos != text.end(); ++pos)
+  {
+    *pos = std::tolower(static_cast<unsigned char>(*pos));
+  }
+
+  return text;
+}
+
+
+// Remembers whether each string in the table matches a pattern, so it
+// is matched at most once however many events use it
+class MatchCache
+{
+public:
+  explicit MatchCache(const std::string & pattern)
+    : pattern_(lowerCase(pattern)) { }
+
+  bool any(void) const { return this->pattern_.empty(); }
+
+  bool match(const Field & field)
+  {
+    if (field.id < 0)
+    {
+      return wildMatch(this->pattern_.c_str(), field.data,
+        field.data + field.length);
+    }
+
+    const std::vector<signed char>::size_type id = field.id;
+    if (id >= this->cache_.size())
+    {
+      this->cache_.resize(id + 1, -1);
+    }
+    if (this->cache_[id] < 0)
+    {
+      this->cache_[id] = wildMatch(this->pattern_.c_str(), field.data,
+        field.data + field.length) ? 1 : 0;
+    }
+
+    return (1 == this->cache_[id]);
+  }
+
+  void reset(void) { this->cache_.clear(); }
+
+private:
+  const std::string pattern_;
+  std::vector<signed char> cache_;
+};
+
+
+// The journal header and RESET record written each time the bot starts
+// journaling
+static std::string
+syncMarker(void)
+{
+  std::string marker(JOURNAL_MAGIC);
+  marker += static_cast<char>(JOURNAL_VERSION);
+  marker += static_cast<char>(2);	// Length of the RESET record
+  marker += static_cast<char>(Journal::RESET);
+  marker += '\0';			// Seconds since the last record
+
+  return marker;
+}
+
+
+class Reader
+{
+public:
+  Reader(const Options & options) : options_(options),
+    nicks_(options.nickMask), hosts_(options.hostMask), lastTime_(0),
+    lastStamp_(static_cast<std::time_t>(-1))
+  {
+    for (int i = 0; i < TYPE_COUNT; ++i)
+    {
+      this->typeCounts_[i] = 0;
+    }
+  }
+
+  bool read(const char *filename);
+  void report(void);
+
+private:
+  bool decode(const char *data, const char *end);
+  bool getVarint(const char * & data, const char *end, unsigned long & value);
+  bool getField(const char * & data, const char *end, Field & field);
+  bool selected(Event & event);
+  void print(const Event & event);
+  void foldDomains(void);
+
+  const Options & options_;
+  MatchCache nicks_, hosts_;
+  std::vector<std::string> strings_;
+  std::vector<unsigned long> domainCounts_;	// By string number
+  std::map<std::string, unsigned long> domains_;
+  unsigned long typeCounts_[TYPE_COUNT];
+  std::time_t lastTime_;
+  std::time_t lastStamp_;
+  char stamp_[32];
+};
+
+
+// Returns false with data short of end if the varint is too long to be
+// valid, and with data at end if it is cut off
+bool
+Reader::getVarint(const char * & data, const char *end, unsigned long & value)
+{
+  value = 0;
+  for (unsigned int shift = 0; data < end; shift += 7)
+  {
+    if (shift >= sizeof(unsigned long) * CHAR_BIT)
+    {
+      return false;
+    }
+
+    const unsigned char byte = *data++;
+    value |= static_cast<unsigned long>(byte & 0x7f) << shift;
+    if (0 == (byte & 0x80))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+bool
+Reader::getField(const char * & data, const char *end, Field & field)
+{
+  unsigned long value;
+
+  if (!this->getVarint(data, end, value))
+  {
+    return false;
+  }
+
+  if (0 == value)
+  {
+    field.id = -1;
+    if (!this->getVarint(data, end, field.length) ||
+      (field.length > static_cast<unsigned long>(end - data)))
+    {
+      return false;
+    }
+    field.data = data;
+    data += field.length;
+  }
+  else
+  {
+    if (value > this->strings_.size())
+    {
+      return false;
+    }
+    field.id = value - 1;
+    field.data = this->strings_[field.id].data();
+    field.length = this->strings_[field.id].length();
+  }
+
+  return true;
+}
+
+
+// foldDomains()
+//
+// Adds the domain counts kept by string number to the totals kept by
+// name, before the string table is replaced.
+//
+void
+Reader::foldDomains(void)
+{
+  for (std::vector<unsigned long>::size_type i = 0;
+    i < this->domainCounts_.size(); ++i)
+  {
+    if (this->domainCounts_[i] > 0)
+    {
+      this->domains_[this->strings_[i]] += this->domainCounts_[i];
+    }
+  }
+  this->domainCounts_.clear();
+}
+
+
+bool
+Reader::selected(Event & event)
+{
+  if ((0 != this->options_.types) &&
+    (0 == (this->options_.types & (1 << event.type))))
+  {
+    return false;
+  }
+
+  if ((0 != this->options_.start) && (event.when < this->options_.start))
+  {
+    return false;
+  }
+
+  if ((0 != this->options_.end) && (event.when > this->options_.end))
+  {
+    return false;
+  }
+
+  // A /0 block matches every address
+  if ((this->options_.ipBits > 0) && (0 != ((event.ip ^
+    this->options_.ipMask) >> (32 - this->options_.ipBits))))
+  {
+    return false;
+  }
+
+  if (!this->hosts_.any() && !this->hosts_.match(event.host))
+  {
+    return false;
+  }
+
+  if (!this->nicks_.any() && !this->nicks_.match(event.nick) &&
+    ((Journal::NICK != event.type) || !this->nicks_.match(event.extra)))
+  {
+    return false;
+  }
+
+  return true;
+}
+
+
+void
+Reader::print(const Event & event)
+{
+  if (event.when != this->lastStamp_)
+  {
+    this->lastStamp_ = event.when;
+    std::strftime(this->stamp_, sizeof(this->stamp_), "%Y/%m/%d %H:%M:%S",
+      std::localtime(&event.when));
+  }
+
+  struct in_addr addr;
+  addr.s_addr = htonl(event.ip);
+
+  std::cout << '[' << this->stamp_ << "] " << event.server.str() << ' ' <<
+    typeNames[event.type] << ' ' << event.nick.str() << '!' <<
+    event.user.str() << '@' << event.host.str() << " [" <<
+    ::inet_ntoa(addr) << ']';
+
+  switch (event.type)
+  {
+    case Journal::CONNECT:
+      std::cout << " {" << event.extra.str() << "} (" << event.text.str() <<
+        ')';
+      break;
+    case Journal::NICK:
+      std::cout << " -> " << event.extra.str();
+      break;
+    case Journal::TRAP:
+      std::cout << " #" << event.number << ' ' << event.extra.str();
+      break;
+    case Journal::PROXY:
+      std::cout << ' ' << event.extra.str() << ':' << event.number;
+      break;
+    case Journal::DNSBL:
+      std::cout << ' ' << event.extra.str();
+      break;
+    case Journal::ACTION:
+      std::cout << ' ' << event.extra.str() << ": " << event.text.str();
+      break;
+  }
+
+  std::cout << '\n';
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Reader::decode(data, end)
+//
+// Description:
+//  Decodes one record, updating the string table or reporting the
+//  event if it is selected.
+//
+// Parameters:
+//  data - The first byte of the record, after its length.
+//  end  - The end of the record.
+//
+// Return Value:
+//  The function returns false if the record is malformed.
+//////////////////////////////////////////////////////////////////////
+bool
+Reader::decode(const char *data, const char *end)
+{
+  if (data >= end)
+  {
+    return false;
+  }
+
+  Event event;
+  event.type = static_cast<unsigned char>(*data++);
+
+  if (Journal::RESET == event.type)
+  {
+    this->foldDomains();
+    this->strings_.clear();
+    this->nicks_.reset();
+    this->hosts_.reset();
+    this->lastTime_ = 0;
+  }
+
+  unsigned long delta;
+  if ((event.type >= TYPE_COUNT) || !this->getVarint(data, end, delta))
+  {
+    return false;
+  }
+  this->lastTime_ += static_cast<long>(delta >> 1) ^
+    -static_cast<long>(delta & 1);
+  event.when = this->lastTime_;
+
+  switch (event.type)
+  {
+    case Journal::STRING:
+      this->strings_.push_back(std::string(data, end - data));
+      return true;
+    case Journal::RESET:
+      return true;
+  }
+
+  if (!this->getField(data, end, event.server) ||
+    !this->getField(data, end, event.nick) ||
+    !this->getField(data, end, event.user) ||
+    !this->getField(data, end, event.host) ||
+    !this->getField(data, end, event.domain) || (end - data < 4))
+  {
+    return false;
+  }
+
+  uint32_t ip;
+  std::memcpy(&ip, data, 4);
+  event.ip = ntohl(ip);
+  data += 4;
+
+  event.number = 0;
+  event.extra.id = event.text.id = -1;
+  event.extra.data = event.text.data = data;
+  event.extra.length = event.text.length = 0;
+
+  switch (event.type)
+  {
+    case Journal::CONNECT:
+    case Journal::ACTION:
+      if (!this->getField(data, end, event.extra) ||
+        !this->getField(data, end, event.text))
+      {
+        return false;
+      }
+      break;
+    case Journal::NICK:
+    case Journal::DNSBL:
+      if (!this->getField(data, end, event.extra))
+      {
+        return false;
+      }
+      break;
+    case Journal::TRAP:
+    case Journal::PROXY:
+      if (!this->getVarint(data, end, event.number) ||
+        !this->getField(data, end, event.extra))
+      {
+        return false;
+      }
+      break;
+  }
+
+  if (this->selected(event))
+  {
+    ++this->typeCounts_[event.type];
+
+    if (this->options_.byDomain)
+    {
+      if (event.domain.id >= 0)
+      {
+        const std::vector<unsigned long>::size_type id = event.domain.id;
+        if (id >= this->domainCounts_.size())
+        {
+          this->domainCounts_.resize(id + 1, 0);
+        }
+        ++this->domainCounts_[id];
+      }
+      else
+      {
+        ++this->domains_[event.domain.str()];
+      }
+    }
+    else if (!this->options_.byType)
+    {
+      this->print(event);
+    }
+  }
+
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Reader::read(filename)
+//
+// Description:
+//  Reads a journal file, a block at a time.  A record cut off at the
+//  end of the file, as happens while the bot is still writing it, is
+//  ignored with a warning.  After a damaged or truncated record, reading
+//  resumes at the marker written when the bot next started journaling.
+//
+// Parameters:
+//  filename - The journal file, or "-" for standard input.
+//
+// Return Value:
+//  The function returns false if the file could not be read or is not
+//  a journal.
+//////////////////////////////////////////////////////////////////////
+bool
+Reader::read(const char *filename)
+{
+  const int fd = (0 == std::strcmp(filename, "-")) ? 0 :
+    ::open(filename, O_RDONLY);
+
+  if (-1 == fd)
+  {
+    std::cerr << filename << ": " << std::strerror(errno) << std::endl;
+    return false;
+  }
+
+  std::vector<char> buffer(READ_SIZE);
+  std::vector<char>::size_type have = 0;
+  unsigned long offset = 0;		// Of the start of the buffer
+  unsigned long skipped = 0;		// Of the record being skipped
+  bool header = true, eof = false, resync = false, ok = true;
+  const std::string marker(syncMarker());
+
+  while (ok && !eof)
+  {
+    if (have == buffer.size())
+    {
+      buffer.resize(buffer.size() * 2);
+    }
+
+    const ssize_t n = ::read(fd, &buffer[have], buffer.size() - have);
+    if (n < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+      std::cerr << filename << ": " << std::strerror(errno) << std::endl;
+      ok = false;
+      break;
+    }
+    eof = (0 == n);
+    have += n;
+
+    const char *data = &buffer[0];
+    const char *end = data + have;
+
+    if (header)
+    {
+      const std::string::size_type magic = std::strlen(JOURNAL_MAGIC);
+      if (static_cast<std::string::size_type>(end - data) < magic + 1)
+      {
+        if (eof)
+        {
+          std::cerr << filename << ": Not a journal" << std::endl;
+          ok = false;
+        }
+        continue;
+      }
+      if ((0 != std::memcmp(data, JOURNAL_MAGIC, magic)) ||
+        (JOURNAL_VERSION != data[magic]))
+      {
+        std::cerr << filename << ": Not a journal, or an unknown version" <<
+          std::endl;
+        ok = false;
+        break;
+      }
+      data += magic + 1;
+      header = false;
+    }
+
+    for (;;)
+    {
+      if (resync)
+      {
+        const char *found = std::search(data, end, marker.begin(),
+          marker.end());
+
+        if (end == found)
+        {
+          // Keep what might be the start of a marker
+          if (static_cast<std::string::size_type>(end - data) >=
+            marker.length())
+          {
+            data = end - (marker.length() - 1);
+          }
+          break;
+        }
+
+        const unsigned long resume = offset + (found - &buffer[0]);
+        std::cerr << filename << ": Skipped " << (resume - skipped) <<
+          " bytes to offset " << resume << std::endl;
+        data = found;
+        resync = false;
+      }
+
+      const char *start = data;
+      unsigned long length;
+
+      if ((static_cast<std::string::size_type>(end - data) >=
+        marker.length()) &&
+        (0 == std::memcmp(data, marker.data(), marker.length())))
+      {
+        // Another run of the bot; its RESET record comes next
+        data += std::strlen(JOURNAL_MAGIC) + 1;
+        continue;
+      }
+
+      if (!this->getVarint(data, end, length))
+      {
+        if (data < end)
+        {
+          std::cerr << filename << ": Bad record length at offset " <<
+            (offset + (start - &buffer[0])) << std::endl;
+          data = start + 1;
+          resync = true;
+          continue;
+        }
+        data = start;
+        break;
+      }
+
+      // A run of the bot that stopped partway through a record leaves
+      // it cut short, followed by the marker of the next run
+      const char *recordEnd = data +
+        std::min(length, static_cast<unsigned long>(end - data));
+      const char *found = std::search(start + 1, std::min(end,
+        recordEnd + marker.length() - 1), marker.begin(), marker.end());
+
+      if (found < recordEnd)
+      {
+        std::cerr << filename << ": Truncated record at offset " <<
+          (offset + (start - &buffer[0])) << std::endl;
+        data = found;
+        continue;
+      }
+
+      // Wait for the rest of the record, and for enough after it to be
+      // sure no marker starts inside it
+      if ((length > static_cast<unsigned long>(end - data)) || (!eof &&
+        (static_cast<std::string::size_type>(end - recordEnd) <
+        marker.length() - 1)))
+      {
+        data = start;
+        break;
+      }
+
+      if (!this->decode(data, data + length))
+      {
+        skipped = offset + (start - &buffer[0]);
+        std::cerr << filename << ": Bad record at offset " << skipped <<
+          std::endl;
+        data = start + 1;
+        resync = true;
+        continue;
+      }
+      data += length;
+    }
+
+    // Keep the partial record for the next block
+    offset += data - &buffer[0];
+    have = end - data;
+    std::memmove(&buffer[0], data, have);
+  }
+
+  if (ok && resync)
+  {
+    std::cerr << filename << ": Skipped the rest of the file" << std::endl;
+  }
+  else if (ok && (have > 0))
+  {
+    std::cerr << filename << ": Ignored a truncated record at offset " <<
+      offset << std::endl;
+  }
+
+  if (0 != fd)
+  {
+    ::close(fd);
+  }
+
+  return ok;
+}
+
+
+static bool
+byCount(const std::pair<std::string, unsigned long> & left,
+  const std::pair<std::string, unsigned long> & right)
+{
+  return (left.second > right.second) ||
+    ((left.second == right.second) && (left.first < right.first));
+}
+
+
+void
+Reader::report(void)
+{
+  if (this->options_.byDomain)
+  {
+    this->foldDomains();
+
+    std::vector<std::pair<std::string, unsigned long> > sorted(
+      this->domains_.begin(), this->domains_.end());
+    std::sort(sorted.begin(), sorted.end(), byCount);
+
+    for (std::vector<std::pair<std::string, unsigned long> >::iterator pos =
+      sorted.begin(); pos != sorted.end(); ++pos)
+    {
+      std::cout << pos->second << ' ' << pos->first << '\n';
+    }
+  }
+  else if (this->options_.byType)
+  {
+    for (int i = Journal::CONNECT; i < TYPE_COUNT; ++i)
+    {
+      std::cout << this->typeCounts_[i] << ' ' << typeNames[i] << '\n';
+    }
+  }
+}
+
+
+// Accepts seconds since the epoch or a local "YYYY/MM/DD [hh:mm[:ss]]"
+static bool
+parseTime(const char *text, std::time_t & when)
+{
+  struct std::tm tm;
+  std::memset(&tm, 0, sizeof(tm));
+  tm.tm_isdst = -1;
+
+  const int fields = std::sscanf(text, "%d/%d/%d %d:%d:%d", &tm.tm_year,
+    &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+
+  if (fields >= 3)
+  {
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    when = std::mktime(&tm);
+    return (static_cast<std::time_t>(-1) != when);
+  }
+
+  char *end;
+  when = std::strtol(text, &end, 10);
+
+  return ('\0' == *end) && (end != text);
+}
+
+
+static bool
+parseAddress(const std::string & text, unsigned long & address, int & bits)
+{
+  std::string::size_type slash = text.find('/');
+  struct in_addr addr;
+
+  if (0 == ::inet_aton(text.substr(0, slash).c_str(), &addr))
+  {
+    return false;
+  }
+  address = ntohl(addr.s_addr);
+  bits = (std::string::npos == slash) ? 32 :
+    std::atoi(text.c_str() + slash + 1);
+
+  return (bits >= 0) && (bits <= 32);
+}
+
+
+static bool
+parseTypes(const std::string & text, unsigned int & types)
+{
+  std::string::size_type start = 0;
+
+  while (start <= text.length())
+  {
+    std::string::size_type comma = text.find(',', start);
+    if (std::string::npos == comma)
+    {
+      comma = text.length();
+    }
+
+    const std::string name(lowerCase(text.substr(start, comma - start)));
+    int type = Journal::CONNECT;
+    while ((type < TYPE_COUNT) && (name != typeNames[type]))
+    {
+      ++type;
+    }
+    if (TYPE_COUNT == type)
+    {
+      return false;
+    }
+    types |= 1 << type;
+
+    start = comma + 1;
+  }
+
+  return true;
+}
+
+
+static void
+usage(const char *name)
+{
+  std::cerr << "Usage: " << name << " [-cd] [-s start] [-e end] [-t types]" <<
+    " [-n nick] [-H host]" << std::endl << "       [-i ip[/bits]]" <<
+    " journal_file ..." << std::endl;
+  std::cerr << std::endl;
+  std::cerr << "Options:" << std::endl;
+  std::cerr << " -c             count the selected events by type" <<
+    std::endl;
+  std::cerr << " -d             count the selected events by domain" <<
+    std::endl;
+  std::cerr << " -s start       skip events before this time" << std::endl;
+  std::cerr << " -e end         skip events after this time" << std::endl;
+  std::cerr << " -t types       select connect, exit, nick, trap, proxy," <<
+    " dnsbl, action" << std::endl;
+  std::cerr << " -n nick        select events for nicks matching this mask" <<
+    std::endl;
+  std::cerr << " -H host        select events for hosts matching this mask" <<
+    std::endl;
+  std::cerr << " -i ip[/bits]   select events for this address or block" <<
+    std::endl;
+  std::cerr << std::endl;
+  std::cerr << "Times are seconds since the epoch or \"YYYY/MM/DD hh:mm:ss\"." <<
+    std::endl;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  Options options;
+  int ch;
+
+  while ((ch = getopt(argc, argv, "cds:e:t:n:H:i:")) != -1)
+  {
+    switch (ch)
+    {
+      case 'c':
+        options.byType = true;
+        break;
+      case 'd':
+        options.byDomain = true;
+        break;
+      case 's':
+      case 'e':
+        if (!parseTime(optarg, ('s' == ch) ? options.start : options.end))
+        {
+          std::cerr << "Invalid time: " << optarg << std::endl;
+          return 1;
+        }
+        break;
+      case 't':
+        if (!parseTypes(optarg, options.types))
+        {
+          std::cerr << "Invalid event type: " << optarg << std::endl;
+          return 1;
+        }
+        break;
+      case 'n':
+        options.nickMask = optarg;
+        break;
+      case 'H':
+        options.hostMask = optarg;
+        break;
+      case 'i':
+        if (!parseAddress(optarg, options.ipMask, options.ipBits))
+        {
+          std::cerr << "Invalid address: " << optarg << std::endl;
+          return 1;
+        }
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (optind >= argc)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::ios::sync_with_stdio(false);
+
+  Reader reader(options);
+  int result = 0;
+
+  for (int i = optind; i < argc; ++i)
+  {
+    if (!reader.read(argv[i]))
+    {
+      result = 1;
+    }
+  }
+
+  reader.report();
+
+  return result;
+}
+
@@ -24,6 +24,9 @@
 // Std C++ headers
 #include <iostream>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
 
 // Boost C++ Headers
 #include <boost/lexical_cast.hpp>
@@ -37,6 +40,10 @@
 #include "util.h"
 #include "config.h"
 #include "log.h"
+#include "vars.h"
+#include "defaults.h"
+#include "zstream.h"
+#include "stats.h"
 
 
 #ifdef DEBUG
@@ -48,10 +55,26 @@ const std::string Remote::PROTOCOL_NAME("OOMon");
 const int Remote::PROTOCOL_VERSION_MAJOR(2);
 const int Remote::PROTOCOL_VERSION_MINOR(3);
 
+int Remote::sendQ(DEFAULT_REMOTE_SENDQ);
+int Remote::compression(DEFAULT_REMOTE_COMPRESSION);
+bool Remote::framing(DEFAULT_REMOTE_FRAMING);
+
+// Command names, indexed by command number
+static const char * const COMMAND_NAMES[Remote::CMD_COUNT] =
+{
+  "", "ERROR", "PING", "PONG", "AUTH", "BOTJOIN", "BOTPART", "CHAT",
+  "COMMAND", "BROADCAST", "NOTICE"
+};
+
+// Longest message sent over a framed link, not counting its header.
+// Longer ones are cut short, as long lines are on text links.
+static const std::string::size_type MAX_FRAME = 2048;
+
 
 Remote::Remote(const std::string & handle)
   : handle_(handle), stage_(Remote::STAGE_INIT), client_(true),
-  sock_(false, true), targetEstablished_(false)
+  sock_(false, true), targetEstablished_(false), compressionOffered_(false),
+  framingOffered_(false), framed_(false), handlers_(Remote::CMD_COUNT)
 {
   this->sock_.setBuffering(true);
   this->configureCallbacks();
@@ -60,7 +83,8 @@ Remote::Remote(const std::string & handle)
 
 Remote::Remote(BotSock *listener)
   : stage_(Remote::STAGE_INIT), client_(false), sock_(listener, false, true),
-  targetEstablished_(false)
+  targetEstablished_(false), compressionOffered_(false),
+  framingOffered_(false), framed_(false), handlers_(Remote::CMD_COUNT)
 {
   this->sock_.setBuffering(true);
   this->configureCallbacks();
@@ -70,38 +94,53 @@ Remote::Remote(BotSock *listener)
 void
 Remote::configureCallbacks(void)
 {
+  this->sock_.setMaxQueue(Remote::sendQ);
+  this->sock_.setBufferSize(BotSock::FRAME_HEADER + MAX_FRAME);
+
   // BotSock callbacks
   this->sock_.registerOnConnectHandler(boost::bind(&Remote::onConnect, this));
   this->sock_.registerOnReadHandler(boost::bind(&Remote::onRead, this, _1));
+  // If we've been idle for half the timeout period, send a PING to make
+  // sure the connection is still good!
+  this->sock_.registerOnIdleHandler(boost::bind(&Remote::sendPing, this));
 
   // Remote callbacks
-  this->registerCommand("ERROR", &Remote::onError);
-  this->registerCommand("PING", &Remote::onPing);
-  this->registerCommand("PONG", &Remote::onPong);
-  this->registerCommand("AUTH", &Remote::onAuth);
-  this->registerCommand("BOTJOIN", &Remote::onBotJoin);
-  this->registerCommand("BOTPART", &Remote::onBotPart);
-  this->registerCommand("CHAT", &Remote::onChat);
-  this->registerCommand("COMMAND", &Remote::onCommand);
-  this->registerCommand("BROADCAST", &Remote::onBroadcast);
-  this->registerCommand("NOTICE", &Remote::onNotice);
+  this->registerCommand(Remote::CMD_ERROR, &Remote::onError);
+  this->registerCommand(Remote::CMD_PING, &Remote::onPing);
+  this->registerCommand(Remote::CMD_PONG, &Remote::onPong);
+  this->registerCommand(Remote::CMD_AUTH, &Remote::onAuth);
+  this->registerCommand(Remote::CMD_BOTJOIN, &Remote::onBotJoin);
+  this->registerCommand(Remote::CMD_BOTPART, &Remote::onBotPart);
+  this->registerCommand(Remote::CMD_CHAT, &Remote::onChat);
+  this->registerCommand(Remote::CMD_COMMAND, &Remote::onCommand);
+  this->registerCommand(Remote::CMD_BROADCAST, &Remote::onBroadcast);
+  this->registerCommand(Remote::CMD_NOTICE, &Remote::onNotice);
 }
 
 
+// registerCommand(command, callback)
+//
+// Registers a command's callback both by name, for text links, and by
+// number, for framed links.
+//
 void
-Remote::registerCommand(const std::string & command,
+Remote::registerCommand(const Remote::Command command,
   bool (Remote::*callback)(const std::string & from,
   const std::string & command, const StrVector & parameters))
 {
-  this->commands.insert(std::make_pair(::UpCase(command),
-    boost::bind(callback, this, _1, _2, _3)));
+  CommandCallback function(boost::bind(callback, this, _1, _2, _3));
+
+  this->commands.insert(std::make_pair(std::string(COMMAND_NAMES[command]),
+    function));
+  this->handlers_[command] = function;
 }
 
 
 void
-Remote::unregisterCommand(const std::string & command)
+Remote::unregisterCommand(const Remote::Command command)
 {
-  this->commands.erase(::UpCase(command));
+  this->commands.erase(COMMAND_NAMES[command]);
+  this->handlers_[command].clear();
 }
 
 
@@ -141,25 +180,76 @@ Remote::isAuthorized(void) const
 
 
 void
-Remote::preSelect(fd_set & readset, fd_set & writeset) const
+Remote::init(void)
 {
-  this->sock_.preSelect(readset, writeset);
+  vars.insert("REMOTE_COMPRESSION",
+    Setting::IntegerSetting(Remote::compression, 0, 9));
+  vars.insert("REMOTE_FRAMING", Setting::BooleanSetting(Remote::framing));
+  vars.insert("REMOTE_SENDQ", Setting::IntegerSetting(Remote::sendQ, 0));
 }
 
 
 bool
-Remote::postSelect(const fd_set & readset, const fd_set & writeset)
+Remote::process(void)
 {
-  // If we've been idle for half the timeout period, send a PING to make
-  // sure the connection is still good!
-  if (this->isConnected() &&
-      (this->getIdle() > (this->sock_.getTimeout() / 2)) &&
-      (this->sock_.getWriteIdle() > (this->sock_.getTimeout() / 2)))
+  return this->sock_.process();
+}
+
+
+// flush()
+//
+// Sends whatever output a compressed or framed link is holding back,
+// without waiting for BotSock::flushBatches() at the end of the main
+// loop pass.
+//
+bool
+Remote::flush(void)
+{
+  return this->sock_.flushBatch();
+}
+
+
+#ifdef HAVE_LIBZ
+// Describes one direction of a compressed link
+static std::string
+compressed(const unsigned long raw, const unsigned long packed)
+{
+  char ratio[32];
+
+  std::snprintf(ratio, sizeof(ratio), "%.1f:1",
+    (packed > 0) ? (static_cast<double>(raw) / packed) : 0.0);
+
+  return boost::lexical_cast<std::string>(raw) + " bytes as " +
+    boost::lexical_cast<std::string>(packed) + " (" + ratio + ")";
+}
+#endif
+
+
+void
+Remote::status(BotClient * client) const
+{
+  std::string handle(this->getHandle());
+
+  std::string msg("Link ");
+  msg += handle.empty() ? "<unknown>" : handle;
+  msg += this->framed_ ? ": framed, " : ": text, ";
+
+#ifdef HAVE_LIBZ
+  const ZStream * zstream = this->sock_.getCompression();
+
+  if (0 != zstream)
   {
-    this->sendPing();
+    msg += "sent " + compressed(zstream->rawOut(), zstream->packedOut()) +
+      ", received " + compressed(zstream->rawIn(), zstream->packedIn()) +
+      ", " + Stats::formatSeconds(zstream->seconds()) + " in zlib";
+  }
+  else
+#endif
+  {
+    msg += "not compressed";
   }
 
-  return this->sock_.postSelect(readset, writeset);
+  client->send(msg);
 }
 
 
@@ -324,6 +414,54 @@ Remote::isCompatibleProtocolVersion(std::string text)
 }
 
 
+// offers(version, option)
+//
+// Checks whether the other end's version line offers an option, such as
+// "ZLIB" or "FRAMED".  Older bots ignore anything after the version
+// numbers.
+//
+bool
+Remote::offers(std::string version, const std::string & option)
+{
+  // Skip the protocol name and version numbers
+  FirstWord(version);
+  FirstWord(version);
+  FirstWord(version);
+
+  for (std::string word = FirstWord(version); !word.empty();
+    word = FirstWord(version))
+  {
+    if (word == option)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+// startOptions(version)
+//
+// Turns on the options that both ends of the link offered, starting
+// after the version line just received.
+//
+void
+Remote::startOptions(const std::string & version)
+{
+  if (this->compressionOffered_ && Remote::offers(version, "ZLIB"))
+  {
+    this->sock_.compress(Remote::compression);
+  }
+
+  if (this->framingOffered_ && Remote::offers(version, "FRAMED"))
+  {
+    this->framed_ = this->sock_.frame();
+    this->sock_.setBatching(this->framed_);
+  }
+}
+
+
 bool
 Remote::onRead(std::string text)
 {
@@ -333,6 +471,10 @@ Remote::onRead(std::string text)
   {
     result = true;
   }
+  else if (this->sock_.isFramed())
+  {
+    result = this->parseFrame(text);
+  }
   else
   {
 #ifdef REMOTE_DEBUG
@@ -350,11 +492,15 @@ Remote::onRead(std::string text)
 #endif
           if (this->isClient())
 	  {
+	    // The server's version came in reply to ours, so both ends
+	    // know by now which options the other offered
+	    this->startOptions(text);
 	    this->sendAuth();
 	  }
 	  else
 	  {
 	    this->sendVersion();
+	    this->startOptions(text);
 	  }
 	  this->stage_ = Remote::STAGE_GOODVERSION;
         }
@@ -401,9 +547,10 @@ Remote::onAuth(const std::string &, const std::string & command,
       result = true;
       this->handle_ = handle;
       this->children_.setName(handle);
+      remotes.addRoute(handle, this);
 
       this->stage_ = Remote::STAGE_AUTHED;
-      this->unregisterCommand("AUTH");
+      this->unregisterCommand(Remote::CMD_AUTH);
 
       if (this->isServer())
       {
@@ -469,6 +616,92 @@ Remote::parse(std::string text)
 }
 
 
+// Reads one field of a frame: a two byte, big-endian length followed by
+// that many bytes.  Returns false if the frame ends too soon.
+static bool
+readField(const std::string & frame, std::string::size_type & pos,
+  std::string & field)
+{
+  if ((frame.length() - pos) < 2)
+  {
+    return false;
+  }
+
+  const std::string::size_type length =
+    (static_cast<unsigned char>(frame[pos]) << 8) |
+    static_cast<unsigned char>(frame[pos + 1]);
+
+  if ((frame.length() - pos - 2) < length)
+  {
+    return false;
+  }
+
+  field.assign(frame, pos + 2, length);
+  pos += 2 + length;
+
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Remote::parseFrame(frame)
+//
+// Description:
+//  Handles a message received over a framed link.  The message is the
+//  command number, in one byte, followed by the name of the sender and
+//  then the parameters, each as a two byte, big-endian length followed
+//  by that many bytes.  The command's callback is found by number.
+//
+// Parameters:
+//  frame - The message, without its frame header.
+//
+// Return Value:
+//  The function returns false if the link should be dropped.
+//////////////////////////////////////////////////////////////////////
+bool
+Remote::parseFrame(const std::string & frame)
+{
+  const unsigned int command = static_cast<unsigned char>(frame[0]);
+  std::string::size_type pos = 1;
+  std::string from;
+  StrVector parameters;
+
+  if (!readField(frame, pos, from))
+  {
+    this->sendError("Malformed message");
+    return false;
+  }
+
+  while (pos < frame.length())
+  {
+    parameters.push_back(std::string());
+    if (!readField(frame, pos, parameters.back()))
+    {
+      this->sendError("Malformed message");
+      return false;
+    }
+  }
+
+#ifdef REMOTE_DEBUG
+  std::cout << "Remote >> [" << command << "] " << from;
+  for (StrVector::const_iterator param = parameters.begin();
+    param != parameters.end(); ++param)
+  {
+    std::cout << " \"" << *param << '"';
+  }
+  std::cout << std::endl;
+#endif
+
+  if ((command >= Remote::CMD_COUNT) || this->handlers_[command].empty())
+  {
+    this->sendUnknownCommand(boost::lexical_cast<std::string>(command));
+    return false;
+  }
+
+  return this->handlers_[command](from, COMMAND_NAMES[command], parameters);
+}
+
+
 bool
 Remote::onError(const std::string &, const std::string &,
   const StrVector & parameters)
@@ -509,7 +742,7 @@ Remote::onPing(const std::string & from, const std::string &,
 {
   if (from.empty())
   {
-    this->sendCommand("", "PONG", "");
+    this->sendCommand("", Remote::CMD_PONG);
   }
 
   return true;
@@ -550,10 +783,11 @@ Remote::onBotJoin(const std::string & from, const std::string & command,
       this->sendMyBotNet();
     }
 
-    if (!this->sendQ_.empty())
+    // The link's protocol is settled by now, so the messages queued
+    // while it was starting up can be encoded
+    for (; !this->sendQ_.empty(); this->sendQ_.pop_front())
     {
-      this->write(this->sendQ_);
-      this->sendQ_ = "";
+      this->write(this->sendQ_.front().encode(this->framed_));
     }
   }
   else if (1 == parameters.size())
@@ -568,7 +802,10 @@ Remote::onBotJoin(const std::string & from, const std::string & command,
     {
       result = true;
 
-      this->children_.Link(from, node);
+      if (this->children_.Link(from, node))
+      {
+        remotes.addRoute(node, this);
+      }
       remotes.sendBotJoin(from, node, this);
 
       if (this->ready())
@@ -605,7 +842,10 @@ Remote::onBotPart(const std::string & from, const std::string & command,
 
     if (this->ready())
     {
-      this->children_.Unlink(node);
+      StrList gone;
+
+      this->children_.Unlink(node, &gone);
+      remotes.removeRoutes(gone);
       remotes.sendBotPart(from, node, this);
 
       std::string notice("*** Bot ");
@@ -756,7 +996,13 @@ Remote::onBroadcast(const std::string & from, const std::string & command,
     std::string text(parameters[3]);
 
     std::string::size_type at(skip.find('@'));
-    if (std::string::npos != at)
+    if (!remotes.isRoute(from, this))
+    {
+      // This is a copy that went around a loop, so it has already been
+      // delivered and relayed
+      result = true;
+    }
+    else if (std::string::npos != at)
     {
       std::string skipId = skip.substr(0, at);
       std::string skipBot = skip.substr(at + 1);
@@ -821,55 +1067,213 @@ Remote::onNotice(const std::string & from, const std::string & command,
 }
 
 
-int
-Remote::sendBroadcast(const std::string & from, const std::string & text,
-  const std::string & flags, const std::string & watches)
+// Message::encode(framed)
+//
+// Returns the message encoded for a text or framed link, encoding it the
+// first time it is needed.
+//
+const BotSock::Buffer &
+Remote::Message::encode(const bool framed) const
 {
-  std::string msg("* ");
-  msg += flags;
-  msg += ' ';
-  msg += watches;
-  msg += " :";
-  msg += text;
-  msg += '\n';
-
-  return this->sendCommand(from, "BROADCAST", msg);
+  BotSock::Buffer & encoded = framed ? this->frame_ : this->text_;
+
+  if (0 == encoded.get())
+  {
+    encoded.reset(new std::string(framed ? this->encodeFrame() :
+      this->encodeText()));
+  }
+
+  return encoded;
 }
 
 
-int
-Remote::sendBroadcastPtr(const std::string & from, const Remote *skip,
-  const std::string & text, const std::string & flags,
-  const std::string & watches)
+// Message::encodeText()
+//
+// Encodes the message as a line of text.  The last parameter is preceded
+// by a colon if it could be mistaken for more than one parameter.
+//
+std::string
+Remote::Message::encodeText(void) const
 {
-  int result = 0;
+  std::string text;
 
-  if (this != skip)
+  if (!this->from_.empty())
   {
-    result = this->sendBroadcast(from, text, flags, watches);
+    text += ':';
+    text += this->from_;
+    text += ' ';
   }
+  text += COMMAND_NAMES[this->command_];
 
-  return result;
+  for (StrVector::const_iterator pos = this->parameters_.begin();
+    pos != this->parameters_.end(); ++pos)
+  {
+    text += ' ';
+    if (((pos + 1) == this->parameters_.end()) && (pos->empty() ||
+      (':' == (*pos)[0]) || (std::string::npos != pos->find(' '))))
+    {
+      text += ':';
+    }
+    text += *pos;
+  }
+  text += '\n';
+
+  return text;
 }
 
 
+// Appends a field to a frame, cut short to at most the given length
+static void
+appendField(std::string & frame, const std::string & field,
+  const std::string::size_type limit)
+{
+  const std::string::size_type length = std::min(field.length(), limit);
+
+  frame += static_cast<char>((length >> 8) & 0xff);
+  frame += static_cast<char>(length & 0xff);
+  frame.append(field, 0, length);
+}
+
+
+// Message::encodeFrame()
+//
+// Encodes the message as a frame.  If it would be too long, the fields
+// are cut short, starting with the last parameter and working back
+// until it fits.  A message that can't be made to fit at all is encoded
+// as an empty string, which is not sent.
+//
+std::string
+Remote::Message::encodeFrame(void) const
+{
+  // The length of the sender followed by the length of each parameter
+  std::vector<std::string::size_type> lengths;
+  lengths.reserve(1 + this->parameters_.size());
+  lengths.push_back(this->from_.length());
+
+  std::string::size_type size = 3 + this->from_.length();
+
+  for (StrVector::const_iterator pos = this->parameters_.begin();
+    pos != this->parameters_.end(); ++pos)
+  {
+    lengths.push_back(pos->length());
+    size += 2 + pos->length();
+  }
+
+  std::string::size_type excess = (size > MAX_FRAME) ?
+    (size - MAX_FRAME) : 0;
+
+  for (std::vector<std::string::size_type>::reverse_iterator pos =
+    lengths.rbegin(); (excess > 0) && (pos != lengths.rend()); ++pos)
+  {
+    const std::string::size_type cut = std::min(excess, *pos);
+
+    *pos -= cut;
+    size -= cut;
+    excess -= cut;
+  }
+
+  if (excess > 0)
+  {
+    return std::string();
+  }
+
+  std::string frame;
+  frame.reserve(BotSock::FRAME_HEADER + size);
+  frame.append(BotSock::FRAME_HEADER, '\0');
+  frame += static_cast<char>(this->command_);
+  appendField(frame, this->from_, lengths[0]);
+
+  for (StrVector::size_type i = 0; i < this->parameters_.size(); ++i)
+  {
+    appendField(frame, this->parameters_[i], lengths[i + 1]);
+  }
+
+  const std::string::size_type length = frame.length() -
+    BotSock::FRAME_HEADER;
+  frame[0] = static_cast<char>((length >> 8) & 0xff);
+  frame[1] = static_cast<char>(length & 0xff);
+
+  return frame;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Remote::makeBroadcast(from, skip, text, flags, watches)
+//
+// Description:
+//  Builds a BROADCAST command.  The same message is usually sent over
+//  every link, so it is built once and shared by each link it is sent
+//  to with sendMessage().
+//
+// Parameters:
+//  from    - The bot the broadcast came from.
+//  skip    - The client ID and bot ("id@bot") of the client that is not
+//            to receive the broadcast, or "*".
+//  text    - The text of the broadcast.
+//  flags   - The user flags a client needs to receive the broadcast.
+//  watches - The watches a client needs to receive the broadcast.
+//
+// Return Value:
+//  The function returns the message.
+//////////////////////////////////////////////////////////////////////
+Remote::Message
+Remote::makeBroadcast(const std::string & from, const std::string & skip,
+  const std::string & text, const std::string & flags,
+  const std::string & watches)
+{
+  StrVector parameters;
+
+  parameters.reserve(4);
+  parameters.push_back(skip);
+  parameters.push_back(flags);
+  parameters.push_back(watches);
+  parameters.push_back(text);
+
+  return Remote::Message(from, Remote::CMD_BROADCAST, parameters);
+}
+
+
+// makeRemoteCommand(from, to, clientId, command, parameters)
+//
+// Builds a COMMAND command, to run a command on another bot, or on
+// every bot if "to" is "*".
+//
+Remote::Message
+Remote::makeRemoteCommand(const std::string & from, const std::string & to,
+  const std::string & clientId, const std::string & command,
+  const std::string & parameters)
+{
+  StrVector fields;
+
+  fields.reserve(3);
+  fields.push_back(to);
+  fields.push_back(clientId);
+  fields.push_back(command + ' ' + parameters);
+
+  return Remote::Message(from, Remote::CMD_COMMAND, fields);
+}
+
+
+// sendMessage(message, queue)
+//
+// Sends a message, encoded for the link's protocol.  Unless queue is
+// false, it is held until the link is ready.
+//
 int
-Remote::sendBroadcastId(const std::string & from, const std::string & skipId,
-  const std::string & skipBot, const std::string & text,
-  const std::string & flags, const std::string & watches)
+Remote::sendMessage(const Remote::Message & message, const bool queue)
 {
-  std::string msg(skipId);
-  msg += '@';
-  msg += skipBot;
-  msg += ' ';
-  msg += flags;
-  msg += ' ';
-  msg += watches;
-  msg += " :";
-  msg += text;
-  msg += '\n';
-
-  return this->sendCommand(from, "BROADCAST", msg);
+  int result = 0;
+
+  if (!queue || this->ready())
+  {
+    result = this->write(message.encode(this->framed_));
+  }
+  else
+  {
+    this->sendQ_.push_back(message);
+  }
+
+  return result;
 }
 
 
@@ -877,21 +1281,24 @@ int
 Remote::sendNotice(const std::string & from, const std::string & clientId,
   const std::string & clientBot, const std::string & text)
 {
-  std::string msg(clientId);
-  msg += ' ';
-  msg += clientBot;
-  msg += " :";
-  msg += text;
-  msg += '\n';
-
-  return this->sendCommand(from, "NOTICE", msg);
+  StrVector parameters;
+
+  parameters.reserve(3);
+  parameters.push_back(clientId);
+  parameters.push_back(clientBot);
+  parameters.push_back(text);
+
+  return this->sendCommand(from, Remote::CMD_NOTICE, parameters);
 }
 
 
 int
 Remote::sendError(const std::string & text)
 {
-  int result = this->sendCommand("", "ERROR", ":" + text, false);
+  int result = this->sendCommand("", Remote::CMD_ERROR, StrVector(1, text),
+    false);
+  // The link is about to be dropped, so don't hold the error back
+  this->flush();
 
   std::string handle(this->getHandle());
 
@@ -930,57 +1337,10 @@ Remote::sendSyntaxError(const std::string & command)
 
 
 int
-Remote::sendCommand(const std::string & from, const std::string & command,
-  const std::string & parameters, const bool queue)
-{
-  int result = 0;
-
-  std::string text;
-  if (!from.empty())
-  {
-    text += ':';
-    text += from;
-    text += ' ';
-  }
-  text += command;
-  if (!parameters.empty())
-  {
-    text += ' ';
-    text += parameters;
-  }
-  text += '\n';
-
-  if (!queue || this->ready())
-  {
-    result = this->write(text);
-  }
-  else
-  {
-    this->sendQ_ += text;
-  }
-
-  return result;
-}
-
-
-int
-Remote::sendChat(const std::string & from, const std::string & text)
+Remote::sendCommand(const std::string & from, const Remote::Command command,
+  const StrVector & parameters, const bool queue)
 {
-  return this->sendCommand(from, "CHAT", ":" + text);
-}
-
-
-int
-Remote::sendBotJoin(const std::string & oldnode, const std::string & newnode)
-{
-  return this->sendCommand(oldnode, "BOTJOIN", newnode);
-}
-
-
-int
-Remote::sendBotPart(const std::string & from, const std::string & node)
-{
-  return this->sendCommand(from, "BOTPART", node);
+  return this->sendMessage(Remote::Message(from, command, parameters), queue);
 }
 
 
@@ -995,9 +1355,11 @@ Remote::sendMyBotNet(void)
   for (BotLinkList::iterator pos = net.begin(); pos != net.end(); 
     pos = net.erase(pos))
   {
-    result += this->sendCommand(pos->nodeA, "BOTJOIN", pos->nodeB, false);
+    result += this->sendCommand(pos->nodeA, Remote::CMD_BOTJOIN,
+      StrVector(1, pos->nodeB), false);
   }
-  this->sendCommand(config.nickname(), "BOTJOIN", "", false);
+  this->sendCommand(config.nickname(), Remote::CMD_BOTJOIN, StrVector(),
+    false);
 
   return result;
 }
@@ -1006,16 +1368,32 @@ Remote::sendMyBotNet(void)
 int
 Remote::sendVersion(void)
 {
-  return this->write(Remote::PROTOCOL_NAME + " " +
+  std::string version(Remote::PROTOCOL_NAME + " " +
     boost::lexical_cast<std::string>(Remote::PROTOCOL_VERSION_MAJOR) + " " +
-    boost::lexical_cast<std::string>(Remote::PROTOCOL_VERSION_MINOR) + '\n');
+    boost::lexical_cast<std::string>(Remote::PROTOCOL_VERSION_MINOR));
+
+#ifdef HAVE_LIBZ
+  if (Remote::compression > 0)
+  {
+    version += " ZLIB";
+    this->compressionOffered_ = true;
+  }
+#endif
+
+  if (Remote::framing)
+  {
+    version += " FRAMED";
+    this->framingOffered_ = true;
+  }
+
+  return this->write(version + '\n');
 }
 
 
 int
 Remote::sendPing(void)
 {
-  return this->sendCommand("", "PING", "");
+  return this->sendCommand("", Remote::CMD_PING);
 }
 
 
@@ -1029,8 +1407,11 @@ Remote::sendAuth(void)
 
   config.connect(handle, hostname, port, password);
 
-  return this->sendCommand("", "AUTH", config.nickname() + " :" + password,
-    false);
+  StrVector parameters;
+  parameters.push_back(config.nickname());
+  parameters.push_back(password);
+
+  return this->sendCommand("", Remote::CMD_AUTH, parameters, false);
 }
 
 
@@ -1045,6 +1426,23 @@ Remote::write(const std::string & text)
 }
 
 
+int
+Remote::write(const BotSock::Buffer & message)
+{
+  // A message too long to frame is encoded as nothing
+  if (message->empty())
+  {
+    return 0;
+  }
+
+#ifdef REMOTE_DEBUG
+  std::cout << "Remote << " << *message;
+#endif
+
+  return this->sock_.write(message);
+}
+
+
 void
 Remote::getLinks(BotClient * client, const std::string & prefix) const
 {
@@ -1059,41 +1457,11 @@ Remote::getBotNetBranch(BotLinkList & list) const
 }
 
 
-bool
-Remote::isConnectedTo(const std::string & Name) const
-{
-  return this->children_.exists(Name);
-}
-
 int
 Remote::sendRemoteCommand(const std::string & from, const std::string & to,
   const std::string & clientId, const std::string & command,
   const std::string & parameters)
 {
-  std::string msg(to);
-  msg += ' ';
-  msg += clientId;
-  msg += " :";
-  msg += command;
-  msg += ' ';
-  msg += parameters;
-
-  return this->sendCommand(from, "COMMAND", msg);
+  return this->sendMessage(Remote::makeRemoteCommand(from, to, clientId,
+    command, parameters));
 }
-
-
-int
-Remote::sendAllRemoteCommandPtr(BotClient * skip, const std::string & command,
-  const std::string & parameters)
-{
-  int result = 0;
-
-  if (this != skip)
-  {
-    result = this->sendRemoteCommand(skip->handleAndBot(), "*", skip->id(),
-      command, parameters);
-  }
-
-  return result;
-}
-
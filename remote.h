@@ -25,7 +25,9 @@
 
 // Std C++ Headers
 #include <string>
+#include <list>
 #include <map>
+#include <vector>
 #include <ctime>
 
 // Boost C++ Headers
@@ -42,11 +44,49 @@
 class Remote : public BotClient
 {
 public:
+  // Commands, numbered as they are sent over framed links.  The numbers
+  // are part of the protocol and must never change.
+  enum Command
+  {
+    CMD_ERROR = 1,
+    CMD_PING = 2,
+    CMD_PONG = 3,
+    CMD_AUTH = 4,
+    CMD_BOTJOIN = 5,
+    CMD_BOTPART = 6,
+    CMD_CHAT = 7,
+    CMD_COMMAND = 8,
+    CMD_BROADCAST = 9,
+    CMD_NOTICE = 10,
+    CMD_COUNT
+  };
+
+  // A message to send over one or more links.  It is encoded for each
+  // protocol the first time it is sent over a link that uses it, so a
+  // message relayed to every link is only encoded once or twice.
+  class Message
+  {
+  public:
+    Message(const std::string & from, const Command command,
+      const StrVector & parameters)
+      : from_(from), command_(command), parameters_(parameters) { }
+
+    const BotSock::Buffer & encode(const bool framed) const;
+
+  private:
+    std::string encodeText(void) const;
+    std::string encodeFrame(void) const;
+
+    std::string from_;
+    Command command_;
+    StrVector parameters_;
+    mutable BotSock::Buffer text_, frame_;
+  };
+
   Remote(const std::string & handle);
   Remote(BotSock *listener);
   virtual ~Remote(void);
 
-  bool isConnectedTo(const std::string &) const;
   void getLinks(class BotClient * client, const std::string &) const;
 
   std::string getHandle(void) const { return this->handle_; };
@@ -65,28 +105,24 @@ public:
     return Remote::STAGE_READY == this->stage_;
   }
 
-  int sendBroadcast(const std::string & from, const std::string & text,
-    const std::string & flags, const std::string & watches);
-  int sendBroadcastPtr(const std::string & from, const Remote *skip,
-    const std::string & text, const std::string & flags,
-    const std::string & watches);
-  int sendBroadcastId(const std::string & from, const std::string & skipId,
-    const std::string & skipBot, const std::string & text,
+  bool isFramed(void) const { return this->framed_; };
+
+  static Message makeBroadcast(const std::string & from,
+    const std::string & skip, const std::string & text,
     const std::string & flags, const std::string & watches);
+  static Message makeRemoteCommand(const std::string & from,
+    const std::string & to, const std::string & clientId,
+    const std::string & command, const std::string & parameters);
+  int sendMessage(const Message & message, const bool queue = true);
 
   int sendNotice(const std::string & from, const std::string & skipId,
     const std::string & skipBot, const std::string & text);
 
   int sendError(const std::string & text);
-  int sendChat(const std::string & from, const std::string & text);
-  int sendBotJoin(const std::string & oldnode, const std::string & newnode);
-  int sendBotPart(const std::string & from, const std::string & node);
 
   int sendRemoteCommand(const std::string & from, const std::string & to,
     const std::string & clientId, const std::string & command,
     const std::string & parameters);
-  int sendAllRemoteCommandPtr(BotClient * skip, const std::string & command,
-    const std::string & parameters);
 
   bool onConnect(void);
 
@@ -96,8 +132,13 @@ public:
   virtual std::string id(void) const;
   virtual void send(const std::string & text);
 
-  void preSelect(fd_set & readset, fd_set & writeset) const;
-  bool postSelect(const fd_set & readset, const fd_set & writeset);
+  bool process(void);
+  void registerOnReadyHandler(BotSock::OnReadyHandler func)
+    { this->sock_.registerOnReadyHandler(func); }
+  bool flush(void);
+  void status(class BotClient * client) const;
+
+  static void init(void);
 
   bool isConnected(void) const { return this->sock_.isConnected(); }
   time_t getIdle(void) const { return this->sock_.getIdle(); }
@@ -111,24 +152,27 @@ private:
   bool isAuthorized(void) const;
   bool authenticate(std::string text);
   bool parse(std::string text);
+  bool parseFrame(const std::string & frame);
 
   void configureCallbacks(void);
+  void startOptions(const std::string & version);
 
-  void registerCommand(const std::string & command,
+  void registerCommand(const Command command,
     bool (Remote::*callback)(const std::string & from,
     const std::string & command, const StrVector & parameters));
-  void unregisterCommand(const std::string & command);
+  void unregisterCommand(const Command command);
 
   int sendVersion(void);
   int sendPing(void);
   int sendAuth(void);
   int sendUnknownCommand(const std::string & command);
   int sendSyntaxError(const std::string & command);
-  int sendCommand(const std::string & from, const std::string & command,
-    const std::string & parameters, const bool queue = true);
+  int sendCommand(const std::string & from, const Command command,
+    const StrVector & parameters = StrVector(), const bool queue = true);
   int sendMyBotNet(void);
 
   int write(const std::string & text);
+  int write(const BotSock::Buffer & message);
 
   // Callbacks
   bool onError(const std::string & from, const std::string & command,
@@ -153,6 +197,7 @@ private:
     const StrVector & parameters);
 
   static bool isCompatibleProtocolVersion(std::string text);
+  static bool offers(std::string version, const std::string & option);
 
   // Stages:
   //  INIT - have not yet received the protocol version from the remote bot
@@ -173,15 +218,23 @@ private:
   std::string hostname_;
   Stage stage_;
   bool client_;
-  std::string sendQ_;
+  std::list<Message> sendQ_;
   CommandParser parser_;
   BotSock sock_;
   bool targetEstablished_;
+  bool compressionOffered_;
+  bool framingOffered_;
+  bool framed_;
   std::string clientHandle_;
   std::string clientBot_;
   std::string clientId_;
   UserFlags clientFlags_;
   CommandMap commands;
+  std::vector<CommandCallback> handlers_;	// Indexed by command number
+
+  static int sendQ;
+  static int compression;
+  static bool framing;
 
   static const std::string PROTOCOL_NAME;
   static const int PROTOCOL_VERSION_MAJOR, PROTOCOL_VERSION_MINOR;
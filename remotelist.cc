@@ -53,16 +53,7 @@ RemoteList::shutdown(void)
 {
   this->listeners_.clear();
   this->connections_.clear();
-}
-
-
-void
-RemoteList::preSelect(fd_set & readset, fd_set & writeset) const
-{
-  std::for_each(this->listeners_.begin(), this->listeners_.end(),
-    FDSetter<BotSock::ptr>(readset, writeset));
-  std::for_each(this->connections_.begin(), this->connections_.end(),
-    FDSetter<RemotePtr>(readset, writeset));
+  this->routes_.clear();
 }
 
 
@@ -73,7 +64,7 @@ RemoteList::ListenProcess::operator()(BotSock::ptr s)
 
   try
   {
-    remove = !s->postSelect(this->readset_, this->writeset_);
+    remove = !s->process();
   }
   catch (OOMon::ready_for_accept)
   {
@@ -109,7 +100,7 @@ RemoteList::ListenProcess::operator()(BotSock::ptr s)
 
     if (addRemote && temp->onConnect())
     {
-      this->connections_.push_back(temp);
+      this->list_.addConnection(temp);
     }
   }
 
@@ -124,7 +115,7 @@ RemoteList::RemoteProcess::operator()(RemotePtr r)
 
   try
   {
-    remove = !r->postSelect(this->readset_, this->writeset_);
+    remove = !r->process();
 
     if (remove)
     {
@@ -142,7 +133,7 @@ RemoteList::RemoteProcess::operator()(RemotePtr r)
   catch (OOMon::timeout_error)
   {
 #ifdef REMOTELIST_DEBUG
-    std::cout << "Remote::postSelect() threw exception: timeout_error" <<
+    std::cout << "Remote::process() threw exception: timeout_error" <<
       std::endl;
 #endif
     remove = true;
@@ -165,13 +156,18 @@ RemoteList::RemoteProcess::operator()(RemotePtr r)
   {
     remove = true;
 #ifdef REMOTELIST_DEBUG
-    std::cout << "Remote::postSelect() threw exception: errno_error: " <<
+    std::cout << "Remote::process() threw exception: errno_error: " <<
       e.why() << std::endl;
 #endif
     r->sendError(e.why());
     Log::Write("Remote bot connection error: " + e.why());
   }
 
+  if (remove)
+  {
+    remotes.removeRoutes(r.get());
+  }
+
   if (remove && r->ready())
   {
     remotes.sendBotPart(config.nickname(), r->getHandle());
@@ -183,46 +179,111 @@ RemoteList::RemoteProcess::operator()(RemotePtr r)
 }
 
 
+// Processes each listener and link that is ready
+void
+RemoteList::process(void)
+{
+  this->readyListeners_.process(this->listeners_, ListenProcess(*this));
+  this->readyConnections_.process(this->connections_, RemoteProcess());
+}
+
+
 void
-RemoteList::postSelect(const fd_set & readset, const fd_set & writeset)
+RemoteList::addConnection(RemotePtr connection)
 {
-  ListenProcess lp(readset, writeset, this->connections_);
-  this->listeners_.remove_if(lp);
+  connection->registerOnReadyHandler(
+    this->readyConnections_.handler(connection));
+  this->connections_.push_back(connection);
+}
+
 
-  RemoteProcess rp(readset, writeset);
-  this->connections_.remove_if(rp);
+void
+RemoteList::status(BotClient * client) const
+{
+  std::for_each(this->connections_.begin(), this->connections_.end(),
+    boost::bind(&Remote::status, _1, client));
 }
 
 
+//////////////////////////////////////////////////////////////////////
+// RemoteList::sendBroadcast(from, text, flags, watches)
+//
+// Description:
+//  Sends a broadcast over every link.  The message is built once, and
+//  encoded at most once for each protocol in use.
+//
+// Parameters:
+//  from    - The bot the broadcast came from.
+//  text    - The text of the broadcast.
+//  flags   - The user flags a client needs to receive the broadcast.
+//  watches - The watches a client needs to receive the broadcast.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
 void
 RemoteList::sendBroadcast(const std::string & from, const std::string & text,
   const std::string & flags, const std::string & watches)
 {
-  std::for_each(this->connections_.begin(), this->connections_.end(),
-    boost::bind(&Remote::sendBroadcast, _1, from, text, flags, watches));
+  if (!this->connections_.empty())
+  {
+    this->sendMessage(Remote::makeBroadcast(from, "*", text, flags, watches));
+  }
 }
 
 
+// sendBroadcastPtr(from, skip, text, flags, watches)
+//
+// Sends a broadcast over every link except the one it arrived on.
+//
 void
 RemoteList::sendBroadcastPtr(const std::string & from, const Remote *skip,
   const std::string & text, const std::string & flags,
   const std::string & watches)
 {
-  std::for_each(this->connections_.begin(), this->connections_.end(),
-    boost::bind(&Remote::sendBroadcastPtr, _1, from, skip, text, flags,
-    watches));
+  if (!this->connections_.empty())
+  {
+    this->sendMessage(Remote::makeBroadcast(from, "*", text, flags, watches),
+      skip);
+  }
 }
 
 
+// sendBroadcastId(from, skipId, skipBot, text, flags, watches)
+//
+// Sends a broadcast over every link that is to be delivered to every
+// client except the one with the given ID on the given bot.
+//
 void
 RemoteList::sendBroadcastId(const std::string & from,
   const std::string & skipId, const std::string & skipBot,
   const std::string & text, const std::string & flags,
   const std::string & watches)
 {
-  std::for_each(this->connections_.begin(), this->connections_.end(),
-    boost::bind(&Remote::sendBroadcastId, _1, from, skipId, skipBot, text,
-    flags, watches));
+  if (!this->connections_.empty())
+  {
+    this->sendMessage(Remote::makeBroadcast(from, skipId + '@' + skipBot,
+      text, flags, watches));
+  }
+}
+
+
+// sendMessage(message, skip)
+//
+// Sends a message over every link except the one to skip.
+//
+void
+RemoteList::sendMessage(const Remote::Message & message,
+  const BotClient *skip)
+{
+  for (ConnectionList::iterator pos = this->connections_.begin();
+    pos != this->connections_.end(); ++pos)
+  {
+    if (pos->get() != skip)
+    {
+      (*pos)->sendMessage(message);
+    }
+  }
 }
 
 
@@ -250,8 +311,8 @@ void
 RemoteList::sendChat(const std::string & from, const std::string & text,
   const Remote *skip)
 {
-  std::for_each(this->connections_.begin(), this->connections_.end(),
-    RemoteList::SendChat(from, text, skip));
+  this->sendMessage(Remote::Message(from, Remote::CMD_CHAT,
+    StrVector(1, text)), skip);
 }
 
 
@@ -259,8 +320,8 @@ void
 RemoteList::sendBotJoin(const std::string & oldnode,
   const std::string & newnode, const Remote *skip)
 {
-  std::for_each(this->connections_.begin(), this->connections_.end(),
-    SendBotJoinPart(true, oldnode, newnode, skip));
+  this->sendMessage(Remote::Message(oldnode, Remote::CMD_BOTJOIN,
+    StrVector(1, newnode)), skip);
 }
 
 
@@ -268,8 +329,8 @@ void
 RemoteList::sendBotPart(const std::string & from, const std::string & node,
   const Remote *skip)
 {
-  std::for_each(this->connections_.begin(), this->connections_.end(),
-    SendBotJoinPart(false, from, node, skip));
+  this->sendMessage(Remote::Message(from, Remote::CMD_BOTPART,
+    StrVector(1, node)), skip);
 }
 
 
@@ -307,9 +368,9 @@ void
 RemoteList::sendAllRemoteCommand(BotClient * from, const std::string & command,
   const std::string & parameters)
 {
-  std::for_each(this->connections_.begin(), this->connections_.end(),
-    boost::bind(&Remote::sendAllRemoteCommandPtr, _1, from, command,
-      parameters));
+  // A command from a linked bot isn't sent back over its own link
+  this->sendMessage(Remote::makeRemoteCommand(from->handleAndBot(), "*",
+    from->id(), command, parameters), from);
 }
 
 
@@ -378,6 +439,7 @@ RemoteList::cmdDisconn(BotClient * from, const std::string & command,
       ::SendAll(notice, UserFlags::OPER, WatchSet(), from);
       Log::Write(notice);
 
+      this->removeRoutes(remote.get());
       this->connections_.remove(remote);
     }
   }
@@ -441,6 +503,7 @@ RemoteList::listen(const std::string & address, const BotSock::Port & port)
 
   if (temp->listen(port, 5))
   {
+    temp->registerOnReadyHandler(this->readyListeners_.handler(temp));
     this->listeners_.push_back(temp);
 
     result = true;
@@ -479,9 +542,17 @@ RemoteList::connect(BotClient * from, const std::string & handle)
     ::SendAll(notice, UserFlags::OPER, WatchSet(), from);
     Log::Write(notice);
 
-    temp->connect(host, port);
-
-    this->connections_.push_back(temp);
+    if (temp->connect(host, port))
+    {
+      this->addConnection(temp);
+    }
+    else
+    {
+      // A link that failed right away would never be ready to process
+      notice = "*** Unable to connect to " + handle_;
+      ::SendAll(notice, UserFlags::OPER);
+      Log::Write(notice);
+    }
 
     result = true;
   }
@@ -507,29 +578,112 @@ RemoteList::isLinkedDirectlyToMe(const std::string & Name) const
 }   
 
 
+// findBot(to)
+//
+// Returns the link leading to a bot, or a null pointer if the bot isn't
+// part of the botnet.
+//
 RemoteList::RemotePtr
 RemoteList::findBot(const std::string & to) const
 {
-  RemotePtr result;
+  RouteMap::const_iterator pos = this->routes_.find(UpCase(to));
+
+  return (pos != this->routes_.end()) ? pos->second : RemotePtr();
+}
+
+
+bool
+RemoteList::isConnected(const std::string & handle) const
+{
+  return (0 != this->findBot(handle));
+}
+
 
+//////////////////////////////////////////////////////////////////////
+// RemoteList::addRoute(bot, link)
+//
+// Description:
+//  Records that a bot is reached through a link, when the bot has
+//  authenticated itself on that link or when a bot further along it
+//  has announced it with BOTJOIN.  If the bot is already reached some
+//  other way, the existing route is kept.
+//
+// Parameters:
+//  bot  - The name of the bot.
+//  link - The link leading to the bot.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+RemoteList::addRoute(const std::string & bot, const Remote * link)
+{
   for (ConnectionList::const_iterator pos = this->connections_.begin();
     pos != this->connections_.end(); ++pos)
   {
-    RemotePtr copy(*pos);
-
-    if (copy->isConnectedTo(to))
+    if (pos->get() == link)
     {
-      result = copy;
+      this->routes_.insert(RouteMap::value_type(UpCase(bot), *pos));
       break;
     }
   }
-  return result;
 }
 
 
+// removeRoutes(bots)
+//
+// Forgets the routes to bots that have left the botnet.
+//
+void
+RemoteList::removeRoutes(const StrList & bots)
+{
+  for (StrList::const_iterator pos = bots.begin(); pos != bots.end(); ++pos)
+  {
+    this->routes_.erase(UpCase(*pos));
+  }
+}
+
+
+// removeRoutes(link)
+//
+// Forgets every route through a link that is being dropped.
+//
+void
+RemoteList::removeRoutes(const Remote * link)
+{
+  for (RouteMap::iterator pos = this->routes_.begin();
+    pos != this->routes_.end(); )
+  {
+    if (pos->second.get() == link)
+    {
+      this->routes_.erase(pos++);
+    }
+    else
+    {
+      ++pos;
+    }
+  }
+}
+
+
+// isRoute(bot, link)
+//
+// Checks whether a message from a bot could have arrived over a link.
+// Since the botnet is a tree, every message from a bot arrives over the
+// link leading to it.  One that arrives over any other link has gone
+// around a loop and has already been seen.  Messages from bots that
+// haven't been announced yet are accepted.
+//
 bool
-RemoteList::isConnected(const std::string & handle) const
+RemoteList::isRoute(const std::string & bot, const Remote * link) const
 {
-  return (0 != this->findBot(handle));
+  if (Same(bot, config.nickname()))
+  {
+    return false;
+  }
+
+  RouteMap::const_iterator pos = this->routes_.find(UpCase(bot));
+
+  return (pos == this->routes_.end()) || (pos->second.get() == link);
 }
 
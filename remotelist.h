@@ -25,6 +25,7 @@
 
 #include <string>
 #include <list>
+#include <map>
 
 #include "strtype"
 #include "remote.h"
@@ -42,8 +43,8 @@ public:
 
   void shutdown(void);
 
-  void preSelect(fd_set & readset, fd_set & writeset) const;
-  void postSelect(const fd_set & readset, const fd_set & writeset);
+  void process(void);
+  void status(class BotClient * client) const;
 
   bool connect(class BotClient * from, const std::string & handle);
   void listen(void);
@@ -57,6 +58,8 @@ public:
     const std::string & skipBot, const std::string & text,
     const std::string & flags = "NONE", const std::string & watches = "NONE");
 
+  bool empty(void) const { return this->connections_.empty(); }
+
   void sendNotice(const std::string & from, const std::string & clientId,
     const std::string & clientBot, const std::string & text);
 
@@ -83,84 +86,46 @@ public:
   RemotePtr findBot(const std::string &) const;
   bool isConnected(const std::string &) const;
 
+  void addRoute(const std::string & bot, const Remote * link);
+  void removeRoutes(const StrList & bots);
+  bool isRoute(const std::string & bot, const Remote * link) const;
+
 private:
   bool listen(const std::string & address, const BotSock::Port & port);
 
+  void sendMessage(const Remote::Message & message,
+    const class BotClient *skip = 0);
+
   typedef std::list<BotSock::ptr> ListenerList;
   typedef std::list<RemotePtr> ConnectionList;
+  // The link leading to each bot in the botnet, keyed by its upper-case
+  // name
+  typedef std::map<std::string, RemotePtr> RouteMap;
+
+  void removeRoutes(const Remote * link);
+  void addConnection(RemotePtr connection);
 
   class ListenProcess
   {
   public:
-    ListenProcess(const fd_set & readset, const fd_set & writeset,
-      ConnectionList & connections) : readset_(readset), writeset_(writeset),
-      connections_(connections) { }
+    ListenProcess(RemoteList & list) : list_(list) { }
     bool operator()(BotSock::ptr s);
   private:
-    const fd_set & readset_;
-    const fd_set & writeset_;
-    ConnectionList & connections_;
+    RemoteList & list_;
   };
 
   class RemoteProcess
   {
   public:
-    RemoteProcess(const fd_set & readset, const fd_set & writeset)
-      : readset_(readset), writeset_(writeset) { }
+    RemoteProcess(void) { }
     bool operator()(RemotePtr r);
-  private:
-    const fd_set & readset_;
-    const fd_set & writeset_;
-  };
-
-  class SendChat
-  {
-  public:
-    SendChat(const std::string & from, const std::string & text,
-      const Remote *skip = 0) : from_(from), text_(text),
-      skip_(skip) { }
-    void operator()(RemotePtr r)
-    {
-      if (r.get() != this->skip_)
-      {
-        r->sendChat(this->from_, this->text_);
-      }
-    }
-  private:
-    const std::string & from_;
-    const std::string & text_;
-    const Remote * skip_;
-  };
-
-  class SendBotJoinPart
-  {
-  public:
-    SendBotJoinPart(const bool join, const std::string node1,
-      const std::string node2, const Remote *skip = 0)
-      : join_(join), node1_(node1), node2_(node2), skip_(skip) { }
-    void operator()(RemotePtr r)
-    {
-      if (r.get() != this->skip_)
-      {
-	if (this->join_)
-	{
-          r->sendBotJoin(this->node1_, this->node2_);
-	}
-	else
-	{
-          r->sendBotPart(this->node1_, this->node2_);
-	}
-      }
-    }
-  private:
-    const bool join_;
-    const std::string & node1_;
-    const std::string & node2_;
-    const Remote * skip_;
   };
 
   ListenerList listeners_;
   ConnectionList connections_;
+  ReadyList<BotSock> readyListeners_;
+  ReadyList<Remote> readyConnections_;
+  RouteMap routes_;
 };
 
 extern RemoteList remotes;
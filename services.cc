@@ -24,6 +24,7 @@
 #include <ctime>
 
 // Boost C++ Headers
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
 
 // Std C Headers
@@ -42,6 +43,7 @@
 #include "format.h"
 #include "config.h"
 #include "defaults.h"
+#include "timers.h"
 
 
 Services services;
@@ -64,31 +66,59 @@ std::string Services::xoServicesRequest_(DEFAULT_XO_SERVICES_REQUEST);
 std::string Services::xoServicesResponse_(DEFAULT_XO_SERVICES_RESPONSE);
 
 
+Services::Services(void) : lastCheckedTime(0)
+{
+  // SERVICES_CHECK_INTERVAL is in minutes, so this is often enough
+  Timers::instance().every(60, boost::bind(&Services::check, this));
+}
+
+
 void
 Services::check()
 {
   std::time_t now = std::time(NULL);
 
-  if ((this->lastCheckedTime + (Services::servicesCheckInterval_ * 60)) < now)
+  if ((this->lastCheckedTime + (Services::servicesCheckInterval_ * 60)) > now)
   {
-    this->lastCheckedTime = now;
+    return;
+  }
 
-    if (Services::xoServicesEnable_)
-    {
-      server.msg(Services::xoServicesRequest_, "clones " +
-          boost::lexical_cast<std::string>(Services::servicesCloneLimit_));
-    }
+  // Timers run outside of any server's context, so query the services
+  // of each connected server in turn
+  const IRC::List & servers = IRC::list();
+
+  for (IRC::List::const_iterator pos = servers.begin(); pos != servers.end();
+    ++pos)
+  {
+    IRC::Context context(*pos);
 
-    if (Services::spamtrapEnable_)
+    if (server().isConnected())
     {
-      server.whois(Services::spamtrapNick_);
+      this->lastCheckedTime = now;
+      this->checkServer();
     }
+  }
+}
+
+
+void
+Services::checkServer(void)
+{
+  if (Services::xoServicesEnable_)
+  {
+    server().msg(Services::xoServicesRequest_, "clones " +
+        boost::lexical_cast<std::string>(Services::servicesCloneLimit_));
+  }
+
+  if (Services::spamtrapEnable_)
+  {
+    server().whois(Services::spamtrapNick_);
+  }
 
 #ifdef CA_SERVICES
-    /* check if services.ca just signed on or off */
-    server.isOn(CA_SERVICES_REQUEST);
+  /* check if services.ca just signed on or off */
+  server().isOn(CA_SERVICES_REQUEST);
 #endif
-  }
 }
 
 
@@ -103,7 +133,7 @@ Services::onXoNotice(std::string text)
   StrVector parms;
   StrSplit(parms, text, " ", true);
 
-  if ((parms.size() > 3) && server.same("users", parms[3]))
+  if ((parms.size() > 3) && server().same("users", parms[3]))
   {
     this->cloningUserhost = parms[0];
     try
@@ -116,8 +146,8 @@ Services::onXoNotice(std::string text)
     }
     this->suggestKline = true;
   }
-  else if ((parms.size() > 2) && server.same("on", parms[1]) &&
-    server.same(server.getServerName(), parms[2]))
+  else if ((parms.size() > 2) && server().same("on", parms[1]) &&
+    server().same(server().getServerName(), parms[2]))
   {
     std::string nick = parms[0];
     std::string count(boost::lexical_cast<std::string>(this->cloneCount));
@@ -135,7 +165,7 @@ Services::onXoNotice(std::string text)
 
     bool exempt(false);
     BotSock::Address ip(INADDR_NONE);
-    UserEntryPtr find(users.findUser(nick, this->cloningUserhost));
+    UserEntryPtr find(users().findUser(nick, this->cloningUserhost));
     if (find)
     {
       ip = find->getIP();
@@ -279,9 +309,9 @@ Services::onIson(const std::string & text)
 {
   StrVector nicks;
 
-  StrSplit(nicks, " ", server.upCase(text), true);
+  StrSplit(nicks, " ", server().upCase(text), true);
 
-  if (nicks.end() == nicks.find(server.upCase(CA_SERVICES_REQUEST)))
+  if (nicks.end() == nicks.find(server().upCase(CA_SERVICES_REQUEST)))
   {
     // CA services disconnected - stop receiving reports
     this->gettingCaReports = false;
@@ -308,9 +338,9 @@ Services::onSpamtrapMessage(const std::string & text)
 {
   std::string copy = text;
 
-  if (0 == server.upCase(FirstWord(copy)).compare("SPAM"))
+  if (0 == server().upCase(FirstWord(copy)).compare("SPAM"))
   {
-    if (server.same(server.getServerName(), FirstWord(copy)))
+    if (server().same(server().getServerName(), FirstWord(copy)))
     {
       std::string nick = FirstWord(copy);
 
@@ -339,7 +369,7 @@ Services::onSpamtrapMessage(const std::string & text)
           ::SendAll(notice, UserFlags::OPER, WATCH_SPAMTRAP);
           Log::Write(notice);
 
-          doAction(nick, userhost, users.getIP(nick, userhost),
+          doAction(nick, userhost, users().getIP(nick, userhost),
               Services::spamtrapAction_, copy, false);
         }
       }
@@ -391,7 +421,7 @@ Services::onSpamtrapNotice(const std::string & text)
     {
       userhost = userhost.substr(1, userhost.length() - 2);
 
-      if (0 == server.downCase(FirstWord(copy)).compare("(score"))
+      if (0 == server().downCase(FirstWord(copy)).compare("(score"))
       {
 	std::string scoreText = FirstWord(copy);
 
@@ -403,12 +433,12 @@ Services::onSpamtrapNotice(const std::string & text)
 	    int score = boost::lexical_cast<int>(scoreText.substr(0,
 	      scoreText.length() - 1));
 
-	    if (0 == server.downCase(FirstWord(copy)).compare("on"))
+	    if (0 == server().downCase(FirstWord(copy)).compare("on"))
 	    {
 	      std::string serverName = FirstWord(copy);
 
 	      if ((score >= Services::spamtrapMinScore_) &&
-                  server.same(serverName, server.getServerName()))
+                  server().same(serverName, server().getServerName()))
 	      {
                 std::string notice("*** SpamTrap report: ");
 	        notice += nick;
@@ -420,7 +450,7 @@ Services::onSpamtrapNotice(const std::string & text)
                 ::SendAll(notice, UserFlags::OPER, WATCH_SPAMTRAP);
                 Log::Write(notice);
 
-                doAction(nick, userhost, users.getIP(nick, userhost),
+                doAction(nick, userhost, users().getIP(nick, userhost),
                     Services::spamtrapAction_, Services::spamtrapDefaultReason_,
                     false);
 	      }
@@ -455,7 +485,8 @@ Services::pollSpamtrap()
 {
   if (Services::spamtrapEnable_)
   {
-    server.msg(Services::spamtrapNick_, ".server " + server.getServerName());
+    server().msg(Services::spamtrapNick_,
+      ".server " + server().getServerName());
   }
 }
 
@@ -32,7 +32,7 @@
 class Services
 {
 public:
-  Services() { };
+  Services(void);
 
   void check();
   void pollSpamtrap();
@@ -60,6 +60,8 @@ public:
   static void init(void);
 
 private:
+  void checkServer(void);
+
   // XO services parameters
   std::string cloningUserhost;
   int cloneCount;
@@ -84,7 +84,7 @@ Socks4::onConnect()
   if (INADDR_NONE == dst)
   {
     port = config.serverPort();
-    dst = ntohl(server.getRemoteAddress());
+    dst = ntohl(server().getRemoteAddress());
   }
 
   char buff[128];
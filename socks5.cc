@@ -120,7 +120,7 @@ Socks5::onRead(const char *text, const int size)
       if (INADDR_NONE == dst)
       {
         port = config.serverPort();
-        dst = ntohl(server.getRemoteAddress());
+        dst = ntohl(server().getRemoteAddress());
       }
 
       char buff[64];
@@ -0,0 +1,122 @@
+#ifndef __SPSCRING_H__
+#define __SPSCRING_H__
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <vector>
+
+// Boost C++ Headers
+#include <boost/utility.hpp>
+
+
+// A fixed-size queue with exactly one producer thread and one consumer
+// thread, which need no lock to share it.  Each side owns one index and
+// only reads the other's, using acquire/release ordering so that a slot
+// is never seen before it has been filled or reused before it has been
+// emptied.  The indices are kept on separate cache lines so the two
+// threads don't keep stealing each other's.
+//
+// Slots are filled and emptied in place: the producer calls reserve(),
+// fills in the slot, and then commit(); the consumer calls front(),
+// reads the slot, and then pop().
+template<class T>
+class SpscRing : private boost::noncopyable
+{
+public:
+  typedef unsigned long size_type;
+
+  // The capacity is rounded up to a power of two
+  explicit SpscRing(const size_type capacity) : head_(0), tail_(0)
+  {
+    size_type size = 1;
+    while (size < capacity)
+    {
+      size <<= 1;
+    }
+    this->slots_.resize(size);
+    this->mask_ = size - 1;
+  }
+
+  // Producer: returns the next free slot, or 0 if the ring is full
+  T * reserve(void)
+  {
+    const size_type tail = this->tail_;
+
+    if ((tail - __atomic_load_n(&this->head_, __ATOMIC_ACQUIRE)) >
+      this->mask_)
+    {
+      return 0;
+    }
+
+    return &this->slots_[tail & this->mask_];
+  }
+
+  // Producer: hands the slot returned by reserve() to the consumer
+  void commit(void)
+  {
+    __atomic_store_n(&this->tail_, this->tail_ + 1, __ATOMIC_RELEASE);
+  }
+
+  // Consumer: returns the oldest filled slot, or 0 if the ring is empty
+  const T * front(void) const
+  {
+    const size_type head = this->head_;
+
+    if (head == __atomic_load_n(&this->tail_, __ATOMIC_ACQUIRE))
+    {
+      return 0;
+    }
+
+    return &this->slots_[head & this->mask_];
+  }
+
+  // Consumer: gives the slot returned by front() back to the producer
+  void pop(void)
+  {
+    __atomic_store_n(&this->head_, this->head_ + 1, __ATOMIC_RELEASE);
+  }
+
+  // Either side: the number of filled slots, which may already be out
+  // of date by the time it is returned
+  size_type size(void) const
+  {
+    return __atomic_load_n(&this->tail_, __ATOMIC_ACQUIRE) -
+      __atomic_load_n(&this->head_, __ATOMIC_ACQUIRE);
+  }
+
+  size_type capacity(void) const { return this->mask_ + 1; }
+
+private:
+  enum { CACHE_LINE = 64 };
+
+  std::vector<T> slots_;
+  size_type mask_;
+  char pad0_[CACHE_LINE];
+  size_type head_;	// Written only by the consumer
+  char pad1_[CACHE_LINE];
+  size_type tail_;	// Written only by the producer
+  char pad2_[CACHE_LINE];
+};
+
+
+#endif /* __SPSCRING_H__ */
+
@@ -0,0 +1,468 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+
+// $Id$
+
+// Std C++ Headers
+#include <fstream>
+#include <string>
+#include <climits>
+#include <cstdio>
+
+// Boost C++ Headers
+#include <boost/lexical_cast.hpp>
+
+// OOMon Headers
+#include "oomon.h"
+#include "stats.h"
+#include "irc.h"
+#include "log.h"
+#include "proxylist.h"
+#include "userhash.h"
+#include "util.h"
+#include "vars.h"
+#include "defaults.h"
+#include "botclient.h"
+
+
+static const char * const latencyNames[Stats::LATENCY_COUNT] =
+{
+  "notice", "user_add", "trap_match", "command", "proxy_scan"
+};
+
+static const char * const counterNames[Stats::COUNTER_COUNT] =
+{
+  "lines_received", "actions", "trap_matches", "proxies_detected"
+};
+
+// Bucket boundaries written to the Prometheus file, in seconds
+static const double exportBounds[] =
+{
+  0.00001, 0.0001, 0.001, 0.01, 0.1, 1, 10
+};
+
+
+Stats::Histogram Stats::latency[Stats::LATENCY_COUNT];
+unsigned long Stats::counters[Stats::COUNTER_COUNT];
+unsigned long Stats::lastLines = 0;
+double Stats::lastSample = 0;
+double Stats::lineRate = 0;
+std::string Stats::filename(DEFAULT_STATS_FILE);
+int Stats::interval(DEFAULT_STATS_INTERVAL);
+Timers::Id Stats::sampleTimer = 0;
+
+
+Stats::Histogram::Histogram(void)
+  : buckets_(SUB_COUNT + (MAX_BITS - SUB_BITS) * SUB_COUNT, 0), count_(0),
+  sum_(0), max_(0)
+{
+}
+
+
+// index(micros)
+//
+// Values below SUB_COUNT get a bucket each.  Above that, each power of
+// two is split into SUB_COUNT buckets by the bits following the
+// leading one.
+//
+unsigned int
+Stats::Histogram::index(const unsigned long micros)
+{
+  if (micros < SUB_COUNT)
+  {
+    return micros;
+  }
+
+  const int bits = (sizeof(unsigned long) * CHAR_BIT) - 1 -
+    __builtin_clzl(micros);
+  const int shift = bits - SUB_BITS;
+
+  return SUB_COUNT + (shift * SUB_COUNT) +
+    ((micros >> shift) & (SUB_COUNT - 1));
+}
+
+
+unsigned long
+Stats::Histogram::upperBound(const unsigned int index)
+{
+  if (index < SUB_COUNT)
+  {
+    return index;
+  }
+
+  const int shift = (index - SUB_COUNT) / SUB_COUNT;
+  const unsigned long low = (SUB_COUNT + ((index - SUB_COUNT) % SUB_COUNT)) <<
+    shift;
+
+  return low + (1UL << shift) - 1;
+}
+
+
+void
+Stats::Histogram::add(const double seconds)
+{
+  const double limit = (1UL << MAX_BITS) - 1;
+  double micros = seconds * 1000000;
+
+  if (micros < 0)
+  {
+    micros = 0;
+  }
+  else if (micros > limit)
+  {
+    micros = limit;
+  }
+
+  const unsigned long value = static_cast<unsigned long>(micros);
+
+  ++this->buckets_[Histogram::index(value)];
+  ++this->count_;
+  this->sum_ += seconds;
+  if (value > this->max_)
+  {
+    this->max_ = value;
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Stats::Histogram::percentile(fraction)
+//
+// Description:
+//  Finds the value that the given fraction of the samples do not
+//  exceed.  The top of the bucket it falls in is returned, so the
+//  result errs on the high side.
+//
+// Parameters:
+//  fraction - Between 0 and 1.
+//
+// Return Value:
+//  The function returns the value in seconds, or 0 if there are no
+//  samples.
+//////////////////////////////////////////////////////////////////////
+double
+Stats::Histogram::percentile(const double fraction) const
+{
+  unsigned long target = static_cast<unsigned long>(fraction * this->count_ +
+    0.999999);
+  if (0 == target)
+  {
+    target = 1;
+  }
+
+  unsigned long seen = 0;
+  for (std::vector<unsigned long>::size_type i = 0; i < this->buckets_.size();
+    ++i)
+  {
+    seen += this->buckets_[i];
+    if (seen >= target)
+    {
+      const unsigned long upper = Histogram::upperBound(i);
+      return ((upper < this->max_) ? upper : this->max_) / 1000000.0;
+    }
+  }
+
+  return 0;
+}
+
+
+// countUpTo(seconds)
+//
+// Returns the number of samples in buckets lying entirely at or below
+// the given value.
+//
+unsigned long
+Stats::Histogram::countUpTo(const double seconds) const
+{
+  const double limit = seconds * 1000000;
+  unsigned long result = 0;
+
+  for (std::vector<unsigned long>::size_type i = 0; (i < this->buckets_.size())
+    && (Histogram::upperBound(i) <= limit); ++i)
+  {
+    result += this->buckets_[i];
+  }
+
+  return result;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Stats::formatSeconds(seconds)
+//
+// Description:
+//  Formats a duration for display, in microseconds, milliseconds, or
+//  seconds, whichever keeps it short.
+//
+// Parameters:
+//  seconds - The duration.
+//
+// Return Value:
+//  The function returns the formatted duration.
+//////////////////////////////////////////////////////////////////////
+std::string
+Stats::formatSeconds(const double seconds)
+{
+  char text[32];
+
+  if (seconds < 0.001)
+  {
+    std::snprintf(text, sizeof(text), "%.0fus", seconds * 1000000);
+  }
+  else if (seconds < 1)
+  {
+    std::snprintf(text, sizeof(text), "%.1fms", seconds * 1000);
+  }
+  else
+  {
+    std::snprintf(text, sizeof(text), "%.2fs", seconds);
+  }
+
+  return text;
+}
+
+
+// Current values of the queues and tables worth watching
+struct Gauges
+{
+  Gauges(void) : users(0), sendQueue(0), logQueue(Log::queued()),
+    proxyScans(proxies.scanning()), proxyQueue(proxies.queued())
+  {
+    for (IRC::List::const_iterator pos = IRC::list().begin();
+      pos != IRC::list().end(); ++pos)
+    {
+      this->users += (*pos)->users().size();
+      this->sendQueue += (*pos)->queued();
+    }
+  }
+
+  unsigned long users, sendQueue, logQueue, proxyScans, proxyQueue;
+};
+
+
+void
+Stats::report(BotClient * client)
+{
+  client->send(padRight("Latency", 12) + padLeft("count", 10) +
+    padLeft("p50", 9) + padLeft("p90", 9) + padLeft("p99", 9) +
+    padLeft("max", 9));
+
+  for (int i = 0; i < LATENCY_COUNT; ++i)
+  {
+    const Histogram & histogram = Stats::latency[i];
+
+    client->send("  " + padRight(latencyNames[i], 10) +
+      padLeft(boost::lexical_cast<std::string>(histogram.count()), 10) +
+      padLeft(formatSeconds(histogram.percentile(0.50)), 9) +
+      padLeft(formatSeconds(histogram.percentile(0.90)), 9) +
+      padLeft(formatSeconds(histogram.percentile(0.99)), 9) +
+      padLeft(formatSeconds(histogram.max()), 9));
+  }
+
+  client->send("Lines received: " +
+    boost::lexical_cast<std::string>(Stats::counters[LINES]) + " (" +
+    boost::lexical_cast<std::string>(static_cast<long>(Stats::lineRate)) +
+    "/sec over the last " + boost::lexical_cast<std::string>(Stats::interval) +
+    " seconds)");
+  client->send("Actions: " +
+    boost::lexical_cast<std::string>(Stats::counters[ACTIONS]) +
+    ", trap matches: " +
+    boost::lexical_cast<std::string>(Stats::counters[TRAP_HITS]) +
+    ", open proxies: " +
+    boost::lexical_cast<std::string>(Stats::counters[PROXIES]));
+
+  const Gauges gauges;
+
+  client->send("Users: " + boost::lexical_cast<std::string>(gauges.users) +
+    ", send queue: " + boost::lexical_cast<std::string>(gauges.sendQueue) +
+    " lines, log queue: " + boost::lexical_cast<std::string>(gauges.logQueue) +
+    " bytes, proxy scans: " +
+    boost::lexical_cast<std::string>(gauges.proxyScans) + " (" +
+    boost::lexical_cast<std::string>(gauges.proxyQueue) + " queued)");
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Stats::write()
+//
+// Description:
+//  Writes everything to STATS_FILE in the Prometheus text exposition
+//  format.  The file is written under a temporary name and renamed, so
+//  a reader never sees it half written.  The histogram buckets are
+//  only as exact as the ones kept in memory.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns false if the file could not be written.
+//////////////////////////////////////////////////////////////////////
+bool
+Stats::write(void)
+{
+  const std::string temp(Stats::filename + ".tmp");
+  std::ofstream file(temp.c_str());
+
+  if (!file)
+  {
+    return false;
+  }
+
+  file << "# HELP oomon_latency_seconds Time taken by OOMon's busiest tasks\n"
+    "# TYPE oomon_latency_seconds histogram\n";
+  for (int i = 0; i < LATENCY_COUNT; ++i)
+  {
+    const Histogram & histogram = Stats::latency[i];
+    const std::string label(std::string("{task=\"") + latencyNames[i] + '"');
+
+    for (unsigned int j = 0; j < sizeof(exportBounds) / sizeof(double); ++j)
+    {
+      file << "oomon_latency_seconds_bucket" << label << ",le=\"" <<
+        exportBounds[j] << "\"} " << histogram.countUpTo(exportBounds[j]) <<
+        '\n';
+    }
+    file << "oomon_latency_seconds_bucket" << label << ",le=\"+Inf\"} " <<
+      histogram.count() << '\n';
+    file << "oomon_latency_seconds_sum" << label << "} " << histogram.sum() <<
+      '\n';
+    file << "oomon_latency_seconds_count" << label << "} " <<
+      histogram.count() << '\n';
+  }
+
+  for (int i = 0; i < COUNTER_COUNT; ++i)
+  {
+    file << "# TYPE oomon_" << counterNames[i] << "_total counter\n";
+    file << "oomon_" << counterNames[i] << "_total " << Stats::counters[i] <<
+      '\n';
+  }
+
+  const Gauges gauges;
+
+  file << "# TYPE oomon_users gauge\noomon_users " << gauges.users << '\n';
+  file << "# TYPE oomon_send_queue_lines gauge\noomon_send_queue_lines " <<
+    gauges.sendQueue << '\n';
+  file << "# TYPE oomon_log_queue_bytes gauge\noomon_log_queue_bytes " <<
+    gauges.logQueue << '\n';
+  file << "# TYPE oomon_proxy_scans gauge\n";
+  file << "oomon_proxy_scans{state=\"running\"} " << gauges.proxyScans << '\n';
+  file << "oomon_proxy_scans{state=\"queued\"} " << gauges.proxyQueue << '\n';
+
+  file.close();
+  if (!file)
+  {
+    std::remove(temp.c_str());
+    return false;
+  }
+
+  return (0 == std::rename(temp.c_str(), Stats::filename.c_str()));
+}
+
+
+void
+Stats::sample(void)
+{
+  const double now = Timers::now();
+
+  if (Stats::lastSample > 0)
+  {
+    Stats::lineRate = (Stats::counters[LINES] - Stats::lastLines) /
+      (now - Stats::lastSample);
+  }
+  Stats::lastLines = Stats::counters[LINES];
+  Stats::lastSample = now;
+
+  if (!Stats::filename.empty())
+  {
+    Stats::write();
+  }
+}
+
+
+std::string
+Stats::getInterval(void)
+{
+  return boost::lexical_cast<std::string>(Stats::interval);
+}
+
+
+std::string
+Stats::setInterval(const std::string & newValue)
+{
+  std::string result;
+
+  try
+  {
+    int seconds = boost::lexical_cast<int>(newValue);
+    if (seconds >= 1)
+    {
+      Stats::interval = seconds;
+      Timers::instance().cancel(Stats::sampleTimer);
+      Stats::sampleTimer = Timers::instance().every(seconds, Stats::sample);
+    }
+    else
+    {
+      result = "*** Numeric value between 1 and ";
+      result += boost::lexical_cast<std::string>(INT_MAX);
+      result += " expected!";
+    }
+  }
+  catch (const boost::bad_lexical_cast &)
+  {
+    result = "*** Numeric value expected!";
+  }
+
+  return result;
+}
+
+
+std::string
+Stats::getFilename(void)
+{
+  return Stats::filename;
+}
+
+
+std::string
+Stats::setFilename(const std::string & newValue)
+{
+  const std::string previous(Stats::filename);
+
+  Stats::filename = newValue;
+  if (!newValue.empty() && !Stats::write())
+  {
+    Stats::filename = previous;
+    return "*** Unable to write " + newValue + "!";
+  }
+
+  return "";
+}
+
+
+void
+Stats::init(void)
+{
+  Stats::sampleTimer = Timers::instance().every(Stats::interval,
+    Stats::sample);
+
+  vars.insert("STATS_FILE", Setting(Stats::getFilename, Stats::setFilename));
+  vars.insert("STATS_INTERVAL", Setting(Stats::getInterval,
+    Stats::setInterval));
+}
+
@@ -0,0 +1,133 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+#include <vector>
+
+// Boost C++ Headers
+#include <boost/utility.hpp>
+
+// OOMon Headers
+#include "timers.h"
+
+
+// Latency histograms and counters for the busiest parts of the monitor
+// bot, shown by ".stats" and optionally written every STATS_INTERVAL
+// seconds to STATS_FILE in the Prometheus text format, for a local node
+// exporter to pick up.  Recording a sample costs two clock reads and an
+// increment, so they can be left on all the time.
+class Stats
+{
+public:
+  enum Latency
+  {
+    NOTICE,		// Handling one server notice
+    USER_ADD,		// Adding a connecting client
+    TRAP_MATCH,		// Matching a client against the traps
+    COMMAND,		// Running a DCC or remote command
+    PROXY_SCAN,		// From starting a proxy scan to finishing it
+    LATENCY_COUNT
+  };
+
+  enum Counter
+  {
+    LINES,		// Lines received from IRC servers
+    ACTIONS,		// Automatic actions taken
+    TRAP_HITS,		// Clients that matched a trap
+    PROXIES,		// Open proxies detected
+    COUNTER_COUNT
+  };
+
+  // Counts samples in buckets that are exact below 16 microseconds and
+  // no more than 1/16 wide above, in the manner of an HDR histogram,
+  // so percentiles are accurate to about 6% across the whole range.
+  class Histogram
+  {
+  public:
+    Histogram(void);
+
+    void add(const double seconds);
+
+    unsigned long count(void) const { return this->count_; }
+    double sum(void) const { return this->sum_; }
+    double max(void) const { return this->max_ / 1000000.0; }
+    double percentile(const double fraction) const;
+    unsigned long countUpTo(const double seconds) const;
+
+  private:
+    enum { SUB_BITS = 4, SUB_COUNT = 1 << SUB_BITS, MAX_BITS = 32 };
+
+    static unsigned int index(const unsigned long micros);
+    static unsigned long upperBound(const unsigned int index);
+
+    std::vector<unsigned long> buckets_;
+    unsigned long count_;
+    double sum_;
+    unsigned long max_;
+  };
+
+  // Records the time from its creation to its destruction
+  class Timer : private boost::noncopyable
+  {
+  public:
+    explicit Timer(const Latency which)
+      : which_(which), start_(Timers::now()) { }
+    ~Timer(void) { Stats::record(this->which_, Timers::now() - this->start_); }
+
+  private:
+    const Latency which_;
+    const double start_;
+  };
+
+  static void init(void);
+
+  static void record(const Latency which, const double seconds)
+    { Stats::latency[which].add(seconds); }
+  static void count(const Counter which)
+    { ++Stats::counters[which]; }
+
+  static void report(class BotClient * client);
+  static std::string formatSeconds(const double seconds);
+
+private:
+  static void sample(void);
+  static bool write(void);
+  static std::string getFilename(void);
+  static std::string setFilename(const std::string & newValue);
+  static std::string getInterval(void);
+  static std::string setInterval(const std::string & newValue);
+
+  static Histogram latency[LATENCY_COUNT];
+  static unsigned long counters[COUNTER_COUNT];
+  static unsigned long lastLines;
+  static double lastSample;
+  static double lineRate;
+  static std::string filename;
+  static int interval;
+  static Timers::Id sampleTimer;
+};
+
+
+#endif /* __STATS_H__ */
@@ -0,0 +1,303 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+#include <algorithm>
+
+// Boost C++ Headers
+#include <boost/lexical_cast.hpp>
+
+// Std C Headers
+#include <time.h>
+
+// OOMon Headers
+#include "oomon.h"
+#include "timers.h"
+#include "botclient.h"
+
+
+//////////////////////////////////////////////////////////////////////
+// Timers::instance()
+//
+// Description:
+//  Returns the timer queue, creating it the first time it is needed.
+//  Like the reactor, it is never destroyed, so global objects may
+//  still cancel their timers while the program exits.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns a reference to the timer queue.
+//////////////////////////////////////////////////////////////////////
+Timers &
+Timers::instance(void)
+{
+  static Timers * timers = new Timers;
+
+  return *timers;
+}
+
+
+double
+Timers::now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+
+void
+Timers::push(const double when, const Timers::Id id)
+{
+  Deadline deadline;
+  deadline.when = when;
+  deadline.id = id;
+
+  this->heap_.push_back(deadline);
+  std::push_heap(this->heap_.begin(), this->heap_.end());
+}
+
+
+Timers::Id
+Timers::schedule(const double seconds, Timers::Callback callback,
+  const double interval)
+{
+  const Id id = this->nextId_++;
+
+  Entry & entry = this->entries_[id];
+  entry.callback = callback;
+  entry.interval = interval;
+
+  this->push(Timers::now() + seconds, id);
+
+  return id;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Timers::after(seconds, callback)
+//
+// Description:
+//  Calls a function once, after the given time has passed.  An empty
+//  callback simply makes sure the main loop wakes up by then.
+//
+// Parameters:
+//  seconds  - How long to wait.
+//  callback - The function to call.
+//
+// Return Value:
+//  The function returns an ID that can be passed to cancel().  IDs are
+//  never zero and never reused.
+//////////////////////////////////////////////////////////////////////
+Timers::Id
+Timers::after(const double seconds, Timers::Callback callback)
+{
+  return this->schedule(seconds, callback, 0);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Timers::every(seconds, callback)
+//
+// Description:
+//  Calls a function repeatedly at a fixed interval until the timer is
+//  cancelled.  The first call happens one interval from now.
+//
+// Parameters:
+//  seconds  - The interval, which must be greater than zero.
+//  callback - The function to call.
+//
+// Return Value:
+//  The function returns an ID that can be passed to cancel().
+//////////////////////////////////////////////////////////////////////
+Timers::Id
+Timers::every(const double seconds, Timers::Callback callback)
+{
+  return this->schedule(seconds, callback, seconds);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Timers::cancel(id)
+//
+// Description:
+//  Stops a timer.  Its deadline stays in the heap until it comes up or
+//  the heap is compacted, but the callback is released right away.
+//  Cancelling an ID of zero, or a timer that has already fired, does
+//  nothing.
+//
+// Parameters:
+//  id - The timer's ID.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+Timers::cancel(const Timers::Id id)
+{
+  if (0 != id)
+  {
+    this->entries_.erase(id);
+
+    // Don't let deadlines of cancelled timers pile up
+    if (this->heap_.size() > ((2 * this->entries_.size()) + 64))
+    {
+      DeadlineHeap live;
+      for (DeadlineHeap::const_iterator pos = this->heap_.begin();
+        pos != this->heap_.end(); ++pos)
+      {
+        if (this->entries_.end() != this->entries_.find(pos->id))
+        {
+          live.push_back(*pos);
+        }
+      }
+      std::make_heap(live.begin(), live.end());
+      this->heap_.swap(live);
+    }
+  }
+}
+
+
+void
+Timers::discardStale(void)
+{
+  while (!this->heap_.empty() &&
+    (this->entries_.end() == this->entries_.find(this->heap_.front().id)))
+  {
+    std::pop_heap(this->heap_.begin(), this->heap_.end());
+    this->heap_.pop_back();
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Timers::timeout()
+//
+// Description:
+//  Calculates how long the main loop may wait for I/O before the next
+//  timer is due.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns the number of milliseconds until the nearest
+//  deadline, rounded up, or -1 if there are no timers.
+//////////////////////////////////////////////////////////////////////
+int
+Timers::timeout(void)
+{
+  this->discardStale();
+
+  if (this->heap_.empty())
+  {
+    return -1;
+  }
+
+  const double remaining = this->heap_.front().when - Timers::now();
+
+  if (remaining <= 0)
+  {
+    return 0;
+  }
+  else if (remaining > 86400)
+  {
+    return 86400000;
+  }
+
+  return static_cast<int>(remaining * 1000) + 1;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Timers::run()
+//
+// Description:
+//  Calls every timer whose deadline has passed.  Periodic timers are
+//  rescheduled first, so a callback may cancel its own timer.  A
+//  periodic timer that has fallen more than an interval behind skips
+//  the missed calls rather than firing repeatedly to catch up.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+Timers::run(void)
+{
+  const double now = Timers::now();
+
+  while (!this->heap_.empty() && (this->heap_.front().when <= now))
+  {
+    const Deadline due = this->heap_.front();
+    std::pop_heap(this->heap_.begin(), this->heap_.end());
+    this->heap_.pop_back();
+
+    EntryMap::iterator pos = this->entries_.find(due.id);
+    if (this->entries_.end() == pos)
+    {
+      continue;
+    }
+
+    Callback callback(pos->second.callback);
+
+    if (pos->second.interval > 0)
+    {
+      double next = due.when + pos->second.interval;
+      if (next <= now)
+      {
+        next = now + pos->second.interval;
+      }
+      this->push(next, due.id);
+    }
+    else
+    {
+      this->entries_.erase(pos);
+    }
+
+    ++this->fired_;
+    if (!callback.empty())
+    {
+      callback();
+    }
+  }
+}
+
+
+void
+Timers::status(BotClient * client) const
+{
+  std::string msg("Timers: ");
+  msg += boost::lexical_cast<std::string>(this->entries_.size());
+  msg += " pending, ";
+  msg += boost::lexical_cast<std::string>(this->fired_);
+  msg += " fired";
+
+  client->send(msg);
+}
+
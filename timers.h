@@ -0,0 +1,90 @@
+#ifndef __TIMERS_H__
+#define __TIMERS_H__
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+// $Id$
+
+// Std C++ Headers
+#include <map>
+#include <vector>
+
+// Boost C++ Headers
+#include <boost/function.hpp>
+#include <boost/utility.hpp>
+
+
+// Runs callbacks at set times.  Deadlines are kept in a binary heap, so
+// the main loop can sleep until the nearest one instead of waking up
+// periodically to see whether anything is due.  Times are in seconds
+// on a monotonic clock, with sub-second precision.
+class Timers : private boost::noncopyable
+{
+public:
+  typedef boost::function<void (void)> Callback;
+  typedef unsigned long Id;
+
+  static Timers & instance(void);
+
+  Id after(const double seconds, Callback callback);
+  Id every(const double seconds, Callback callback);
+  void cancel(const Id id);
+
+  int timeout(void);
+  void run(void);
+
+  static double now(void);
+
+  void status(class BotClient * client) const;
+
+private:
+  Timers(void) : nextId_(1), fired_(0) { }
+
+  struct Entry
+  {
+    Callback callback;
+    double interval;	// 0 for one-shot timers
+  };
+
+  struct Deadline
+  {
+    double when;
+    Id id;
+
+    // Reversed, so that std::push_heap() keeps the earliest on top
+    bool operator<(const Deadline & other) const
+      { return this->when > other.when; }
+  };
+
+  typedef std::map<Id, Entry> EntryMap;
+  typedef std::vector<Deadline> DeadlineHeap;
+
+  Id schedule(const double seconds, Callback callback, const double interval);
+  void push(const double when, const Id id);
+  void discardStale(void);
+
+  EntryMap entries_;
+  DeadlineHeap heap_;
+  Id nextId_;
+  unsigned long fired_;
+};
+
+
+#endif /* __TIMERS_H__ */
+
@@ -22,6 +22,9 @@
 // Std C++ Headers
 #include <fstream>
 #include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
 #include <ctime>
 
 // OOMon Headers
@@ -32,6 +35,9 @@
 #include "util.h"
 #include "irc.h"
 #include "log.h"
+#include "journal.h"
+#include "stats.h"
+#include "timers.h"
 #include "main.h"
 #include "config.h"
 #include "pattern.h"
@@ -40,12 +46,16 @@
 
 
 TrapList::TrapMap TrapList::traps;
+LiteralScanner TrapList::scanner;
+unsigned long TrapList::scanCount = 0;
+unsigned long TrapList::skipCount = 0;
 
 
 Trap::Trap(const TrapAction action, const long timeout,
   const std::string & line)
   : action_(action), timeout_(timeout), filter_(line, Filter::FIELD_NUH, true),
-  lastMatch_(0), matchCount_(0), loaded_(false)
+  lastMatch_(0), matchCount_(0), evalCount_(0), totalTime_(0), maxTime_(0),
+  loaded_(false), versionLiteral_(-1), privmsgLiteral_(-1), noticeLiteral_(-1)
 {
   std::string rest = this->filter_.rest();
   this->reason_ = trimLeft(rest);
@@ -55,7 +65,10 @@ Trap::Trap(const TrapAction action, const long timeout,
 Trap::Trap(const Trap & copy)
   : action_(copy.action_), timeout_(copy.timeout_), filter_(copy.filter_),
   reason_(copy.reason_), lastMatch_(copy.lastMatch_),
-  matchCount_(copy.matchCount_), loaded_(copy.loaded_)
+  matchCount_(copy.matchCount_), evalCount_(copy.evalCount_),
+  totalTime_(copy.totalTime_), maxTime_(copy.maxTime_), loaded_(copy.loaded_),
+  versionLiteral_(copy.versionLiteral_), privmsgLiteral_(copy.privmsgLiteral_),
+  noticeLiteral_(copy.noticeLiteral_)
 {
 }
 
@@ -81,6 +94,9 @@ Trap::update(const TrapAction action, const long timeout,
   {
     this->matchCount_ = 0;
     this->lastMatch_ = 0;
+    this->evalCount_ = 0;
+    this->totalTime_ = 0;
+    this->maxTime_ = 0;
 
     this->action_ = action;
     this->timeout_ = timeout;
@@ -91,9 +107,67 @@ Trap::update(const TrapAction action, const long timeout,
 
 bool
 Trap::matches(const UserEntryPtr user, const std::string & version,
-  const std::string & privmsg, const std::string & notice) const
+  const std::string & privmsg, const std::string & notice)
+{
+  const double start = Timers::now();
+
+  ++this->evalCount_;
+  const bool result = this->filter_.matches(user, version, privmsg, notice);
+
+  const double elapsed = Timers::now() - start;
+  this->totalTime_ += elapsed;
+  if (elapsed > this->maxTime_)
+  {
+    this->maxTime_ = elapsed;
+  }
+
+  return result;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Trap::mayMatch(version, privmsg, notice)
+//
+// Description:
+//  Quickly rules out traps whose VERSION, PRIVMSG, or NOTICE pattern
+//  requires a literal string that the message doesn't contain.
+//
+// Parameters:
+//  version - The literals found in the CTCP VERSION reply.
+//  privmsg - The literals found in the PRIVMSG text.
+//  notice  - The literals found in the NOTICE text.
+//
+// Return Value:
+//  The function returns false if the trap cannot possibly match, or
+//  true if Trap::matches() must be called to find out.
+//////////////////////////////////////////////////////////////////////
+bool
+Trap::mayMatch(const LiteralScanner::Result & version,
+  const LiteralScanner::Result & privmsg,
+  const LiteralScanner::Result & notice) const
+{
+  return ((this->versionLiteral_ < 0) || version[this->versionLiteral_]) &&
+    ((this->privmsgLiteral_ < 0) || privmsg[this->privmsgLiteral_]) &&
+    ((this->noticeLiteral_ < 0) || notice[this->noticeLiteral_]);
+}
+
+
+static int
+addLiteral(LiteralScanner & scanner, const PatternPtr & pattern)
+{
+  return pattern ? scanner.add(pattern->literal()) : -1;
+}
+
+
+void
+Trap::prepare(LiteralScanner & scanner)
 {
-  return this->filter_.matches(user, version, privmsg, notice);
+  this->versionLiteral_ = addLiteral(scanner,
+    this->filter_.pattern(Filter::FIELD_VERSION));
+  this->privmsgLiteral_ = addLiteral(scanner,
+    this->filter_.pattern(Filter::FIELD_PRIVMSG));
+  this->noticeLiteral_ = addLiteral(scanner,
+    this->filter_.pattern(Filter::FIELD_NOTICE));
 }
 
 
@@ -178,6 +252,33 @@ Trap::getString(bool showCount, bool showTime) const
 }
 
 
+//////////////////////////////////////////////////////////////////////
+// Trap::getCostString()
+//
+// Description:
+//  Describes what the trap has cost: how many times its filter has
+//  been evaluated, how many of those matched, and the total, average,
+//  and longest evaluation time.  Clients skipped by the literal
+//  prefilter are not evaluated, so they cost nothing.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  The function returns the columns for ".trap list -s".
+//////////////////////////////////////////////////////////////////////
+std::string
+Trap::getCostString(void) const
+{
+  return padLeft(boost::lexical_cast<std::string>(this->evalCount_), 9) +
+    padLeft(boost::lexical_cast<std::string>(this->matchCount_), 8) +
+    padLeft(Stats::formatSeconds(this->totalTime_), 9) +
+    padLeft(Stats::formatSeconds((this->evalCount_ > 0) ?
+    (this->totalTime_ / this->evalCount_) : 0), 9) +
+    padLeft(Stats::formatSeconds(this->maxTime_), 9) + ' ';
+}
+
+
 std::string
 TrapList::actionString(const TrapAction & action)
 {
@@ -239,6 +340,8 @@ TrapList::actionType(const std::string & text)
 void
 Trap::doAction(const TrapKey key, const UserEntryPtr user) const
 {
+  IRC::Context context(user->getServer());
+
   std::string notice("*** Trapped ");
   notice += boost::lexical_cast<std::string>(key);
   notice += ": ";
@@ -258,35 +361,37 @@ Trap::doAction(const TrapKey key, const UserEntryPtr user) const
   std::string reason(fmt.format(this->getReason()));
 
   Log::Write(notice);
+  Journal::trap(user, key, TrapList::actionString(this->getAction()));
+  Stats::count(Stats::TRAP_HITS);
   switch (this->getAction())
   {
     case TRAP_ECHO:
       ::SendAll(notice, UserFlags::OPER, WATCH_TRAPS);
       break;
     case TRAP_KILL:
-      server.kill("Auto-Kill", user->getNick(), reason);
+      server().kill("Auto-Kill", user->getNick(), reason);
       break;
     case TRAP_KLINE:
-      server.kline("Auto-Kline", this->getTimeout(),
+      server().kline("Auto-Kline", this->getTimeout(),
           klineMask(user->getUserHost()), reason);
       break;
     case TRAP_KLINE_HOST:
       {
-	server.kline("Auto-Kline", this->getTimeout(), "*@" + user->getHost(),
+	server().kline("Auto-Kline", this->getTimeout(), "*@" + user->getHost(),
             reason);
       }
       break;
     case TRAP_KLINE_DOMAIN:
       {
 	std::string domain = getDomain(user->getHost(), true);
-	server.kline("Auto-Kline", this->getTimeout(), "*@" + domain, reason);
+	server().kline("Auto-Kline", this->getTimeout(), "*@" + domain, reason);
       }
       break;
     case TRAP_KLINE_IP:
       if (INADDR_NONE != user->getIP())
       {
-        server.kline("Auto-Kline", this->getTimeout(), "*@" + user->getTextIP(),
-            reason);
+        server().kline("Auto-Kline", this->getTimeout(),
+            "*@" + user->getTextIP(), reason);
       }
       else
       {
@@ -303,7 +408,7 @@ Trap::doAction(const TrapKey key, const UserEntryPtr user) const
 	}
 	if (INADDR_NONE != user->getIP())
 	{
-	  server.kline("Auto-Kline", this->getTimeout(), "*" + username + "@" +
+	  server().kline("Auto-Kline", this->getTimeout(), "*" + username + "@" +
               classCMask(user->getTextIP()), reason);
 	}
 	else
@@ -316,7 +421,7 @@ Trap::doAction(const TrapKey key, const UserEntryPtr user) const
     case TRAP_KLINE_NET:
       if (INADDR_NONE != user->getIP())
       {
-        server.kline("Auto-Kline", this->getTimeout(), "*@" +
+        server().kline("Auto-Kline", this->getTimeout(), "*@" +
             classCMask(user->getTextIP()), reason);
       }
       else
@@ -328,7 +433,7 @@ Trap::doAction(const TrapKey key, const UserEntryPtr user) const
     case TRAP_DLINE_IP:
       if (INADDR_NONE != user->getIP())
       {
-        server.dline("Auto-Dline", this->getTimeout(), user->getTextIP(),
+        server().dline("Auto-Dline", this->getTimeout(), user->getTextIP(),
             reason);
       }
       else
@@ -340,7 +445,7 @@ Trap::doAction(const TrapKey key, const UserEntryPtr user) const
     case TRAP_DLINE_NET:
       if (INADDR_NONE != user->getIP())
       {
-        server.dline("Auto-Dline", this->getTimeout(),
+        server().dline("Auto-Dline", this->getTimeout(),
             classCMask(user->getTextIP()), reason);
       }
       else
@@ -380,6 +485,7 @@ TrapList::add(const TrapKey key, const TrapAction action,
   }
 
   pos->second.loaded(true);
+  pos->second.prepare(TrapList::scanner);
 
   return pos->second;
 }
@@ -403,7 +509,7 @@ TrapList::getMaxKey(void)
 void
 TrapList::cmd(BotClient * client, std::string line)
 {
-  ArgList args("-a -t", "");
+  ArgList args("-a -s -t", "");
 
   if (-1 == args.parseCommand(line))
   {
@@ -413,6 +519,7 @@ TrapList::cmd(BotClient * client, std::string line)
 
   bool showCounts = args.haveUnary("-a");
   bool showTimes = args.haveUnary("-t");
+  bool showCosts = args.haveUnary("-s");
 
   std::string flag = UpCase(FirstWord(line));
   long timeout = 0;
@@ -420,7 +527,7 @@ TrapList::cmd(BotClient * client, std::string line)
 
   if (flag.empty() || (flag == "LIST"))
   {
-    TrapList::list(client, showCounts, showTimes);
+    TrapList::list(client, showCounts, showTimes, showCosts);
   }
   else if (flag == "REMOVE")
   {
@@ -535,9 +642,12 @@ TrapList::remove(const TrapKey key)
   const TrapMap::iterator begin = traps.lower_bound(key);
   const TrapMap::iterator end = traps.upper_bound(key);
 
+  bool found = (begin != end);
+
   traps.erase(begin, end);
+  TrapList::prepare();
 
-  return (begin != end);
+  return found;
 }
 
 bool
@@ -551,6 +661,7 @@ TrapList::remove(const std::string & pattern)
     {
       found = true;
       traps.erase(pos);
+      TrapList::prepare();
       break;
     }
     else
@@ -566,14 +677,40 @@ void
 TrapList::match(const UserEntryPtr user, const std::string & version,
   const std::string & privmsg, const std::string & notice)
 {
+  // Look for every trap's required literals in a single pass over each
+  // message, then skip the traps that can't possibly match.
+  static LiteralScanner::Result inVersion, inPrivmsg, inNotice;
+
+  Stats::Timer timer(Stats::TRAP_MATCH);
+
+  TrapList::scanner.scan(version, inVersion);
+  TrapList::scanner.scan(privmsg, inPrivmsg);
+  TrapList::scanner.scan(notice, inNotice);
+  ++TrapList::scanCount;
+
+  TrapMap::iterator pos;
+  for (pos = traps.begin(); pos != traps.end(); ++pos)
+  {
+    if (pos->second.mayMatch(inVersion, inPrivmsg, inNotice))
+    {
+      break;
+    }
+  }
+  if (pos == traps.end())
+  {
+    ++TrapList::skipCount;
+    return;
+  }
+
   if (!user->getOper() && !config.isExempt(user, Config::EXEMPT_TRAP) &&
       !config.isOper(user))
   {
-    for (TrapMap::iterator pos = traps.begin(); pos != traps.end(); ++pos)
+    for (; pos != traps.end(); ++pos)
     {
       try
       {
-        if (pos->second.matches(user, version, privmsg, notice))
+        if (pos->second.mayMatch(inVersion, inPrivmsg, inNotice) &&
+          pos->second.matches(user, version, privmsg, notice))
         {
 	  pos->second.updateStats();
 	  pos->second.doAction(pos->first, user);
@@ -614,20 +751,66 @@ TrapList::matchNotice(const UserEntryPtr user, const std::string & notice)
   TrapList::match(user, "", "", notice);
 }
 
+// Orders traps by the time spent evaluating them, most first
+static bool
+moreTime(const std::pair<TrapKey, const Trap *> & lhs,
+  const std::pair<TrapKey, const Trap *> & rhs)
+{
+  return lhs.second->getTotalTime() > rhs.second->getTotalTime();
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// TrapList::list(client, showCounts, showTimes, showCosts)
+//
+// Description:
+//  Lists the traps in order of their keys, or, when their costs are
+//  shown, with the most expensive first.
+//
+// Parameters:
+//  client     - The client to send the list to.
+//  showCounts - Whether to show how many times each trap has matched.
+//  showTimes  - Whether to show when each trap last matched.
+//  showCosts  - Whether to show how much time each trap has used.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
 void
-TrapList::list(BotClient * client, bool showCounts, bool showTimes)
+TrapList::list(BotClient * client, bool showCounts, bool showTimes,
+  bool showCosts)
 {
-  int count = 0;
+  std::vector<std::pair<TrapKey, const Trap *> > sorted;
 
   for (TrapMap::iterator pos = traps.begin(); pos != traps.end(); ++pos)
+  {
+    sorted.push_back(std::make_pair(pos->first, &pos->second));
+  }
+
+  if (showCosts && !sorted.empty())
+  {
+    std::stable_sort(sorted.begin(), sorted.end(), moreTime);
+    client->send(padRight("key", 6) + padLeft("evals", 9) +
+      padLeft("matches", 8) + padLeft("total", 9) + padLeft("avg", 9) +
+      padLeft("max", 9) + " trap");
+  }
+
+  for (std::vector<std::pair<TrapKey, const Trap *> >::const_iterator pos =
+    sorted.begin(); pos != sorted.end(); ++pos)
   {
     std::string text(boost::lexical_cast<std::string>(pos->first));
-    text += ' ';
-    text += pos->second.getString(showCounts, showTimes);
+    if (showCosts)
+    {
+      text = padRight(text, 6) + pos->second->getCostString();
+    }
+    else
+    {
+      text += ' ';
+    }
+    text += pos->second->getString(showCounts, showTimes);
     client->send(text);
-    ++count;
   }
-  if (count > 0)
+  if (!sorted.empty())
   {
     client->send("*** End of TRAP list.");
   }
@@ -638,6 +821,17 @@ TrapList::list(BotClient * client, bool showCounts, bool showTimes)
 }
 
 
+void
+TrapList::status(BotClient * client)
+{
+  client->send("Trap prefilter: " +
+    boost::lexical_cast<std::string>(TrapList::scanner.size()) +
+    " literals (" + LiteralScanner::isa() + "), skipped " +
+    boost::lexical_cast<std::string>(TrapList::skipCount) + " of " +
+    boost::lexical_cast<std::string>(TrapList::scanCount) + " checks");
+}
+
+
 void
 TrapList::save(std::ofstream & file)
 {
@@ -677,5 +871,31 @@ TrapList::postLoad(void)
   }
 
   traps.swap(copy);
+  TrapList::prepare();
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// TrapList::prepare()
+//
+// Description:
+//  Rebuilds the literal scanner from the current trap list.  This must
+//  be called whenever traps are added or removed.
+//
+// Parameters:
+//  None.
+//
+// Return Value:
+//  None.
+//////////////////////////////////////////////////////////////////////
+void
+TrapList::prepare(void)
+{
+  TrapList::scanner.clear();
+
+  for (TrapMap::iterator pos = traps.begin(); pos != traps.end(); ++pos)
+  {
+    pos->second.prepare(TrapList::scanner);
+  }
 }
 
@@ -35,6 +35,7 @@
 #include "botsock.h"
 #include "filter.h"
 #include "userentry.h"
+#include "litscan.h"
 
 
 enum TrapAction
@@ -59,7 +60,11 @@ public:
     const std::string & reason);
 
   bool matches(const UserEntryPtr user, const std::string & version,
-    const std::string & privmsg, const std::string & notice) const;
+    const std::string & privmsg, const std::string & notice);
+  bool mayMatch(const LiteralScanner::Result & version,
+    const LiteralScanner::Result & privmsg,
+    const LiteralScanner::Result & notice) const;
+  void prepare(LiteralScanner & scanner);
   bool operator==(const Trap & other) const;
   bool operator==(const std::string & pattern) const;
   void doAction(const TrapKey key, const UserEntryPtr user) const;
@@ -71,8 +76,10 @@ public:
   std::string getFilter(void) const { return this->filter_.get(); }
   std::string getReason(void) const { return this->reason_; }
   std::string getString(bool showCount = false, bool showTime = false) const;
+  std::string getCostString(void) const;
   std::time_t getLastMatch(void) const { return this->lastMatch_; };
   unsigned long getMatchCount(void) const { return this->matchCount_; };
+  double getTotalTime(void) const { return this->totalTime_; }
 
   bool loaded(void) const { return this->loaded_; }
   void loaded(const bool value) { this->loaded_ = value; }
@@ -85,7 +92,13 @@ private:
   std::string	reason_;	// For Kills, K-Lines, and D-Lines only
   std::time_t	lastMatch_;
   unsigned long	matchCount_;
+  unsigned long	evalCount_;	// Times matches() has been called
+  double	totalTime_;	// Seconds spent in matches()
+  double	maxTime_;
   bool          loaded_;
+  int		versionLiteral_;	// Indexes into TrapList's scanner
+  int		privmsgLiteral_;
+  int		noticeLiteral_;
 };
 
 
@@ -95,7 +108,7 @@ public:
   static void cmd(class BotClient * client, std::string line);
   static bool remove(const TrapKey key);
   static bool remove(const std::string & pattern);
-  static void clear(void) { TrapList::traps.clear(); };
+  static void clear(void) { TrapList::traps.clear(); TrapList::prepare(); };
 
   static void match(const UserEntryPtr user, const std::string & version,
     const std::string & privmsg, const std::string & notice);
@@ -106,7 +119,9 @@ public:
     const std::string & privmsg);
   static void matchNotice(const UserEntryPtr user, const std::string & notice);
 
-  static void list(class BotClient * client, bool showCounts, bool showTimes);
+  static void list(class BotClient * client, bool showCounts, bool showTimes,
+    bool showCosts);
+  static void status(class BotClient * client);
 
   static void save(std::ofstream & file);
 
@@ -119,10 +134,14 @@ public:
 private:
   typedef std::multimap<TrapKey, Trap> TrapMap;
   static TrapMap traps;
+  static LiteralScanner scanner;
+  static unsigned long scanCount;
+  static unsigned long skipCount;
 
   static Trap add(const TrapKey key, const TrapAction action,
     const long timeout, const std::string & line);
   static TrapKey getMaxKey(void);
+  static void prepare(void);
 };
 
 #endif /* __TRAP_H__ */
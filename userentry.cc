@@ -54,11 +54,11 @@ UserEntry::UserEntry(const std::string & aNick,
   const std::string & aUser, const std::string & aHost,
   const std::string & aFakeHost, const std::string & aUserClass,
   const std::string & aGecos, const BotSock::Address anIp,
-  const std::time_t aConnectTime, const bool oper)
+  const std::time_t aConnectTime, const bool oper, IRC * aServer)
   : user(aUser), host(aHost), fakeHost(aFakeHost),
-  domain(::getDomain(aHost, false)), userClass(::server.downCase(aUserClass)),
+  domain(::getDomain(aHost, false)), userClass(::server().downCase(aUserClass)),
   gecos(aGecos), ip(anIp), connectTime(aConnectTime), reportTime(0),
-  versioned(0), isOper(oper), connected_(true)
+  versioned(0), isOper(oper), connected_(true), server_(aServer)
 {
   this->setNick(aNick);
 #ifdef USERHASH_DEBUG
@@ -75,11 +75,21 @@ UserEntry::~UserEntry(void)
 }
 
 
+// version(onDrop)
+//
+// Sends the client a CTCP VERSION request.  onDrop is called if the
+// request is dropped from the send queue instead of being sent, and
+// should call cancelVersion() so the client isn't blamed for not
+// replying.
+//
 void
-UserEntry::version(void)
+UserEntry::version(const boost::function<void (void)> & onDrop)
 {
-  this->versioned = std::time(NULL);
-  server.ctcp(this->nick, "VERSION");
+  IRC & irc = (0 != this->server_) ? *this->server_ : server();
+
+  // Time spent waiting in the send queue doesn't count against the client
+  this->versioned = std::time(NULL) + irc.queueDelay(IRC::PRIORITY_BULK);
+  irc.ctcp(this->nick, "VERSION", IRC::PRIORITY_BULK, onDrop);
 }
 
 
@@ -93,7 +103,7 @@ UserEntry::hasVersion(const std::string &)
 bool
 UserEntry::matches(const std::string & lcNick) const
 {
-  return (0 == lcNick.compare(server.downCase(this->getNick())));
+  return (0 == lcNick.compare(server().downCase(this->getNick())));
 }
 
 
@@ -104,15 +114,15 @@ UserEntry::matches(const std::string & lcNick, const std::string & lcUser,
   if (UserEntry::brokenHostnameMunging_)
   {
     return (this->matches(lcNick) &&
-      (0 == lcUser.compare(server.downCase(this->getUser()))));
+      (0 == lcUser.compare(server().downCase(this->getUser()))));
   }
   else
   {
     return (this->matches(lcNick) &&
-      (0 == lcUser.compare(server.downCase(this->getUser()))) &&
-      ((0 == lcHost.compare(server.downCase(this->getHost()))) ||
+      (0 == lcUser.compare(server().downCase(this->getUser()))) &&
+      ((0 == lcHost.compare(server().downCase(this->getHost()))) ||
        (!this->getFakeHost().empty() &&
-	(0 == lcHost.compare(server.downCase(this->getFakeHost()))))));
+	(0 == lcHost.compare(server().downCase(this->getFakeHost()))))));
   }
 }
 
@@ -121,9 +131,9 @@ bool
 UserEntry::same(const std::string & nick, const std::string & user,
   const std::string & host) const
 {
-  return (nick.empty() || server.same(this->getNick(), nick)) &&
-    (user.empty() || server.same(this->getUser(), user)) &&
-    (host.empty() || server.same(this->getHost(), host));
+  return (nick.empty() || server().same(this->getNick(), nick)) &&
+    (user.empty() || server().same(this->getUser(), user)) &&
+    (host.empty() || server().same(this->getHost(), host));
 }
 
 
@@ -29,6 +29,7 @@
 
 // Boost C++ Headers
 #include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
 #include <boost/utility.hpp>
 
 // OOMon Headers
@@ -44,14 +45,15 @@ public:
     const std::string & aHost, const std::string & aFakeHost,
     const std::string & aUserClass, const std::string & aGecos,
     const BotSock::Address anIp, const std::time_t aConnectTime,
-    const bool oper);
+    const bool oper, class IRC * aServer = 0);
   ~UserEntry(void);
 
   void setNick(const std::string & aNick);
   void setOper(const bool oper) { this->isOper = oper; }
   void setReportTime(const std::time_t t) { this->reportTime = t; }
-  void version(void);
+  void version(const boost::function<void (void)> & onDrop);
   void hasVersion(const std::string & version);
+  void cancelVersion(void) { this->versioned = 0; }
 
   bool matches(const std::string & lowercaseNick) const;
   bool matches(const std::string & lowercaseNick,
@@ -138,6 +140,7 @@ public:
     result += this->gecos;
     return result;
   }
+  class IRC * getServer(void) const { return this->server_; }
   std::time_t getConnectTime(void) const { return this->connectTime; }
   std::time_t getReportTime(void) const { return this->reportTime; }
 
@@ -163,6 +166,7 @@ private:
   bool isOper;
   bool connected_;
   int randScore;
+  class IRC * const server_;
 
   static bool brokenHostnameMunging_;
 };
@@ -47,6 +47,8 @@
 #include "trap.h"
 #include "main.h"
 #include "log.h"
+#include "journal.h"
+#include "stats.h"
 #include "engine.h"
 #include "pattern.h"
 #include "filter.h"
@@ -98,15 +100,12 @@ bool UserHash::trapNotices(DEFAULT_TRAP_NOTICES);
 bool UserHash::trapPrivmsgs(DEFAULT_TRAP_PRIVMSGS);
 
 
-UserHash users;
-
-
 #ifdef USERHASH_DEBUG
 unsigned long userEntryCount = 0;
 #endif /* USERHASH_DEBUG */
 
 
-UserHash::UserHash(void)
+UserHash::UserHash(IRC * server) : server_(server)
 {
   this->hosttable.resize(HASHTABLESIZE);
   this->domaintable.resize(HASHTABLESIZE);
@@ -122,31 +121,9 @@ UserHash::~UserHash(void)
 }
 
 unsigned int
-UserHash::hashFunc(const std::string & key)
+UserHash::hashFunc(const std::string & key) const
 {
-  std::string::size_type len = key.length();
-  unsigned int i = 0;
-
-  if (len > 0)
-  {
-    i = server.downCase(key[0]);
-
-    if (len > 1)
-    {
-      i |= (server.downCase(key[1]) << 8);
-
-      if (len > 2)
-      {
-        i |= (server.downCase(key[2]) << 16);
-
-	if (len > 3)
-	{
-          i |= (server.downCase(key[3]) << 24);
-	}
-      }
-    }
-  }
-  return i % HASHTABLESIZE;
+  return this->server_->hash(key) % HASHTABLESIZE;
 }
 
 
@@ -162,6 +139,8 @@ UserHash::add(const std::string & nick, const std::string & userhost,
   const std::string & ip, bool fromTrace, bool isOper,
   const std::string & userClass, const std::string & gecos)
 {
+  Stats::Timer timer(Stats::USER_ADD);
+
   // Find '@' in user@host
   std::string::size_type at = userhost.find('@');
 
@@ -177,27 +156,32 @@ UserHash::add(const std::string & nick, const std::string & userhost,
       // hostname.  Oh, happy day!
 
       std::string fakeHost;
-      if ((0 == server.downCase(nick).compare(this->maskNick)) &&
-	(0 == server.downCase(host).compare(this->maskRealHost)))
+      if ((0 == this->server_->downCase(nick).compare(this->maskNick)) &&
+	(0 == this->server_->downCase(host).compare(this->maskRealHost)))
       {
 	fakeHost = this->maskFakeHost;
       }
 
       UserEntryPtr newuser(new UserEntry(nick, user, host, fakeHost, userClass,
         gecos, ip.empty() ? INADDR_NONE : BotSock::inet_addr(ip),
-        (fromTrace ? 0 : std::time(0)), isOper));
+        (fromTrace ? 0 : std::time(0)), isOper, this->server_));
 
 #ifdef USERHASH_DEBUG
       std::cout << "New UserEntryPtr: " << newuser.get() << std::endl;
 #endif
 
       // Add it to the hash tables
-      UserHash::addToHash(this->hosttable, newuser->getHost(), newuser);
-      UserHash::addToHash(this->domaintable, newuser->getDomain(), newuser);
-      UserHash::addToHash(this->usertable, newuser->getUser(), newuser);
+      this->addToHash(this->hosttable, newuser->getHost(), newuser);
+      this->addToHash(this->domaintable, newuser->getDomain(), newuser);
+      this->addToHash(this->usertable, newuser->getUser(), newuser);
       UserHash::addToHash(this->iptable, newuser->getIP(), newuser);
       ++this->userCount;
 
+      if (!fromTrace)
+      {
+        Journal::connect(newuser);
+      }
+
       // Don't check for wingate or clones when doing a TRACE
       if (!fromTrace && !config.isOper(newuser))
       {
@@ -250,7 +234,7 @@ UserHash::add(const std::string & nick, const std::string & userhost,
         if (UserHash::ctcpversionEnable &&
             !config.isExempt(newuser, Config::EXEMPT_VERSION))
         {
-          newuser->version();
+          newuser->version(boost::bind(&UserEntry::cancelVersion, newuser));
         }
 
         if (!config.isExempt(newuser, Config::EXEMPT_CLONE))
@@ -277,8 +261,8 @@ void
 UserHash::setMaskHost(const std::string & nick, const std::string & realHost,
   const std::string & fakeHost)
 {
-  this->maskNick = server.downCase(nick);
-  this->maskRealHost = server.downCase(realHost);
+  this->maskNick = this->server_->downCase(nick);
+  this->maskRealHost = this->server_->downCase(realHost);
   this->maskFakeHost = fakeHost;
 }
 
@@ -398,6 +382,7 @@ UserHash::updateNick(const std::string & oldNick, const std::string & userhost,
   if (find)
   {
     find->setNick(newNick);
+    Journal::nickChange(find, oldNick);
 
     if (UserHash::trapNickChanges)
     {
@@ -453,6 +438,8 @@ UserHash::remove(const std::string & nick, const std::string & userhost,
     std::string host = userhost.substr(at + 1);
     std::string domain = getDomain(host, false);
 
+    Journal::exit(nick, user, host, ip);
+
     // Set this to true if we are unable to remove the entry from one or
     // more of the tables.
     bool error = false;
@@ -465,9 +452,9 @@ UserHash::remove(const std::string & nick, const std::string & userhost,
 
     --this->userCount;
 
-    if (!UserHash::removeFromHash(this->hosttable, host, host, user, nick))
+    if (!this->removeFromHash(this->hosttable, host, host, user, nick))
     {
-      if (!UserHash::removeFromHash(this->hosttable, host, host, user, ""))
+      if (!this->removeFromHash(this->hosttable, host, host, user, ""))
       {
         error = true;
 
@@ -477,9 +464,9 @@ UserHash::remove(const std::string & nick, const std::string & userhost,
       }
     }
 
-    if (!UserHash::removeFromHash(this->domaintable, domain, host, user, nick))
+    if (!this->removeFromHash(this->domaintable, domain, host, user, nick))
     {
-      if (!UserHash::removeFromHash(this->domaintable, domain, host, user, ""))
+      if (!this->removeFromHash(this->domaintable, domain, host, user, ""))
       {
         error = true;
 
@@ -489,9 +476,9 @@ UserHash::remove(const std::string & nick, const std::string & userhost,
       }
     }
 
-    if (!UserHash::removeFromHash(this->usertable, user, host, user, nick))
+    if (!this->removeFromHash(this->usertable, user, host, user, nick))
     {
-      if (!UserHash::removeFromHash(this->usertable, user, host, user, ""))
+      if (!this->removeFromHash(this->usertable, user, host, user, ""))
       {
 	error = true;
 
@@ -527,7 +514,7 @@ void
 UserHash::addToHash(UserEntryTable & table, const std::string & key,
   UserEntryPtr item)
 {
-  const unsigned int index = UserHash::hashFunc(key);
+  const unsigned int index = this->hashFunc(key);
 
   table[index].push_back(item);
 }
@@ -570,7 +557,7 @@ UserHash::removeFromHash(UserEntryTable & table, const std::string & key,
 {
   if (!key.empty())
   {
-    const unsigned int index = UserHash::hashFunc(key);
+    const unsigned int index = this->hashFunc(key);
 
     return UserHash::removeFromHashEntry(table[index], host, user, nick);
   }
@@ -674,7 +661,7 @@ UserHash::have(std::string nick) const
 UserEntryPtr
 UserHash::findUser(const std::string & nick) const
 {
-  std::string lcNick(server.downCase(nick));
+  std::string lcNick(this->server_->downCase(nick));
   UserEntryPtr result;
 
   for (UserEntryTable::const_iterator i = this->hosttable.begin();
@@ -698,16 +685,16 @@ UserHash::findUser(const std::string & nick) const
 UserEntryPtr
 UserHash::findUser(const std::string & nick, const std::string & userhost) const
 {
-  std::string lcNick(server.downCase(nick));
+  std::string lcNick(this->server_->downCase(nick));
   UserEntryPtr result;
 
   std::string::size_type at = userhost.find('@');
   if (std::string::npos != at)
   {
-    std::string lcUser(server.downCase(userhost.substr(0, at)));
-    std::string lcHost(server.downCase(userhost.substr(at + 1)));
+    std::string lcUser(this->server_->downCase(userhost.substr(0, at)));
+    std::string lcHost(this->server_->downCase(userhost.substr(at + 1)));
 
-    const unsigned int hashIndex = UserHash::hashFunc(lcUser);
+    const unsigned int hashIndex = this->hashFunc(lcUser);
 
     const UserEntryList & bucket = this->usertable[hashIndex];
 
@@ -738,7 +725,7 @@ UserHash::reportClasses(BotClient * client, const std::string & className) const
     for (UserEntryList::const_iterator userptr = index->begin();
         userptr != index->end(); ++userptr)
     {
-      std::string name(server.downCase((*userptr)->getClass()));
+      std::string name(this->server_->downCase((*userptr)->getClass()));
       ++unsorted[name];
     }
   }
@@ -786,7 +773,8 @@ UserHash::reportClasses(BotClient * client, const std::string & className) const
   }
   else
   {
-    UnsortedMap::const_iterator pos = unsorted.find(server.downCase(className));
+    UnsortedMap::const_iterator pos =
+      unsorted.find(this->server_->downCase(className));
     if (pos == unsorted.end())
     {
       client->send("*** No users found with class \"" + className + "\"");
@@ -896,7 +884,7 @@ UserHash::reportDomains(BotClient * client, const int minimum) const
       for (UserEntryList::const_iterator userptr = i->begin();
           userptr != i->end(); ++userptr)
       {
-        std::string domain(server.downCase((*userptr)->getDomain()));
+        std::string domain(this->server_->downCase((*userptr)->getDomain()));
         ++unsorted[domain];
       }
     }
@@ -1031,7 +1019,7 @@ UserHash::reportClones(BotClient * client) const
       UserEntryList::const_iterator temp = i->begin();
       for (; temp != userptr; ++temp)
       {
-        if (server.same((*temp)->getHost(), (*userptr)->getHost()))
+        if (this->server_->same((*temp)->getHost(), (*userptr)->getHost()))
 	{
 	  break;
 	}
@@ -1048,7 +1036,7 @@ UserHash::reportClones(BotClient * client) const
         ++temp;
         while (temp != i->end())
 	{
-          if (server.same((*temp)->getHost(), (*userptr)->getHost()))
+          if (this->server_->same((*temp)->getHost(), (*userptr)->getHost()))
 	  {
 	    ++numfound;
             connfromhost.push_back((*temp)->getConnectTime());
@@ -1118,7 +1106,7 @@ UserHash::reportVClones(BotClient * client) const
       for (; temp != userptr; ++temp)
       {
         if (BotSock::sameClassC((*temp)->getIP(), (*userptr)->getIP()) &&
-            server.same((*temp)->getUser(), (*userptr)->getUser()))
+            this->server_->same((*temp)->getUser(), (*userptr)->getUser()))
 	{
 	  break;
 	}
@@ -1136,7 +1124,7 @@ UserHash::reportVClones(BotClient * client) const
         while (temp != i->end())
 	{
           if (BotSock::sameClassC((*temp)->getIP(), (*userptr)->getIP()) &&
-              server.same((*temp)->getUser(), (*userptr)->getUser()))
+              this->server_->same((*temp)->getUser(), (*userptr)->getUser()))
 	  {
 	    ++numfound;
             connectTime.push_back((*temp)->getConnectTime());
@@ -1216,15 +1204,15 @@ UserHash::reportMulti(BotClient * client, const unsigned int minimum) const
 
         if (isNumericIPv4(host))
         {
-          ++unsorted[server.downCase(user + '@' + domain + ".*")];
+          ++unsorted[this->server_->downCase(user + '@' + domain + ".*")];
         }
         else if (isNumericIPv6(host))
         {
-          ++unsorted[server.downCase(user + '@' + domain + ":*")];
+          ++unsorted[this->server_->downCase(user + '@' + domain + ":*")];
         }
         else
         {
-          ++unsorted[server.downCase(user + "@*" + domain)];
+          ++unsorted[this->server_->downCase(user + "@*" + domain)];
         }
       }
     }
@@ -1271,7 +1259,7 @@ UserHash::reportHMulti(BotClient * client, const unsigned int minimum) const
       if (UserHash::operInMulti ||
           (!(*userptr)->getOper() && !config.isOper(*userptr)))
       {
-        ++unsorted[server.downCase((*userptr)->getHost())];
+        ++unsorted[this->server_->downCase((*userptr)->getHost())];
       }
     }
 
@@ -1317,7 +1305,7 @@ UserHash::reportUMulti(BotClient * client, const unsigned int minimum) const
       if (UserHash::operInMulti ||
           (!(*userptr)->getOper() && !config.isOper(*userptr)))
       {
-        ++unsorted[server.downCase((*userptr)->getUser())];
+        ++unsorted[this->server_->downCase((*userptr)->getUser())];
       }
     }
 
@@ -1371,7 +1359,7 @@ UserHash::reportVMulti(BotClient * client, const unsigned int minimum) const
           IP = IP.substr(0, lastDot);
         }
 
-        ++unsorted[server.downCase(user + '@' + IP + ".*")];
+        ++unsorted[this->server_->downCase(user + '@' + IP + ".*")];
       }
     }
 
@@ -1402,7 +1390,7 @@ UserHash::reportVMulti(BotClient * client, const unsigned int minimum) const
 void
 UserHash::checkHostClones(const std::string & host)
 {
-  const unsigned int index = UserHash::hashFunc(host);
+  const unsigned int index = this->hashFunc(host);
 
   std::time_t now = std::time(0);
   std::time_t oldest = now;
@@ -1414,7 +1402,7 @@ UserHash::checkHostClones(const std::string & host)
   for (UserEntryList::iterator find = this->hosttable[index].begin();
     find != this->hosttable[index].end(); ++find)
   {
-    if (server.same((*find)->getHost(), host) &&
+    if (this->server_->same((*find)->getHost(), host) &&
         ((now - (*find)->getConnectTime()) <= UserHash::cloneMaxTime))
     {
       if ((*find)->getReportTime() > 0)
@@ -1490,7 +1478,7 @@ UserHash::checkHostClones(const std::string & host)
   for (UserEntryList::iterator find = this->hosttable[index].begin();
     find != this->hosttable[index].end(); ++find)
   {
-    if (server.same((*find)->getHost(), host) &&
+    if (this->server_->same((*find)->getHost(), host) &&
         ((now - (*find)->getConnectTime()) <= UserHash::cloneMaxTime) &&
         ((*find)->getReportTime() == 0))
     {
@@ -1535,7 +1523,7 @@ UserHash::checkHostClones(const std::string & host)
           currentIdentd = false;
         }
 
-        if (!server.same(lastUser, currentUser))
+        if (!this->server_->same(lastUser, currentUser))
         {
           differentUser = true;
         }
@@ -1714,7 +1702,7 @@ UserHash::checkIpClones(const BotSock::Address & ip)
 
 	currentIp = (*find)->getIP();
 
-        if (!server.same(lastUser, currentUser))
+        if (!this->server_->same(lastUser, currentUser))
         {
           differentUser = true;
         }
@@ -45,7 +45,7 @@ public:
 
   enum ListAction { LIST_VIEW, LIST_COUNT, LIST_KILL };
 
-  UserHash(void);
+  explicit UserHash(class IRC * server = 0);
   virtual ~UserHash(void);
 
   void clear();
@@ -103,6 +103,7 @@ public:
   void reportVMulti(class BotClient * client, const unsigned int minimum) const;
 
   void status(class BotClient * client);
+  int size(void) const { return this->userCount; }
 
   int getUserCountDelta(void);
   void resetUserCountDelta(void);
@@ -112,17 +113,17 @@ private:
   typedef std::vector<UserEntryList> UserEntryTable;
 
   static unsigned int hashFunc(const BotSock::Address & key);
-  static unsigned int hashFunc(const std::string & key);
+  unsigned int hashFunc(const std::string & key) const;
 
   static void addToHash(UserEntryTable & table, const BotSock::Address & key,
     UserEntryPtr item);
-  static void addToHash(UserEntryTable & table, const std::string & key,
+  void addToHash(UserEntryTable & table, const std::string & key,
     UserEntryPtr item);
 
   static bool removeFromHashEntry(UserEntryList & list,
     const std::string & host, const std::string & user,
     const std::string & nick);
-  static bool removeFromHash(UserEntryTable & table, const std::string & key,
+  bool removeFromHash(UserEntryTable & table, const std::string & key,
     const std::string & host, const std::string & user,
     const std::string & nick);
   static bool removeFromHash(UserEntryTable & table,
@@ -140,6 +141,7 @@ private:
   UserEntryTable domaintable;
   UserEntryTable usertable;
   UserEntryTable iptable;
+  class IRC * server_;
   std::string maskNick, maskRealHost, maskFakeHost;
   int userCount, previousCount;
 
@@ -166,7 +168,8 @@ private:
 };
 
 
-extern UserHash users;
+// The users on the current server
+UserHash & users(void);
 
 
 #endif /* __USERHASH_H__ */
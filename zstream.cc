@@ -0,0 +1,219 @@
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+#include <cstring>
+#include <new>
+
+// OOMon Headers
+#include "oomon.h"
+#include "zstream.h"
+#include "timers.h"
+
+
+#ifdef HAVE_LIBZ
+
+// Compressed output is collected this many bytes at a time
+static const std::size_t CHUNK_SIZE = 4096;
+
+
+ZStream::ZStream(const int level)
+  : dirty_(false), rawOut_(0), packedOut_(0), rawIn_(0), packedIn_(0),
+  seconds_(0)
+{
+  std::memset(&this->deflater_, 0, sizeof(this->deflater_));
+  std::memset(&this->inflater_, 0, sizeof(this->inflater_));
+
+  if (Z_OK != ::deflateInit(&this->deflater_, level))
+  {
+    throw std::bad_alloc();
+  }
+  if (Z_OK != ::inflateInit(&this->inflater_))
+  {
+    ::deflateEnd(&this->deflater_);
+    throw std::bad_alloc();
+  }
+}
+
+
+ZStream::~ZStream(void)
+{
+  ::deflateEnd(&this->deflater_);
+  ::inflateEnd(&this->inflater_);
+}
+
+
+// run(flush, out)
+//
+// Compresses the deflater's pending input, appending whatever zlib
+// produces to the output.  Returns false if zlib reported an error.
+//
+bool
+ZStream::run(const int flush, std::string & out)
+{
+  char chunk[CHUNK_SIZE];
+
+  do
+  {
+    this->deflater_.next_out = reinterpret_cast<Bytef *>(chunk);
+    this->deflater_.avail_out = sizeof(chunk);
+
+    if (Z_STREAM_ERROR == ::deflate(&this->deflater_, flush))
+    {
+      return false;
+    }
+
+    const std::size_t produced = sizeof(chunk) - this->deflater_.avail_out;
+    out.append(chunk, produced);
+    this->packedOut_ += produced;
+  }
+  while (0 == this->deflater_.avail_out);
+
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// ZStream::deflate(data, size, out)
+//
+// Description:
+//  Compresses data written to the socket.  zlib usually keeps the data
+//  to itself until it has collected enough, or until flush() is called,
+//  so the output is often empty.
+//
+// Parameters:
+//  data - The data to compress.
+//  size - The number of bytes to compress.
+//  out  - Any compressed output is appended here.
+//
+// Return Value:
+//  The function returns false if zlib reported an error.
+//////////////////////////////////////////////////////////////////////
+bool
+ZStream::deflate(const char * data, const std::size_t size, std::string & out)
+{
+  const double start = Timers::now();
+
+  this->deflater_.next_in =
+    reinterpret_cast<Bytef *>(const_cast<char *>(data));
+  this->deflater_.avail_in = size;
+
+  const bool result = this->run(Z_NO_FLUSH, out);
+
+  this->rawOut_ += size;
+  this->dirty_ = true;
+  this->seconds_ += Timers::now() - start;
+
+  return result;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// ZStream::flush(out)
+//
+// Description:
+//  Finishes the current deflate block with a sync flush, so the other
+//  end can decompress everything written so far.  Nothing is done if
+//  nothing has been written since the last flush.
+//
+// Parameters:
+//  out - The compressed output is appended here.
+//
+// Return Value:
+//  The function returns false if zlib reported an error.
+//////////////////////////////////////////////////////////////////////
+bool
+ZStream::flush(std::string & out)
+{
+  if (!this->dirty_)
+  {
+    return true;
+  }
+
+  const double start = Timers::now();
+
+  this->deflater_.next_in = 0;
+  this->deflater_.avail_in = 0;
+
+  const bool result = this->run(Z_SYNC_FLUSH, out);
+
+  this->dirty_ = false;
+  this->seconds_ += Timers::now() - start;
+
+  return result;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// ZStream::inflate(data, size, out, outSize)
+//
+// Description:
+//  Decompresses data read from the socket, for as long as there is
+//  input left and room in the output.  The input pointer and size are
+//  advanced past whatever was used.  If the output was filled, zlib
+//  may have more to give even if no input is left.
+//
+// Parameters:
+//  data    - The compressed data.
+//  size    - The number of bytes of compressed data.
+//  out     - Where to put the decompressed data.
+//  outSize - The room available at out.
+//
+// Return Value:
+//  The function returns the number of bytes decompressed, or -1 if the
+//  input was corrupt.
+//////////////////////////////////////////////////////////////////////
+long
+ZStream::inflate(const char * & data, std::size_t & size, char * out,
+  const std::size_t outSize)
+{
+  const double start = Timers::now();
+
+  this->inflater_.next_in =
+    reinterpret_cast<Bytef *>(const_cast<char *>(data));
+  this->inflater_.avail_in = size;
+  this->inflater_.next_out = reinterpret_cast<Bytef *>(out);
+  this->inflater_.avail_out = outSize;
+
+  const int status = ::inflate(&this->inflater_, Z_SYNC_FLUSH);
+
+  const std::size_t consumed = size - this->inflater_.avail_in;
+  const std::size_t produced = outSize - this->inflater_.avail_out;
+
+  data += consumed;
+  size -= consumed;
+  this->packedIn_ += consumed;
+  this->rawIn_ += produced;
+  this->seconds_ += Timers::now() - start;
+
+  // Z_BUF_ERROR only means that no progress was possible this time
+  if ((Z_OK != status) && (Z_BUF_ERROR != status))
+  {
+    return -1;
+  }
+
+  return produced;
+}
+
+#endif /* HAVE_LIBZ */
+
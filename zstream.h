@@ -0,0 +1,76 @@
+#ifndef __ZSTREAM_H__
+#define __ZSTREAM_H__
+// ===========================================================================
+// OOMon - Objected Oriented Monitor Bot
+// Copyright (C) 2004  Timothy L. Jensen
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+// ===========================================================================
+
+
+// $Id$
+
+// Std C++ Headers
+#include <string>
+#include <cstddef>
+
+// Boost C++ Headers
+#include <boost/utility.hpp>
+
+// OOMon Headers
+#include "oomon.h"
+
+#ifdef HAVE_LIBZ
+# include <zlib.h>
+#endif
+
+
+#ifdef HAVE_LIBZ
+// A pair of zlib streams, one compressing a socket's output and the
+// other decompressing its input.  Output is held back by zlib until
+// flush() is called, so everything written between flushes shares one
+// deflate block and the dictionary built up by everything before it.
+// The bytes on each side of each stream and the time spent in zlib are
+// counted for the link status.
+class ZStream : private boost::noncopyable
+{
+public:
+  explicit ZStream(const int level);
+  ~ZStream(void);
+
+  bool deflate(const char * data, const std::size_t size, std::string & out);
+  bool flush(std::string & out);
+  long inflate(const char * & data, std::size_t & size, char * out,
+    const std::size_t outSize);
+
+  unsigned long rawOut(void) const { return this->rawOut_; }
+  unsigned long packedOut(void) const { return this->packedOut_; }
+  unsigned long rawIn(void) const { return this->rawIn_; }
+  unsigned long packedIn(void) const { return this->packedIn_; }
+  double seconds(void) const { return this->seconds_; }
+
+private:
+  bool run(const int flush, std::string & out);
+
+  z_stream deflater_;
+  z_stream inflater_;
+  bool dirty_;
+  unsigned long rawOut_, packedOut_, rawIn_, packedIn_;
+  double seconds_;
+};
+#endif /* HAVE_LIBZ */
+
+
+#endif /* __ZSTREAM_H__ */